@@ -0,0 +1,266 @@
+/*
+ * Copyright (c) 2024, Bloomy Controls, Inc. All rights reserved.
+ *
+ * Use of this source code is governed by a BSD-3-clause license that can be
+ * found in the LICENSE file or at https://opensource.org/license/BSD-3-Clause
+ */
+
+#include "MockDevice.h"
+
+#include <fmt/core.h>
+
+#include <array>
+#include <bit>
+#include <boost/asio.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/ip/udp.hpp>
+#include <charconv>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+
+using boost::asio::ip::tcp;
+using boost::asio::ip::udp;
+
+namespace bci::abs::bench {
+
+namespace {
+
+// Number of channels addressed by a "(@1:N)" channel list, or 0 if there is
+// none.
+std::size_t ChannelCount(std::string_view query) {
+  const auto pos = query.find("(@1:");
+  if (pos == query.npos) {
+    return 0;
+  }
+  const auto* first = query.data() + pos + 4;
+  std::size_t count{};
+  std::from_chars(first, query.data() + query.size(), count);
+  return count;
+}
+
+std::string_view Trim(std::string_view v) {
+  while (!v.empty() && (v.front() == ' ' || v.front() == '\r' ||
+                        v.front() == '\n' || v.front() == ':')) {
+    v.remove_prefix(1);
+  }
+  while (!v.empty() && (v.back() == ' ' || v.back() == '\r' ||
+                        v.back() == '\n')) {
+    v.remove_suffix(1);
+  }
+  return v;
+}
+
+std::string ReplyOne(std::string_view query, bool& binary) {
+  query = Trim(query);
+
+  if (query.starts_with("FORM ")) {
+    binary = query.substr(5).starts_with("REAL");
+    return {};
+  }
+
+  if (query.find('?') == query.npos) {
+    return {};
+  }
+
+  if (query.starts_with("*IDN?")) {
+    return "Bloomy Controls,ABS,0001,1.2.0";
+  }
+  if (query.starts_with("SYST:ERR?")) {
+    return "0,\"No error\"";
+  }
+  if (query.starts_with("FORM?")) {
+    return binary ? "REAL,32" : "ASC";
+  }
+
+  const auto count = ChannelCount(query);
+  const bool is_mode = query.starts_with("OUTP:MODE?");
+  const bool is_bool = query.starts_with("AUX:DIN") ||
+                       query.starts_with("OUTP?") ||
+                       query.starts_with("SYST:");
+
+  if (count == 0) {
+    if (is_mode) {
+      return "CV";
+    }
+    return is_bool ? "0" : "1.2345";
+  }
+
+  if (binary && !is_mode && !is_bool) {
+    const auto len = fmt::format("{}", count * sizeof(float));
+    std::string block = fmt::format("#{}{}", len.size(), len);
+    for (std::size_t i = 0; i < count; ++i) {
+      const auto bits = std::bit_cast<std::uint32_t>(1.2345f + i);
+      for (int shift = 24; shift >= 0; shift -= 8) {
+        block.push_back(static_cast<char>((bits >> shift) & 0xFF));
+      }
+    }
+    return block;
+  }
+
+  std::string resp;
+  for (std::size_t i = 0; i < count; ++i) {
+    if (i > 0) {
+      resp += ',';
+    }
+    if (is_mode) {
+      resp += "CV";
+    } else if (is_bool) {
+      resp += (i % 2) ? '1' : '0';
+    } else {
+      fmt::format_to(std::back_inserter(resp), "{:.4f}", 1.2345f + i);
+    }
+  }
+  return resp;
+}
+
+}  // namespace
+
+struct MockDevice::Impl {
+  explicit Impl(std::string_view ip);
+
+  ~Impl();
+
+  void Accept();
+
+  void Serve(std::shared_ptr<tcp::socket> socket,
+             std::shared_ptr<boost::asio::streambuf> buf);
+
+  void Receive();
+
+  boost::asio::io_context io_;
+  tcp::acceptor acceptor_;
+  udp::socket udp_socket_;
+  udp::endpoint udp_sender_;
+  std::array<char, 2048> udp_buf_;
+  bool binary_;
+  std::thread thread_;
+};
+
+MockDevice::Impl::Impl(std::string_view ip)
+    : io_(),
+      acceptor_(io_),
+      udp_socket_(io_),
+      udp_sender_(),
+      udp_buf_(),
+      binary_(false),
+      thread_() {
+  const auto addr = boost::asio::ip::make_address(std::string(ip));
+
+  const tcp::endpoint tcp_ep(addr, 5025);
+  acceptor_.open(tcp_ep.protocol());
+  acceptor_.set_option(tcp::acceptor::reuse_address(true));
+  acceptor_.bind(tcp_ep);
+  acceptor_.listen();
+
+  udp_socket_.open(udp::v4());
+  udp_socket_.bind(udp::endpoint(addr, 5025));
+
+  Accept();
+  Receive();
+
+  thread_ = std::thread([this] { io_.run(); });
+}
+
+MockDevice::Impl::~Impl() {
+  io_.stop();
+  thread_.join();
+}
+
+void MockDevice::Impl::Accept() {
+  acceptor_.async_accept([this](const boost::system::error_code& ec,
+                                tcp::socket socket) {
+    if (ec) {
+      return;
+    }
+    socket.set_option(tcp::no_delay(true));
+    Serve(std::make_shared<tcp::socket>(std::move(socket)),
+          std::make_shared<boost::asio::streambuf>());
+    Accept();
+  });
+}
+
+void MockDevice::Impl::Serve(std::shared_ptr<tcp::socket> socket,
+                             std::shared_ptr<boost::asio::streambuf> buf) {
+  boost::asio::async_read_until(
+      *socket, *buf, '\n',
+      [this, socket, buf](const boost::system::error_code& ec,
+                          std::size_t len) {
+        if (ec) {
+          return;
+        }
+        const auto* data = static_cast<const char*>(buf->data().data());
+        auto reply = std::make_shared<std::string>(
+            MockReply(std::string_view(data, len), binary_));
+        buf->consume(len);
+
+        if (reply->empty()) {
+          Serve(socket, buf);
+          return;
+        }
+
+        boost::asio::async_write(
+            *socket, boost::asio::buffer(*reply),
+            [this, socket, buf, reply](const boost::system::error_code& ec,
+                                       std::size_t) {
+              if (!ec) {
+                Serve(socket, buf);
+              }
+            });
+      });
+}
+
+void MockDevice::Impl::Receive() {
+  udp_socket_.async_receive_from(
+      boost::asio::buffer(udp_buf_), udp_sender_,
+      [this](const boost::system::error_code& ec, std::size_t len) {
+        if (ec) {
+          return;
+        }
+        const auto reply =
+            MockReply(std::string_view(udp_buf_.data(), len), binary_);
+        if (!reply.empty()) {
+          boost::system::error_code ignored;
+          udp_socket_.send_to(boost::asio::buffer(reply), udp_sender_, 0,
+                              ignored);
+        }
+        Receive();
+      });
+}
+
+std::string MockReply(std::string_view command, bool& binary) {
+  // answer each query of a compound command, joined with ';' like the ABS
+  std::string reply;
+  bool first = true;
+  while (!command.empty()) {
+    const auto sep = command.find(';');
+    auto part = ReplyOne(command.substr(0, sep), binary);
+    if (!part.empty()) {
+      if (!first) {
+        reply += ';';
+      }
+      reply += part;
+      first = false;
+    }
+    if (sep == command.npos) {
+      break;
+    }
+    command.remove_prefix(sep + 1);
+  }
+
+  if (!reply.empty()) {
+    reply += "\r\n";
+  }
+  return reply;
+}
+
+MockDevice::MockDevice(std::string_view ip)
+    : impl_(std::make_unique<Impl>(ip)) {}
+
+MockDevice::~MockDevice() = default;
+
+}  // namespace bci::abs::bench
@@ -0,0 +1,42 @@
+/*
+ * Copyright (c) 2024, Bloomy Controls, Inc. All rights reserved.
+ *
+ * Use of this source code is governed by a BSD-3-clause license that can be
+ * found in the LICENSE file or at https://opensource.org/license/BSD-3-Clause
+ */
+
+#ifndef ABS_SCPI_DRIVER_BENCH_MOCKDEVICE_H
+#define ABS_SCPI_DRIVER_BENCH_MOCKDEVICE_H
+
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace bci::abs::bench {
+
+// Build the reply an ABS would send to a command line (including compound
+// commands), or an empty string if the command has no reply. binary is the
+// data format selected with FORM, and is updated by FORM commands.
+std::string MockReply(std::string_view command, bool& binary);
+
+// In-process stand-in for an ABS. Listens for TCP and UDP on port 5025 of the
+// given loopback address and replies to queries with well-formed responses of
+// the same shape a real unit sends (e.g. eight values for "MEAS:VOLT? (@1:8)").
+// Runs on its own thread.
+class MockDevice {
+ public:
+  explicit MockDevice(std::string_view ip = "127.0.0.1");
+
+  ~MockDevice();
+
+  MockDevice(const MockDevice&) = delete;
+  MockDevice& operator=(const MockDevice&) = delete;
+
+ private:
+  struct Impl;
+  std::unique_ptr<Impl> impl_;
+};
+
+}  // namespace bci::abs::bench
+
+#endif /* ABS_SCPI_DRIVER_BENCH_MOCKDEVICE_H */
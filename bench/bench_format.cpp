@@ -0,0 +1,97 @@
+/*
+ * Copyright (c) 2024, Bloomy Controls, Inc. All rights reserved.
+ *
+ * Use of this source code is governed by a BSD-3-clause license that can be
+ * found in the LICENSE file or at https://opensource.org/license/BSD-3-Clause
+ */
+
+#include <benchmark/benchmark.h>
+#include <bci/abs/CommDriver.h>
+#include <bci/abs/CommonTypes.h>
+#include <bci/abs/ScpiClient.h>
+
+#include <array>
+#include <memory>
+#include <string>
+#include <string_view>
+
+using namespace bci::abs;
+
+namespace {
+
+// Driver which discards everything written to it, so the benchmarks measure
+// only the cost of building each command.
+class NullDriver : public drivers::CommDriver {
+ public:
+  ErrorCode Write(std::string_view data, unsigned int) const override {
+    benchmark::DoNotOptimize(data.data());
+    return ErrorCode::kSuccess;
+  }
+
+  Result<std::string> ReadLine(unsigned int) const override {
+    return tl::unexpected(ErrorCode::kReadTimedOut);
+  }
+};
+
+ScpiClient MakeClient() { return ScpiClient{std::make_shared<NullDriver>()}; }
+
+void BM_SetCellVoltage(benchmark::State& state) {
+  const auto client = MakeClient();
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(client.SetCellVoltage(3, 1.2345f));
+  }
+}
+BENCHMARK(BM_SetCellVoltage);
+
+void BM_SetAllCellVoltages(benchmark::State& state) {
+  const auto client = MakeClient();
+  const std::array<float, kCellCount> voltages{1.1f, 1.2f, 1.3f, 1.4f,
+                                               1.5f, 1.6f, 1.7f, 1.8f};
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(client.SetAllCellVoltages(voltages));
+  }
+}
+BENCHMARK(BM_SetAllCellVoltages);
+
+void BM_SetAllCellSourcing(benchmark::State& state) {
+  const auto client = MakeClient();
+  const std::array<float, kCellCount> limits{0.5f, 1.0f, 1.5f, 2.0f,
+                                             2.5f, 3.0f, 3.5f, 4.0f};
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(client.SetAllCellSourcing(limits));
+  }
+}
+BENCHMARK(BM_SetAllCellSourcing);
+
+void BM_SetAllCellSinking(benchmark::State& state) {
+  const auto client = MakeClient();
+  const std::array<float, kCellCount> limits{-0.5f, -1.0f, -1.5f, -2.0f,
+                                             -2.5f, -3.0f, -3.5f, -4.0f};
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(client.SetAllCellSinking(limits));
+  }
+}
+BENCHMARK(BM_SetAllCellSinking);
+
+void BM_SetAllAnalogOutputs(benchmark::State& state) {
+  const auto client = MakeClient();
+  const std::array<float, kAnalogOutputCount> voltages{-4.0f, -2.0f, 0.0f,
+                                                       2.0f,  4.0f,  6.0f,
+                                                       8.0f,  9.5f};
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(client.SetAllAnalogOutputs(voltages));
+  }
+}
+BENCHMARK(BM_SetAllAnalogOutputs);
+
+void BM_SetAllGlobalModelInputs(benchmark::State& state) {
+  const auto client = MakeClient();
+  const std::array<float, kGlobalModelInputCount> values{
+      0.125f, 1.0f, 22.5f, 333.0f, -4.75f, 5e-3f, 6e6f, 7.0f};
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(client.SetAllGlobalModelInputs(values));
+  }
+}
+BENCHMARK(BM_SetAllGlobalModelInputs);
+
+}  // namespace
@@ -0,0 +1,125 @@
+/*
+ * Copyright (c) 2024, Bloomy Controls, Inc. All rights reserved.
+ *
+ * Use of this source code is governed by a BSD-3-clause license that can be
+ * found in the LICENSE file or at https://opensource.org/license/BSD-3-Clause
+ */
+
+#include <benchmark/benchmark.h>
+#include <bci/abs/CommonTypes.h>
+#include <fmt/core.h>
+
+#include <array>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+
+#include "MockDevice.h"
+#include "ScpiUtil.h"
+#include "StringUtil.h"
+
+using namespace bci::abs;
+
+namespace {
+
+// Responses exactly as a unit sends them, including the terminator.
+std::string ReplyTo(std::string_view query, bool binary = false) {
+  return bench::MockReply(query, binary);
+}
+
+void BM_StrViewToFloat(benchmark::State& state) {
+  constexpr std::string_view kText{" 1.2345\r\n"};
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(util::StrViewToFloat(kText));
+  }
+}
+BENCHMARK(BM_StrViewToFloat);
+
+void BM_StrViewToInt(benchmark::State& state) {
+  constexpr std::string_view kText{"131072\r\n"};
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(util::StrViewToInt<std::uint32_t>(kText));
+  }
+}
+BENCHMARK(BM_StrViewToInt);
+
+void BM_Trim(benchmark::State& state) {
+  constexpr std::string_view kText{"  1.2345,2.3456\r\n"};
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(util::Trim(kText));
+  }
+}
+BENCHMARK(BM_Trim);
+
+template <std::size_t kLen>
+void BM_ParseFloatArray(benchmark::State& state) {
+  const auto resp = ReplyTo(fmt::format("MEAS:VOLT? (@1:{})\r\n", kLen));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(scpi::ParseRespFloatArray<kLen>(resp));
+  }
+  state.SetBytesProcessed(state.iterations() * resp.size());
+}
+BENCHMARK_TEMPLATE(BM_ParseFloatArray, kCellCount);
+BENCHMARK_TEMPLATE(BM_ParseFloatArray, kModelOutputCount);
+
+template <std::size_t kLen>
+void BM_DecodeFloatBlock(benchmark::State& state) {
+  const auto resp =
+      ReplyTo(fmt::format("MEAS:VOLT? (@1:{})\r\n", kLen), true);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(scpi::ParseRespFloatArray<kLen>(resp));
+  }
+  state.SetBytesProcessed(state.iterations() * resp.size());
+}
+BENCHMARK_TEMPLATE(BM_DecodeFloatBlock, kCellCount);
+BENCHMARK_TEMPLATE(BM_DecodeFloatBlock, kModelOutputCount);
+
+void BM_ParseBoolMask(benchmark::State& state) {
+  const auto resp = ReplyTo("AUX:DIN? (@1:4)\r\n");
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(
+        scpi::ParseRespBoolMask<kDigitalInputCount>(resp));
+  }
+}
+BENCHMARK(BM_ParseBoolMask);
+
+void BM_ParseCellModes(benchmark::State& state) {
+  const auto resp = ReplyTo("OUTP:MODE? (@1:8)\r\n");
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(
+        scpi::ParseCellOperatingModeArray<kCellCount>(resp));
+  }
+}
+BENCHMARK(BM_ParseCellModes);
+
+void BM_ParseScpiError(benchmark::State& state) {
+  const auto resp = ReplyTo("SYST:ERR?\r\n");
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(scpi::ParseScpiError(resp));
+  }
+}
+BENCHMARK(BM_ParseScpiError);
+
+void BM_ParseSnapshot(benchmark::State& state) {
+  const auto resp = ReplyTo(
+      "MEAS:VOLT? (@1:8);:MEAS:CURR? (@1:8);:OUTP:MODE? (@1:8);"
+      ":AUX:AIN? (@1:8);:AUX:DIN? (@1:4);:SYST:ALARM?\r\n",
+      state.range(0) != 0);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(scpi::ParseMeasurementSnapshot(resp));
+  }
+  state.SetBytesProcessed(state.iterations() * resp.size());
+}
+BENCHMARK(BM_ParseSnapshot)->ArgName("binary")->Arg(0)->Arg(1);
+
+void BM_FindResponseEnd(benchmark::State& state) {
+  const auto resp = ReplyTo("MOD:OUT? (@1:36)\r\n", state.range(0) != 0);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(scpi::FindResponseEnd(resp));
+  }
+  state.SetBytesProcessed(state.iterations() * resp.size());
+}
+BENCHMARK(BM_FindResponseEnd)->ArgName("binary")->Arg(0)->Arg(1);
+
+}  // namespace
@@ -0,0 +1,137 @@
+/*
+ * Copyright (c) 2024, Bloomy Controls, Inc. All rights reserved.
+ *
+ * Use of this source code is governed by a BSD-3-clause license that can be
+ * found in the LICENSE file or at https://opensource.org/license/BSD-3-Clause
+ */
+
+#include <benchmark/benchmark.h>
+#include <bci/abs/CommonTypes.h>
+#include <bci/abs/ScpiClient.h>
+#include <bci/abs/TcpDriver.h>
+#include <bci/abs/UdpDriver.h>
+
+#include <memory>
+#include <string_view>
+
+#include "MockDevice.h"
+
+using namespace bci::abs;
+
+namespace {
+
+constexpr std::string_view kDeviceIp{"127.0.0.1"};
+
+bench::MockDevice& Device() {
+  static bench::MockDevice device{kDeviceIp};
+  return device;
+}
+
+struct Tcp {
+  static ScpiClient Connect() {
+    auto driver = std::make_shared<drivers::TcpDriver>();
+    if (driver->Connect(kDeviceIp, 500) != ErrorCode::kSuccess) {
+      return ScpiClient{nullptr};
+    }
+    return ScpiClient{driver};
+  }
+};
+
+// TCP without going through CommDriver's virtual functions.
+struct TcpDirect {
+  static BasicScpiClient<drivers::TcpDriver> Connect() {
+    auto driver = std::make_shared<drivers::TcpDriver>();
+    if (driver->Connect(kDeviceIp, 500) != ErrorCode::kSuccess) {
+      return BasicScpiClient<drivers::TcpDriver>{nullptr};
+    }
+    return BasicScpiClient<drivers::TcpDriver>{driver};
+  }
+};
+
+struct Udp {
+  static ScpiClient Connect() {
+    auto driver = std::make_shared<drivers::UdpDriver>();
+    if (driver->Open(kDeviceIp) != ErrorCode::kSuccess) {
+      return ScpiClient{nullptr};
+    }
+    return ScpiClient{driver};
+  }
+};
+
+// Run a query against the mock device once per iteration, reporting the
+// first failure.
+template <class Transport, class F>
+void RunQuery(benchmark::State& state, F&& query, bool binary = false) {
+  Device();
+  const auto client = Transport::Connect();
+  if (!client.GetDriver()) {
+    state.SkipWithError("failed to connect to mock device");
+    return;
+  }
+
+  if (auto e = client.SetBinaryTransfer(binary); e != ErrorCode::kSuccess) {
+    state.SkipWithError(ErrorMessage(e));
+    return;
+  }
+
+  for (auto _ : state) {
+    auto res = query(client);
+    if (!res) {
+      state.SkipWithError(ErrorMessage(res.error()));
+      break;
+    }
+    benchmark::DoNotOptimize(res);
+  }
+}
+
+template <class Transport>
+void BM_GetAlarms(benchmark::State& state) {
+  RunQuery<Transport>(state, [](auto& c) { return c.GetAlarms(); });
+}
+BENCHMARK_TEMPLATE(BM_GetAlarms, Tcp)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_GetAlarms, TcpDirect)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_GetAlarms, Udp)->UseRealTime();
+
+template <class Transport>
+void BM_MeasureAllCellVoltages(benchmark::State& state) {
+  RunQuery<Transport>(
+      state, [](auto& c) { return c.MeasureAllCellVoltages(); },
+      state.range(0) != 0);
+}
+BENCHMARK_TEMPLATE(BM_MeasureAllCellVoltages, Tcp)
+    ->ArgName("binary")
+    ->Arg(0)
+    ->Arg(1)
+    ->UseRealTime();
+BENCHMARK_TEMPLATE(BM_MeasureAllCellVoltages, Udp)
+    ->ArgName("binary")
+    ->Arg(0)
+    ->Arg(1)
+    ->UseRealTime();
+
+template <class Transport>
+void BM_GetAllModelOutputs(benchmark::State& state) {
+  RunQuery<Transport>(
+      state, [](auto& c) { return c.GetAllModelOutputs(); },
+      state.range(0) != 0);
+}
+BENCHMARK_TEMPLATE(BM_GetAllModelOutputs, Tcp)
+    ->ArgName("binary")
+    ->Arg(0)
+    ->Arg(1)
+    ->UseRealTime();
+BENCHMARK_TEMPLATE(BM_GetAllModelOutputs, Udp)
+    ->ArgName("binary")
+    ->Arg(0)
+    ->Arg(1)
+    ->UseRealTime();
+
+template <class Transport>
+void BM_MeasureSnapshot(benchmark::State& state) {
+  RunQuery<Transport>(state, [](auto& c) { return c.MeasureSnapshot(); });
+}
+BENCHMARK_TEMPLATE(BM_MeasureSnapshot, Tcp)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_MeasureSnapshot, TcpDirect)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_MeasureSnapshot, Udp)->UseRealTime();
+
+}  // namespace
@@ -0,0 +1,330 @@
+/*
+ * Copyright (c) 2024, Bloomy Controls, Inc. All rights reserved.
+ *
+ * Use of this source code is governed by a BSD-3-clause license that can be
+ * found in the LICENSE file or at https://opensource.org/license/BSD-3-Clause
+ */
+
+/**
+ * @file
+ * @brief Asynchronous SCPI client.
+ */
+#ifndef ABS_SCPI_DRIVER_INCLUDE_BCI_ABS_ASYNCSCPICLIENT_H
+#define ABS_SCPI_DRIVER_INCLUDE_BCI_ABS_ASYNCSCPICLIENT_H
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+
+#include "CommDriver.h"
+#include "CommonTypes.h"
+
+namespace bci::abs {
+
+/**
+ * @brief Asynchronous SCPI client.
+ *
+ * Unlike ScpiClient, which blocks until each reply arrives, every function of
+ * this class returns immediately and reports its result to a completion
+ * handler. Combined with drivers attached to a shared IoContext, this allows a
+ * single thread to control many devices at once.
+ *
+ * Operations on one client are performed in the order they were started, one
+ * at a time. Each operation's handler returns before the next operation
+ * starts, so the handlers of one client are called in order and never run
+ * concurrently, even on an IoContext with several worker threads. Handlers are
+ * called on a thread running the driver's IoContext. Drivers without an
+ * IoContext complete each operation before returning, so the handler is called
+ * on the calling thread. Invalid arguments are also reported before returning.
+ *
+ * Only the subset of ScpiClient needed by fast control and acquisition loops
+ * is provided: system status and error queries, single-cell enable, voltage,
+ * and current limit setpoints, cell and analog and digital input
+ * measurements, and measurement snapshots. Use a ScpiClient for everything
+ * else, such as configuration, modeling, and calibration. Setpoints are
+ * clamped to the same limits as ScpiClient.
+ *
+ * Example usage (error handling omitted):
+ * @code{.cpp}
+ * bci::abs::IoContext io;
+ * auto driver{std::make_shared<bci::abs::drivers::UdpDriver>(io)};
+ * driver->Open("192.168.1.100");
+ * bci::abs::AsyncScpiClient client{driver};
+ * client.SetCellVoltage(0, 1.35f, [](bci::abs::ErrorCode) {});
+ * client.MeasureCellVoltage(0, [](bci::abs::Result<float> v) {
+ *   if (v) {
+ *     std::cout << "cell 1 voltage: " << *v << "\n";
+ *   }
+ * });
+ * io.Run();
+ * @endcode
+ */
+class AsyncScpiClient {
+ public:
+  /// Completion handler for queries.
+  template <typename T>
+  using Handler = std::function<void(Result<T>)>;
+
+  /// Completion handler for commands.
+  using ErrorHandler = std::function<void(ErrorCode)>;
+
+  /**
+   * @brief Initialize an AsyncScpiClient with a driver handle.
+   *
+   * @param[in] driver pointer to a comm driver
+   */
+  explicit AsyncScpiClient(std::shared_ptr<drivers::CommDriver> driver);
+
+  /**
+   * @brief Move construct from another AsyncScpiClient.
+   *
+   * @param[in] other AsyncScpiClient to move from
+   */
+  AsyncScpiClient(AsyncScpiClient&& other) noexcept;
+
+  AsyncScpiClient(const AsyncScpiClient&) = delete;
+
+  /**
+   * @brief Move assign from another AsyncScpiClient.
+   *
+   * @param[in] rhs AsyncScpiClient to move from
+   *
+   * @return Reference to self.
+   */
+  AsyncScpiClient& operator=(AsyncScpiClient&& rhs) noexcept;
+
+  AsyncScpiClient& operator=(const AsyncScpiClient&) = delete;
+
+  /**
+   * @brief DTOR. Operations already started still complete and call their
+   * handlers.
+   */
+  ~AsyncScpiClient();
+
+  /**
+   * @brief Set the read timeout for the client. Applies to operations started
+   * after this call. The default is 150ms.
+   *
+   * @param[in] timeout_ms new read timeout in milliseconds
+   *
+   * @return The previous timeout value.
+   */
+  unsigned int SetReadTimeout(unsigned int timeout_ms) noexcept;
+
+  /**
+   * @name System Control
+   */
+  ///@{
+
+  /**
+   * @brief Query general information about the unit.
+   *
+   * @param[in] handler called with a DeviceInfo structure or an error code
+   */
+  void GetDeviceInfo(Handler<DeviceInfo> handler) const;
+
+  /**
+   * @brief Query the device's serial ID.
+   *
+   * @param[in] handler called with the device ID or an error code
+   */
+  void GetDeviceId(Handler<std::uint8_t> handler) const;
+
+  /**
+   * @brief Query the number of errors in the device's error queue.
+   *
+   * @param[in] handler called with the error count or an error code
+   */
+  void GetErrorCount(Handler<int> handler) const;
+
+  /**
+   * @brief Pop the next error from the SCPI error queue.
+   *
+   * @param[in] handler called with the error or an error code
+   */
+  void GetNextError(Handler<ScpiError> handler) const;
+
+  /**
+   * @brief Clear the device's error queue.
+   *
+   * @param[in] handler called with an error code
+   */
+  void ClearErrors(ErrorHandler handler) const;
+
+  /**
+   * @brief Get the alarms raised on the unit.
+   *
+   * @param[in] handler called with the alarm bitmask or an error code
+   */
+  void GetAlarms(Handler<std::uint32_t> handler) const;
+
+  /**
+   * @brief Get the system interlock state.
+   *
+   * @param[in] handler called with the interlock state or an error code
+   */
+  void GetInterlockState(Handler<bool> handler) const;
+
+  ///@}
+
+  /**
+   * @name Cell Control
+   */
+  ///@{
+
+  /**
+   * @brief Enable or disable a single cell.
+   *
+   * @param[in] cell target cell index, 0-7
+   * @param[in] en whether to enable the cell
+   * @param[in] handler called with an error code
+   */
+  void EnableCell(unsigned int cell, bool en, ErrorHandler handler) const;
+
+  /**
+   * @brief Set a single cell's target voltage.
+   *
+   * @param[in] cell target cell index, 0-7
+   * @param[in] voltage cell voltage
+   * @param[in] handler called with an error code
+   */
+  void SetCellVoltage(unsigned int cell, float voltage,
+                      ErrorHandler handler) const;
+
+  /**
+   * @brief Set all cells to the same target voltage.
+   *
+   * @param[in] voltage cell voltage
+   * @param[in] handler called with an error code
+   */
+  void SetAllCellVoltages(float voltage, ErrorHandler handler) const;
+
+  /**
+   * @brief Query a single cell's target voltage.
+   *
+   * @param[in] cell target cell index, 0-7
+   * @param[in] handler called with the target voltage or an error code
+   */
+  void GetCellVoltageTarget(unsigned int cell, Handler<float> handler) const;
+
+  /**
+   * @brief Set a single cell's sourcing current limit.
+   *
+   * @param[in] cell target cell index, 0-7
+   * @param[in] limit sourcing limit
+   * @param[in] handler called with an error code
+   */
+  void SetCellSourcing(unsigned int cell, float limit,
+                       ErrorHandler handler) const;
+
+  /**
+   * @brief Set a single cell's sinking current limit.
+   *
+   * @param[in] cell target cell index, 0-7
+   * @param[in] limit sinking limit
+   * @param[in] handler called with an error code
+   */
+  void SetCellSinking(unsigned int cell, float limit,
+                      ErrorHandler handler) const;
+
+  /**
+   * @brief Measure a single cell's voltage.
+   *
+   * @param[in] cell target cell index, 0-7
+   * @param[in] handler called with the measured voltage or an error code
+   */
+  void MeasureCellVoltage(unsigned int cell, Handler<float> handler) const;
+
+  /**
+   * @brief Measure all cell voltages.
+   *
+   * @param[in] handler called with an array of voltages or an error code
+   */
+  void MeasureAllCellVoltages(
+      Handler<std::array<float, kCellCount>> handler) const;
+
+  /**
+   * @brief Measure a single cell's current.
+   *
+   * @param[in] cell target cell index, 0-7
+   * @param[in] handler called with the measured current or an error code
+   */
+  void MeasureCellCurrent(unsigned int cell, Handler<float> handler) const;
+
+  /**
+   * @brief Measure all cell currents.
+   *
+   * @param[in] handler called with an array of currents or an error code
+   */
+  void MeasureAllCellCurrents(
+      Handler<std::array<float, kCellCount>> handler) const;
+
+  /**
+   * @brief Query all cells' operating modes.
+   *
+   * @param[in] handler called with an array of modes or an error code
+   */
+  void GetAllCellOperatingModes(
+      Handler<std::array<CellMode, kCellCount>> handler) const;
+
+  ///@}
+
+  /**
+   * @name Aux IO Control
+   */
+  ///@{
+
+  /**
+   * @brief Measure a single analog input.
+   *
+   * @param[in] channel target channel index, 0-7
+   * @param[in] handler called with the measured voltage or an error code
+   */
+  void MeasureAnalogInput(unsigned int channel, Handler<float> handler) const;
+
+  /**
+   * @brief Measure all analog inputs.
+   *
+   * @param[in] handler called with an array of voltages or an error code
+   */
+  void MeasureAllAnalogInputs(
+      Handler<std::array<float, kAnalogInputCount>> handler) const;
+
+  /**
+   * @brief Measure all digital inputs.
+   *
+   * @param[in] handler called with a bitmask of input states or an error code
+   */
+  void MeasureAllDigitalInputsMasked(Handler<unsigned int> handler) const;
+
+  ///@}
+
+  /**
+   * @name Snapshots
+   */
+  ///@{
+
+  /**
+   * @brief Measure all cell voltages and currents, cell operating modes, analog
+   * and digital inputs, and alarms in a single transaction.
+   *
+   * @param[in] handler called with the measurements or an error code
+   */
+  void MeasureSnapshot(Handler<MeasurementSnapshot> handler) const;
+
+  ///@}
+
+ private:
+  // Queue a command on the driver. Queries wait for a reply.
+  void Submit(std::string command, bool query,
+              std::function<void(Result<std::string>)> on_done) const;
+
+  struct Impl;
+  std::shared_ptr<Impl> impl_;
+};
+
+}  // namespace bci::abs
+
+#endif /* ABS_SCPI_DRIVER_INCLUDE_BCI_ABS_ASYNCSCPICLIENT_H */
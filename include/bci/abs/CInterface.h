@@ -83,6 +83,12 @@ extern "C" {
 #define ABS_SCPI_ERR_ALLOCATION_FAILED (-23)
 /// Unexpected exception
 #define ABS_SCPI_ERR_UNEXPECTED_EXCEPTION (-24)
+/// Failed to create or open a file
+#define ABS_SCPI_ERR_FILE_ERROR (-25)
+/// Invalid file format
+#define ABS_SCPI_ERR_INVALID_FILE (-26)
+/// Response too long
+#define ABS_SCPI_ERR_RESPONSE_TOO_LONG (-27)
 /** @} */
 
 /**
@@ -170,6 +176,129 @@ typedef struct AbsModelInfo {
 } AbsModelInfo;
 /** @} */
 
+/**
+ * @addtogroup CSnapshot
+ * @{
+ */
+/// Measurements taken from the ABS in a single transaction.
+typedef struct AbsMeasurementSnapshot {
+  float cell_voltages[8];  ///< Cell voltages.
+  float cell_currents[8];  ///< Cell currents.
+  int cell_modes[8];       ///< Cell operating modes (see ABS_CELL_MODE_*).
+  float analog_inputs[8];  ///< Analog input voltages.
+  unsigned int digital_inputs;  ///< Digital input states, 1 bit per input.
+  uint32_t alarms;              ///< Alarms bitmask.
+} AbsMeasurementSnapshot;
+/** @} */
+
+/**
+ * @addtogroup CBatch
+ * @{
+ */
+/**
+ * @defgroup BatchOps Batch Operation Codes
+ * Operations which may be performed by AbsScpiClient_ExecuteBatch(). Each
+ * operation notes which fields of AbsBatchOp it uses and the type of its
+ * output.
+ * @{
+ */
+/// Enable or disable a cell (channel, value: nonzero to enable).
+#define ABS_BATCH_ENABLE_CELL 1
+/// Set a cell's voltage (channel, value).
+#define ABS_BATCH_SET_CELL_VOLTAGE 2
+/// Set a cell's sourcing current limit (channel, value).
+#define ABS_BATCH_SET_CELL_SOURCING 3
+/// Set a cell's sinking current limit (channel, value).
+#define ABS_BATCH_SET_CELL_SINKING 4
+/// Set a cell's fault state (channel, value: one of ABS_CELL_FAULT_*).
+#define ABS_BATCH_SET_CELL_FAULT 5
+/// Set a cell's sense range (channel, value: one of ABS_CELL_SENSE_RANGE_*).
+#define ABS_BATCH_SET_CELL_SENSE_RANGE 6
+/// Set an analog output's voltage (channel, value).
+#define ABS_BATCH_SET_ANALOG_OUTPUT 7
+/// Set a digital output's level (channel, value: nonzero for high).
+#define ABS_BATCH_SET_DIGITAL_OUTPUT 8
+/// Set a global model input (channel, value).
+#define ABS_BATCH_SET_GLOBAL_MODEL_INPUT 9
+/// Set a local model input (channel, value).
+#define ABS_BATCH_SET_LOCAL_MODEL_INPUT 10
+/// Query the error count (out: int).
+#define ABS_BATCH_GET_ERROR_COUNT 32
+/// Query the alarms bitmask (out: uint32_t).
+#define ABS_BATCH_GET_ALARMS 33
+/// Query the interlock state (out: bool).
+#define ABS_BATCH_GET_INTERLOCK_STATE 34
+/// Query whether a cell is enabled (channel, out: bool).
+#define ABS_BATCH_GET_CELL_ENABLED 35
+/// Query a cell's voltage set point (channel, out: float).
+#define ABS_BATCH_GET_CELL_VOLTAGE_TARGET 36
+/// Query a cell's sourcing current limit (channel, out: float).
+#define ABS_BATCH_GET_CELL_SOURCING_LIMIT 37
+/// Query a cell's sinking current limit (channel, out: float).
+#define ABS_BATCH_GET_CELL_SINKING_LIMIT 38
+/// Query a cell's fault state (channel, out: int).
+#define ABS_BATCH_GET_CELL_FAULT 39
+/// Query a cell's sense range (channel, out: int).
+#define ABS_BATCH_GET_CELL_SENSE_RANGE 40
+/// Measure a cell's voltage (channel, out: float).
+#define ABS_BATCH_MEASURE_CELL_VOLTAGE 41
+/// Measure all cells' voltages (out: float[8]).
+#define ABS_BATCH_MEASURE_ALL_CELL_VOLTAGES 42
+/// Measure a cell's current (channel, out: float).
+#define ABS_BATCH_MEASURE_CELL_CURRENT 43
+/// Measure all cells' currents (out: float[8]).
+#define ABS_BATCH_MEASURE_ALL_CELL_CURRENTS 44
+/// Query a cell's operating mode (channel, out: int).
+#define ABS_BATCH_GET_CELL_OPERATING_MODE 45
+/// Query an analog output's voltage (channel, out: float).
+#define ABS_BATCH_GET_ANALOG_OUTPUT 46
+/// Query a digital output's level (channel, out: bool).
+#define ABS_BATCH_GET_DIGITAL_OUTPUT 47
+/// Measure an analog input (channel, out: float).
+#define ABS_BATCH_MEASURE_ANALOG_INPUT 48
+/// Measure all analog inputs (out: float[8]).
+#define ABS_BATCH_MEASURE_ALL_ANALOG_INPUTS 49
+/// Measure a digital input (channel, out: bool).
+#define ABS_BATCH_MEASURE_DIGITAL_INPUT 50
+/// Measure all digital inputs (out: unsigned int, 1 bit per input).
+#define ABS_BATCH_MEASURE_ALL_DIGITAL_INPUTS 51
+/// Query the model status (out: uint8_t, see ABS_MODEL_STATUS_*).
+#define ABS_BATCH_GET_MODEL_STATUS 52
+/// Query a global model input (channel, out: float).
+#define ABS_BATCH_GET_GLOBAL_MODEL_INPUT 53
+/// Query a local model input (channel, out: float).
+#define ABS_BATCH_GET_LOCAL_MODEL_INPUT 54
+/// Query a model output (channel, out: float).
+#define ABS_BATCH_GET_MODEL_OUTPUT 55
+/** @} */
+
+/// One operation in a batch.
+typedef struct AbsBatchOp {
+  int opcode;            ///< Operation to perform (see ABS_BATCH_*).
+  unsigned int channel;  ///< Cell, channel, or model input index, if used.
+  float value;           ///< Value to set, if used.
+  void* out;             ///< Query output, of the type noted by the opcode.
+  int error;             ///< Set to the operation's error code.
+} AbsBatchOp;
+/** @} */
+
+/**
+ * @addtogroup CAcq
+ * @{
+ */
+/// Continuous acquisition handle.
+typedef void* AbsAcquisitionHandle;
+
+/// One set of measurements taken by a continuous acquisition.
+typedef struct AbsAcquisitionSample {
+  int64_t timestamp_ns;  ///< Time taken, in nanoseconds since the Unix epoch.
+  uint64_t sequence;     ///< Index of the sampling period.
+  unsigned int device;   ///< Index of the client the sample came from.
+  int error;             ///< Error code of the query.
+  AbsMeasurementSnapshot snapshot;  ///< Measurements (valid if error is 0).
+} AbsAcquisitionSample;
+/** @} */
+
 /**
  * @addtogroup CDisc
  * @{
@@ -189,6 +318,24 @@ typedef struct AbsSerialDiscoveryResult {
 } AbsSerialDiscoveryResult;
 /** @} */
 
+/**
+ * @addtogroup CInstr
+ * @{
+ */
+/// Per-command latency histogram handle.
+typedef void* AbsLatencyHistogramHandle;
+
+/// Latency statistics for a single command.
+typedef struct AbsLatencyStats {
+  uint64_t count;     ///< Number of calls.
+  uint64_t errors;    ///< Number of calls which failed.
+  uint64_t timeouts;  ///< Number of calls which timed out.
+  double p50_us;      ///< Median latency in microseconds.
+  double p99_us;      ///< 99th percentile latency in microseconds.
+  double max_us;      ///< Maximum latency in microseconds.
+} AbsLatencyStats;
+/** @} */
+
 /**
  * @brief Get an error message to describe an error code returned by the driver.
  *
@@ -274,6 +421,19 @@ int AbsScpiClient_OpenUdpMulticast(AbsScpiClientHandle handle,
  */
 int AbsScpiClient_Close(AbsScpiClientHandle handle);
 
+/**
+ * @brief Enable or disable thread-safe mode, in which the client may be used
+ * from several threads at once. Each command or query is performed as one
+ * transaction, and commands go ahead of other threads' waiting queries. Must
+ * not be called while another thread is using the client.
+ *
+ * @param[in] handle SCPI client
+ * @param[in] en whether to enable thread-safe mode
+ *
+ * @return 0 on success or a negative error code.
+ */
+int AbsScpiClient_SetThreadSafe(AbsScpiClientHandle handle, bool en);
+
 /**
  * @brief Set the target device ID for communication. Only applies to RS-485
  * connections.
@@ -462,6 +622,29 @@ int AbsScpiClient_ClearRecoverableAlarms(AbsScpiClientHandle handle);
  */
 int AbsScpiClient_Reboot(AbsScpiClientHandle handle);
 
+/**
+ * @brief Select whether the unit returns floating-point readbacks as binary
+ * blocks instead of text. Responses in either format are decoded
+ * automatically. Not all firmware supports binary transfers, so use
+ * AbsScpiClient_GetBinaryTransfer() to confirm the change.
+ *
+ * @param[in] handle SCPI client
+ * @param[in] en whether to use binary transfers
+ *
+ * @return 0 on success or a negative error code.
+ */
+int AbsScpiClient_SetBinaryTransfer(AbsScpiClientHandle handle, bool en);
+
+/**
+ * @brief Query whether the unit returns floating-point readbacks in binary.
+ *
+ * @param[in] handle SCPI client
+ * @param[out] en_out pointer to whether binary transfers are enabled
+ *
+ * @return 0 on success or a negative error code.
+ */
+int AbsScpiClient_GetBinaryTransfer(AbsScpiClientHandle handle, bool* en_out);
+
 /** @} */
 
 /**
@@ -1310,6 +1493,148 @@ int AbsScpiClient_GetAllModelOutputs(AbsScpiClientHandle handle,
 
 /** @} */
 
+/**
+ * @defgroup CSnapshot Measurement Snapshots
+ * Functions for taking many measurements in a single transaction.
+ * @{
+ */
+
+/**
+ * @brief Measure all cell voltages and currents, cell operating modes, analog
+ * and digital inputs, and alarms in a single transaction.
+ *
+ * This requires only one round trip to the device, so it is much faster than
+ * querying each value individually.
+ *
+ * @param[in] handle SCPI client
+ * @param[out] snapshot_out pointer to the returned measurements
+ *
+ * @return 0 on success or a negative error code.
+ */
+int AbsScpiClient_MeasureSnapshot(AbsScpiClientHandle handle,
+                                  AbsMeasurementSnapshot* snapshot_out);
+
+/** @} */
+
+/**
+ * @defgroup CBatch Batched Operations
+ * Functions for performing many operations in a single call.
+ * @{
+ */
+
+/**
+ * @brief Perform a batch of operations in a single call.
+ *
+ * Operations are performed in order. Each run of consecutive queries is
+ * pipelined, so it costs about one round trip to the device in total rather
+ * than one per query. The error code of each operation is stored in its error
+ * field, and a failed operation doesn't stop the rest of the batch.
+ *
+ * @param[in] handle SCPI client
+ * @param[in,out] ops operations to perform
+ * @param[in] count number of operations
+ *
+ * @return 0 if every operation succeeded, otherwise the error code of the
+ * first operation which failed.
+ */
+int AbsScpiClient_ExecuteBatch(AbsScpiClientHandle handle, AbsBatchOp ops[],
+                               unsigned int count);
+
+/** @} */
+
+/**
+ * @defgroup CAcq Continuous Acquisition
+ * Functions for polling units for measurements in the background.
+ * @{
+ */
+
+/**
+ * @brief Initialize a continuous acquisition. Must be destroyed by the caller!
+ *
+ * The acquisition takes over the connections of the given clients, which are
+ * left closed. Use AbsAcquisition_GetClient() to control the units while they
+ * are being polled.
+ *
+ * @param[out] handle_out pointer to a handle to initialize (handle should be
+ * zeroed)
+ * @param[in] clients clients to poll
+ * @param[in] count number of clients
+ * @param[in] period_us time between polls of each client in microseconds
+ * @param[in] capacity number of samples buffered for each client
+ *
+ * @return 0 on success or a negative error code.
+ */
+int AbsAcquisition_Init(AbsAcquisitionHandle* handle_out,
+                        const AbsScpiClientHandle clients[],
+                        unsigned int count, unsigned int period_us,
+                        unsigned int capacity);
+
+/**
+ * @brief Destroy a continuous acquisition, stopping it if it is running.
+ *
+ * @param[in,out] handle pointer to a handle to destroy
+ */
+void AbsAcquisition_Destroy(AbsAcquisitionHandle* handle);
+
+/**
+ * @brief Get one of the clients being polled. The client belongs to the
+ * acquisition and must not be destroyed, opened, or closed.
+ *
+ * @param[in] handle continuous acquisition
+ * @param[in] index client index
+ * @param[out] client_out pointer to the returned client handle
+ *
+ * @return 0 on success or a negative error code.
+ */
+int AbsAcquisition_GetClient(AbsAcquisitionHandle handle, unsigned int index,
+                             AbsScpiClientHandle* client_out);
+
+/**
+ * @brief Start polling.
+ *
+ * @param[in] handle continuous acquisition
+ *
+ * @return 0 on success or a negative error code.
+ */
+int AbsAcquisition_Start(AbsAcquisitionHandle handle);
+
+/**
+ * @brief Stop polling. Samples already taken may still be read.
+ *
+ * @param[in] handle continuous acquisition
+ *
+ * @return 0 on success or a negative error code.
+ */
+int AbsAcquisition_Stop(AbsAcquisitionHandle handle);
+
+/**
+ * @brief Take buffered samples without waiting for new ones. Only one thread
+ * may read samples at a time.
+ *
+ * @param[in] handle continuous acquisition
+ * @param[out] samples_out array to fill with samples
+ * @param[in,out] count length of the array on input, number of samples read
+ * on output
+ *
+ * @return 0 on success or a negative error code.
+ */
+int AbsAcquisition_Read(AbsAcquisitionHandle handle,
+                        AbsAcquisitionSample samples_out[],
+                        unsigned int* count);
+
+/**
+ * @brief Get the number of samples dropped because a buffer was full.
+ *
+ * @param[in] handle continuous acquisition
+ * @param[out] dropped_out pointer to the returned count
+ *
+ * @return 0 on success or a negative error code.
+ */
+int AbsAcquisition_GetDroppedCount(AbsAcquisitionHandle handle,
+                                   uint64_t* dropped_out);
+
+/** @} */
+
 /**
  * @defgroup CDisc Device Discovery
  * Functions for discovering ABSes on the network.
@@ -1367,6 +1692,72 @@ int AbsScpiClient_SerialDiscovery(const char* port, uint8_t first_id,
 
 /** @} */
 
+/**
+ * @defgroup CInstr Instrumentation
+ * Functions for measuring per-command latency.
+ * @{
+ */
+
+/**
+ * @brief Initialize a latency histogram. Must be destroyed by the caller!
+ *
+ * A histogram may be attached to any number of clients, which may use it from
+ * different threads.
+ *
+ * @param[out] handle_out pointer to a handle to initialize (handle should be
+ * zeroed)
+ *
+ * @return 0 on success or a negative error code.
+ */
+int AbsLatencyHistogram_Init(AbsLatencyHistogramHandle* handle_out);
+
+/**
+ * @brief Destroy a latency histogram. Clients it is attached to keep using it
+ * until they are destroyed or detached.
+ *
+ * @param[in,out] handle pointer to a handle to destroy
+ */
+void AbsLatencyHistogram_Destroy(AbsLatencyHistogramHandle* handle);
+
+/**
+ * @brief Get the latency statistics for a single command.
+ *
+ * Commands are identified by mnemonic, without parameters or channel numbers,
+ * such as "MEAS:VOLT?" or "SOUR:VOLT".
+ *
+ * @param[in] handle latency histogram
+ * @param[in] command command mnemonic
+ * @param[out] stats_out pointer to a structure to store the statistics
+ *
+ * @return 0 on success or a negative error code. Returns an invalid argument
+ * error if the command has not been recorded.
+ */
+int AbsLatencyHistogram_GetStats(AbsLatencyHistogramHandle handle,
+                                 const char* command,
+                                 AbsLatencyStats* stats_out);
+
+/**
+ * @brief Clear all statistics in a latency histogram.
+ *
+ * @param[in] handle latency histogram
+ *
+ * @return 0 on success or a negative error code.
+ */
+int AbsLatencyHistogram_Reset(AbsLatencyHistogramHandle handle);
+
+/**
+ * @brief Record the latency of every call made by a client in a histogram.
+ *
+ * @param[in] handle SCPI client
+ * @param[in] histogram latency histogram, or NULL to stop recording
+ *
+ * @return 0 on success or a negative error code.
+ */
+int AbsScpiClient_SetLatencyHistogram(AbsScpiClientHandle handle,
+                                      AbsLatencyHistogramHandle histogram);
+
+/** @} */
+
 /** @} */
 
 #ifdef __cplusplus
@@ -0,0 +1,611 @@
+/*
+ * Copyright (c) 2024, Bloomy Controls, Inc. All rights reserved.
+ *
+ * Use of this source code is governed by a BSD-3-clause license that can be
+ * found in the LICENSE file or at https://opensource.org/license/BSD-3-Clause
+ */
+
+/**
+ * @file
+ * @brief Write-through setpoint cache for the SCPI client.
+ */
+#ifndef ABS_SCPI_DRIVER_INCLUDE_BCI_ABS_CACHEDSCPICLIENT_H
+#define ABS_SCPI_DRIVER_INCLUDE_BCI_ABS_CACHEDSCPICLIENT_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+
+#include "CommonTypes.h"
+
+namespace bci::abs {
+
+namespace drivers {
+
+class CommDriver;
+
+}  // namespace drivers
+
+template <class Driver>
+class BasicScpiClient;
+
+using ScpiClient = BasicScpiClient<drivers::CommDriver>;
+
+/**
+ * @brief Remembers the setpoints written through it, so that writes which
+ * would not change anything are skipped and setpoint queries are answered from
+ * memory.
+ *
+ * Cell voltages, current limits, faults, sense ranges and enable states, analog
+ * and digital outputs, and global and local model inputs are cached per
+ * channel. A setter only sends its command if the new value differs from the
+ * cached one by more than the tolerance (floating point values) or at all
+ * (everything else). Once every channel of a floating point setpoint is cached,
+ * setting several at once only sends the channels which changed (see
+ * ScpiClient::SetCellVoltagesDelta()). A getter only queries the unit if the
+ * value has not been written or read since the cache was last invalidated.
+ *
+ * The cache assumes nothing else changes the unit's setpoints, so only use it
+ * while this is the only writer to the unit. Anything which may change them
+ * behind the cache's back invalidates it: Reboot(), ClearErrors(),
+ * ClearRecoverableAlarms(), AssertSoftwareInterlock(), GetAlarms() returning a
+ * different value than last time, and a failed write (whose effect is unknown).
+ * Call Invalidate() after using the client directly for anything else which
+ * changes setpoints.
+ *
+ * Example usage (error handling omitted):
+ * @code{.cpp}
+ * bci::abs::CachedScpiClient cached{client, 0.0001f};
+ * while (running) {
+ *   cached.SetAllCellVoltages(voltages);  // only sent when voltages change
+ *   cached.GetAlarms();                   // invalidates on any alarm change
+ * }
+ * @endcode
+ *
+ * @note The cache holds a reference to the client, which must outlive it.
+ *
+ * @note Cached getters return the value last written, which may differ from
+ * what the unit reports by up to its setpoint resolution.
+ */
+class CachedScpiClient {
+ public:
+  /**
+   * @brief Create an empty cache in front of a client.
+   *
+   * @param[in] client client to send commands with
+   * @param[in] tolerance largest difference between two floating point
+   * setpoints for them to be considered equal
+   */
+  explicit CachedScpiClient(const ScpiClient& client,
+                            float tolerance = 0.0f) noexcept;
+
+  /**
+   * @return The underlying client.
+   */
+  const ScpiClient& Client() const noexcept;
+
+  /**
+   * @brief Set the tolerance for comparing floating point setpoints.
+   *
+   * @param[in] tolerance largest difference between two floating point
+   * setpoints for them to be considered equal
+   */
+  void SetTolerance(float tolerance) noexcept;
+
+  /**
+   * @return The tolerance for comparing floating point setpoints.
+   */
+  float GetTolerance() const noexcept;
+
+  /// Forget all cached setpoints. The next write or query of each is sent.
+  void Invalidate() noexcept;
+
+  /**
+   * @name System Control
+   */
+  ///@{
+
+  /**
+   * @brief Clear the unit's errors. Invalidates the cache.
+   *
+   * @return An error code.
+   */
+  ErrorCode ClearErrors();
+
+  /**
+   * @brief Query the alarms raised on the unit. Invalidates the cache if they
+   * differ from the last query.
+   *
+   * @return Result containing the alarms or an error code.
+   */
+  Result<std::uint32_t> GetAlarms();
+
+  /**
+   * @brief Assert the software interlock. Invalidates the cache.
+   *
+   * @return An error code.
+   */
+  ErrorCode AssertSoftwareInterlock();
+
+  /**
+   * @brief Clear recoverable alarms. Invalidates the cache.
+   *
+   * @return An error code.
+   */
+  ErrorCode ClearRecoverableAlarms();
+
+  /**
+   * @brief Reboot the unit. Invalidates the cache.
+   *
+   * @return An error code.
+   */
+  ErrorCode Reboot();
+
+  ///@}
+
+  /**
+   * @name Cells
+   */
+  ///@{
+
+  /**
+   * @brief Enable or disable a single cell, unless it already is.
+   *
+   * @param[in] cell target cell index, 0-7
+   * @param[in] en whether to enable the cell
+   *
+   * @return An error code.
+   */
+  ErrorCode EnableCell(unsigned int cell, bool en);
+
+  /**
+   * @brief Get whether a cell is enabled.
+   *
+   * @param[in] cell target cell index, 0-7
+   *
+   * @return Result containing whether the cell is enabled or an error code.
+   */
+  Result<bool> GetCellEnabled(unsigned int cell);
+
+  /**
+   * @brief Set a single cell's voltage target, unless it already is.
+   *
+   * @param[in] cell target cell index, 0-7
+   * @param[in] voltage target voltage
+   *
+   * @return An error code.
+   */
+  ErrorCode SetCellVoltage(unsigned int cell, float voltage);
+
+  /**
+   * @brief Set all cells' voltage targets to one value, unless they already
+   * are.
+   *
+   * @param[in] voltage target voltage
+   *
+   * @return An error code.
+   */
+  ErrorCode SetAllCellVoltages(float voltage);
+
+  /**
+   * @brief Set many cells' voltage targets, unless they already are.
+   *
+   * @param[in] voltages target voltages, one per cell starting at cell 0 (must
+   * not be longer than the total number of cells)
+   *
+   * @return An error code.
+   */
+  ErrorCode SetAllCellVoltages(std::span<const float> voltages);
+
+  /**
+   * @brief Get a single cell's voltage target.
+   *
+   * @param[in] cell target cell index, 0-7
+   *
+   * @return Result containing the voltage target or an error code.
+   */
+  Result<float> GetCellVoltageTarget(unsigned int cell);
+
+  /**
+   * @brief Get all cells' voltage targets.
+   *
+   * @return Result containing the voltage targets or an error code.
+   */
+  Result<std::array<float, kCellCount>> GetAllCellVoltageTargets();
+
+  /**
+   * @brief Set a single cell's sourcing limit, unless it already is.
+   *
+   * @param[in] cell target cell index, 0-7
+   * @param[in] limit sourcing limit
+   *
+   * @return An error code.
+   */
+  ErrorCode SetCellSourcing(unsigned int cell, float limit);
+
+  /**
+   * @brief Set all cells' sourcing limits to one value, unless they already
+   * are.
+   *
+   * @param[in] limit sourcing limit
+   *
+   * @return An error code.
+   */
+  ErrorCode SetAllCellSourcing(float limit);
+
+  /**
+   * @brief Set many cells' sourcing limits, unless they already are.
+   *
+   * @param[in] limits sourcing limits, one per cell starting at cell 0 (must
+   * not be longer than the total number of cells)
+   *
+   * @return An error code.
+   */
+  ErrorCode SetAllCellSourcing(std::span<const float> limits);
+
+  /**
+   * @brief Get a single cell's sourcing limit.
+   *
+   * @param[in] cell target cell index, 0-7
+   *
+   * @return Result containing the sourcing limit or an error code.
+   */
+  Result<float> GetCellSourcingLimit(unsigned int cell);
+
+  /**
+   * @brief Get all cells' sourcing limits.
+   *
+   * @return Result containing the sourcing limits or an error code.
+   */
+  Result<std::array<float, kCellCount>> GetAllCellSourcingLimits();
+
+  /**
+   * @brief Set a single cell's sinking limit, unless it already is.
+   *
+   * @param[in] cell target cell index, 0-7
+   * @param[in] limit sinking limit
+   *
+   * @return An error code.
+   */
+  ErrorCode SetCellSinking(unsigned int cell, float limit);
+
+  /**
+   * @brief Set all cells' sinking limits to one value, unless they already
+   * are.
+   *
+   * @param[in] limit sinking limit
+   *
+   * @return An error code.
+   */
+  ErrorCode SetAllCellSinking(float limit);
+
+  /**
+   * @brief Set many cells' sinking limits, unless they already are.
+   *
+   * @param[in] limits sinking limits, one per cell starting at cell 0 (must not
+   * be longer than the total number of cells)
+   *
+   * @return An error code.
+   */
+  ErrorCode SetAllCellSinking(std::span<const float> limits);
+
+  /**
+   * @brief Get a single cell's sinking limit.
+   *
+   * @param[in] cell target cell index, 0-7
+   *
+   * @return Result containing the sinking limit or an error code.
+   */
+  Result<float> GetCellSinkingLimit(unsigned int cell);
+
+  /**
+   * @brief Get all cells' sinking limits.
+   *
+   * @return Result containing the sinking limits or an error code.
+   */
+  Result<std::array<float, kCellCount>> GetAllCellSinkingLimits();
+
+  /**
+   * @brief Set a single cell's faulting state, unless it already is.
+   *
+   * @param[in] cell target cell index, 0-7
+   * @param[in] fault faulting state
+   *
+   * @return An error code.
+   */
+  ErrorCode SetCellFault(unsigned int cell, CellFault fault);
+
+  /**
+   * @brief Set all cells' faulting states to one value, unless they already
+   * are.
+   *
+   * @param[in] fault faulting state
+   *
+   * @return An error code.
+   */
+  ErrorCode SetAllCellFaults(CellFault fault);
+
+  /**
+   * @brief Set many cells' faulting states, unless they already are.
+   *
+   * @param[in] faults faulting states, one per cell starting at cell 0 (must
+   * not be longer than the total number of cells)
+   *
+   * @return An error code.
+   */
+  ErrorCode SetAllCellFaults(std::span<const CellFault> faults);
+
+  /**
+   * @brief Get a single cell's faulting state.
+   *
+   * @param[in] cell target cell index, 0-7
+   *
+   * @return Result containing the faulting state or an error code.
+   */
+  Result<CellFault> GetCellFault(unsigned int cell);
+
+  /**
+   * @brief Get all cells' faulting states.
+   *
+   * @return Result containing the faulting states or an error code.
+   */
+  Result<std::array<CellFault, kCellCount>> GetAllCellFaults();
+
+  /**
+   * @brief Set a single cell's current sense range, unless it already is.
+   *
+   * @param[in] cell target cell index, 0-7
+   * @param[in] range current sense range
+   *
+   * @return An error code.
+   */
+  ErrorCode SetCellSenseRange(unsigned int cell, CellSenseRange range);
+
+  /**
+   * @brief Set all cells' current sense ranges to one value, unless they
+   * already are.
+   *
+   * @param[in] range current sense range
+   *
+   * @return An error code.
+   */
+  ErrorCode SetAllCellSenseRanges(CellSenseRange range);
+
+  /**
+   * @brief Set many cells' current sense ranges, unless they already are.
+   *
+   * @param[in] ranges current sense ranges, one per cell starting at cell 0
+   * (must not be longer than the total number of cells)
+   *
+   * @return An error code.
+   */
+  ErrorCode SetAllCellSenseRanges(std::span<const CellSenseRange> ranges);
+
+  /**
+   * @brief Get a single cell's current sense range.
+   *
+   * @param[in] cell target cell index, 0-7
+   *
+   * @return Result containing the current sense range or an error code.
+   */
+  Result<CellSenseRange> GetCellSenseRange(unsigned int cell);
+
+  /**
+   * @brief Get all cells' current sense ranges.
+   *
+   * @return Result containing the current sense ranges or an error code.
+   */
+  Result<std::array<CellSenseRange, kCellCount>> GetAllCellSenseRanges();
+
+  ///@}
+
+  /**
+   * @name Analog & Digital I/O
+   */
+  ///@{
+
+  /**
+   * @brief Set a single analog output, unless it already is.
+   *
+   * @param[in] channel target channel, 0-7
+   * @param[in] voltage output voltage
+   *
+   * @return An error code.
+   */
+  ErrorCode SetAnalogOutput(unsigned int channel, float voltage);
+
+  /**
+   * @brief Set all analog outputs to one value, unless they already are.
+   *
+   * @param[in] voltage output voltage
+   *
+   * @return An error code.
+   */
+  ErrorCode SetAllAnalogOutputs(float voltage);
+
+  /**
+   * @brief Set many analog outputs, unless they already are.
+   *
+   * @param[in] voltages output voltages, one per channel starting at channel 0
+   * (must not be longer than the total number of channels)
+   *
+   * @return An error code.
+   */
+  ErrorCode SetAllAnalogOutputs(std::span<const float> voltages);
+
+  /**
+   * @brief Get a single analog output's setpoint.
+   *
+   * @param[in] channel target channel, 0-7
+   *
+   * @return Result containing the output voltage or an error code.
+   */
+  Result<float> GetAnalogOutput(unsigned int channel);
+
+  /**
+   * @brief Get all analog outputs' setpoints.
+   *
+   * @return Result containing the output voltages or an error code.
+   */
+  Result<std::array<float, kAnalogOutputCount>> GetAllAnalogOutputs();
+
+  /**
+   * @brief Set a single digital output, unless it already is.
+   *
+   * @param[in] channel target channel, 0-3
+   * @param[in] level output level
+   *
+   * @return An error code.
+   */
+  ErrorCode SetDigitalOutput(unsigned int channel, bool level);
+
+  /**
+   * @brief Set all digital outputs to one level, unless they already are.
+   *
+   * @param[in] level output level
+   *
+   * @return An error code.
+   */
+  ErrorCode SetAllDigitalOutputs(bool level);
+
+  /**
+   * @brief Get a single digital output's level.
+   *
+   * @param[in] channel target channel, 0-3
+   *
+   * @return Result containing the output level or an error code.
+   */
+  Result<bool> GetDigitalOutput(unsigned int channel);
+
+  /**
+   * @brief Get all digital outputs' levels.
+   *
+   * @return Result containing the output levels or an error code.
+   */
+  Result<std::array<bool, kDigitalOutputCount>> GetAllDigitalOutputs();
+
+  ///@}
+
+  /**
+   * @name Modeling
+   */
+  ///@{
+
+  /**
+   * @brief Set a single global model input, unless it already is.
+   *
+   * @param[in] index input index, 0-7
+   * @param[in] value input value
+   *
+   * @return An error code.
+   */
+  ErrorCode SetGlobalModelInput(unsigned int index, float value);
+
+  /**
+   * @brief Set all global model inputs to one value, unless they already are.
+   *
+   * @param[in] value input value
+   *
+   * @return An error code.
+   */
+  ErrorCode SetAllGlobalModelInputs(float value);
+
+  /**
+   * @brief Set many global model inputs, unless they already are.
+   *
+   * @param[in] values input values, one per input starting at input 0 (must not
+   * be longer than the total number of inputs)
+   *
+   * @return An error code.
+   */
+  ErrorCode SetAllGlobalModelInputs(std::span<const float> values);
+
+  /**
+   * @brief Get a single global model input.
+   *
+   * @param[in] index input index, 0-7
+   *
+   * @return Result containing the input value or an error code.
+   */
+  Result<float> GetGlobalModelInput(unsigned int index);
+
+  /**
+   * @brief Get all global model inputs.
+   *
+   * @return Result containing the input values or an error code.
+   */
+  Result<std::array<float, kGlobalModelInputCount>> GetAllGlobalModelInputs();
+
+  /**
+   * @brief Set a single local model input, unless it already is.
+   *
+   * @param[in] index input index, 0-7
+   * @param[in] value input value
+   *
+   * @return An error code.
+   */
+  ErrorCode SetLocalModelInput(unsigned int index, float value);
+
+  /**
+   * @brief Set all local model inputs to one value, unless they already are.
+   *
+   * @param[in] value input value
+   *
+   * @return An error code.
+   */
+  ErrorCode SetAllLocalModelInputs(float value);
+
+  /**
+   * @brief Set many local model inputs, unless they already are.
+   *
+   * @param[in] values input values, one per input starting at input 0 (must not
+   * be longer than the total number of inputs)
+   *
+   * @return An error code.
+   */
+  ErrorCode SetAllLocalModelInputs(std::span<const float> values);
+
+  /**
+   * @brief Get a single local model input.
+   *
+   * @param[in] index input index, 0-7
+   *
+   * @return Result containing the input value or an error code.
+   */
+  Result<float> GetLocalModelInput(unsigned int index);
+
+  /**
+   * @brief Get all local model inputs.
+   *
+   * @return Result containing the input values or an error code.
+   */
+  Result<std::array<float, kLocalModelInputCount>> GetAllLocalModelInputs();
+
+  ///@}
+
+ private:
+  template <class T, std::size_t N>
+  using Setpoints = std::array<std::optional<T>, N>;
+
+  const ScpiClient* client_;
+  float tolerance_;
+
+  std::optional<std::uint32_t> alarms_;
+
+  Setpoints<bool, kCellCount> cell_enabled_;
+  Setpoints<float, kCellCount> cell_voltage_;
+  Setpoints<float, kCellCount> cell_sourcing_;
+  Setpoints<float, kCellCount> cell_sinking_;
+  Setpoints<CellFault, kCellCount> cell_fault_;
+  Setpoints<CellSenseRange, kCellCount> cell_sense_range_;
+  Setpoints<float, kAnalogOutputCount> analog_output_;
+  Setpoints<bool, kDigitalOutputCount> digital_output_;
+  Setpoints<float, kGlobalModelInputCount> global_model_input_;
+  Setpoints<float, kLocalModelInputCount> local_model_input_;
+};
+
+}  // namespace bci::abs
+
+#endif /* ABS_SCPI_DRIVER_INCLUDE_BCI_ABS_CACHEDSCPICLIENT_H */
@@ -11,10 +11,22 @@
 #ifndef ABS_SCPI_DRIVER_INCLUDE_BCI_ABS_COMMDRIVER_H
 #define ABS_SCPI_DRIVER_INCLUDE_BCI_ABS_COMMDRIVER_H
 
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <span>
 #include <string>
 #include <string_view>
+#include <utility>
 
 #include "CommonTypes.h"
+#include "Instrumentation.h"
+
+namespace bci::abs::detail {
+
+class TransactionLock;
+
+}  // namespace bci::abs::detail
 
 /**
  * @brief Contains comm drivers for use with the SCPI client.
@@ -26,6 +38,12 @@ namespace bci::abs::drivers {
  */
 class CommDriver {
  public:
+  /// Completion handler for asynchronous writes.
+  using WriteHandler = std::function<void(ErrorCode)>;
+
+  /// Completion handler for asynchronous reads.
+  using ReadHandler = std::function<void(Result<std::string>)>;
+
   virtual ~CommDriver() = default;
 
   /**
@@ -50,6 +68,72 @@ class CommDriver {
    */
   virtual Result<std::string> ReadLine(unsigned int timeout_ms) const = 0;
 
+  /**
+   * @brief Read a line from the device into a caller-provided buffer with a
+   * timeout. Unlike ReadLine(), this does not allocate in drivers which
+   * implement it natively. The default implementation copies the result of
+   * ReadLine().
+   *
+   * @param[out] buf buffer to read into (should be larger than the longest
+   * line expected)
+   * @param[in] timeout_ms read timeout in milliseconds
+   *
+   * @return Result containing a view of the line within the buffer or an error
+   * code.
+   */
+  virtual Result<std::string_view> ReadLineInto(std::span<char> buf,
+                                                unsigned int timeout_ms) const {
+    auto line = ReadLine(timeout_ms);
+    if (!line) {
+      return tl::unexpected(line.error());
+    }
+
+    if (line->size() > buf.size()) {
+      return tl::unexpected(ErrorCode::kBufferTooSmall);
+    }
+
+    std::ranges::copy(*line, buf.begin());
+    return std::string_view(buf.data(), line->size());
+  }
+
+  /**
+   * @brief Start writing data with a timeout.
+   *
+   * Drivers attached to an IoContext complete the write on the context's
+   * thread. The default implementation performs a blocking Write() and calls
+   * the handler before returning.
+   *
+   * @note Only one asynchronous operation may be outstanding on a driver at a
+   * time.
+   *
+   * @param[in] data data to send (copied before returning)
+   * @param[in] timeout_ms send timeout in milliseconds (may be ignored by some
+   * drivers)
+   * @param[in] handler called with the result of the write
+   */
+  virtual void AsyncWrite(std::string_view data, unsigned int timeout_ms,
+                          WriteHandler handler) const {
+    handler(Write(data, timeout_ms));
+  }
+
+  /**
+   * @brief Start reading a line from the device with a timeout.
+   *
+   * Drivers attached to an IoContext complete the read on the context's thread.
+   * The default implementation performs a blocking ReadLine() and calls the
+   * handler before returning.
+   *
+   * @note Only one asynchronous operation may be outstanding on a driver at a
+   * time.
+   *
+   * @param[in] timeout_ms read timeout in milliseconds
+   * @param[in] handler called with the line read or an error code
+   */
+  virtual void AsyncReadLine(unsigned int timeout_ms,
+                             ReadHandler handler) const {
+    handler(ReadLine(timeout_ms));
+  }
+
   /**
    * @brief Set the target device ID. Not implemented by most drivers.
    *
@@ -73,6 +157,46 @@ class CommDriver {
    * @return Whether the driver is send-only.
    */
   virtual bool IsSendOnly() const { return false; }
+
+  /**
+   * @brief Attach a sink which is told about every write and read made by the
+   * driver. Pass nullptr to detach it.
+   *
+   * The built-in drivers report to the sink from their blocking Write(),
+   * ReadLine(), and ReadLineInto() functions. Asynchronous operations are not
+   * reported.
+   *
+   * @param[in] sink instrumentation sink
+   */
+  void SetInstrumentation(std::shared_ptr<InstrumentationSink> sink) noexcept {
+    sink_ = std::move(sink);
+  }
+
+  /**
+   * @return Pointer to the instrumentation sink, if any.
+   */
+  std::shared_ptr<InstrumentationSink> GetInstrumentation() const noexcept {
+    return sink_;
+  }
+
+  /**
+   * @brief Get the lock which serializes the transactions of thread-safe
+   * clients using this driver, creating it on first use. Used by
+   * BasicScpiClient::SetThreadSafe(); not thread-safe itself.
+   *
+   * @return The driver's transaction lock.
+   */
+  std::shared_ptr<detail::TransactionLock> GetTransactionLock();
+
+ protected:
+  /**
+   * @return The instrumentation sink, or nullptr if none is attached.
+   */
+  InstrumentationSink* Instrumentation() const noexcept { return sink_.get(); }
+
+ private:
+  std::shared_ptr<InstrumentationSink> sink_;
+  std::shared_ptr<detail::TransactionLock> lock_;
 };
 
 }  // namespace bci::abs::drivers
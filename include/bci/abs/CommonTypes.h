@@ -12,9 +12,13 @@
 #ifndef ABS_SCPI_DRIVER_INCLUDE_BCI_ABS_COMMONTYPES_H
 #define ABS_SCPI_DRIVER_INCLUDE_BCI_ABS_COMMONTYPES_H
 
+#include <array>
+#include <cstddef>
 #include <cstdint>
 #include <string>
+#include <type_traits>
 #include <utility>
+#include <vector>
 
 #include "util/expected.hpp"
 
@@ -77,6 +81,126 @@ struct ScpiError {
   std::string err_msg;    ///< Error message
 };
 
+/**
+ * @brief List of SCPI errors read from the device error queue, oldest first.
+ *
+ * The first kInlineCount errors are stored in the list itself, so draining a
+ * short error queue allocates nothing but any long error messages.
+ */
+class ScpiErrorList {
+ public:
+  /// Number of errors stored without allocating.
+  static constexpr std::size_t kInlineCount = 8;
+
+  using value_type = ScpiError;
+  using iterator = ScpiError*;
+  using const_iterator = const ScpiError*;
+
+  /**
+   * @brief Append an error to the list.
+   *
+   * @param[in] err error to append
+   */
+  void push_back(ScpiError err) {
+    static_assert(std::is_nothrow_move_constructible_v<ScpiError> &&
+                  std::is_nothrow_move_assignable_v<ScpiError>);
+
+    if (size_ < kInlineCount) {
+      inline_[size_] = std::move(err);
+    } else if (size_ == kInlineCount) {
+      // only allocating may throw, so it's done before the list is touched;
+      // storage kept by clear() is reused
+      std::vector<ScpiError> heap;
+      if (heap_.capacity() > kInlineCount) {
+        heap.swap(heap_);
+      } else {
+        heap.reserve(2 * kInlineCount);
+      }
+      for (auto& e : inline_) {
+        heap.push_back(std::move(e));
+      }
+      heap.push_back(std::move(err));
+      heap_ = std::move(heap);
+    } else {
+      heap_.push_back(std::move(err));
+    }
+    ++size_;
+  }
+
+  /// Remove every error from the list.
+  void clear() noexcept {
+    heap_.clear();
+    size_ = 0;
+  }
+
+  /**
+   * @return The number of errors.
+   */
+  std::size_t size() const noexcept { return size_; }
+
+  /**
+   * @return Whether the list is empty.
+   */
+  bool empty() const noexcept { return size_ == 0; }
+
+  /**
+   * @return Pointer to the first error.
+   */
+  ScpiError* data() noexcept {
+    return size_ <= kInlineCount ? inline_.data() : heap_.data();
+  }
+
+  /**
+   * @return Pointer to the first error.
+   */
+  const ScpiError* data() const noexcept {
+    return size_ <= kInlineCount ? inline_.data() : heap_.data();
+  }
+
+  iterator begin() noexcept { return data(); }
+  iterator end() noexcept { return data() + size_; }
+  const_iterator begin() const noexcept { return data(); }
+  const_iterator end() const noexcept { return data() + size_; }
+
+  /**
+   * @param[in] index index of the error, which must be less than size()
+   *
+   * @return Reference to the error.
+   */
+  ScpiError& operator[](std::size_t index) noexcept { return data()[index]; }
+
+  /**
+   * @param[in] index index of the error, which must be less than size()
+   *
+   * @return Reference to the error.
+   */
+  const ScpiError& operator[](std::size_t index) const noexcept {
+    return data()[index];
+  }
+
+ private:
+  std::array<ScpiError, kInlineCount> inline_{};
+  std::vector<ScpiError> heap_{};
+  std::size_t size_{0};
+};
+
+/// Measurements taken from the device in a single transaction.
+struct MeasurementSnapshot {
+  std::array<float, kCellCount> cell_voltages;         ///< Cell voltages
+  std::array<float, kCellCount> cell_currents;         ///< Cell currents
+  std::array<CellMode, kCellCount> cell_modes;         ///< Cell modes
+  std::array<float, kAnalogInputCount> analog_inputs;  ///< Analog inputs
+  unsigned int digital_inputs;  ///< Digital inputs bitmask
+  std::uint32_t alarms;         ///< Alarms bitmask
+};
+
+/// Device health read in a single transaction.
+struct DeviceHealth {
+  std::uint32_t alarms;  ///< Alarms bitmask
+  bool interlock;        ///< Interlock state
+  int error_count;       ///< Number of errors in the error queue
+};
+
 /// Bits and masks for interpreting alarms.
 namespace alarms {
 
@@ -160,6 +284,9 @@ enum class ErrorCode : int {
   kBufferTooSmall = -22,           ///< Buffer too small
   kAllocationFailed = -23,         ///< Allocation failed (C only)
   kUnexpectedException = -24,      ///< Unexpected exception (C only)
+  kFileError = -25,                ///< Failed to create or open a file
+  kInvalidFile = -26,              ///< File is corrupt or of the wrong format
+  kResponseTooLong = -27,          ///< Response too long (no terminator)
 };
 
 /**
@@ -0,0 +1,166 @@
+/*
+ * Copyright (c) 2024, Bloomy Controls, Inc. All rights reserved.
+ *
+ * Use of this source code is governed by a BSD-3-clause license that can be
+ * found in the LICENSE file or at https://opensource.org/license/BSD-3-Clause
+ */
+
+/**
+ * @file
+ * @brief Background acquisition of measurements from many ABS units.
+ */
+#ifndef ABS_SCPI_DRIVER_INCLUDE_BCI_ABS_CONTINUOUSACQUISITION_H
+#define ABS_SCPI_DRIVER_INCLUDE_BCI_ABS_CONTINUOUSACQUISITION_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <vector>
+
+#include "CommonTypes.h"
+#include "ScpiClient.h"
+
+namespace bci::abs {
+
+/// One set of measurements taken by a ContinuousAcquisition.
+struct AcquisitionSample {
+  /// Time at which the measurements were taken, estimated as the midpoint of
+  /// the query.
+  std::chrono::system_clock::time_point timestamp;
+
+  /// Index of the sampling period in which the sample was taken. Gaps show
+  /// periods which were skipped because a query overran.
+  std::uint64_t sequence;
+
+  /// Index of the client the sample was taken from.
+  std::size_t device;
+
+  /// Result of the query. The measurements are only valid on success.
+  ErrorCode error;
+
+  /// Measurements.
+  MeasurementSnapshot snapshot;
+};
+
+/**
+ * @brief Polls a set of units for measurements in the background at a fixed
+ * rate.
+ *
+ * Each client is polled by its own thread with MeasureSnapshot(). Polls are
+ * scheduled from the time acquisition started rather than from the end of the
+ * previous poll, so the rate doesn't drift, and a poll which overruns its
+ * period skips the periods it missed instead of bunching the following polls
+ * together.
+ *
+ * Samples are published to a lock-free ring buffer per client, so reading
+ * them never blocks the pollers. If a ring is full, new samples from its
+ * client are dropped and counted by DroppedSamples().
+ *
+ * Example usage (error handling omitted):
+ * @code{.cpp}
+ * bci::abs::ContinuousAcquisition acq{std::move(clients),
+ *                                     std::chrono::milliseconds(10)};
+ * acq.Start();
+ * std::array<bci::abs::AcquisitionSample, 64> samples;
+ * for (;;) {
+ *   auto count = acq.Read(samples);
+ *   // process the first count samples
+ * }
+ * @endcode
+ *
+ * @note Thread-safe mode is enabled on every client (see
+ * ScpiClient::SetThreadSafe()), so units may be controlled through the clients
+ * while they are polled.
+ */
+class ContinuousAcquisition {
+ public:
+  /**
+   * @brief Create an acquisition engine. Acquisition doesn't begin until
+   * Start() is called.
+   *
+   * @param[in,out] clients clients to poll, which are moved from unless
+   * construction throws
+   * @param[in] period time between polls of each client
+   * @param[in] capacity number of samples buffered for each client, rounded up
+   * to a power of two
+   */
+  ContinuousAcquisition(std::vector<ScpiClient>&& clients,
+                        std::chrono::nanoseconds period,
+                        std::size_t capacity = 1024);
+
+  ContinuousAcquisition(const ContinuousAcquisition&) = delete;
+  ContinuousAcquisition& operator=(const ContinuousAcquisition&) = delete;
+
+  /// DTOR. Stops acquisition.
+  ~ContinuousAcquisition();
+
+  /**
+   * @brief Start polling. Does nothing if acquisition is already running.
+   *
+   * @return An error code.
+   */
+  ErrorCode Start();
+
+  /// Stop polling and wait for any poll in progress to finish. Samples already
+  /// taken may still be read.
+  void Stop() noexcept;
+
+  /**
+   * @return Whether acquisition is running.
+   */
+  bool IsRunning() const noexcept;
+
+  /**
+   * @brief Take buffered samples without waiting for new ones.
+   *
+   * Samples from each client are returned in the order they were taken, but
+   * samples from different clients are not ordered relative to each other.
+   *
+   * @note Only one thread may read samples at a time.
+   *
+   * @param[out] samples buffer to fill with samples
+   *
+   * @return The number of samples stored in the buffer.
+   */
+  std::size_t Read(std::span<AcquisitionSample> samples);
+
+  /**
+   * @return The total number of samples dropped because a buffer was full.
+   */
+  std::uint64_t DroppedSamples() const noexcept;
+
+  /**
+   * @return The number of clients.
+   */
+  std::size_t Size() const noexcept;
+
+  /**
+   * @brief Access a client, for example to control its unit while it is being
+   * polled. The client's configuration must not be changed while acquisition
+   * is running.
+   *
+   * @param[in] index client index
+   *
+   * @return Reference to the client.
+   */
+  ScpiClient& operator[](std::size_t index) noexcept;
+
+  /**
+   * @brief Access a client.
+   *
+   * @param[in] index client index
+   *
+   * @return Reference to the client.
+   */
+  const ScpiClient& operator[](std::size_t index) const noexcept;
+
+ private:
+  struct Impl;
+  std::unique_ptr<Impl> impl_;
+};
+
+}  // namespace bci::abs
+
+#endif /* ABS_SCPI_DRIVER_INCLUDE_BCI_ABS_CONTINUOUSACQUISITION_H */
@@ -0,0 +1,338 @@
+/*
+ * Copyright (c) 2024, Bloomy Controls, Inc. All rights reserved.
+ *
+ * Use of this source code is governed by a BSD-3-clause license that can be
+ * found in the LICENSE file or at https://opensource.org/license/BSD-3-Clause
+ */
+
+/**
+ * @file
+ * @brief Parallel control of many ABS units.
+ */
+#ifndef ABS_SCPI_DRIVER_INCLUDE_BCI_ABS_DEVICEGROUP_H
+#define ABS_SCPI_DRIVER_INCLUDE_BCI_ABS_DEVICEGROUP_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <span>
+#include <type_traits>
+#include <vector>
+
+#include "CommonTypes.h"
+#include "ScpiClient.h"
+
+namespace bci::abs {
+
+/**
+ * @brief Model inputs to set on one unit and outputs to read back, for
+ * DeviceGroup::ExchangeModelIO().
+ */
+struct ModelExchange {
+  std::span<const float> global_inputs{};  ///< Global input values
+  std::span<const float> local_inputs{};   ///< Local input values
+  std::span<float> outputs{};              ///< Returned outputs
+};
+
+/**
+ * @brief Group of clients which perform each operation on every device in
+ * parallel.
+ *
+ * Each group operation is issued to all devices at once from a pool of worker
+ * threads and returns once every device has finished, so an operation on the
+ * whole group takes about as long as it takes on the slowest device instead of
+ * the sum over all of them. Results are returned in the same order as the
+ * clients in the group.
+ *
+ * Example usage (error handling omitted):
+ * @code{.cpp}
+ * std::vector<bci::abs::ScpiClient> clients;
+ * for (auto ip : ips) {
+ *   auto driver = std::make_shared<bci::abs::drivers::UdpDriver>();
+ *   driver->Open(ip);
+ *   clients.emplace_back(driver);
+ * }
+ * bci::abs::DeviceGroup group{std::move(clients)};
+ * group.SetAllCellVoltages(1.5f);
+ * for (auto& v : group.MeasureAllCellVoltages()) {
+ *   // v is a Result<std::array<float, 8>>
+ * }
+ * @endcode
+ *
+ * Setpoints can also be broadcast to every unit at once by attaching a
+ * broadcast driver (see SetBroadcastDriver()). Setters then send one message
+ * over it instead of one message per device, while queries still go to each
+ * device over its own driver.
+ *
+ * @note Operations run on the clients concurrently, so no two clients of a
+ * group may share a driver. Devices sharing an RS-485 bus cannot be grouped.
+ */
+class DeviceGroup {
+ public:
+  /**
+   * @brief Create a group from a set of clients.
+   *
+   * @param[in] clients clients to group
+   * @param[in] max_threads maximum number of devices to operate on at once, or
+   * 0 to operate on every device at once
+   */
+  explicit DeviceGroup(std::vector<ScpiClient> clients,
+                       std::size_t max_threads = 0);
+
+  /**
+   * @brief Move construct from another DeviceGroup.
+   *
+   * @param[in] other DeviceGroup to move from
+   */
+  DeviceGroup(DeviceGroup&& other) noexcept;
+
+  DeviceGroup(const DeviceGroup&) = delete;
+
+  /**
+   * @brief Move assign from another DeviceGroup.
+   *
+   * @param[in] rhs DeviceGroup to move from
+   *
+   * @return Reference to self.
+   */
+  DeviceGroup& operator=(DeviceGroup&& rhs) noexcept;
+
+  DeviceGroup& operator=(const DeviceGroup&) = delete;
+
+  /// DTOR. Stops the worker threads.
+  ~DeviceGroup();
+
+  /**
+   * @return The number of clients in the group.
+   */
+  std::size_t Size() const noexcept;
+
+  /**
+   * @brief Access a single client in the group.
+   *
+   * @param[in] index client index
+   *
+   * @return Reference to the client.
+   */
+  ScpiClient& operator[](std::size_t index) noexcept;
+
+  /**
+   * @brief Access a single client in the group.
+   *
+   * @param[in] index client index
+   *
+   * @return Reference to the client.
+   */
+  const ScpiClient& operator[](std::size_t index) const noexcept;
+
+  /**
+   * @brief Set a driver used to broadcast setpoints to every unit at once,
+   * typically a UdpMcastDriver. Pass nullptr to send setpoints to each device
+   * individually again.
+   *
+   * While a broadcast driver is set, the group setters (such as
+   * SetAllCellVoltages()) send a single message over it, and every device is
+   * reported the result of that one send. Because no device acknowledges a
+   * broadcast, errors on individual devices cannot be detected.
+   *
+   * @note A multicast message reaches every ABS listening on the network, not
+   * only the members of this group.
+   *
+   * @param[in] driver broadcast driver
+   */
+  void SetBroadcastDriver(std::shared_ptr<drivers::CommDriver> driver) noexcept;
+
+  /**
+   * @return Pointer to the broadcast driver, if any.
+   */
+  std::shared_ptr<const drivers::CommDriver> GetBroadcastDriver()
+      const noexcept;
+
+  /**
+   * @brief Call a function on every client in parallel.
+   *
+   * @tparam F function taking a const ScpiClient& and returning a default
+   * constructible value
+   *
+   * @param[in] func function to call on each client
+   *
+   * @return Vector of results, one per client.
+   */
+  template <class F>
+  auto ForEach(F&& func) const {
+    std::vector<std::invoke_result_t<F&, const ScpiClient&>> results(
+        clients_.size());
+    Run([&](std::size_t i) { results[i] = func(clients_[i]); });
+    return results;
+  }
+
+  /**
+   * @name System Control
+   */
+  ///@{
+
+  /**
+   * @brief Query general information about every unit.
+   *
+   * @return Vector of results, one per client.
+   */
+  std::vector<Result<DeviceInfo>> GetDeviceInfo() const;
+
+  /**
+   * @brief Get the alarms raised on every unit.
+   *
+   * @return Vector of results containing alarm bitmasks, one per client.
+   */
+  std::vector<Result<std::uint32_t>> GetAlarms() const;
+
+  ///@}
+
+  /**
+   * @name Cell Control
+   */
+  ///@{
+
+  /**
+   * @brief Enable or disable many cells on every unit.
+   *
+   * @param[in] cells bitmask of cells to enable or disable
+   * @param[in] en whether to enable the cells
+   *
+   * @return Vector of error codes, one per client.
+   */
+  std::vector<ErrorCode> EnableCellsMasked(unsigned int cells, bool en) const;
+
+  /**
+   * @brief Set every cell of every unit to the same target voltage.
+   *
+   * @param[in] voltage cell voltage
+   *
+   * @return Vector of error codes, one per client.
+   */
+  std::vector<ErrorCode> SetAllCellVoltages(float voltage) const;
+
+  /**
+   * @brief Set the same target voltages on every unit.
+   *
+   * @param[in] voltages target voltages, one per cell (must not be longer than
+   * the total number of cells)
+   *
+   * @return Vector of error codes, one per client.
+   */
+  std::vector<ErrorCode> SetAllCellVoltages(
+      std::span<const float> voltages) const;
+
+  /**
+   * @brief Set every cell of every unit to the same sourcing current limit.
+   *
+   * @param[in] limit sourcing limit
+   *
+   * @return Vector of error codes, one per client.
+   */
+  std::vector<ErrorCode> SetAllCellSourcing(float limit) const;
+
+  /**
+   * @brief Set every cell of every unit to the same sinking current limit.
+   *
+   * @param[in] limit sinking limit
+   *
+   * @return Vector of error codes, one per client.
+   */
+  std::vector<ErrorCode> SetAllCellSinking(float limit) const;
+
+  /**
+   * @brief Measure all cell voltages of every unit.
+   *
+   * @return Vector of results containing voltage arrays, one per client.
+   */
+  std::vector<Result<std::array<float, kCellCount>>> MeasureAllCellVoltages()
+      const;
+
+  /**
+   * @brief Measure all cell currents of every unit.
+   *
+   * @return Vector of results containing current arrays, one per client.
+   */
+  std::vector<Result<std::array<float, kCellCount>>> MeasureAllCellCurrents()
+      const;
+
+  ///@}
+
+  /**
+   * @name Model Control
+   */
+  ///@{
+
+  /**
+   * @brief Set all global model inputs of every unit to the same value.
+   *
+   * @param[in] value input value
+   *
+   * @return Vector of error codes, one per client.
+   */
+  std::vector<ErrorCode> SetAllGlobalModelInputs(float value) const;
+
+  /**
+   * @brief Set the same global model inputs on every unit.
+   *
+   * @param[in] values input values, one per input (must not be longer than the
+   * total number of inputs)
+   *
+   * @return Vector of error codes, one per client.
+   */
+  std::vector<ErrorCode> SetAllGlobalModelInputs(
+      std::span<const float> values) const;
+
+  /**
+   * @brief Set model inputs and query model outputs on every unit, each in a
+   * single transaction (see ScpiClient::ExchangeModelIO()). Every unit is
+   * stepped at once, so the whole group steps in about one round trip.
+   *
+   * The broadcast driver is never used, since each unit has its own inputs.
+   *
+   * @param[in,out] exchanges inputs and outputs of each unit, one per client
+   * in the same order as the clients
+   *
+   * @return Vector of error codes, one per client. Every code is
+   * ErrorCode::kInvalidArgument if there isn't one exchange per client.
+   */
+  std::vector<ErrorCode> ExchangeModelIO(
+      std::span<const ModelExchange> exchanges) const;
+
+  ///@}
+
+  /**
+   * @name Snapshots
+   */
+  ///@{
+
+  /**
+   * @brief Take a measurement snapshot of every unit.
+   *
+   * @return Vector of results containing snapshots, one per client.
+   */
+  std::vector<Result<MeasurementSnapshot>> MeasureSnapshot() const;
+
+  ///@}
+
+ private:
+  // Call task(i) for each client index in parallel and wait for completion.
+  void Run(const std::function<void(std::size_t)>& task) const;
+
+  // Perform a setter over the broadcast driver if there is one, otherwise on
+  // every client in parallel.
+  std::vector<ErrorCode> Broadcast(
+      const std::function<ErrorCode(const ScpiClient&)>& set) const;
+
+  struct Impl;
+
+  std::vector<ScpiClient> clients_;
+  ScpiClient broadcast_;
+  std::unique_ptr<Impl> impl_;
+};
+
+}  // namespace bci::abs
+
+#endif /* ABS_SCPI_DRIVER_INCLUDE_BCI_ABS_DEVICEGROUP_H */
@@ -12,7 +12,9 @@
 #ifndef ABS_SCPI_DRIVER_INCLUDE_BCI_ABS_DISCOVERY_H
 #define ABS_SCPI_DRIVER_INCLUDE_BCI_ABS_DISCOVERY_H
 
+#include <cstddef>
 #include <cstdint>
+#include <functional>
 #include <string>
 #include <string_view>
 #include <vector>
@@ -67,6 +69,78 @@ Result<SerialDeviceList> SerialDiscovery(std::string_view port,
                                          std::uint8_t first_id,
                                          std::uint8_t last_id);
 
+/// Options for Discover().
+struct DiscoveryOptions {
+  /// IP addresses of the local NICs to send multicast discovery from.
+  std::vector<std::string> interfaces;
+
+  /// Serial ports to scan.
+  std::vector<std::string> serial_ports;
+
+  /// First serial ID to query on each port, 0-31.
+  std::uint8_t first_id{0};
+
+  /// Last serial ID to query on each port, 0-31 (inclusive).
+  std::uint8_t last_id{31};
+
+  /// Longest time to wait for a reply from each serial ID, in milliseconds.
+  unsigned int serial_timeout_ms{50};
+
+  /// Silence to wait for on each interface before concluding that every unit
+  /// has replied, in milliseconds.
+  unsigned int multicast_timeout_ms{100};
+
+  /// Once units have begun replying on an interface, end the scan after a
+  /// shorter silence of a few times the first unit's response time, down to
+  /// 20 ms. Faster, but a unit which replies much later than the others may
+  /// be missed.
+  bool adaptive_multicast_timeout{false};
+
+  /// Size of the socket receive buffer on each interface in bytes. Replies
+  /// which arrive while it is full are lost, so many units which reply at once
+  /// may need more room. The system may limit the size.
+  std::size_t multicast_receive_buffer_size{256 * 1024};
+
+  /// Stop as soon as this many devices have been found in total, or 0 to scan
+  /// everything.
+  unsigned int max_devices{0};
+};
+
+/// Callback invoked for each discovered Ethernet device.
+using EthernetDiscoveryCallback = std::function<void(const EthernetDevice&)>;
+
+/// Callback invoked for each discovered serial device, along with the port on
+/// which it was found.
+using SerialDiscoveryCallback =
+    std::function<void(const std::string& port, const SerialDevice&)>;
+
+/**
+ * @brief Discover units on several network interfaces and serial ports at
+ * once.
+ *
+ * Every interface and serial port is scanned concurrently, and each device is
+ * passed to the matching callback as soon as it replies. Callbacks are called
+ * from the scanning threads, but never more than one at a time.
+ *
+ * Each serial ID is given the full DiscoveryOptions::serial_timeout_ms to
+ * reply, since a late reply can't be told apart from the next ID's. Each
+ * interface is scanned until no reply has arrived for
+ * DiscoveryOptions::multicast_timeout_ms, unless
+ * DiscoveryOptions::adaptive_multicast_timeout shortens it.
+ *
+ * A failure on one interface or port doesn't stop the others from being
+ * scanned.
+ *
+ * @param[in] options interfaces, ports, and timeouts to use
+ * @param[in] on_ethernet callback for each Ethernet device (may be empty)
+ * @param[in] on_serial callback for each serial device (may be empty)
+ *
+ * @return The first error encountered, if any.
+ */
+ErrorCode Discover(const DiscoveryOptions& options,
+                   const EthernetDiscoveryCallback& on_ethernet,
+                   const SerialDiscoveryCallback& on_serial);
+
 }  // namespace bci::abs
 
 #endif /* ABS_SCPI_DRIVER_INCLUDE_BCI_ABS_DISCOVERY_H */
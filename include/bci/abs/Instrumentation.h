@@ -0,0 +1,189 @@
+/*
+ * Copyright (c) 2024, Bloomy Controls, Inc. All rights reserved.
+ *
+ * Use of this source code is governed by a BSD-3-clause license that can be
+ * found in the LICENSE file or at https://opensource.org/license/BSD-3-Clause
+ */
+
+/**
+ * @file
+ * @brief Per-call latency and error instrumentation.
+ */
+#ifndef ABS_SCPI_DRIVER_INCLUDE_BCI_ABS_INSTRUMENTATION_H
+#define ABS_SCPI_DRIVER_INCLUDE_BCI_ABS_INSTRUMENTATION_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "CommonTypes.h"
+
+namespace bci::abs {
+
+/// Layer which reported a CallEvent.
+enum class CallSource {
+  kClient,  ///< ScpiClient command or query (write plus response, if any)
+  kDriver,  ///< Single comm driver write or read
+};
+
+/**
+ * @brief Description of a single instrumented call.
+ *
+ * The command mnemonic has its parameters and channel suffixes removed, so
+ * "SOUR3:VOLT 1.5\r\n" is reported as "SOUR:VOLT". Compound commands report
+ * the headers of every element joined with ';'. Driver reads carry no command.
+ * The command view is only valid until InstrumentationSink::Record() returns.
+ *
+ * A read which timed out and was retried reports the retries, and the total
+ * time spent waiting. Only drivers with a retry policy (see UdpTimeoutPolicy)
+ * retry reads.
+ */
+struct CallEvent {
+  CallSource source;                    ///< Layer which made the call
+  std::string_view command;             ///< Command mnemonic
+  std::size_t bytes_sent;               ///< Bytes written to the device
+  std::size_t bytes_received;           ///< Bytes received (no terminator)
+  std::chrono::nanoseconds write_time;  ///< Time spent writing
+  std::chrono::nanoseconds read_time;   ///< Time spent waiting for a response
+  ErrorCode error;                      ///< Result of the call
+  unsigned int retries;                 ///< Times the request was resent
+};
+
+/// Kind of ConnectionEvent.
+enum class ConnectionEventType {
+  kLost,           ///< The active connection failed
+  kRestored,       ///< A working connection replaced the one which failed
+  kConnectFailed,  ///< An attempt to establish a connection failed
+};
+
+/**
+ * @brief Change in the state of a managed connection (see
+ * drivers::ManagedTcpDriver).
+ */
+struct ConnectionEvent {
+  ConnectionEventType type;  ///< What happened
+  ErrorCode error;  ///< Cause of a loss or failed attempt, otherwise kSuccess
+  std::chrono::nanoseconds downtime;  ///< Time without a working connection
+                                      ///< before it was restored
+  unsigned int attempts;  ///< Consecutive failed attempts, for kConnectFailed
+};
+
+/**
+ * @brief Receives an event for every instrumented call.
+ *
+ * Attach a sink to a ScpiClient or CommDriver with its SetInstrumentation()
+ * method. Nothing is measured while no sink is attached.
+ *
+ * @note Record() is called on the thread making the call, inline with the
+ * call, so it should be fast. It may be called concurrently when a sink is
+ * shared between clients or drivers.
+ */
+class InstrumentationSink {
+ public:
+  virtual ~InstrumentationSink() = default;
+
+  /**
+   * @brief Record a call.
+   *
+   * @param[in] event description of the call
+   */
+  virtual void Record(const CallEvent& event) noexcept = 0;
+
+  /**
+   * @brief Record a change in the state of a managed connection. Called from
+   * the connection's background thread as well as the calling thread. The
+   * default implementation ignores the event.
+   *
+   * @param[in] event description of the change
+   */
+  virtual void RecordConnection(const ConnectionEvent& event) noexcept {
+    static_cast<void>(event);
+  }
+};
+
+/// Latency statistics for a single command.
+struct LatencyStats {
+  std::uint64_t count;           ///< Number of calls
+  std::uint64_t errors;          ///< Number of calls which failed
+  std::uint64_t timeouts;        ///< Number of calls which timed out
+  std::chrono::nanoseconds p50;  ///< Median latency
+  std::chrono::nanoseconds p99;  ///< 99th percentile latency
+  std::chrono::nanoseconds max;  ///< Maximum latency
+};
+
+/**
+ * @brief Lock-free per-command latency histogram.
+ *
+ * Records the total latency (write plus response) of every client call, keyed
+ * by command mnemonic. Driver events are ignored so that attaching the same
+ * histogram to a client and its driver does not count calls twice. Latencies
+ * are bucketed with a relative error of at most 12.5%.
+ *
+ * Recording never locks or allocates, so one histogram may be shared by many
+ * clients on different threads. Up to 128 distinct commands are tracked;
+ * calls to further commands are not recorded.
+ *
+ * Example usage:
+ * @code{.cpp}
+ * auto hist = std::make_shared<bci::abs::LatencyHistogram>();
+ * client.SetInstrumentation(hist);
+ * client.MeasureAllCellVoltages();
+ * if (auto stats = hist->Stats("MEAS:VOLT?")) {
+ *   std::cout << "p99: " << stats->p99.count() << "ns\n";
+ * }
+ * @endcode
+ */
+class LatencyHistogram final : public InstrumentationSink {
+ public:
+  /// CTOR.
+  LatencyHistogram();
+
+  LatencyHistogram(const LatencyHistogram&) = delete;
+  LatencyHistogram& operator=(const LatencyHistogram&) = delete;
+
+  /// DTOR.
+  ~LatencyHistogram() override;
+
+  /**
+   * @brief Record a call.
+   *
+   * @param[in] event description of the call
+   */
+  void Record(const CallEvent& event) noexcept override;
+
+  /**
+   * @brief Get the statistics for a single command.
+   *
+   * @param[in] command command mnemonic, as reported in CallEvent::command
+   *
+   * @return Result containing the statistics or an error code if the command
+   * has not been recorded.
+   */
+  Result<LatencyStats> Stats(std::string_view command) const;
+
+  /**
+   * @brief Get the statistics for every command recorded.
+   *
+   * @return Vector of command mnemonics and their statistics.
+   */
+  std::vector<std::pair<std::string, LatencyStats>> AllStats() const;
+
+  /**
+   * @brief Clear all statistics. Commands already seen remain tracked.
+   */
+  void Reset() noexcept;
+
+ private:
+  struct Impl;
+
+  std::unique_ptr<Impl> impl_;
+};
+
+}  // namespace bci::abs
+
+#endif /* ABS_SCPI_DRIVER_INCLUDE_BCI_ABS_INSTRUMENTATION_H */
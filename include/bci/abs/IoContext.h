@@ -0,0 +1,150 @@
+/*
+ * Copyright (c) 2024, Bloomy Controls, Inc. All rights reserved.
+ *
+ * Use of this source code is governed by a BSD-3-clause license that can be
+ * found in the LICENSE file or at https://opensource.org/license/BSD-3-Clause
+ */
+
+/**
+ * @file
+ * @brief Event loop shared by asynchronous comm drivers.
+ */
+#ifndef ABS_SCPI_DRIVER_INCLUDE_BCI_ABS_IOCONTEXT_H
+#define ABS_SCPI_DRIVER_INCLUDE_BCI_ABS_IOCONTEXT_H
+
+#include <cstddef>
+#include <memory>
+
+namespace bci::abs {
+
+namespace drivers {
+class BlockingWait;
+class SerialDriver;
+class TcpDriver;
+class UdpDriver;
+class UdpMcastDriver;
+}  // namespace drivers
+
+/**
+ * @brief Event loop which runs the I/O of any number of comm drivers.
+ *
+ * By default, each driver owns a private event loop and can only be used by
+ * blocking on each call, so each device needs its own thread to be used
+ * concurrently. Drivers constructed with a shared IoContext instead run their
+ * asynchronous operations on it, so a single thread calling Run() can drive
+ * many devices at once.
+ *
+ * Example usage (error handling omitted):
+ * @code{.cpp}
+ * bci::abs::IoContext io;
+ * std::vector<bci::abs::AsyncScpiClient> clients;
+ * for (auto ip : ips) {
+ *   auto driver = std::make_shared<bci::abs::drivers::UdpDriver>(io);
+ *   driver->Open(ip);
+ *   clients.emplace_back(driver);
+ * }
+ * for (auto& client : clients) {
+ *   client.MeasureAllCellVoltages([](auto res) { ... });
+ * }
+ * io.Run();  // returns once all measurements have completed
+ * @endcode
+ *
+ * An IoContext can also run its own pool of worker threads, in which case
+ * handlers are called on those threads and Run() need not be called at all.
+ * Sharing one IoContext between many drivers saves the memory, file descriptors
+ * and startup cost of one event loop per driver.
+ *
+ * Without worker threads, blocking calls on drivers using the IoContext run the
+ * event loop on the calling thread, so they must all be made from one thread,
+ * and not while another thread is running the event loop.
+ *
+ * @note The IoContext must outlive all drivers using it.
+ */
+class IoContext {
+ public:
+  /// CTOR. The event loop only runs on threads calling Run() and friends.
+  IoContext();
+
+  /**
+   * @brief Create an event loop which runs on its own worker threads.
+   *
+   * The workers keep running, even while there is no work, until the IoContext
+   * is destroyed. Blocking calls on drivers using the IoContext then wait for
+   * the workers to complete them instead of running the event loop on the
+   * calling thread, so they may be made from any thread.
+   *
+   * @param[in] threads number of worker threads (0 for none, which is the same
+   * as the default constructor)
+   */
+  explicit IoContext(std::size_t threads);
+
+  IoContext(const IoContext&) = delete;
+  IoContext& operator=(const IoContext&) = delete;
+
+  /// DTOR. Stops and joins any worker threads.
+  ~IoContext();
+
+  /**
+   * @return The number of worker threads owned by the IoContext.
+   */
+  std::size_t ThreadCount() const noexcept;
+
+  /**
+   * @brief Run the event loop until there is no more work to do or Stop() is
+   * called.
+   *
+   * @return The number of handlers executed.
+   */
+  std::size_t Run();
+
+  /**
+   * @brief Run the event loop until one handler has executed, there is no more
+   * work to do, or Stop() is called.
+   *
+   * @return The number of handlers executed.
+   */
+  std::size_t RunOne();
+
+  /**
+   * @brief Run any handlers which are ready without blocking.
+   *
+   * @return The number of handlers executed.
+   */
+  std::size_t Poll();
+
+  /**
+   * @brief Stop the event loop. Any threads in Run() return as soon as
+   * possible. Worker threads exit and are not restarted.
+   *
+   * Blocking driver calls in progress return ErrorCode::kNotConnected as soon
+   * as possible, and later ones fail with it immediately. They never restart
+   * the event loop themselves. Without worker threads, Restart() lets them
+   * run again; with worker threads, they keep failing.
+   */
+  void Stop();
+
+  /**
+   * @return Whether the event loop has been stopped.
+   */
+  bool Stopped() const noexcept;
+
+  /**
+   * @brief Prepare to run the event loop again after it has stopped or run out
+   * of work.
+   */
+  void Restart();
+
+ private:
+  friend class drivers::BlockingWait;
+  friend class drivers::SerialDriver;
+  friend class drivers::TcpDriver;
+  friend class drivers::UdpDriver;
+  friend class drivers::UdpMcastDriver;
+
+  struct Impl;
+  std::unique_ptr<Impl> impl_;
+};
+
+}  // namespace bci::abs
+
+#endif /* ABS_SCPI_DRIVER_INCLUDE_BCI_ABS_IOCONTEXT_H */
@@ -0,0 +1,176 @@
+/*
+ * Copyright (c) 2024, Bloomy Controls, Inc. All rights reserved.
+ *
+ * Use of this source code is governed by a BSD-3-clause license that can be
+ * found in the LICENSE file or at https://opensource.org/license/BSD-3-Clause
+ */
+
+/**
+ * @file
+ * @brief Self-healing TCP connection with a warm standby.
+ */
+#ifndef ABS_SCPI_DRIVER_INCLUDE_BCI_ABS_MANAGEDTCPDRIVER_H
+#define ABS_SCPI_DRIVER_INCLUDE_BCI_ABS_MANAGEDTCPDRIVER_H
+
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+
+#include "CommDriver.h"
+#include "CommonTypes.h"
+#include "TcpDriver.h"
+
+namespace bci::abs::drivers {
+
+/**
+ * @brief Options for a ManagedTcpDriver.
+ */
+struct ManagedTcpOptions {
+  /// Socket options for every connection.
+  TcpOptions socket{};
+
+  /// Timeout of each background connection attempt in milliseconds.
+  unsigned int connect_timeout_ms = 1000;
+
+  /// Time between health checks in milliseconds.
+  unsigned int health_interval_ms = 1000;
+
+  /// Timeout of the *IDN? query used as a health check in milliseconds.
+  unsigned int probe_timeout_ms = 250;
+
+  /// Delay before retrying after the first failed connection attempt in
+  /// milliseconds. The delay doubles with each consecutive failure.
+  unsigned int initial_backoff_ms = 100;
+
+  /// Longest delay between connection attempts in milliseconds.
+  unsigned int max_backoff_ms = 5000;
+
+  /// Keep a second connection open to take over as soon as the active one
+  /// fails. Without it, a failed connection is replaced in the background.
+  bool standby = true;
+};
+
+/**
+ * @brief TCP driver which keeps its connection alive in the background.
+ *
+ * Connect() establishes the first connection. A background thread then opens a
+ * standby connection to the same unit, and checks both with a cheap *IDN?
+ * query every ManagedTcpOptions::health_interval_ms. The active connection is
+ * only checked while it's idle and every reply has been read. When the standby
+ * is ready, the two swap places for the check, so calls don't wait for it.
+ *
+ * When a write or read on the active connection fails or times out, or a
+ * health check fails, the connection is closed and the standby takes its place
+ * at once. The call which failed still returns its error, since the command
+ * may or may not have reached the unit. A timed out connection is replaced too,
+ * because a late response would otherwise be read as the answer to the next
+ * query. If no standby is ready, for example while the unit reboots, calls
+ * fail immediately with ErrorCode::kNotConnected while the background thread
+ * reconnects with exponential backoff. Calls never wait for a connection to be
+ * established.
+ *
+ * Losses, restorations, and failed connection attempts are reported to the
+ * instrumentation sink, if any, with InstrumentationSink::RecordConnection().
+ * Connection events go to the sink attached when Connect() is called; a sink
+ * attached later only sees writes and reads.
+ *
+ * Example usage (error handling omitted):
+ * @code{.cpp}
+ * auto driver = std::make_shared<bci::abs::drivers::ManagedTcpDriver>();
+ * driver->Connect("192.168.1.70", 1000);
+ * bci::abs::ScpiClient client{driver};
+ * client.Reboot();
+ * // calls fail quickly until the unit is back, then resume on their own
+ * @endcode
+ *
+ * @note The driver must only be used by one thread at a time, like the other
+ * drivers. The background thread only touches the active connection between
+ * calls.
+ */
+class ManagedTcpDriver final : public CommDriver {
+ public:
+  /// CTOR.
+  ManagedTcpDriver();
+
+  ManagedTcpDriver(const ManagedTcpDriver&) = delete;
+  ManagedTcpDriver& operator=(const ManagedTcpDriver&) = delete;
+
+  /// DTOR. Stops the background thread and closes every connection.
+  ~ManagedTcpDriver();
+
+  /**
+   * @brief Connect to the ABS using the default ManagedTcpOptions and start
+   * managing the connection.
+   *
+   * @param[in] ip device IP address
+   * @param[in] timeout_ms timeout of the first connection in milliseconds
+   *
+   * @return An error code.
+   */
+  ErrorCode Connect(std::string_view ip, unsigned int timeout_ms);
+
+  /**
+   * @brief Connect to the ABS with custom options and start managing the
+   * connection.
+   *
+   * @param[in] ip device IP address
+   * @param[in] timeout_ms timeout of the first connection in milliseconds
+   * @param[in] options connection management options
+   *
+   * @return An error code.
+   */
+  ErrorCode Connect(std::string_view ip, unsigned int timeout_ms,
+                    const ManagedTcpOptions& options);
+
+  /// Stop the background thread and close every connection. May wait for a
+  /// background connection attempt to time out.
+  void Close() noexcept;
+
+  /**
+   * @return Whether a working connection is active.
+   */
+  bool IsConnected() const;
+
+  /**
+   * @brief Send data over the active connection.
+   *
+   * @param[in] data data to send
+   * @param[in] timeout_ms send timeout in milliseconds
+   *
+   * @return An error code.
+   */
+  ErrorCode Write(std::string_view data, unsigned int timeout_ms) const;
+
+  /**
+   * @brief Read a line over the active connection. Fails with
+   * ErrorCode::kNotConnected if the connection which the query was sent on has
+   * since been replaced.
+   *
+   * @param[in] timeout_ms read timeout in milliseconds
+   *
+   * @return Result containing the line read or an error code.
+   */
+  Result<std::string> ReadLine(unsigned int timeout_ms) const;
+
+  /**
+   * @brief Read a line over the active connection into a caller-provided
+   * buffer.
+   *
+   * @param[out] buf buffer to read into
+   * @param[in] timeout_ms read timeout in milliseconds
+   *
+   * @return Result containing a view of the line within the buffer or an error
+   * code.
+   */
+  Result<std::string_view> ReadLineInto(std::span<char> buf,
+                                        unsigned int timeout_ms) const;
+
+ private:
+  struct Impl;
+  std::unique_ptr<Impl> impl_;
+};
+
+}  // namespace bci::abs::drivers
+
+#endif /* ABS_SCPI_DRIVER_INCLUDE_BCI_ABS_MANAGEDTCPDRIVER_H */
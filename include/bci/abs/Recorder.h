@@ -0,0 +1,455 @@
+/*
+ * Copyright (c) 2024, Bloomy Controls, Inc. All rights reserved.
+ *
+ * Use of this source code is governed by a BSD-3-clause license that can be
+ * found in the LICENSE file or at https://opensource.org/license/BSD-3-Clause
+ */
+
+/**
+ * @file
+ * @brief Binary recording of measurement streams.
+ */
+#ifndef ABS_SCPI_DRIVER_INCLUDE_BCI_ABS_RECORDER_H
+#define ABS_SCPI_DRIVER_INCLUDE_BCI_ABS_RECORDER_H
+
+#include <chrono>
+#include <compare>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <ranges>
+#include <span>
+#include <string>
+#include <utility>
+
+#include "CommonTypes.h"
+#include "ContinuousAcquisition.h"
+
+namespace bci::abs {
+
+/**
+ * @brief Records measurements to memory-mapped, columnar binary files.
+ *
+ * Each device is recorded to its own series of files named
+ * `<prefix>.dev<device>.<sequence>.absrec`. A file holds up to a number of rows
+ * determined by the maximum file size, in blocks of a few thousand rows. Within
+ * a block, each value recorded (the timestamp, error code, alarms, digital
+ * inputs, and every cell voltage, cell current, analog input, and model output)
+ * is stored as a separate column. Recording a sample only copies it into the
+ * mapped file, so it costs no formatting or system calls. Rows fill the file
+ * from the start, block by block. Once a file is full, or if the clock goes
+ * backwards, recording continues in the next file of the series.
+ *
+ * Files use the host's byte order, and are read with RecordingReader.
+ *
+ * Example usage (error handling omitted):
+ * @code{.cpp}
+ * bci::abs::Recorder recorder{"soak"};
+ * std::array<bci::abs::AcquisitionSample, 64> samples;
+ * for (;;) {
+ *   auto count = acq.Read(samples);
+ *   recorder.Record(std::span(samples).first(count));
+ * }
+ * @endcode
+ */
+class Recorder {
+ public:
+  /// Default maximum size of each file.
+  static constexpr std::size_t kDefaultMaxFileSize = 64 * 1024 * 1024;
+
+  /// Default number of devices which may be recorded.
+  static constexpr std::size_t kDefaultMaxDevices = 256;
+
+  /**
+   * @brief Create a recorder. Files are only created once something is
+   * recorded.
+   *
+   * @param[in] path_prefix path of the files, excluding the suffix
+   * @param[in] max_file_size maximum size of each file in bytes
+   * @param[in] max_devices number of devices which may be recorded; samples of
+   * devices with higher indices are rejected with ErrorCode::kInvalidArgument
+   */
+  explicit Recorder(std::string path_prefix,
+                    std::size_t max_file_size = kDefaultMaxFileSize,
+                    std::size_t max_devices = kDefaultMaxDevices);
+
+  /**
+   * @brief Move construct from another Recorder.
+   *
+   * @param[in] other Recorder to move from
+   */
+  Recorder(Recorder&& other) noexcept;
+
+  Recorder(const Recorder&) = delete;
+
+  /**
+   * @brief Move assign from another Recorder.
+   *
+   * @param[in] rhs Recorder to move from
+   *
+   * @return Reference to self.
+   */
+  Recorder& operator=(Recorder&& rhs) noexcept;
+
+  Recorder& operator=(const Recorder&) = delete;
+
+  /// DTOR. Closes any open files.
+  ~Recorder();
+
+  /**
+   * @brief Record a sample taken by a ContinuousAcquisition.
+   *
+   * @param[in] sample sample to record
+   *
+   * @return An error code.
+   */
+  ErrorCode Record(const AcquisitionSample& sample);
+
+  /**
+   * @brief Record many samples taken by a ContinuousAcquisition.
+   *
+   * @param[in] samples samples to record
+   *
+   * @return An error code.
+   */
+  ErrorCode Record(std::span<const AcquisitionSample> samples);
+
+  /**
+   * @brief Record a snapshot of a device's measurements.
+   *
+   * @param[in] device index of the device
+   * @param[in] timestamp time at which the measurements were taken
+   * @param[in] snapshot measurements
+   * @param[in] model_outputs model outputs, if any (outputs not given are
+   * recorded as NaN)
+   *
+   * @return An error code.
+   */
+  ErrorCode Record(std::size_t device,
+                   std::chrono::system_clock::time_point timestamp,
+                   const MeasurementSnapshot& snapshot,
+                   std::span<const float> model_outputs = {});
+
+  /**
+   * @brief Write everything recorded so far to disk. This isn't necessary for
+   * readers to see new samples, only to protect them from a system crash.
+   *
+   * @return An error code.
+   */
+  ErrorCode Flush();
+
+  /// Close all open files. Recording again starts a new file for each device.
+  void Close() noexcept;
+
+ private:
+  struct Impl;
+  std::unique_ptr<Impl> impl_;
+};
+
+/**
+ * @brief Random-access view of one column of a recording.
+ *
+ * A column is stored in blocks spread through the file, so it isn't contiguous,
+ * but it can be indexed and iterated like a span.
+ *
+ * @tparam T value type
+ */
+template <class T>
+class ColumnView : public std::ranges::view_interface<ColumnView<T>> {
+ public:
+  class Iterator;
+
+  /// CTOR. Creates an empty view.
+  ColumnView() noexcept = default;
+
+  /**
+   * @brief Create a view of a column. Used by RecordingReader.
+   *
+   * @param[in] first start of the column in the first block
+   * @param[in] block_size bytes between the starts of consecutive blocks
+   * @param[in] block_rows rows per block
+   * @param[in] size number of rows
+   */
+  ColumnView(const std::byte* first, std::size_t block_size,
+             std::size_t block_rows, std::size_t size) noexcept
+      : first_{first},
+        block_size_{block_size},
+        block_rows_{block_rows},
+        offset_{0},
+        size_{size} {}
+
+  /**
+   * @return The number of rows.
+   */
+  std::size_t size() const noexcept { return size_; }
+
+  /**
+   * @param[in] row row index, which must be less than size()
+   *
+   * @return The value in the row.
+   */
+  const T& operator[](std::size_t row) const noexcept {
+    row += offset_;
+    const auto* block = first_ + row / block_rows_ * block_size_;
+    return reinterpret_cast<const T*>(block)[row % block_rows_];
+  }
+
+  /**
+   * @return Iterator to the first row.
+   */
+  Iterator begin() const noexcept { return Iterator{*this, 0}; }
+
+  /**
+   * @return Iterator past the last row.
+   */
+  Iterator end() const noexcept { return Iterator{*this, size_}; }
+
+  /**
+   * @brief Get a view of some of the rows.
+   *
+   * @param[in] first first row
+   * @param[in] count number of rows, which must not extend past the end
+   *
+   * @return View of the rows.
+   */
+  ColumnView Subview(std::size_t first, std::size_t count) const noexcept {
+    auto view = *this;
+    view.offset_ += first;
+    view.size_ = count;
+    return view;
+  }
+
+ private:
+  const std::byte* first_{};
+  std::size_t block_size_{};
+  std::size_t block_rows_{1};
+  std::size_t offset_{};
+  std::size_t size_{};
+};
+
+/// Random-access iterator over a column.
+template <class T>
+class ColumnView<T>::Iterator {
+ public:
+  using iterator_concept = std::random_access_iterator_tag;
+  using iterator_category = std::random_access_iterator_tag;
+  using value_type = T;
+  using difference_type = std::ptrdiff_t;
+  using pointer = const T*;
+  using reference = const T&;
+
+  Iterator() noexcept = default;
+
+  Iterator(const ColumnView& view, std::size_t row) noexcept
+      : view_{view}, row_{row} {}
+
+  reference operator*() const noexcept { return view_[row_]; }
+
+  reference operator[](difference_type n) const noexcept {
+    return view_[row_ + n];
+  }
+
+  Iterator& operator++() noexcept {
+    ++row_;
+    return *this;
+  }
+
+  Iterator operator++(int) noexcept {
+    auto it = *this;
+    ++row_;
+    return it;
+  }
+
+  Iterator& operator--() noexcept {
+    --row_;
+    return *this;
+  }
+
+  Iterator operator--(int) noexcept {
+    auto it = *this;
+    --row_;
+    return it;
+  }
+
+  Iterator& operator+=(difference_type n) noexcept {
+    row_ += n;
+    return *this;
+  }
+
+  Iterator& operator-=(difference_type n) noexcept {
+    row_ -= n;
+    return *this;
+  }
+
+  friend Iterator operator+(Iterator it, difference_type n) noexcept {
+    return it += n;
+  }
+
+  friend Iterator operator+(difference_type n, Iterator it) noexcept {
+    return it += n;
+  }
+
+  friend Iterator operator-(Iterator it, difference_type n) noexcept {
+    return it -= n;
+  }
+
+  friend difference_type operator-(const Iterator& a,
+                                   const Iterator& b) noexcept {
+    return static_cast<difference_type>(a.row_) -
+           static_cast<difference_type>(b.row_);
+  }
+
+  friend bool operator==(const Iterator& a, const Iterator& b) noexcept {
+    return a.row_ == b.row_;
+  }
+
+  friend auto operator<=>(const Iterator& a, const Iterator& b) noexcept {
+    return a.row_ <=> b.row_;
+  }
+
+ private:
+  ColumnView view_{};
+  std::size_t row_{};
+};
+
+/**
+ * @brief Reads a file written by a Recorder.
+ *
+ * Columns are returned as views of the mapped file, so reading a slice of a
+ * recording only touches the pages holding that slice. The file may be read
+ * while it is still being recorded, in which case Size() grows as rows are
+ * added.
+ *
+ * Example usage (error handling omitted):
+ * @code{.cpp}
+ * bci::abs::RecordingReader reader;
+ * reader.Open("soak.dev0.0000.absrec");
+ * auto [first, last] = reader.Find(start_time, end_time);
+ * auto v = reader.CellVoltages(0).Subview(first, last - first);
+ * @endcode
+ */
+class RecordingReader {
+ public:
+  /// CTOR.
+  RecordingReader() noexcept;
+
+  /**
+   * @brief Move construct from another RecordingReader.
+   *
+   * @param[in] other RecordingReader to move from
+   */
+  RecordingReader(RecordingReader&& other) noexcept;
+
+  RecordingReader(const RecordingReader&) = delete;
+
+  /**
+   * @brief Move assign from another RecordingReader.
+   *
+   * @param[in] rhs RecordingReader to move from
+   *
+   * @return Reference to self.
+   */
+  RecordingReader& operator=(RecordingReader&& rhs) noexcept;
+
+  RecordingReader& operator=(const RecordingReader&) = delete;
+
+  /// DTOR.
+  ~RecordingReader();
+
+  /**
+   * @brief Open a recording.
+   *
+   * @param[in] path path of the file
+   *
+   * @return An error code.
+   */
+  ErrorCode Open(const std::string& path);
+
+  /// Close the recording. Views returned by the reader become invalid.
+  void Close() noexcept;
+
+  /**
+   * @return The number of rows recorded, or 0 if no file is open.
+   */
+  std::size_t Size() const noexcept;
+
+  /**
+   * @return Index of the device recorded in the file.
+   */
+  std::size_t Device() const noexcept;
+
+  /**
+   * @brief Find the rows recorded within a time range.
+   *
+   * @param[in] begin start of the range (inclusive)
+   * @param[in] end end of the range (exclusive)
+   *
+   * @return The first row in the range and one past the last row.
+   */
+  std::pair<std::size_t, std::size_t> Find(
+      std::chrono::system_clock::time_point begin,
+      std::chrono::system_clock::time_point end) const noexcept;
+
+  /**
+   * @return Timestamps in nanoseconds since the Unix epoch.
+   */
+  ColumnView<std::int64_t> Timestamps() const noexcept;
+
+  /**
+   * @return Error codes of the queries (see ErrorCode). Measurements are NaN
+   * or zero in rows with errors.
+   */
+  ColumnView<std::int32_t> Errors() const noexcept;
+
+  /**
+   * @return Alarm bitmasks.
+   */
+  ColumnView<std::uint32_t> Alarms() const noexcept;
+
+  /**
+   * @return Digital input bitmasks.
+   */
+  ColumnView<std::uint32_t> DigitalInputs() const noexcept;
+
+  /**
+   * @param[in] cell target cell (empty if out of range)
+   *
+   * @return Cell voltages.
+   */
+  ColumnView<float> CellVoltages(unsigned int cell) const noexcept;
+
+  /**
+   * @param[in] cell target cell (empty if out of range)
+   *
+   * @return Cell currents.
+   */
+  ColumnView<float> CellCurrents(unsigned int cell) const noexcept;
+
+  /**
+   * @param[in] channel target channel (empty if out of range)
+   *
+   * @return Analog input voltages.
+   */
+  ColumnView<float> AnalogInputs(unsigned int channel) const noexcept;
+
+  /**
+   * @param[in] index target model output (empty if out of range)
+   *
+   * @return Model output values.
+   */
+  ColumnView<float> ModelOutputs(unsigned int index) const noexcept;
+
+ private:
+  struct Impl;
+  std::unique_ptr<Impl> impl_;
+};
+
+}  // namespace bci::abs
+
+// iterators of a column view don't refer to the view itself
+template <class T>
+inline constexpr bool
+    std::ranges::enable_borrowed_range<bci::abs::ColumnView<T>> = true;
+
+#endif /* ABS_SCPI_DRIVER_INCLUDE_BCI_ABS_RECORDER_H */
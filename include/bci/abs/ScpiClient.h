@@ -21,6 +21,7 @@
 
 #include "CommDriver.h"
 #include "CommonTypes.h"
+#include "Instrumentation.h"
 
 // These comments make sure doxygen generates docs properly.
 /**
@@ -34,11 +35,34 @@
 
 namespace bci::abs {
 
+namespace drivers {
+
+class TcpDriver;
+class UdpDriver;
+class UdpMcastDriver;
+class SerialDriver;
+
+}  // namespace drivers
+
+namespace detail {
+
+class TransactionLock;
+
+}  // namespace detail
+
 /**
- * @brief Generic SCPI client for communicating with the Bloomy Controls ABS.
+ * @brief SCPI client for communicating with the Bloomy Controls ABS over a
+ * particular type of driver.
  *
  * This class implements all the SCPI commands and queries, as well as parsing
- * and returning the results. It works with any CommDriver.
+ * and returning the results. ScpiClient, which works with any CommDriver, is
+ * the usual choice. When the type of driver is known in advance, a client for
+ * that type calls the driver directly rather than through CommDriver's virtual
+ * functions. The library provides clients for CommDriver, TcpDriver,
+ * UdpDriver, UdpMcastDriver, and SerialDriver.
+ *
+ * ScpiPipeline, CachedScpiClient, DeviceGroup, and the other classes which
+ * work with a client take a ScpiClient.
  *
  * Example usage (error handling omitted):
  * @code{.cpp}
@@ -49,59 +73,69 @@ namespace bci::abs {
  * if (auto v = client.MeasureCellVoltage(0)) {
  *   std::cout << "cell 1 voltage: " << *v << "\n";
  * }
+ *
+ * // or, calling the UDP driver directly:
+ * BasicScpiClient<bci::abs::drivers::UdpDriver> udp_client{driver};
  * @endcode
+ *
+ * @tparam Driver type of comm driver
  */
-class ScpiClient {
+template <class Driver>
+class BasicScpiClient {
  public:
+  /// Type of comm driver.
+  using DriverType = Driver;
+
   /// Default CTOR.
-  ScpiClient() noexcept;
+  BasicScpiClient() noexcept;
 
   /**
-   * @brief Initialize a ScpiClient with a driver handle.
+   * @brief Initialize a client with a driver handle.
    *
    * @param[in] driver pointer to a comm driver
    */
-  explicit ScpiClient(std::shared_ptr<drivers::CommDriver> driver) noexcept;
+  explicit BasicScpiClient(std::shared_ptr<Driver> driver) noexcept;
 
   /**
-   * @brief Move construct from another ScpiClient.
+   * @brief Move construct from another client.
    *
-   * @param[in] other ScpiClient to move from
+   * @param[in] other client to move from
    */
-  ScpiClient(ScpiClient&& other) noexcept;
+  BasicScpiClient(BasicScpiClient&& other) noexcept;
 
-  ScpiClient(const ScpiClient&) = delete;
+  BasicScpiClient(const BasicScpiClient&) = delete;
 
   /**
-   * @brief Move assign from another ScpiClient.
+   * @brief Move assign from another client.
    *
-   * @param[in] rhs ScpiClient to move from
+   * @param[in] rhs client to move from
    *
    * @return Reference to self.
    */
-  ScpiClient& operator=(ScpiClient&& rhs) noexcept;
+  BasicScpiClient& operator=(BasicScpiClient&& rhs) noexcept;
 
-  ScpiClient& operator=(const ScpiClient&) = delete;
+  BasicScpiClient& operator=(const BasicScpiClient&) = delete;
 
   /// DTOR.
-  ~ScpiClient() = default;
+  ~BasicScpiClient() = default;
 
   /**
    * @return Pointer to the comm driver.
    */
-  std::shared_ptr<drivers::CommDriver> GetDriver() noexcept;
+  std::shared_ptr<Driver> GetDriver() noexcept;
 
   /**
    * @return Pointer to the comm driver.
    */
-  std::shared_ptr<const drivers::CommDriver> GetDriver() const noexcept;
+  std::shared_ptr<const Driver> GetDriver() const noexcept;
 
   /**
-   * @brief Set or replace the comm driver for the client.
+   * @brief Set or replace the comm driver for the client. In thread-safe mode,
+   * the client switches to the new driver's lock.
    *
    * @param[in] driver new driver to use
    */
-  void SetDriver(std::shared_ptr<drivers::CommDriver> driver) noexcept;
+  void SetDriver(std::shared_ptr<Driver> driver) noexcept;
 
   /**
    * @brief Set the read timeout for the client. In most cases, this is
@@ -113,6 +147,52 @@ class ScpiClient {
    */
   unsigned int SetReadTimeout(unsigned int timeout_ms) noexcept;
 
+  /**
+   * @brief Attach a sink which is told about every command and query sent by
+   * the client, or pass nullptr to detach it. Nothing is measured while no sink
+   * is attached.
+   *
+   * Each event covers a whole transaction: the time spent writing the command
+   * and the time spent waiting for its response. Parsing the response is not
+   * included. Queries made through an AsyncScpiClient are not reported.
+   *
+   * @param[in] sink instrumentation sink, such as a LatencyHistogram
+   */
+  void SetInstrumentation(std::shared_ptr<InstrumentationSink> sink) noexcept;
+
+  /**
+   * @return Pointer to the instrumentation sink, if any.
+   */
+  std::shared_ptr<InstrumentationSink> GetInstrumentation() const noexcept;
+
+  /**
+   * @brief Enable or disable thread-safe mode.
+   *
+   * In thread-safe mode, the client may be shared by several threads, for
+   * example a monitoring thread polling alarms while a control thread sets
+   * voltages. Each command or query, including a whole pipeline, is performed
+   * as one transaction on the driver, so responses are never mixed up between
+   * threads. Commands which don't expect a response go ahead of other threads'
+   * waiting queries, so they are usually only delayed by the transaction in
+   * progress, though a waiting query gets its turn after a few of them.
+   *
+   * The lock belongs to the driver, so thread-safe clients sharing a driver are
+   * serialized with each other too. Clients which aren't thread-safe don't
+   * take it, and must not share a driver with concurrently used clients.
+   *
+   * Thread-safe mode is off by default. Configuration functions such as this
+   * one, SetDriver(), SetReadTimeout(), and SetInstrumentation() are never
+   * thread-safe, and must be called before the client is shared.
+   *
+   * @param[in] enable whether to enable thread-safe mode
+   */
+  void SetThreadSafe(bool enable);
+
+  /**
+   * @return Whether thread-safe mode is enabled.
+   */
+  bool IsThreadSafe() const noexcept;
+
   /**
    * @brief Change the targeted device ID. This is currently only meaningful for
    * RS-485.
@@ -190,6 +270,16 @@ class ScpiClient {
    */
   Result<ScpiError> GetNextError() const;
 
+  /**
+   * @brief Pop every error from the SCPI error queue.
+   *
+   * The queue is read several errors per transaction rather than one, so an
+   * empty or short queue is drained in a single round trip.
+   *
+   * @return Result containing the errors, oldest first, or an error code.
+   */
+  Result<ScpiErrorList> DrainErrors() const;
+
   /**
    * @brief Clear the device's error queue.
    *
@@ -215,6 +305,14 @@ class ScpiClient {
    */
   Result<bool> GetInterlockState() const;
 
+  /**
+   * @brief Query the alarms, interlock state, and error count of the unit in a
+   * single transaction.
+   *
+   * @return Result containing the device health or an error code.
+   */
+  Result<DeviceHealth> GetHealth() const;
+
   /**
    * @brief Assert the software interlock.
    *
@@ -242,6 +340,32 @@ class ScpiClient {
    */
   ErrorCode Reboot() const;
 
+  /**
+   * @brief Select the transfer format for floating-point readbacks.
+   *
+   * By default, the unit returns measurements as text. In binary mode, arrays
+   * of values (such as MeasureAllCellVoltages()) are returned as IEEE 488.2
+   * definite-length blocks of 32-bit floats, which are smaller and cheaper to
+   * decode. Responses in either format are decoded automatically.
+   *
+   * @note Not all firmware supports binary transfers. Use GetBinaryTransfer()
+   * to confirm that the unit accepted the change.
+   *
+   * @param[in] en whether to use binary transfers
+   *
+   * @return An error code.
+   */
+  ErrorCode SetBinaryTransfer(bool en) const;
+
+  /**
+   * @brief Query whether the unit is returning floating-point readbacks in
+   * binary.
+   *
+   * @return Result containing whether binary transfers are enabled or an error
+   * code.
+   */
+  Result<bool> GetBinaryTransfer() const;
+
   ///@}
 
   /**
@@ -357,6 +481,36 @@ class ScpiClient {
    */
   ErrorCode SetMultipleCellVoltages(unsigned int cells, float voltage) const;
 
+  /**
+   * @brief Set only the cells' voltages which have changed.
+   *
+   * Cells whose voltage is the same in @a prev and @a next are skipped, and
+   * cells changing to the same voltage share one command with a channel list,
+   * so the message is usually much shorter than with SetAllCellVoltages(). This
+   * matters most on slow links such as RS-485. Nothing is sent if no voltage
+   * changed.
+   *
+   * @param[in] prev values last set, one per cell
+   * @param[in] next new values, one per cell (must be the same length as
+   * @a prev, and there may not be more entries than cells)
+   *
+   * @return An error code.
+   */
+  ErrorCode SetCellVoltagesDelta(std::span<const float> prev,
+                                 std::span<const float> next) const;
+
+  /**
+   * @brief Set only the cells' voltages which have changed.
+   *
+   * @param[in] prev values last set, one per cell
+   * @param[in] next new values, one per cell
+   *
+   * @return An error code.
+   */
+  ErrorCode SetCellVoltagesDelta(
+      const std::array<float, kCellCount>& prev,
+      const std::array<float, kCellCount>& next) const;
+
   /**
    * @brief Query a single cell's voltage set point.
    *
@@ -470,6 +624,32 @@ class ScpiClient {
    */
   ErrorCode SetMultipleCellSourcing(unsigned int cells, float limit) const;
 
+  /**
+   * @brief Set only the cells' sourcing limits which have changed.
+   *
+   * Works like SetCellVoltagesDelta().
+   *
+   * @param[in] prev values last set, one per cell
+   * @param[in] next new values, one per cell (must be the same length as
+   * @a prev, and there may not be more entries than cells)
+   *
+   * @return An error code.
+   */
+  ErrorCode SetCellSourcingDelta(std::span<const float> prev,
+                                 std::span<const float> next) const;
+
+  /**
+   * @brief Set only the cells' sourcing limits which have changed.
+   *
+   * @param[in] prev values last set, one per cell
+   * @param[in] next new values, one per cell
+   *
+   * @return An error code.
+   */
+  ErrorCode SetCellSourcingDelta(
+      const std::array<float, kCellCount>& prev,
+      const std::array<float, kCellCount>& next) const;
+
   /**
    * @brief Query a single cell's sourcing current limit.
    *
@@ -588,6 +768,32 @@ class ScpiClient {
    */
   ErrorCode SetMultipleCellSinking(unsigned int cells, float limit) const;
 
+  /**
+   * @brief Set only the cells' sinking limits which have changed.
+   *
+   * Works like SetCellVoltagesDelta().
+   *
+   * @param[in] prev values last set, one per cell
+   * @param[in] next new values, one per cell (must be the same length as
+   * @a prev, and there may not be more entries than cells)
+   *
+   * @return An error code.
+   */
+  ErrorCode SetCellSinkingDelta(std::span<const float> prev,
+                                std::span<const float> next) const;
+
+  /**
+   * @brief Set only the cells' sinking limits which have changed.
+   *
+   * @param[in] prev values last set, one per cell
+   * @param[in] next new values, one per cell
+   *
+   * @return An error code.
+   */
+  ErrorCode SetCellSinkingDelta(
+      const std::array<float, kCellCount>& prev,
+      const std::array<float, kCellCount>& next) const;
+
   /**
    * @brief Query a single cell's sinking current limit.
    *
@@ -1099,6 +1305,32 @@ class ScpiClient {
   ErrorCode SetMultipleAnalogOutputs(unsigned int channels,
                                      float voltage) const;
 
+  /**
+   * @brief Set only the analog outputs which have changed.
+   *
+   * Works like SetCellVoltagesDelta().
+   *
+   * @param[in] prev values last set, one per channel
+   * @param[in] next new values, one per channel (must be the same length as
+   * @a prev, and there may not be more entries than channels)
+   *
+   * @return An error code.
+   */
+  ErrorCode SetAnalogOutputsDelta(std::span<const float> prev,
+                                  std::span<const float> next) const;
+
+  /**
+   * @brief Set only the analog outputs which have changed.
+   *
+   * @param[in] prev values last set, one per channel
+   * @param[in] next new values, one per channel
+   *
+   * @return An error code.
+   */
+  ErrorCode SetAnalogOutputsDelta(
+      const std::array<float, kAnalogOutputCount>& prev,
+      const std::array<float, kAnalogOutputCount>& next) const;
+
   /**
    * @brief Query a single analog output's voltage.
    *
@@ -1405,6 +1637,32 @@ class ScpiClient {
   ErrorCode SetAllGlobalModelInputs(
       const std::array<float, kGlobalModelInputCount>& values) const;
 
+  /**
+   * @brief Set only the global model inputs which have changed.
+   *
+   * Works like SetCellVoltagesDelta().
+   *
+   * @param[in] prev values last set, one per input
+   * @param[in] next new values, one per input (must be the same length as
+   * @a prev, and there may not be more entries than inputs)
+   *
+   * @return An error code.
+   */
+  ErrorCode SetGlobalModelInputsDelta(std::span<const float> prev,
+                                      std::span<const float> next) const;
+
+  /**
+   * @brief Set only the global model inputs which have changed.
+   *
+   * @param[in] prev values last set, one per input
+   * @param[in] next new values, one per input
+   *
+   * @return An error code.
+   */
+  ErrorCode SetGlobalModelInputsDelta(
+      const std::array<float, kGlobalModelInputCount>& prev,
+      const std::array<float, kGlobalModelInputCount>& next) const;
+
   /**
    * @brief Query a single global model input.
    *
@@ -1510,6 +1768,32 @@ class ScpiClient {
   ErrorCode SetAllLocalModelInputs(
       const std::array<float, kLocalModelInputCount>& values) const;
 
+  /**
+   * @brief Set only the local model inputs which have changed.
+   *
+   * Works like SetCellVoltagesDelta().
+   *
+   * @param[in] prev values last set, one per input
+   * @param[in] next new values, one per input (must be the same length as
+   * @a prev, and there may not be more entries than inputs)
+   *
+   * @return An error code.
+   */
+  ErrorCode SetLocalModelInputsDelta(std::span<const float> prev,
+                                     std::span<const float> next) const;
+
+  /**
+   * @brief Set only the local model inputs which have changed.
+   *
+   * @param[in] prev values last set, one per input
+   * @param[in] next new values, one per input
+   *
+   * @return An error code.
+   */
+  ErrorCode SetLocalModelInputsDelta(
+      const std::array<float, kLocalModelInputCount>& prev,
+      const std::array<float, kLocalModelInputCount>& next) const;
+
   /**
    * @brief Query a single local model input.
    *
@@ -1611,6 +1895,65 @@ class ScpiClient {
    */
   ErrorCode GetAllModelOutputs(std::span<float> outputs) const;
 
+  /**
+   * @brief Set model inputs and query model outputs in a single transaction.
+   *
+   * The inputs and the output query are sent as one message, so a model step
+   * costs one round trip instead of one for each of SetAllGlobalModelInputs(),
+   * SetAllLocalModelInputs(), and GetAllModelOutputs(). The inputs are set
+   * before the outputs are read, but whether the outputs already reflect the
+   * new inputs depends on the model.
+   *
+   * Any of the spans may be empty to skip that part of the exchange. With no
+   * outputs, the inputs are sent without waiting for a response.
+   *
+   * @param[in] global_inputs global input values, one per input (must not be
+   * longer than the total number of global inputs)
+   * @param[in] local_inputs local input values, one per input (must not be
+   * longer than the total number of local inputs)
+   * @param[out] outputs returned outputs, one per output (must not be longer
+   * than the total number of outputs)
+   *
+   * @return An error code.
+   */
+  ErrorCode ExchangeModelIO(std::span<const float> global_inputs,
+                            std::span<const float> local_inputs,
+                            std::span<float> outputs) const;
+
+  /**
+   * @brief Set all model inputs and query all model outputs in a single
+   * transaction. See the span overload for details.
+   *
+   * @param[in] global_inputs global input values
+   * @param[in] local_inputs local input values
+   * @param[out] outputs returned outputs
+   *
+   * @return An error code.
+   */
+  ErrorCode ExchangeModelIO(
+      const std::array<float, kGlobalModelInputCount>& global_inputs,
+      const std::array<float, kLocalModelInputCount>& local_inputs,
+      std::array<float, kModelOutputCount>& outputs) const;
+
+  ///@}
+
+  /**
+   * @name Snapshots
+   * @{
+   */
+
+  /**
+   * @brief Measure all cell voltages and currents, cell operating modes, analog
+   * and digital inputs, and alarms in a single transaction.
+   *
+   * This sends one compound query, so it requires only one round trip to the
+   * device rather than one per reading. This is both much faster than querying
+   * each value individually and ensures the readings are taken close together.
+   *
+   * @return Result containing the measurements or an error code.
+   */
+  Result<MeasurementSnapshot> MeasureSnapshot() const;
+
   ///@}
 
  protected:
@@ -1633,14 +1976,48 @@ class ScpiClient {
    */
   Result<std::string> SendAndRecv(std::string_view buf) const;
 
+  /**
+   * @brief Send a message to the ABS and read the response into a
+   * caller-provided buffer. Checks for driver validity.
+   *
+   * @param[in] buf data to send
+   * @param[out] resp_buf buffer to read the response into
+   *
+   * @return Result containing a view of the response within resp_buf or an
+   * error code.
+   */
+  Result<std::string_view> SendAndRecv(std::string_view buf,
+                                       std::span<char> resp_buf) const;
+
  private:
+  friend class ScpiPipeline;
+
+  // Write to the driver without reporting to the sink. The driver must be
+  // valid.
+  ErrorCode Write(std::string_view buf) const;
+
   /// Driver handle.
-  std::shared_ptr<drivers::CommDriver> driver_;
+  std::shared_ptr<Driver> driver_;
 
   /// Read timeout.
   unsigned int read_timeout_ms_;
+
+  /// Instrumentation sink.
+  std::shared_ptr<InstrumentationSink> sink_;
+
+  /// Transaction lock, if thread-safe mode is enabled.
+  std::shared_ptr<detail::TransactionLock> lock_;
 };
 
+/// SCPI client which works with any CommDriver.
+using ScpiClient = BasicScpiClient<drivers::CommDriver>;
+
+extern template class BasicScpiClient<drivers::CommDriver>;
+extern template class BasicScpiClient<drivers::TcpDriver>;
+extern template class BasicScpiClient<drivers::UdpDriver>;
+extern template class BasicScpiClient<drivers::UdpMcastDriver>;
+extern template class BasicScpiClient<drivers::SerialDriver>;
+
 }  // namespace bci::abs
 
 #endif /* ABS_SCPI_DRIVER_INCLUDE_BCI_ABS_SCPICLIENT_H */
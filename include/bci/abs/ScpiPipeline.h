@@ -0,0 +1,463 @@
+/*
+ * Copyright (c) 2024, Bloomy Controls, Inc. All rights reserved.
+ *
+ * Use of this source code is governed by a BSD-3-clause license that can be
+ * found in the LICENSE file or at https://opensource.org/license/BSD-3-Clause
+ */
+
+/**
+ * @file
+ * @brief Pipelined queries for the SCPI client.
+ */
+#ifndef ABS_SCPI_DRIVER_INCLUDE_BCI_ABS_SCPIPIPELINE_H
+#define ABS_SCPI_DRIVER_INCLUDE_BCI_ABS_SCPIPIPELINE_H
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "CommonTypes.h"
+
+namespace bci::abs {
+
+namespace drivers {
+
+class CommDriver;
+
+}  // namespace drivers
+
+template <class Driver>
+class BasicScpiClient;
+
+using ScpiClient = BasicScpiClient<drivers::CommDriver>;
+
+/**
+ * @brief Queues several queries and sends them back to back, then collects the
+ * replies in order.
+ *
+ * A regular ScpiClient query waits for its reply before the next command can be
+ * sent, so every query costs a full round trip. A pipeline puts all of its
+ * queued commands on the wire first and only then reads the responses, so a
+ * group of queries costs roughly one round trip.
+ *
+ * Each query writes its result to the Result object passed when it was queued.
+ * These objects must outlive every call to Execute(). Queued queries are kept
+ * until Clear() is called, so a pipeline can be built once and executed every
+ * cycle of a poll loop.
+ *
+ * Example usage (error handling omitted):
+ * @code{.cpp}
+ * bci::abs::Result<std::array<float, bci::abs::kCellCount>> voltages;
+ * bci::abs::Result<std::uint32_t> alarms;
+ * bci::abs::ScpiPipeline pipeline{client};
+ * pipeline.MeasureAllCellVoltages(voltages);
+ * pipeline.GetAlarms(alarms);
+ * while (running) {
+ *   pipeline.Execute();
+ *   // use voltages and alarms
+ * }
+ * @endcode
+ *
+ * @note The pipeline holds a reference to the client, which must outlive it.
+ */
+class ScpiPipeline {
+ public:
+  /**
+   * @brief Create an empty pipeline for a client.
+   *
+   * @param[in] client client to send queries with
+   */
+  explicit ScpiPipeline(const ScpiClient& client) noexcept;
+
+  /**
+   * @brief Move construct from another pipeline.
+   *
+   * @param[in] other pipeline to move from
+   */
+  ScpiPipeline(ScpiPipeline&& other) noexcept;
+
+  ScpiPipeline(const ScpiPipeline&) = delete;
+
+  /**
+   * @brief Move assign from another pipeline.
+   *
+   * @param[in] rhs pipeline to move from
+   *
+   * @return Reference to self.
+   */
+  ScpiPipeline& operator=(ScpiPipeline&& rhs) noexcept;
+
+  ScpiPipeline& operator=(const ScpiPipeline&) = delete;
+
+  /// DTOR.
+  ~ScpiPipeline();
+
+  /**
+   * @return The number of queued queries.
+   */
+  std::size_t Size() const noexcept;
+
+  /// Remove all queued queries.
+  void Clear() noexcept;
+
+  /**
+   * @brief Send all queued queries, then read and parse their replies.
+   *
+   * If a command cannot be sent, the replies to the commands already sent are
+   * still read, and the remaining queries fail with the send error. If a reply
+   * cannot be read, the remaining queries fail with the read error, as any
+   * later replies can no longer be matched to their queries.
+   *
+   * @note Errors while parsing a reply are only reported in that query's
+   * result.
+   *
+   * @return An error code. This is the first communication error encountered,
+   * or success if every reply was received.
+   */
+  ErrorCode Execute() const;
+
+  /**
+   * @name System Control
+   */
+  ///@{
+
+  /**
+   * @brief Queue a query of general information about the unit.
+   *
+   * @param[out] out result of the query, updated by Execute()
+   */
+  void GetDeviceInfo(Result<DeviceInfo>& out);
+
+  /**
+   * @brief Queue a query of the device's serial ID.
+   *
+   * @param[out] out result of the query, updated by Execute()
+   */
+  void GetDeviceId(Result<std::uint8_t>& out);
+
+  /**
+   * @brief Queue a query of the number of errors in the device's error queue.
+   *
+   * @param[out] out result of the query, updated by Execute()
+   */
+  void GetErrorCount(Result<int>& out);
+
+  /**
+   * @brief Queue a query of the alarms raised on the unit.
+   *
+   * @param[out] out result of the query, updated by Execute()
+   */
+  void GetAlarms(Result<std::uint32_t>& out);
+
+  /**
+   * @brief Queue a query of the system interlock state.
+   *
+   * @param[out] out result of the query, updated by Execute()
+   */
+  void GetInterlockState(Result<bool>& out);
+
+  ///@}
+
+  /**
+   * @name Cell Control
+   */
+  ///@{
+
+  /**
+   * @brief Queue a query of the enable state of a cell.
+   *
+   * @param[in] cell target cell index
+   * @param[out] out result of the query, updated by Execute()
+   */
+  void GetCellEnabled(unsigned int cell, Result<bool>& out);
+
+  /**
+   * @brief Queue a query of the enable states of all cells.
+   *
+   * @param[out] out result of the query, updated by Execute()
+   */
+  void GetAllCellsEnabled(Result<std::array<bool, kCellCount>>& out);
+
+  /**
+   * @brief Queue a query of the enable states of all cells as a bitmask.
+   *
+   * @param[out] out result of the query, updated by Execute()
+   */
+  void GetAllCellsEnabledMasked(Result<unsigned int>& out);
+
+  /**
+   * @brief Queue a query of a single cell's voltage set point.
+   *
+   * @param[in] cell target cell index
+   * @param[out] out result of the query, updated by Execute()
+   */
+  void GetCellVoltageTarget(unsigned int cell, Result<float>& out);
+
+  /**
+   * @brief Queue a query of all cells' voltage set points.
+   *
+   * @param[out] out result of the query, updated by Execute()
+   */
+  void GetAllCellVoltageTargets(Result<std::array<float, kCellCount>>& out);
+
+  /**
+   * @brief Queue a query of a single cell's sourcing current limit.
+   *
+   * @param[in] cell target cell index
+   * @param[out] out result of the query, updated by Execute()
+   */
+  void GetCellSourcingLimit(unsigned int cell, Result<float>& out);
+
+  /**
+   * @brief Queue a query of all cells' sourcing current limits.
+   *
+   * @param[out] out result of the query, updated by Execute()
+   */
+  void GetAllCellSourcingLimits(Result<std::array<float, kCellCount>>& out);
+
+  /**
+   * @brief Queue a query of a single cell's sinking current limit.
+   *
+   * @param[in] cell target cell index
+   * @param[out] out result of the query, updated by Execute()
+   */
+  void GetCellSinkingLimit(unsigned int cell, Result<float>& out);
+
+  /**
+   * @brief Queue a query of all cells' sinking current limits.
+   *
+   * @param[out] out result of the query, updated by Execute()
+   */
+  void GetAllCellSinkingLimits(Result<std::array<float, kCellCount>>& out);
+
+  /**
+   * @brief Queue a query of a single cell's fault state.
+   *
+   * @param[in] cell target cell index
+   * @param[out] out result of the query, updated by Execute()
+   */
+  void GetCellFault(unsigned int cell, Result<CellFault>& out);
+
+  /**
+   * @brief Queue a query of all cells' fault states.
+   *
+   * @param[out] out result of the query, updated by Execute()
+   */
+  void GetAllCellFaults(Result<std::array<CellFault, kCellCount>>& out);
+
+  /**
+   * @brief Queue a query of a single cell's current sense range.
+   *
+   * @param[in] cell target cell index
+   * @param[out] out result of the query, updated by Execute()
+   */
+  void GetCellSenseRange(unsigned int cell, Result<CellSenseRange>& out);
+
+  /**
+   * @brief Queue a query of all cells' current sense ranges.
+   *
+   * @param[out] out result of the query, updated by Execute()
+   */
+  void GetAllCellSenseRanges(
+      Result<std::array<CellSenseRange, kCellCount>>& out);
+
+  /**
+   * @brief Queue a query of a single cell's measured voltage.
+   *
+   * @param[in] cell target cell index
+   * @param[out] out result of the query, updated by Execute()
+   */
+  void MeasureCellVoltage(unsigned int cell, Result<float>& out);
+
+  /**
+   * @brief Queue a query of all cells' measured voltages.
+   *
+   * @param[out] out result of the query, updated by Execute()
+   */
+  void MeasureAllCellVoltages(Result<std::array<float, kCellCount>>& out);
+
+  /**
+   * @brief Queue a query of a single cell's measured current.
+   *
+   * @param[in] cell target cell index
+   * @param[out] out result of the query, updated by Execute()
+   */
+  void MeasureCellCurrent(unsigned int cell, Result<float>& out);
+
+  /**
+   * @brief Queue a query of all cells' measured currents.
+   *
+   * @param[out] out result of the query, updated by Execute()
+   */
+  void MeasureAllCellCurrents(Result<std::array<float, kCellCount>>& out);
+
+  /**
+   * @brief Queue a query of a single cell's operating mode.
+   *
+   * @param[in] cell target cell index
+   * @param[out] out result of the query, updated by Execute()
+   */
+  void GetCellOperatingMode(unsigned int cell, Result<CellMode>& out);
+
+  /**
+   * @brief Queue a query of all cells' operating modes.
+   *
+   * @param[out] out result of the query, updated by Execute()
+   */
+  void GetAllCellOperatingModes(Result<std::array<CellMode, kCellCount>>& out);
+
+  ///@}
+
+  /**
+   * @name Auxiliary I/O
+   */
+  ///@{
+
+  /**
+   * @brief Queue a query of an analog output's set point.
+   *
+   * @param[in] channel target channel index
+   * @param[out] out result of the query, updated by Execute()
+   */
+  void GetAnalogOutput(unsigned int channel, Result<float>& out);
+
+  /**
+   * @brief Queue a query of all analog outputs' set points.
+   *
+   * @param[out] out result of the query, updated by Execute()
+   */
+  void GetAllAnalogOutputs(Result<std::array<float, kAnalogOutputCount>>& out);
+
+  /**
+   * @brief Queue a query of a digital output's state.
+   *
+   * @param[in] channel target channel index
+   * @param[out] out result of the query, updated by Execute()
+   */
+  void GetDigitalOutput(unsigned int channel, Result<bool>& out);
+
+  /**
+   * @brief Queue a query of all digital outputs' states as a bitmask.
+   *
+   * @param[out] out result of the query, updated by Execute()
+   */
+  void GetAllDigitalOutputsMasked(Result<unsigned int>& out);
+
+  /**
+   * @brief Queue a measurement of a single analog input.
+   *
+   * @param[in] channel target channel index
+   * @param[out] out result of the query, updated by Execute()
+   */
+  void MeasureAnalogInput(unsigned int channel, Result<float>& out);
+
+  /**
+   * @brief Queue a measurement of all analog inputs.
+   *
+   * @param[out] out result of the query, updated by Execute()
+   */
+  void MeasureAllAnalogInputs(
+      Result<std::array<float, kAnalogInputCount>>& out);
+
+  /**
+   * @brief Queue a measurement of a single digital input.
+   *
+   * @param[in] channel target channel index
+   * @param[out] out result of the query, updated by Execute()
+   */
+  void MeasureDigitalInput(unsigned int channel, Result<bool>& out);
+
+  /**
+   * @brief Queue a measurement of all digital inputs as a bitmask.
+   *
+   * @param[out] out result of the query, updated by Execute()
+   */
+  void MeasureAllDigitalInputsMasked(Result<unsigned int>& out);
+
+  ///@}
+
+  /**
+   * @name Modeling
+   */
+  ///@{
+
+  /**
+   * @brief Queue a query of the model status.
+   *
+   * @param[out] out result of the query, updated by Execute()
+   */
+  void GetModelStatus(Result<std::uint8_t>& out);
+
+  /**
+   * @brief Queue a query of a single global model input.
+   *
+   * @param[in] index input index
+   * @param[out] out result of the query, updated by Execute()
+   */
+  void GetGlobalModelInput(unsigned int index, Result<float>& out);
+
+  /**
+   * @brief Queue a query of all global model inputs.
+   *
+   * @param[out] out result of the query, updated by Execute()
+   */
+  void GetAllGlobalModelInputs(
+      Result<std::array<float, kGlobalModelInputCount>>& out);
+
+  /**
+   * @brief Queue a query of a single local model input.
+   *
+   * @param[in] index input index
+   * @param[out] out result of the query, updated by Execute()
+   */
+  void GetLocalModelInput(unsigned int index, Result<float>& out);
+
+  /**
+   * @brief Queue a query of all local model inputs.
+   *
+   * @param[out] out result of the query, updated by Execute()
+   */
+  void GetAllLocalModelInputs(
+      Result<std::array<float, kLocalModelInputCount>>& out);
+
+  /**
+   * @brief Queue a query of a single model output.
+   *
+   * @param[in] index output index
+   * @param[out] out result of the query, updated by Execute()
+   */
+  void GetModelOutput(unsigned int index, Result<float>& out);
+
+  /**
+   * @brief Queue a query of all model outputs.
+   *
+   * @param[out] out result of the query, updated by Execute()
+   */
+  void GetAllModelOutputs(Result<std::array<float, kModelOutputCount>>& out);
+
+  ///@}
+
+ private:
+  /// Callback which parses a reply (or handles a failure) for one query.
+  using Completion = std::function<void(Result<std::string>)>;
+
+  /// A queued query.
+  struct Query {
+    std::string command;  ///< Command to send, including terminator.
+    Completion on_reply;  ///< Invoked with the reply or an error.
+  };
+
+  /// Client used to send the queries.
+  const ScpiClient* client_;
+
+  /// Queued queries.
+  std::vector<Query> queries_;
+
+  void Queue(std::string command, Completion on_reply);
+};
+
+}  // namespace bci::abs
+
+#endif /* ABS_SCPI_DRIVER_INCLUDE_BCI_ABS_SCPIPIPELINE_H */
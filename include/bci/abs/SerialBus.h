@@ -0,0 +1,106 @@
+/*
+ * Copyright (c) 2024, Bloomy Controls, Inc. All rights reserved.
+ *
+ * Use of this source code is governed by a BSD-3-clause license that can be
+ * found in the LICENSE file or at https://opensource.org/license/BSD-3-Clause
+ */
+
+/**
+ * @file
+ * @brief Shared RS-485 bus scheduler.
+ */
+#ifndef ABS_SCPI_DRIVER_INCLUDE_BCI_ABS_SERIALBUS_H
+#define ABS_SCPI_DRIVER_INCLUDE_BCI_ABS_SERIALBUS_H
+
+#include <memory>
+#include <string>
+
+#include "CommDriver.h"
+#include "CommonTypes.h"
+
+namespace bci::abs::drivers {
+
+/**
+ * @brief Schedules the traffic of many devices sharing one RS-485 bus.
+ *
+ * The bus owns a SerialDriver and a thread which performs every transaction on
+ * it. Device() returns a driver for each device ID on the bus, and clients
+ * using these drivers queue their transactions with the bus instead of
+ * switching the device ID of a shared SerialDriver themselves.
+ *
+ * Each device has its own queue, and the bus serves the devices in turn so one
+ * busy device cannot starve the others. Broadcasts (device ID 32 and up) are
+ * send-only, so they are sent as soon as the current transaction completes,
+ * ahead of queued queries. If a device doesn't answer a query in time, the
+ * other queries already queued for it fail immediately with the same error
+ * instead of each waiting out its own timeout.
+ *
+ * Drivers for different devices may be used from different threads at the
+ * same time. Each driver, and so each client, must only be used by one thread
+ * at a time: a driver shared between threads needs the transaction lock of
+ * ScpiClient::SetThreadSafe(), since the queries it holds aren't locked.
+ *
+ * Example usage (error handling omitted):
+ * @code{.cpp}
+ * bci::abs::drivers::SerialBus bus;
+ * bus.Open("/dev/ttyUSB0");
+ * bci::abs::ScpiClient all{bus.Device(32)};
+ * std::vector<bci::abs::ScpiClient> units;
+ * for (unsigned int id = 0; id < 8; ++id) {
+ *   units.emplace_back(bus.Device(id));
+ * }
+ * all.SetAllCellVoltages(1.5f);  // one message for every unit
+ * for (auto& unit : units) {
+ *   unit.MeasureAllCellVoltages();
+ * }
+ * @endcode
+ *
+ * @note Drivers returned by Device() keep the bus' state alive, but fail with
+ * ErrorCode::kNotConnected once the bus is closed or destroyed.
+ */
+class SerialBus {
+ public:
+  /// CTOR. Starts the bus thread.
+  SerialBus();
+
+  SerialBus(const SerialBus&) = delete;
+  SerialBus& operator=(const SerialBus&) = delete;
+
+  /// DTOR. Closes the port and stops the bus thread.
+  ~SerialBus();
+
+  /**
+   * @brief Open the serial port.
+   *
+   * @param[in] port the serial port to open, such as COM5 or /dev/ttyS2
+   *
+   * @return An error code.
+   */
+  ErrorCode Open(const std::string& port);
+
+  /// Close the serial port. Queued transactions fail.
+  void Close() noexcept;
+
+  /**
+   * @brief Get a driver for one device on the bus.
+   *
+   * Queries are sent when the client reads their response, so a write of a
+   * query always succeeds and any error is reported by the read instead. A
+   * failed write or read discards the queries still waiting to be read.
+   *
+   * @param[in] id device ID, 0-31 or 32+ to broadcast to all devices on the
+   * bus (send-only)
+   *
+   * @return A driver to construct a client with.
+   */
+  std::shared_ptr<CommDriver> Device(unsigned int id) const;
+
+ private:
+  struct Impl;
+  class DeviceDriver;
+  std::shared_ptr<Impl> impl_;
+};
+
+}  // namespace bci::abs::drivers
+
+#endif /* ABS_SCPI_DRIVER_INCLUDE_BCI_ABS_SERIALBUS_H */
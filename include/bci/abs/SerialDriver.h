@@ -11,28 +11,68 @@
 #ifndef ABS_SCPI_DRIVER_INCLUDE_BCI_ABS_SERIALDRIVER_H
 #define ABS_SCPI_DRIVER_INCLUDE_BCI_ABS_SERIALDRIVER_H
 
+#include <cstddef>
 #include <memory>
+#include <span>
 #include <string>
 #include <string_view>
 
 #include "CommDriver.h"
 #include "CommonTypes.h"
+#include "IoContext.h"
 
 namespace bci::abs::drivers {
 
+/**
+ * @brief Serial port options.
+ */
+struct SerialOptions {
+  /// Baud rate. Must match the rate configured on the ABS.
+  unsigned int baud_rate = 115200;
+
+  /// Ask the port's driver to deliver received data immediately rather than
+  /// batching it. On Linux this sets ASYNC_LOW_LATENCY, which also lowers the
+  /// latency timer of FTDI USB adapters to 1 ms. Ignored where unsupported.
+  bool low_latency = true;
+
+  /// Hold commands sent to the broadcast ID and send them together in as few
+  /// writes as possible. Held commands are sent by Flush(), by the next
+  /// command to a single device, by any read, by Close(), or once
+  /// kPipelineBufferSize bytes are held. Commands which fail to send stay held
+  /// and are retried with the next write.
+  bool pipeline_broadcasts = false;
+};
+
 /**
  * @brief Serial (RS-485) driver.
  */
 class SerialDriver final : public CommDriver {
  public:
+  /// Most bytes of broadcast commands held before they are sent when
+  /// SerialOptions::pipeline_broadcasts is set.
+  static constexpr std::size_t kPipelineBufferSize = 1024;
+
   /// CTOR.
   SerialDriver();
 
+  /**
+   * @brief Create a driver which runs its I/O on a shared IoContext.
+   *
+   * Blocking calls on the driver run the IoContext on the calling thread until
+   * they complete, so they must not be made while another thread is running the
+   * same IoContext. If the IoContext has worker threads, blocking calls instead
+   * wait for the workers and may be made from any thread, but never from a
+   * handler.
+   *
+   * @param[in] io_context event loop to use (must outlive the driver)
+   */
+  explicit SerialDriver(IoContext& io_context);
+
   /// DTOR.
   ~SerialDriver();
 
   /**
-   * @brief Open the serial port.
+   * @brief Open the serial port using the default SerialOptions.
    *
    * @param[in] port the serial port to open, such as COM5 or /dev/ttyS2
    *
@@ -40,11 +80,22 @@ class SerialDriver final : public CommDriver {
    */
   ErrorCode Open(const std::string& port);
 
-  /// Close the serial port.
+  /**
+   * @brief Open the serial port with custom options.
+   *
+   * @param[in] port the serial port to open, such as COM5 or /dev/ttyS2
+   * @param[in] options port options
+   *
+   * @return An error code.
+   */
+  ErrorCode Open(const std::string& port, const SerialOptions& options);
+
+  /// Close the serial port, first sending any held broadcast commands.
   void Close() noexcept;
 
   /**
-   * @brief Write data over the serial port.
+   * @brief Write data over the serial port. The device ID prefix and the data
+   * are sent with a single write.
    *
    * @param[in] data data to send
    * @param[in] timeout_ms send timeout in milliseconds (ignored; unsupported
@@ -54,6 +105,23 @@ class SerialDriver final : public CommDriver {
    */
   ErrorCode Write(std::string_view data, unsigned int timeout_ms) const;
 
+  /**
+   * @brief Send any broadcast commands held by
+   * SerialOptions::pipeline_broadcasts. If the write fails, the commands which
+   * weren't sent stay held.
+   *
+   * @return An error code.
+   */
+  ErrorCode Flush() const;
+
+  /**
+   * @brief Discard any input which has been received but not read, such as a
+   * late response to a query which timed out.
+   *
+   * @return An error code.
+   */
+  ErrorCode DiscardInput() const;
+
   /**
    * @brief Read a line from  the serial port.
    *
@@ -63,6 +131,18 @@ class SerialDriver final : public CommDriver {
    */
   Result<std::string> ReadLine(unsigned int timeout_ms) const;
 
+  /**
+   * @brief Read a line from the serial port into a caller-provided buffer.
+   *
+   * @param[out] buf buffer to read into
+   * @param[in] timeout_ms read timeout in milliseconds
+   *
+   * @return Result containing a view of the line within the buffer or an error
+   * code.
+   */
+  Result<std::string_view> ReadLineInto(std::span<char> buf,
+                                        unsigned int timeout_ms) const;
+
   /**
    * @brief Set the target device ID.
    *
@@ -12,14 +12,31 @@
 #define ABS_SCPI_DRIVER_INCLUDE_BCI_ABS_TCPDRIVER_H
 
 #include <memory>
+#include <span>
 #include <string>
 #include <string_view>
 
 #include "CommDriver.h"
 #include "CommonTypes.h"
+#include "IoContext.h"
 
 namespace bci::abs::drivers {
 
+/**
+ * @brief Socket options for a TCP connection.
+ */
+struct TcpOptions {
+  /// Disable Nagle's algorithm so that each command is sent immediately.
+  /// Recommended, since SCPI commands are small and wait for a response.
+  bool no_delay = true;
+
+  /// Socket send buffer size in bytes, or 0 to use the system default.
+  unsigned int send_buffer_size = 0;
+
+  /// Socket receive buffer size in bytes, or 0 to use the system default.
+  unsigned int receive_buffer_size = 0;
+};
+
 /**
  * @brief TCP driver.
  *
@@ -31,11 +48,25 @@ class TcpDriver final : public CommDriver {
   /// CTOR.
   TcpDriver();
 
+  /**
+   * @brief Create a driver which runs its asynchronous operations on a shared
+   * IoContext.
+   *
+   * Blocking calls on the driver run the IoContext on the calling thread until
+   * they complete, so they must not be made while another thread is running the
+   * same IoContext. If the IoContext has worker threads, blocking calls instead
+   * wait for the workers and may be made from any thread, but never from a
+   * handler.
+   *
+   * @param[in] io_context event loop to use (must outlive the driver)
+   */
+  explicit TcpDriver(IoContext& io_context);
+
   /// DTOR. Closes any ongoing connection.
   ~TcpDriver();
 
   /**
-   * @brief Connect to the ABS.
+   * @brief Connect to the ABS using the default TcpOptions.
    *
    * @param[in] ip device IP address
    * @param[in] timeout_ms connection timeout in milliseconds
@@ -44,6 +75,18 @@ class TcpDriver final : public CommDriver {
    */
   ErrorCode Connect(std::string_view ip, unsigned int timeout_ms);
 
+  /**
+   * @brief Connect to the ABS with custom socket options.
+   *
+   * @param[in] ip device IP address
+   * @param[in] timeout_ms connection timeout in milliseconds
+   * @param[in] options socket options
+   *
+   * @return An error code.
+   */
+  ErrorCode Connect(std::string_view ip, unsigned int timeout_ms,
+                    const TcpOptions& options);
+
   /// Close the connection to the ABS.
   void Close() noexcept;
 
@@ -66,6 +109,36 @@ class TcpDriver final : public CommDriver {
    */
   Result<std::string> ReadLine(unsigned int timeout_ms) const;
 
+  /**
+   * @brief Read a line over TCP into a caller-provided buffer.
+   *
+   * @param[out] buf buffer to read into
+   * @param[in] timeout_ms read timeout in milliseconds
+   *
+   * @return Result containing a view of the line within the buffer or an error
+   * code.
+   */
+  Result<std::string_view> ReadLineInto(std::span<char> buf,
+                                        unsigned int timeout_ms) const;
+
+  /**
+   * @brief Start sending data over TCP. Completes on the IoContext, if any.
+   *
+   * @param[in] data data to send (copied before returning)
+   * @param[in] timeout_ms send timeout in milliseconds
+   * @param[in] handler called with the result of the write
+   */
+  void AsyncWrite(std::string_view data, unsigned int timeout_ms,
+                  WriteHandler handler) const;
+
+  /**
+   * @brief Start reading a line over TCP. Completes on the IoContext, if any.
+   *
+   * @param[in] timeout_ms read timeout in milliseconds
+   * @param[in] handler called with the line read or an error code
+   */
+  void AsyncReadLine(unsigned int timeout_ms, ReadHandler handler) const;
+
  private:
   struct Impl;
   std::shared_ptr<Impl> impl_;
@@ -11,23 +11,85 @@
 #ifndef ABS_SCPI_DRIVER_INCLUDE_BCI_ABS_UDPDRIVER_H
 #define ABS_SCPI_DRIVER_INCLUDE_BCI_ABS_UDPDRIVER_H
 
+#include <chrono>
+#include <cstdint>
 #include <memory>
+#include <span>
 #include <string>
 #include <string_view>
 
 #include "CommDriver.h"
 #include "CommonTypes.h"
+#include "IoContext.h"
 
 namespace bci::abs::drivers {
 
+/**
+ * @brief Read timeout and retry settings for a UdpDriver.
+ *
+ * With the defaults, every read waits out the whole timeout it is given.
+ */
+struct UdpTimeoutPolicy {
+  /// Give up on a response once it is later than the round-trip times
+  /// measured so far suggest it will ever be, instead of waiting out the whole
+  /// read timeout. The timeout given to each read remains the limit.
+  bool adaptive{false};
+
+  /// Shortest adaptive timeout, in milliseconds. This should be longer than
+  /// the unit's slowest response: a response which arrives after its query
+  /// timed out may be taken as the response to a later query.
+  unsigned int min_timeout_ms{20};
+
+  /// Number of times a query is resent when its response doesn't arrive in
+  /// time. Only queries which can safely be repeated are resent: those made up
+  /// entirely of queries, other than queries of the error queue. The read
+  /// timeout is shared between the attempts.
+  unsigned int max_retries{0};
+};
+
+/// Round-trip time and timeout statistics of a UdpDriver.
+struct UdpTimeoutStats {
+  std::chrono::nanoseconds smoothed_rtt;   ///< Smoothed round-trip time
+  std::chrono::nanoseconds rtt_variation;  ///< Round-trip time variation
+  unsigned int timeout_ms;   ///< Current adaptive timeout (0 until measured)
+  std::uint64_t timeouts;    ///< Attempts which timed out, retried or not
+  std::uint64_t retries;     ///< Queries resent
+};
+
 /**
  * @brief UDP driver.
+ *
+ * The driver measures the time between sending each query and receiving its
+ * response, smoothing it as TCP does. With an adaptive UdpTimeoutPolicy, reads
+ * time out after the smoothed round-trip time plus four times its variation,
+ * so a lost datagram costs a few round trips rather than the whole read
+ * timeout. Round trips of resent queries are not measured, and each timeout
+ * doubles the next one until a response arrives in time.
+ *
+ * After a read times out, datagrams which arrive late are discarded before the
+ * next write, as are those which arrive sooner after it than any response
+ * has. UDP responses carry nothing to match them to their queries, though, so
+ * one which is later still can't be told apart from the next response.
  */
 class UdpDriver final : public CommDriver {
  public:
   /// CTOR.
   UdpDriver();
 
+  /**
+   * @brief Create a driver which runs its asynchronous operations on a shared
+   * IoContext.
+   *
+   * Blocking calls on the driver run the IoContext on the calling thread until
+   * they complete, so they must not be made while another thread is running the
+   * same IoContext. If the IoContext has worker threads, blocking calls instead
+   * wait for the workers and may be made from any thread, but never from a
+   * handler.
+   *
+   * @param[in] io_context event loop to use (must outlive the driver)
+   */
+  explicit UdpDriver(IoContext& io_context);
+
   /// DTOR.
   ~UdpDriver();
 
@@ -73,6 +135,59 @@ class UdpDriver final : public CommDriver {
    */
   Result<std::string> ReadLine(unsigned int timeout_ms) const;
 
+  /**
+   * @brief Read a line over UDP into a caller-provided buffer.
+   *
+   * @param[out] buf buffer to read into (must be larger than the datagram)
+   * @param[in] timeout_ms read timeout in milliseconds
+   *
+   * @return Result containing a view of the line within the buffer or an error
+   * code.
+   */
+  Result<std::string_view> ReadLineInto(std::span<char> buf,
+                                        unsigned int timeout_ms) const;
+
+  /**
+   * @brief Start sending data over UDP. Completes on the IoContext, if any.
+   *
+   * @param[in] data data to send (copied before returning)
+   * @param[in] timeout_ms send timeout in milliseconds
+   * @param[in] handler called with the result of the write
+   */
+  void AsyncWrite(std::string_view data, unsigned int timeout_ms,
+                  WriteHandler handler) const;
+
+  /**
+   * @brief Start reading a line over UDP. Completes on the IoContext, if any.
+   *
+   * @param[in] timeout_ms read timeout in milliseconds
+   * @param[in] handler called with the line read or an error code
+   */
+  void AsyncReadLine(unsigned int timeout_ms, ReadHandler handler) const;
+
+  /**
+   * @brief Set the read timeout and retry policy of blocking reads.
+   * Asynchronous reads always wait out their whole timeout.
+   *
+   * @note Must not be called while another thread is using the driver.
+   *
+   * @param[in] policy new policy
+   */
+  void SetTimeoutPolicy(const UdpTimeoutPolicy& policy) noexcept;
+
+  /**
+   * @return The read timeout and retry policy.
+   */
+  UdpTimeoutPolicy GetTimeoutPolicy() const noexcept;
+
+  /**
+   * @brief Get the round-trip time and timeout statistics. May be called from
+   * any thread.
+   *
+   * @return The statistics.
+   */
+  UdpTimeoutStats GetTimeoutStats() const noexcept;
+
  private:
   struct Impl;
   std::shared_ptr<Impl> impl_;
@@ -11,12 +11,15 @@
 #ifndef ABS_SCPI_DRIVER_INCLUDE_BCI_ABS_UDPMULTICASTDRIVER_H
 #define ABS_SCPI_DRIVER_INCLUDE_BCI_ABS_UDPMULTICASTDRIVER_H
 
+#include <cstddef>
 #include <memory>
+#include <span>
 #include <string>
 #include <string_view>
 
 #include "CommDriver.h"
 #include "CommonTypes.h"
+#include "IoContext.h"
 
 namespace bci::abs::drivers {
 
@@ -33,9 +36,37 @@ class UdpMcastDriver final : public CommDriver {
     std::string data;
   };
 
+  /// Response read by ReadBatchFrom(). Both views refer to the driver's
+  /// receive buffers and remain valid until the next read.
+  struct AddressedResponseView {
+    /// Source IP address.
+    std::string_view ip;
+    /// Response data.
+    std::string_view data;
+  };
+
+  /// Most responses returned by one call to ReadBatchFrom().
+  static constexpr std::size_t kMaxBatchSize = 32;
+
+  /// Default size of the socket's receive buffer in bytes.
+  static constexpr std::size_t kDefaultReceiveBufferSize = 64 * 1024;
+
   /// CTOR.
   UdpMcastDriver();
 
+  /**
+   * @brief Create a driver which runs its I/O on a shared IoContext.
+   *
+   * Blocking calls on the driver run the IoContext on the calling thread until
+   * they complete, so they must not be made while another thread is running the
+   * same IoContext. If the IoContext has worker threads, blocking calls instead
+   * wait for the workers and may be made from any thread, but never from a
+   * handler.
+   *
+   * @param[in] io_context event loop to use (must outlive the driver)
+   */
+  explicit UdpMcastDriver(IoContext& io_context);
+
   /// DTOR.
   ~UdpMcastDriver();
 
@@ -82,6 +113,39 @@ class UdpMcastDriver final : public CommDriver {
    */
   Result<AddressedResponse> ReadLineFrom(unsigned int timeout_ms) const;
 
+  /**
+   * @brief Read every response waiting on the socket, up to kMaxBatchSize of
+   * them, waiting for the first to arrive. Where the system supports it (on
+   * Linux), the whole batch is read with one system call. The responses are
+   * read into buffers owned by the driver rather than copied into strings.
+   *
+   * This is the most efficient way to collect the replies of many units to one
+   * query, such as during device discovery.
+   *
+   * @param[in] timeout_ms longest time to wait for the first response in
+   * milliseconds
+   *
+   * @return Result containing at least one response, valid until the next
+   * read, or an error code.
+   */
+  Result<std::span<const AddressedResponseView>> ReadBatchFrom(
+      unsigned int timeout_ms) const;
+
+  /**
+   * @brief Set the size of the socket's receive buffer. Responses which arrive
+   * while it is full are dropped, so a larger buffer may be needed when many
+   * units reply at once. The system may limit the size. The default is
+   * kDefaultReceiveBufferSize.
+   *
+   * The size applies to the open socket, if any, and whenever the driver is
+   * opened.
+   *
+   * @param[in] bytes receive buffer size in bytes
+   *
+   * @return An error code.
+   */
+  ErrorCode SetReceiveBufferSize(std::size_t bytes);
+
   /**
    * @brief Whether the device is send-only in the general case. Always true for
    * multicast devices.
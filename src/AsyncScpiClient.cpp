@@ -0,0 +1,407 @@
+/*
+ * Copyright (c) 2024, Bloomy Controls, Inc. All rights reserved.
+ *
+ * Use of this source code is governed by a BSD-3-clause license that can be
+ * found in the LICENSE file or at https://opensource.org/license/BSD-3-Clause
+ */
+
+#include <bci/abs/AsyncScpiClient.h>
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+
+#include "CommandBuffer.h"
+#include "CommandTable.h"
+#include "Limits.h"
+#include "ScpiUtil.h"
+#include "Util.h"
+
+namespace bci::abs {
+
+using util::Err;
+using ec = ErrorCode;
+
+struct AsyncScpiClient::Impl : std::enable_shared_from_this<Impl> {
+  using Completion = std::function<void(Result<std::string>)>;
+
+  explicit Impl(std::shared_ptr<drivers::CommDriver> driver) noexcept;
+
+  // Queue a command and its completion. Queries wait for a reply, commands
+  // complete once written.
+  void Submit(std::string command, bool query, Completion on_done);
+
+  std::shared_ptr<drivers::CommDriver> driver;
+  unsigned int read_timeout_ms;
+
+ private:
+  struct Transaction {
+    std::string command;
+    bool query;
+    Completion on_done;
+  };
+
+  // Start queued transactions one at a time until one is left in flight.
+  void StartNext();
+
+  void Start(Transaction t);
+
+  void Finish(Completion on_done, Result<std::string> res);
+
+  std::mutex mutex_;
+  std::deque<Transaction> queue_;
+  bool busy_;        // a transaction is in flight
+  bool starting_;    // StartNext() is running
+  bool completed_;   // a transaction completed while StartNext() was running
+};
+
+namespace {
+
+// Build a completion which parses a reply and passes it on to a handler.
+template <class T, class F>
+auto ParseThen(AsyncScpiClient::Handler<T> handler, F&& parse) {
+  return [handler = std::move(handler),
+          parse = std::forward<F>(parse)](Result<std::string> resp) {
+    handler(std::move(resp).and_then(parse));
+  };
+}
+
+// Build a completion which passes only the error code on to a handler.
+auto IgnoreReply(AsyncScpiClient::ErrorHandler handler) {
+  return [handler = std::move(handler)](Result<std::string> resp) {
+    handler(resp ? ec::kSuccess : resp.error());
+  };
+}
+
+}  // namespace
+
+AsyncScpiClient::Impl::Impl(
+    std::shared_ptr<drivers::CommDriver> driver) noexcept
+    : driver{std::move(driver)},
+      read_timeout_ms{150U},
+      mutex_{},
+      queue_{},
+      busy_{false},
+      starting_{false},
+      completed_{false} {}
+
+void AsyncScpiClient::Impl::Submit(std::string command, bool query,
+                                   Completion on_done) {
+  if (!driver) {
+    on_done(Err(ec::kInvalidDriverHandle));
+    return;
+  }
+
+  if (query && driver->IsSendOnly()) {
+    on_done(Err(ec::kReceiveNotAllowed));
+    return;
+  }
+
+  std::unique_lock lock{mutex_};
+  queue_.push_back({std::move(command), query, std::move(on_done)});
+  if (busy_) {
+    return;
+  }
+  busy_ = true;
+  lock.unlock();
+
+  StartNext();
+}
+
+void AsyncScpiClient::Impl::StartNext() {
+  std::unique_lock lock{mutex_};
+
+  // Drivers without an IoContext complete transactions inside Start(), which
+  // calls back into this function. Let the outer call start the next one so
+  // the stack doesn't grow with the length of the queue.
+  if (starting_) {
+    completed_ = true;
+    return;
+  }
+
+  starting_ = true;
+  do {
+    completed_ = false;
+    if (queue_.empty()) {
+      busy_ = false;
+      break;
+    }
+
+    auto t = std::move(queue_.front());
+    queue_.pop_front();
+    lock.unlock();
+    Start(std::move(t));
+    lock.lock();
+  } while (completed_);
+  starting_ = false;
+}
+
+void AsyncScpiClient::Impl::Start(Transaction t) {
+  auto self = shared_from_this();
+  auto on_written = [self, query = t.query, on_done = std::move(t.on_done)](
+                        ErrorCode e) mutable {
+    if (e != ec::kSuccess) {
+      self->Finish(std::move(on_done), Err(e));
+    } else if (!query) {
+      self->Finish(std::move(on_done), std::string{});
+    } else {
+      auto on_read = [self, on_done = std::move(on_done)](
+                         Result<std::string> res) mutable {
+        self->Finish(std::move(on_done), std::move(res));
+      };
+      self->driver->AsyncReadLine(self->read_timeout_ms, std::move(on_read));
+    }
+  };
+  driver->AsyncWrite(t.command, limits::kWriteTimeoutMs,
+                     std::move(on_written));
+}
+
+void AsyncScpiClient::Impl::Finish(Completion on_done,
+                                   Result<std::string> res) {
+  // run the handler before starting the next transaction, so that handlers
+  // are called in order and never overlap, even on a threaded IoContext
+  on_done(std::move(res));
+  StartNext();
+}
+
+AsyncScpiClient::AsyncScpiClient(std::shared_ptr<drivers::CommDriver> driver)
+    : impl_{std::make_shared<Impl>(std::move(driver))} {}
+
+AsyncScpiClient::AsyncScpiClient(AsyncScpiClient&& other) noexcept = default;
+
+AsyncScpiClient& AsyncScpiClient::operator=(AsyncScpiClient&& rhs) noexcept =
+    default;
+
+AsyncScpiClient::~AsyncScpiClient() = default;
+
+unsigned int AsyncScpiClient::SetReadTimeout(unsigned int timeout_ms) noexcept {
+  if (!impl_) {
+    return 0;
+  }
+  return std::exchange(impl_->read_timeout_ms, timeout_ms);
+}
+
+void AsyncScpiClient::Submit(
+    std::string command, bool query,
+    std::function<void(Result<std::string>)> on_done) const {
+  if (!impl_) {
+    on_done(Err(ec::kInvalidDriverHandle));
+    return;
+  }
+  impl_->Submit(std::move(command), query, std::move(on_done));
+}
+
+void AsyncScpiClient::GetDeviceInfo(Handler<DeviceInfo> handler) const {
+  Submit("*IDN?\r\n", true,
+         ParseThen(std::move(handler), scpi::ParseDeviceInfo));
+}
+
+void AsyncScpiClient::GetDeviceId(Handler<std::uint8_t> handler) const {
+  Submit("CONF:COMM:SER:ID?\r\n", true,
+         ParseThen(std::move(handler), scpi::ParseIntResponse<std::uint8_t>));
+}
+
+void AsyncScpiClient::GetErrorCount(Handler<int> handler) const {
+  Submit("SYST:ERR:COUN?\r\n", true,
+         ParseThen(std::move(handler), scpi::ParseIntResponse<int>));
+}
+
+void AsyncScpiClient::GetNextError(Handler<ScpiError> handler) const {
+  Submit("SYST:ERR?\r\n", true,
+         ParseThen(std::move(handler), scpi::ParseScpiError));
+}
+
+void AsyncScpiClient::ClearErrors(ErrorHandler handler) const {
+  Submit("*CLS\r\n", false, IgnoreReply(std::move(handler)));
+}
+
+void AsyncScpiClient::GetAlarms(Handler<std::uint32_t> handler) const {
+  Submit("SYST:ALARM?\r\n", true,
+         ParseThen(std::move(handler), scpi::ParseIntResponse<std::uint32_t>));
+}
+
+void AsyncScpiClient::GetInterlockState(Handler<bool> handler) const {
+  Submit("SYST:INT?\r\n", true,
+         ParseThen(std::move(handler), scpi::ParseBoolResponse));
+}
+
+void AsyncScpiClient::EnableCell(unsigned int cell, bool en,
+                                 ErrorHandler handler) const {
+  if (cell >= kCellCount) {
+    handler(ec::kChannelIndexOutOfRange);
+    return;
+  }
+
+  scpi::CommandBuffer<32> buf;
+  buf.Append(scpi::ChannelCommand<"OUTP", " ", kCellCount>(cell));
+  buf.Append(en ? "1" : "0");
+  buf.Append("\r\n");
+  Submit(std::string{buf.View()}, false, IgnoreReply(std::move(handler)));
+}
+
+void AsyncScpiClient::SetCellVoltage(unsigned int cell, float voltage,
+                                     ErrorHandler handler) const {
+  if (cell >= kCellCount) {
+    handler(ec::kChannelIndexOutOfRange);
+    return;
+  }
+
+  voltage = limits::ClampVoltage(voltage);
+
+  scpi::CommandBuffer<32> buf;
+  buf.Append(scpi::ChannelCommand<"SOUR", ":VOLT ", kCellCount>(cell));
+  buf.AppendFixed<4>(voltage);
+  buf.Append("\r\n");
+  Submit(std::string{buf.View()}, false, IgnoreReply(std::move(handler)));
+}
+
+void AsyncScpiClient::SetAllCellVoltages(float voltage,
+                                         ErrorHandler handler) const {
+  voltage = limits::ClampVoltage(voltage);
+
+  scpi::CommandBuffer<32> buf;
+  buf.Append("SOUR:VOLT ");
+  buf.AppendFixed<4>(voltage);
+  buf.Append(scpi::ChannelListCommand<",", "\r\n", kCellCount>(kCellCount));
+  Submit(std::string{buf.View()}, false, IgnoreReply(std::move(handler)));
+}
+
+void AsyncScpiClient::GetCellVoltageTarget(unsigned int cell,
+                                           Handler<float> handler) const {
+  if (cell >= kCellCount) {
+    handler(Err(ec::kChannelIndexOutOfRange));
+    return;
+  }
+
+  const auto cmd = scpi::ChannelCommand<"SOUR", ":VOLT?\r\n", kCellCount>(cell);
+  Submit(std::string{cmd}, true,
+         ParseThen(std::move(handler), scpi::ParseFloatResponse));
+}
+
+void AsyncScpiClient::SetCellSourcing(unsigned int cell, float limit,
+                                      ErrorHandler handler) const {
+  if (cell >= kCellCount) {
+    handler(ec::kChannelIndexOutOfRange);
+    return;
+  }
+
+  limit = limits::ClampSourcing(limit);
+
+  scpi::CommandBuffer<32> buf;
+  buf.Append(scpi::ChannelCommand<"SOUR", ":CURR:SRC ", kCellCount>(cell));
+  buf.AppendFixed<4>(limit);
+  buf.Append("\r\n");
+  Submit(std::string{buf.View()}, false, IgnoreReply(std::move(handler)));
+}
+
+void AsyncScpiClient::SetCellSinking(unsigned int cell, float limit,
+                                     ErrorHandler handler) const {
+  if (cell >= kCellCount) {
+    handler(ec::kChannelIndexOutOfRange);
+    return;
+  }
+
+  limit = limits::ClampSinking(limit);
+
+  scpi::CommandBuffer<32> buf;
+  buf.Append(scpi::ChannelCommand<"SOUR", ":CURR:SNK ", kCellCount>(cell));
+  buf.AppendFixed<4>(limit);
+  buf.Append("\r\n");
+  Submit(std::string{buf.View()}, false, IgnoreReply(std::move(handler)));
+}
+
+void AsyncScpiClient::MeasureCellVoltage(unsigned int cell,
+                                         Handler<float> handler) const {
+  if (cell >= kCellCount) {
+    handler(Err(ec::kChannelIndexOutOfRange));
+    return;
+  }
+
+  const auto cmd = scpi::ChannelCommand<"MEAS", ":VOLT?\r\n", kCellCount>(cell);
+  Submit(std::string{cmd}, true,
+         ParseThen(std::move(handler), scpi::ParseFloatResponse));
+}
+
+void AsyncScpiClient::MeasureAllCellVoltages(
+    Handler<std::array<float, kCellCount>> handler) const {
+  constexpr auto cmd =
+      scpi::ChannelListCommand<"MEAS:VOLT? ", "\r\n", kCellCount>(kCellCount);
+  Submit(std::string{cmd}, true,
+         ParseThen(std::move(handler), scpi::ParseRespFloatArray<kCellCount>));
+}
+
+void AsyncScpiClient::MeasureCellCurrent(unsigned int cell,
+                                         Handler<float> handler) const {
+  if (cell >= kCellCount) {
+    handler(Err(ec::kChannelIndexOutOfRange));
+    return;
+  }
+
+  const auto cmd = scpi::ChannelCommand<"MEAS", ":CURR?\r\n", kCellCount>(cell);
+  Submit(std::string{cmd}, true,
+         ParseThen(std::move(handler), scpi::ParseFloatResponse));
+}
+
+void AsyncScpiClient::MeasureAllCellCurrents(
+    Handler<std::array<float, kCellCount>> handler) const {
+  constexpr auto cmd =
+      scpi::ChannelListCommand<"MEAS:CURR? ", "\r\n", kCellCount>(kCellCount);
+  Submit(std::string{cmd}, true,
+         ParseThen(std::move(handler), scpi::ParseRespFloatArray<kCellCount>));
+}
+
+void AsyncScpiClient::GetAllCellOperatingModes(
+    Handler<std::array<CellMode, kCellCount>> handler) const {
+  constexpr auto cmd =
+      scpi::ChannelListCommand<"OUTP:MODE? ", "\r\n", kCellCount>(kCellCount);
+  Submit(std::string{cmd}, true,
+         ParseThen(std::move(handler),
+                   scpi::ParseCellOperatingModeArray<kCellCount>));
+}
+
+void AsyncScpiClient::MeasureAnalogInput(unsigned int channel,
+                                         Handler<float> handler) const {
+  if (channel >= kAnalogInputCount) {
+    handler(Err(ec::kChannelIndexOutOfRange));
+    return;
+  }
+
+  const auto cmd =
+      scpi::ChannelCommand<"AUX:AIN", "?\r\n", kAnalogInputCount>(channel);
+  Submit(std::string{cmd}, true,
+         ParseThen(std::move(handler), scpi::ParseFloatResponse));
+}
+
+void AsyncScpiClient::MeasureAllAnalogInputs(
+    Handler<std::array<float, kAnalogInputCount>> handler) const {
+  constexpr auto cmd =
+      scpi::ChannelListCommand<"AUX:AIN? ", "\r\n", kAnalogInputCount>(
+          kAnalogInputCount);
+  Submit(std::string{cmd}, true,
+         ParseThen(std::move(handler),
+                   scpi::ParseRespFloatArray<kAnalogInputCount>));
+}
+
+void AsyncScpiClient::MeasureAllDigitalInputsMasked(
+    Handler<unsigned int> handler) const {
+  constexpr auto cmd =
+      scpi::ChannelListCommand<"AUX:DIN? ", "\r\n", kDigitalInputCount>(
+          kDigitalInputCount);
+  Submit(std::string{cmd}, true,
+         ParseThen(std::move(handler),
+                   scpi::ParseRespBoolMask<kDigitalInputCount>));
+}
+
+void AsyncScpiClient::MeasureSnapshot(
+    Handler<MeasurementSnapshot> handler) const {
+  Submit(std::string{scpi::kSnapshotCommand}, true,
+         ParseThen(std::move(handler), scpi::ParseMeasurementSnapshot));
+}
+
+}  // namespace bci::abs
@@ -6,8 +6,11 @@
  */
 
 #include <bci/abs/CInterface.h>
+#include <bci/abs/ContinuousAcquisition.h>
 #include <bci/abs/Discovery.h>
+#include <bci/abs/Instrumentation.h>
 #include <bci/abs/ScpiClient.h>
+#include <bci/abs/ScpiPipeline.h>
 #include <bci/abs/SerialDriver.h>
 #include <bci/abs/TcpDriver.h>
 #include <bci/abs/UdpDriver.h>
@@ -16,12 +19,16 @@
 
 #include <algorithm>
 #include <array>
+#include <chrono>
+#include <cmath>
 #include <cstddef>
 #include <cstring>
 #include <memory>
 #include <new>
+#include <optional>
 #include <span>
 #include <type_traits>
+#include <vector>
 
 using namespace bci::abs;
 using ec = bci::abs::ErrorCode;
@@ -31,6 +38,17 @@ static ScpiClient& GetClient(AbsScpiClientHandle handle) {
   return *(ScpiClient*)handle;
 }
 
+static ContinuousAcquisition& GetAcquisition(AbsAcquisitionHandle handle) {
+  return *(ContinuousAcquisition*)handle;
+}
+
+// Histogram handles own a reference so that clients can share the histogram.
+using HistogramPtr = std::shared_ptr<LatencyHistogram>;
+
+static HistogramPtr& GetHistogram(AbsLatencyHistogramHandle handle) {
+  return *(HistogramPtr*)handle;
+}
+
 template <class... Args>
 static int WrapSet(ErrorCode (ScpiClient::*func)(Args...) const,
                    AbsScpiClientHandle handle, Args... args) noexcept try {
@@ -218,6 +236,20 @@ int AbsScpiClient_Close(AbsScpiClientHandle handle) try {
   return static_cast<int>(ec::kUnexpectedException);
 }
 
+int AbsScpiClient_SetThreadSafe(AbsScpiClientHandle handle, bool en) try {
+  if (!handle) {
+    return static_cast<int>(ec::kInvalidArgument);
+  }
+
+  GetClient(handle).SetThreadSafe(en);
+
+  return static_cast<int>(ec::kSuccess);
+} catch (const std::bad_alloc&) {
+  return static_cast<int>(ec::kAllocationFailed);
+} catch (...) {
+  return static_cast<int>(ec::kUnexpectedException);
+}
+
 int AbsScpiClient_SetTargetDeviceId(AbsScpiClientHandle handle,
                                     unsigned int device_id) try {
   if (!handle) {
@@ -392,6 +424,14 @@ int AbsScpiClient_Reboot(AbsScpiClientHandle handle) {
   return WrapSet(&sc::Reboot, handle);
 }
 
+int AbsScpiClient_SetBinaryTransfer(AbsScpiClientHandle handle, bool en) {
+  return WrapSet(&sc::SetBinaryTransfer, handle, en);
+}
+
+int AbsScpiClient_GetBinaryTransfer(AbsScpiClientHandle handle, bool* en_out) {
+  return WrapGet(&sc::GetBinaryTransfer, handle, en_out);
+}
+
 int AbsScpiClient_EnableCell(AbsScpiClientHandle handle, unsigned int cell,
                              bool en) {
   return WrapSet(&sc::EnableCell, handle, cell, en);
@@ -833,6 +873,419 @@ int AbsScpiClient_GetAllModelOutputs(AbsScpiClientHandle handle,
                  static_cast<std::size_t>(count));
 }
 
+static_assert(std::extent_v<decltype(AbsMeasurementSnapshot::cell_voltages)> ==
+              kCellCount);
+static_assert(std::extent_v<decltype(AbsMeasurementSnapshot::cell_currents)> ==
+              kCellCount);
+static_assert(std::extent_v<decltype(AbsMeasurementSnapshot::cell_modes)> ==
+              kCellCount);
+static_assert(std::extent_v<decltype(AbsMeasurementSnapshot::analog_inputs)> ==
+              kAnalogInputCount);
+
+// Copy a snapshot into its C equivalent.
+static void CopySnapshot(const MeasurementSnapshot& snapshot,
+                         AbsMeasurementSnapshot* snapshot_out) {
+  std::ranges::copy(snapshot.cell_voltages, snapshot_out->cell_voltages);
+  std::ranges::copy(snapshot.cell_currents, snapshot_out->cell_currents);
+  std::ranges::transform(snapshot.cell_modes, snapshot_out->cell_modes,
+                         [](CellMode mode) { return static_cast<int>(mode); });
+  std::ranges::copy(snapshot.analog_inputs, snapshot_out->analog_inputs);
+  snapshot_out->digital_inputs = snapshot.digital_inputs;
+  snapshot_out->alarms = snapshot.alarms;
+}
+
+int AbsScpiClient_MeasureSnapshot(AbsScpiClientHandle handle,
+                                  AbsMeasurementSnapshot* snapshot_out) try {
+  if (!handle || !snapshot_out) {
+    return static_cast<int>(ec::kInvalidArgument);
+  }
+
+  *snapshot_out = {};
+
+  auto snapshot = GetClient(handle).MeasureSnapshot();
+  if (!snapshot) {
+    return static_cast<int>(snapshot.error());
+  }
+
+  CopySnapshot(*snapshot, snapshot_out);
+
+  return static_cast<int>(ec::kSuccess);
+} catch (const std::bad_alloc&) {
+  return static_cast<int>(ec::kAllocationFailed);
+} catch (...) {
+  return static_cast<int>(ec::kUnexpectedException);
+}
+
+// A query queued in a batch, whose result is stored in its op once the batch's
+// pipeline has run.
+class BatchQuery {
+ public:
+  explicit BatchQuery(AbsBatchOp& op) noexcept : op_{op} {}
+
+  virtual ~BatchQuery() = default;
+
+  virtual void Store() = 0;
+
+ protected:
+  AbsBatchOp& op_;
+};
+
+template <class T, class Out>
+class TypedBatchQuery final : public BatchQuery {
+ public:
+  using BatchQuery::BatchQuery;
+
+  Result<T> result;
+
+  void Store() override {
+    if (!result) {
+      op_.error = static_cast<int>(result.error());
+    } else if constexpr (std::is_array_v<Out>) {
+      std::ranges::copy(*result, *static_cast<Out*>(op_.out));
+    } else {
+      *static_cast<Out*>(op_.out) = static_cast<Out>(*result);
+    }
+  }
+};
+
+// Queries of a batch waiting to be sent together.
+class BatchPipeline {
+ public:
+  explicit BatchPipeline(const ScpiClient& client) : pipeline_{client} {}
+
+  template <class Out, class T>
+  void Queue(AbsBatchOp& op, void (ScpiPipeline::*queue)(Result<T>&)) {
+    (pipeline_.*queue)(Add<T, Out>(op));
+  }
+
+  template <class Out, class T>
+  void Queue(AbsBatchOp& op,
+             void (ScpiPipeline::*queue)(unsigned int, Result<T>&)) {
+    (pipeline_.*queue)(op.channel, Add<T, Out>(op));
+  }
+
+  // Run the queued queries and store their results.
+  void Flush() {
+    if (queries_.empty()) {
+      return;
+    }
+
+    pipeline_.Execute();
+    for (auto& query : queries_) {
+      query->Store();
+    }
+
+    pipeline_.Clear();
+    queries_.clear();
+  }
+
+ private:
+  ScpiPipeline pipeline_;
+  std::vector<std::unique_ptr<BatchQuery>> queries_;
+
+  template <class T, class Out>
+  Result<T>& Add(AbsBatchOp& op) {
+    auto query = std::make_unique<TypedBatchQuery<T, Out>>(op);
+    auto& result = query->result;
+    queries_.push_back(std::move(query));
+    return result;
+  }
+};
+
+// Convert a batch operation's value to an enumerator from 0 to last, if it is
+// one.
+template <class E>
+static std::optional<E> BatchEnum(float val, E last) noexcept {
+  if (!std::isfinite(val) || val != std::trunc(val) || val < 0.0f ||
+      val > static_cast<float>(static_cast<int>(last))) {
+    return std::nullopt;
+  }
+  return static_cast<E>(static_cast<int>(val));
+}
+
+// Perform one operation of a batch. Queries are queued in the pipeline.
+static ec ExecuteBatchOp(const ScpiClient& client, BatchPipeline& pipeline,
+                         AbsBatchOp& op) {
+  using P = ScpiPipeline;
+  const unsigned int ch = op.channel;
+  const float val = op.value;
+
+  // a set must not overtake the queries queued before it
+  const auto set = [&](auto func, auto... args) {
+    pipeline.Flush();
+    return (client.*func)(ch, args...);
+  };
+
+  switch (op.opcode) {
+    case ABS_BATCH_ENABLE_CELL:
+      return set(&sc::EnableCell, val != 0.0f);
+    case ABS_BATCH_SET_CELL_VOLTAGE:
+      return set(&sc::SetCellVoltage, val);
+    case ABS_BATCH_SET_CELL_SOURCING:
+      return set(&sc::SetCellSourcing, val);
+    case ABS_BATCH_SET_CELL_SINKING:
+      return set(&sc::SetCellSinking, val);
+    case ABS_BATCH_SET_CELL_FAULT:
+      if (const auto fault = BatchEnum(val, CellFault::kPolarity)) {
+        return set(&sc::SetCellFault, *fault);
+      }
+      return ec::kInvalidArgument;
+    case ABS_BATCH_SET_CELL_SENSE_RANGE:
+      if (const auto range = BatchEnum(val, CellSenseRange::kHigh)) {
+        return set(&sc::SetCellSenseRange, *range);
+      }
+      return ec::kInvalidArgument;
+    case ABS_BATCH_SET_ANALOG_OUTPUT:
+      return set(&sc::SetAnalogOutput, val);
+    case ABS_BATCH_SET_DIGITAL_OUTPUT:
+      return set(&sc::SetDigitalOutput, val != 0.0f);
+    case ABS_BATCH_SET_GLOBAL_MODEL_INPUT:
+      return set(&sc::SetGlobalModelInput, val);
+    case ABS_BATCH_SET_LOCAL_MODEL_INPUT:
+      return set(&sc::SetLocalModelInput, val);
+    default:
+      break;
+  }
+
+  if (!op.out) {
+    return ec::kInvalidArgument;
+  }
+
+  switch (op.opcode) {
+    case ABS_BATCH_GET_ERROR_COUNT:
+      pipeline.Queue<int>(op, &P::GetErrorCount);
+      break;
+    case ABS_BATCH_GET_ALARMS:
+      pipeline.Queue<std::uint32_t>(op, &P::GetAlarms);
+      break;
+    case ABS_BATCH_GET_INTERLOCK_STATE:
+      pipeline.Queue<bool>(op, &P::GetInterlockState);
+      break;
+    case ABS_BATCH_GET_CELL_ENABLED:
+      pipeline.Queue<bool>(op, &P::GetCellEnabled);
+      break;
+    case ABS_BATCH_GET_CELL_VOLTAGE_TARGET:
+      pipeline.Queue<float>(op, &P::GetCellVoltageTarget);
+      break;
+    case ABS_BATCH_GET_CELL_SOURCING_LIMIT:
+      pipeline.Queue<float>(op, &P::GetCellSourcingLimit);
+      break;
+    case ABS_BATCH_GET_CELL_SINKING_LIMIT:
+      pipeline.Queue<float>(op, &P::GetCellSinkingLimit);
+      break;
+    case ABS_BATCH_GET_CELL_FAULT:
+      pipeline.Queue<int>(op, &P::GetCellFault);
+      break;
+    case ABS_BATCH_GET_CELL_SENSE_RANGE:
+      pipeline.Queue<int>(op, &P::GetCellSenseRange);
+      break;
+    case ABS_BATCH_MEASURE_CELL_VOLTAGE:
+      pipeline.Queue<float>(op, &P::MeasureCellVoltage);
+      break;
+    case ABS_BATCH_MEASURE_ALL_CELL_VOLTAGES:
+      pipeline.Queue<float[kCellCount]>(op, &P::MeasureAllCellVoltages);
+      break;
+    case ABS_BATCH_MEASURE_CELL_CURRENT:
+      pipeline.Queue<float>(op, &P::MeasureCellCurrent);
+      break;
+    case ABS_BATCH_MEASURE_ALL_CELL_CURRENTS:
+      pipeline.Queue<float[kCellCount]>(op, &P::MeasureAllCellCurrents);
+      break;
+    case ABS_BATCH_GET_CELL_OPERATING_MODE:
+      pipeline.Queue<int>(op, &P::GetCellOperatingMode);
+      break;
+    case ABS_BATCH_GET_ANALOG_OUTPUT:
+      pipeline.Queue<float>(op, &P::GetAnalogOutput);
+      break;
+    case ABS_BATCH_GET_DIGITAL_OUTPUT:
+      pipeline.Queue<bool>(op, &P::GetDigitalOutput);
+      break;
+    case ABS_BATCH_MEASURE_ANALOG_INPUT:
+      pipeline.Queue<float>(op, &P::MeasureAnalogInput);
+      break;
+    case ABS_BATCH_MEASURE_ALL_ANALOG_INPUTS:
+      pipeline.Queue<float[kAnalogInputCount]>(op, &P::MeasureAllAnalogInputs);
+      break;
+    case ABS_BATCH_MEASURE_DIGITAL_INPUT:
+      pipeline.Queue<bool>(op, &P::MeasureDigitalInput);
+      break;
+    case ABS_BATCH_MEASURE_ALL_DIGITAL_INPUTS:
+      pipeline.Queue<unsigned int>(op, &P::MeasureAllDigitalInputsMasked);
+      break;
+    case ABS_BATCH_GET_MODEL_STATUS:
+      pipeline.Queue<std::uint8_t>(op, &P::GetModelStatus);
+      break;
+    case ABS_BATCH_GET_GLOBAL_MODEL_INPUT:
+      pipeline.Queue<float>(op, &P::GetGlobalModelInput);
+      break;
+    case ABS_BATCH_GET_LOCAL_MODEL_INPUT:
+      pipeline.Queue<float>(op, &P::GetLocalModelInput);
+      break;
+    case ABS_BATCH_GET_MODEL_OUTPUT:
+      pipeline.Queue<float>(op, &P::GetModelOutput);
+      break;
+    default:
+      return ec::kInvalidArgument;
+  }
+
+  return ec::kSuccess;
+}
+
+int AbsScpiClient_ExecuteBatch(AbsScpiClientHandle handle, AbsBatchOp ops[],
+                               unsigned int count) try {
+  if (!handle || (!ops && count > 0)) {
+    return static_cast<int>(ec::kInvalidArgument);
+  }
+
+  const auto& client = GetClient(handle);
+  BatchPipeline pipeline{client};
+
+  std::span batch(ops, count);
+  for (auto& op : batch) {
+    op.error = static_cast<int>(ExecuteBatchOp(client, pipeline, op));
+  }
+  pipeline.Flush();
+
+  for (const auto& op : batch) {
+    if (op.error != static_cast<int>(ec::kSuccess)) {
+      return op.error;
+    }
+  }
+
+  return static_cast<int>(ec::kSuccess);
+} catch (const std::bad_alloc&) {
+  return static_cast<int>(ec::kAllocationFailed);
+} catch (...) {
+  return static_cast<int>(ec::kUnexpectedException);
+}
+
+int AbsAcquisition_Init(AbsAcquisitionHandle* handle_out,
+                        const AbsScpiClientHandle clients[],
+                        unsigned int count, unsigned int period_us,
+                        unsigned int capacity) try {
+  if (!handle_out || *handle_out || !clients || count == 0 ||
+      period_us == 0) {
+    return static_cast<int>(ec::kInvalidArgument);
+  }
+
+  for (const auto handle : std::span(clients, count)) {
+    if (!handle) {
+      return static_cast<int>(ec::kInvalidArgument);
+    }
+  }
+
+  std::vector<ScpiClient> owned;
+  owned.reserve(count);
+  for (const auto handle : std::span(clients, count)) {
+    owned.push_back(std::move(GetClient(handle)));
+  }
+
+  try {
+    *handle_out = new ContinuousAcquisition(
+        std::move(owned), std::chrono::microseconds(period_us), capacity);
+  } catch (...) {
+    // give the clients back, last first so that a handle passed twice gets its
+    // client rather than the moved-from copy
+    for (std::size_t i = count; i-- > 0;) {
+      GetClient(clients[i]) = std::move(owned[i]);
+    }
+    throw;
+  }
+
+  return static_cast<int>(ec::kSuccess);
+} catch (const std::bad_alloc&) {
+  return static_cast<int>(ec::kAllocationFailed);
+} catch (...) {
+  return static_cast<int>(ec::kUnexpectedException);
+}
+
+void AbsAcquisition_Destroy(AbsAcquisitionHandle* handle) {
+  if (handle && *handle) {
+    delete (ContinuousAcquisition*)*handle;
+    *handle = nullptr;
+  }
+}
+
+int AbsAcquisition_GetClient(AbsAcquisitionHandle handle, unsigned int index,
+                             AbsScpiClientHandle* client_out) {
+  if (!handle || !client_out || index >= GetAcquisition(handle).Size()) {
+    return static_cast<int>(ec::kInvalidArgument);
+  }
+
+  *client_out = &GetAcquisition(handle)[index];
+
+  return static_cast<int>(ec::kSuccess);
+}
+
+int AbsAcquisition_Start(AbsAcquisitionHandle handle) try {
+  if (!handle) {
+    return static_cast<int>(ec::kInvalidArgument);
+  }
+
+  return static_cast<int>(GetAcquisition(handle).Start());
+} catch (const std::bad_alloc&) {
+  return static_cast<int>(ec::kAllocationFailed);
+} catch (...) {
+  return static_cast<int>(ec::kUnexpectedException);
+}
+
+int AbsAcquisition_Stop(AbsAcquisitionHandle handle) {
+  if (!handle) {
+    return static_cast<int>(ec::kInvalidArgument);
+  }
+
+  GetAcquisition(handle).Stop();
+
+  return static_cast<int>(ec::kSuccess);
+}
+
+int AbsAcquisition_Read(AbsAcquisitionHandle handle,
+                        AbsAcquisitionSample samples_out[],
+                        unsigned int* count) {
+  if (!handle || !count || (!samples_out && *count > 0)) {
+    return static_cast<int>(ec::kInvalidArgument);
+  }
+
+  // read in chunks to avoid allocating
+  std::array<AcquisitionSample, 32> buf;
+  unsigned int total = 0;
+  while (total < *count) {
+    const auto want = std::min<std::size_t>(buf.size(), *count - total);
+    const auto got = GetAcquisition(handle).Read(std::span(buf).first(want));
+    for (std::size_t i = 0; i < got; ++i) {
+      const auto& sample = buf[i];
+      auto& out = samples_out[total++];
+      out.timestamp_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                             sample.timestamp.time_since_epoch())
+                             .count();
+      out.sequence = sample.sequence;
+      out.device = static_cast<unsigned int>(sample.device);
+      out.error = static_cast<int>(sample.error);
+      out.snapshot = {};
+      if (sample.error == ec::kSuccess) {
+        CopySnapshot(sample.snapshot, &out.snapshot);
+      }
+    }
+    if (got < want) {
+      break;
+    }
+  }
+  *count = total;
+
+  return static_cast<int>(ec::kSuccess);
+}
+
+int AbsAcquisition_GetDroppedCount(AbsAcquisitionHandle handle,
+                                   uint64_t* dropped_out) {
+  if (!handle || !dropped_out) {
+    return static_cast<int>(ec::kInvalidArgument);
+  }
+
+  *dropped_out = GetAcquisition(handle).DroppedSamples();
+
+  return static_cast<int>(ec::kSuccess);
+}
+
 int AbsScpiClient_MulticastDiscovery(const char* interface_ip,
                                      AbsEthernetDiscoveryResult results_out[],
                                      unsigned int* count) try {
@@ -897,3 +1350,74 @@ int AbsScpiClient_SerialDiscovery(const char* port, uint8_t first_id,
 } catch (...) {
   return static_cast<int>(ec::kUnexpectedException);
 }
+
+int AbsLatencyHistogram_Init(AbsLatencyHistogramHandle* handle_out) try {
+  if (!handle_out) {
+    return static_cast<int>(ec::kInvalidArgument);
+  }
+
+  HistogramPtr*& hist_ptr = *(HistogramPtr**)handle_out;
+  if (!hist_ptr) {
+    hist_ptr = new HistogramPtr(std::make_shared<LatencyHistogram>());
+  }
+
+  return static_cast<int>(ec::kSuccess);
+} catch (const std::bad_alloc&) {
+  return static_cast<int>(ec::kAllocationFailed);
+} catch (...) {
+  return static_cast<int>(ec::kUnexpectedException);
+}
+
+void AbsLatencyHistogram_Destroy(AbsLatencyHistogramHandle* handle) {
+  if (handle && *handle) {
+    delete (HistogramPtr*)*handle;
+    *handle = nullptr;
+  }
+}
+
+int AbsLatencyHistogram_GetStats(AbsLatencyHistogramHandle handle,
+                                 const char* command,
+                                 AbsLatencyStats* stats_out) {
+  if (!handle || !command || !stats_out) {
+    return static_cast<int>(ec::kInvalidArgument);
+  }
+
+  const auto stats = GetHistogram(handle)->Stats(command);
+  if (!stats) {
+    return static_cast<int>(stats.error());
+  }
+
+  using us = std::chrono::duration<double, std::micro>;
+  *stats_out = {};
+  stats_out->count = stats->count;
+  stats_out->errors = stats->errors;
+  stats_out->timeouts = stats->timeouts;
+  stats_out->p50_us = us(stats->p50).count();
+  stats_out->p99_us = us(stats->p99).count();
+  stats_out->max_us = us(stats->max).count();
+
+  return static_cast<int>(ec::kSuccess);
+}
+
+int AbsLatencyHistogram_Reset(AbsLatencyHistogramHandle handle) {
+  if (!handle) {
+    return static_cast<int>(ec::kInvalidArgument);
+  }
+
+  GetHistogram(handle)->Reset();
+  return static_cast<int>(ec::kSuccess);
+}
+
+int AbsScpiClient_SetLatencyHistogram(AbsScpiClientHandle handle,
+                                      AbsLatencyHistogramHandle histogram) {
+  if (!handle) {
+    return static_cast<int>(ec::kInvalidArgument);
+  }
+
+  if (histogram) {
+    GetClient(handle).SetInstrumentation(GetHistogram(histogram));
+  } else {
+    GetClient(handle).SetInstrumentation(nullptr);
+  }
+  return static_cast<int>(ec::kSuccess);
+}
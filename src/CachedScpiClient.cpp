@@ -0,0 +1,497 @@
+/*
+ * Copyright (c) 2024, Bloomy Controls, Inc. All rights reserved.
+ *
+ * Use of this source code is governed by a BSD-3-clause license that can be
+ * found in the LICENSE file or at https://opensource.org/license/BSD-3-Clause
+ */
+
+#include <bci/abs/CachedScpiClient.h>
+#include <bci/abs/ScpiClient.h>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <span>
+#include <type_traits>
+#include <utility>
+
+#include "Limits.h"
+
+namespace bci::abs {
+
+using ec = ErrorCode;
+using limits::ClampAnalogOut;
+using limits::ClampSinking;
+using limits::ClampSourcing;
+using limits::ClampVoltage;
+
+namespace {
+
+template <class T, std::size_t N>
+using Setpoints = std::array<std::optional<T>, N>;
+
+template <class T>
+bool Matches(const std::optional<T>& cached, T value, float tolerance) {
+  if (!cached) {
+    return false;
+  }
+  if constexpr (std::is_floating_point_v<T>) {
+    return std::abs(*cached - value) <= tolerance;
+  } else {
+    return *cached == value;
+  }
+}
+
+// Write a single setpoint unless it's already cached. Out of range indices are
+// passed through so the client reports the error.
+template <class T, std::size_t N, class F>
+ErrorCode SetOne(Setpoints<T, N>& cache, unsigned int index, T value,
+                 float tolerance, F&& set) {
+  if (index >= N) {
+    return set();
+  }
+
+  if (Matches(cache[index], value, tolerance)) {
+    return ec::kSuccess;
+  }
+
+  const auto res = set();
+  cache[index] = res == ec::kSuccess ? std::optional{value} : std::nullopt;
+  return res;
+}
+
+// Write one value to every setpoint unless all are already cached.
+template <class T, std::size_t N, class F>
+ErrorCode SetAll(Setpoints<T, N>& cache, T value, float tolerance, F&& set) {
+  if (std::ranges::all_of(cache, [&](const auto& cached) {
+        return Matches(cached, value, tolerance);
+      })) {
+    return ec::kSuccess;
+  }
+
+  const auto res = set();
+  cache.fill(res == ec::kSuccess ? std::optional{value} : std::nullopt);
+  return res;
+}
+
+// Write the first values.size() setpoints unless all are already cached.
+// Values are compared and cached as clamp(value), the way the client sends
+// them.
+template <class T, std::size_t N, class C, class F>
+ErrorCode SetMany(Setpoints<T, N>& cache, std::span<const T> values,
+                  float tolerance, C&& clamp, F&& set) {
+  if (values.size() > N) {
+    return set();
+  }
+
+  bool changed = false;
+  for (std::size_t i = 0; i < values.size() && !changed; ++i) {
+    changed = !Matches(cache[i], clamp(values[i]), tolerance);
+  }
+  if (!changed) {
+    return ec::kSuccess;
+  }
+
+  const auto res = set();
+  for (std::size_t i = 0; i < values.size(); ++i) {
+    cache[i] =
+        res == ec::kSuccess ? std::optional{clamp(values[i])} : std::nullopt;
+  }
+  return res;
+}
+
+// Like SetMany(), but if every value being written is cached only the ones
+// which changed are sent, with set_delta(prev, next). Values within tolerance
+// of the cache count as unchanged.
+template <std::size_t N, class C, class F, class D>
+ErrorCode SetManyDelta(Setpoints<float, N>& cache,
+                       std::span<const float> values, float tolerance,
+                       C&& clamp, F&& set, D&& set_delta) {
+  if (values.size() > N ||
+      !std::all_of(cache.begin(), cache.begin() + values.size(),
+                   [](const auto& cached) { return !!cached; })) {
+    return SetMany(cache, values, tolerance, clamp, std::forward<F>(set));
+  }
+
+  std::array<float, N> prev;
+  for (std::size_t i = 0; i < values.size(); ++i) {
+    prev[i] = Matches(cache[i], clamp(values[i]), tolerance) ? values[i]
+                                                              : *cache[i];
+  }
+
+  const auto res = set_delta(std::span{prev.data(), values.size()});
+  for (std::size_t i = 0; i < values.size(); ++i) {
+    if (res != ec::kSuccess) {
+      cache[i].reset();
+    } else if (prev[i] != values[i]) {
+      cache[i] = clamp(values[i]);
+    }
+  }
+  return res;
+}
+
+// Get a single setpoint from the cache, or query and cache it.
+template <class T, std::size_t N, class F>
+Result<T> GetOne(Setpoints<T, N>& cache, unsigned int index, F&& get) {
+  if (index >= N) {
+    return get();
+  }
+
+  if (cache[index]) {
+    return *cache[index];
+  }
+
+  auto res = get();
+  if (res) {
+    cache[index] = *res;
+  }
+  return res;
+}
+
+// Get every setpoint from the cache, or query and cache them all if any are
+// missing.
+template <class T, std::size_t N, class F>
+Result<std::array<T, N>> GetAll(Setpoints<T, N>& cache, F&& get) {
+  if (std::ranges::all_of(cache, [](const auto& cached) { return !!cached; })) {
+    std::array<T, N> values;
+    std::ranges::transform(cache, values.begin(),
+                           [](const auto& cached) { return *cached; });
+    return values;
+  }
+
+  auto res = get();
+  if (res) {
+    std::ranges::copy(*res, cache.begin());
+  }
+  return res;
+}
+
+}  // namespace
+
+CachedScpiClient::CachedScpiClient(const ScpiClient& client,
+                                   float tolerance) noexcept
+    : client_{&client}, tolerance_{tolerance} {}
+
+const ScpiClient& CachedScpiClient::Client() const noexcept {
+  return *client_;
+}
+
+void CachedScpiClient::SetTolerance(float tolerance) noexcept {
+  tolerance_ = tolerance;
+}
+
+float CachedScpiClient::GetTolerance() const noexcept { return tolerance_; }
+
+void CachedScpiClient::Invalidate() noexcept {
+  cell_enabled_.fill(std::nullopt);
+  cell_voltage_.fill(std::nullopt);
+  cell_sourcing_.fill(std::nullopt);
+  cell_sinking_.fill(std::nullopt);
+  cell_fault_.fill(std::nullopt);
+  cell_sense_range_.fill(std::nullopt);
+  analog_output_.fill(std::nullopt);
+  digital_output_.fill(std::nullopt);
+  global_model_input_.fill(std::nullopt);
+  local_model_input_.fill(std::nullopt);
+}
+
+ErrorCode CachedScpiClient::ClearErrors() {
+  Invalidate();
+  return client_->ClearErrors();
+}
+
+Result<std::uint32_t> CachedScpiClient::GetAlarms() {
+  auto alarms = client_->GetAlarms();
+  if (alarms && alarms_ != *alarms) {
+    Invalidate();
+    alarms_ = *alarms;
+  }
+  return alarms;
+}
+
+ErrorCode CachedScpiClient::AssertSoftwareInterlock() {
+  Invalidate();
+  return client_->AssertSoftwareInterlock();
+}
+
+ErrorCode CachedScpiClient::ClearRecoverableAlarms() {
+  Invalidate();
+  return client_->ClearRecoverableAlarms();
+}
+
+ErrorCode CachedScpiClient::Reboot() {
+  Invalidate();
+  return client_->Reboot();
+}
+
+ErrorCode CachedScpiClient::EnableCell(unsigned int cell, bool en) {
+  return SetOne(cell_enabled_, cell, en, tolerance_,
+                [&] { return client_->EnableCell(cell, en); });
+}
+
+Result<bool> CachedScpiClient::GetCellEnabled(unsigned int cell) {
+  return GetOne(cell_enabled_, cell,
+                [&] { return client_->GetCellEnabled(cell); });
+}
+
+ErrorCode CachedScpiClient::SetCellVoltage(unsigned int cell, float voltage) {
+  return SetOne(cell_voltage_, cell, ClampVoltage(voltage), tolerance_,
+                [&] { return client_->SetCellVoltage(cell, voltage); });
+}
+
+ErrorCode CachedScpiClient::SetAllCellVoltages(float voltage) {
+  return SetAll(cell_voltage_, ClampVoltage(voltage), tolerance_,
+                [&] { return client_->SetAllCellVoltages(voltage); });
+}
+
+ErrorCode CachedScpiClient::SetAllCellVoltages(
+    std::span<const float> voltages) {
+  return SetManyDelta(
+      cell_voltage_, voltages, tolerance_, ClampVoltage,
+      [&] { return client_->SetAllCellVoltages(voltages); },
+      [&](auto prev) { return client_->SetCellVoltagesDelta(prev, voltages); });
+}
+
+Result<float> CachedScpiClient::GetCellVoltageTarget(unsigned int cell) {
+  return GetOne(cell_voltage_, cell,
+                [&] { return client_->GetCellVoltageTarget(cell); });
+}
+
+Result<std::array<float, kCellCount>>
+CachedScpiClient::GetAllCellVoltageTargets() {
+  return GetAll(cell_voltage_,
+                [&] { return client_->GetAllCellVoltageTargets(); });
+}
+
+ErrorCode CachedScpiClient::SetCellSourcing(unsigned int cell, float limit) {
+  return SetOne(cell_sourcing_, cell, ClampSourcing(limit), tolerance_,
+                [&] { return client_->SetCellSourcing(cell, limit); });
+}
+
+ErrorCode CachedScpiClient::SetAllCellSourcing(float limit) {
+  return SetAll(cell_sourcing_, ClampSourcing(limit), tolerance_,
+                [&] { return client_->SetAllCellSourcing(limit); });
+}
+
+ErrorCode CachedScpiClient::SetAllCellSourcing(std::span<const float> limits) {
+  return SetManyDelta(
+      cell_sourcing_, limits, tolerance_, ClampSourcing,
+      [&] { return client_->SetAllCellSourcing(limits); },
+      [&](auto prev) { return client_->SetCellSourcingDelta(prev, limits); });
+}
+
+Result<float> CachedScpiClient::GetCellSourcingLimit(unsigned int cell) {
+  return GetOne(cell_sourcing_, cell,
+                [&] { return client_->GetCellSourcingLimit(cell); });
+}
+
+Result<std::array<float, kCellCount>>
+CachedScpiClient::GetAllCellSourcingLimits() {
+  return GetAll(cell_sourcing_,
+                [&] { return client_->GetAllCellSourcingLimits(); });
+}
+
+ErrorCode CachedScpiClient::SetCellSinking(unsigned int cell, float limit) {
+  return SetOne(cell_sinking_, cell, ClampSinking(limit), tolerance_,
+                [&] { return client_->SetCellSinking(cell, limit); });
+}
+
+ErrorCode CachedScpiClient::SetAllCellSinking(float limit) {
+  return SetAll(cell_sinking_, ClampSinking(limit), tolerance_,
+                [&] { return client_->SetAllCellSinking(limit); });
+}
+
+ErrorCode CachedScpiClient::SetAllCellSinking(std::span<const float> limits) {
+  return SetManyDelta(
+      cell_sinking_, limits, tolerance_, ClampSinking,
+      [&] { return client_->SetAllCellSinking(limits); },
+      [&](auto prev) { return client_->SetCellSinkingDelta(prev, limits); });
+}
+
+Result<float> CachedScpiClient::GetCellSinkingLimit(unsigned int cell) {
+  return GetOne(cell_sinking_, cell,
+                [&] { return client_->GetCellSinkingLimit(cell); });
+}
+
+Result<std::array<float, kCellCount>>
+CachedScpiClient::GetAllCellSinkingLimits() {
+  return GetAll(cell_sinking_,
+                [&] { return client_->GetAllCellSinkingLimits(); });
+}
+
+ErrorCode CachedScpiClient::SetCellFault(unsigned int cell, CellFault fault) {
+  return SetOne(cell_fault_, cell, fault, tolerance_,
+                [&] { return client_->SetCellFault(cell, fault); });
+}
+
+ErrorCode CachedScpiClient::SetAllCellFaults(CellFault fault) {
+  return SetAll(cell_fault_, fault, tolerance_,
+                [&] { return client_->SetAllCellFaults(fault); });
+}
+
+ErrorCode CachedScpiClient::SetAllCellFaults(
+    std::span<const CellFault> faults) {
+  return SetMany(cell_fault_, faults, tolerance_, std::identity{},
+                 [&] { return client_->SetAllCellFaults(faults); });
+}
+
+Result<CellFault> CachedScpiClient::GetCellFault(unsigned int cell) {
+  return GetOne(cell_fault_, cell, [&] { return client_->GetCellFault(cell); });
+}
+
+Result<std::array<CellFault, kCellCount>> CachedScpiClient::GetAllCellFaults() {
+  return GetAll(cell_fault_, [&] { return client_->GetAllCellFaults(); });
+}
+
+ErrorCode CachedScpiClient::SetCellSenseRange(unsigned int cell,
+                                              CellSenseRange range) {
+  return SetOne(cell_sense_range_, cell, range, tolerance_,
+                [&] { return client_->SetCellSenseRange(cell, range); });
+}
+
+ErrorCode CachedScpiClient::SetAllCellSenseRanges(CellSenseRange range) {
+  return SetAll(cell_sense_range_, range, tolerance_,
+                [&] { return client_->SetAllCellSenseRanges(range); });
+}
+
+ErrorCode CachedScpiClient::SetAllCellSenseRanges(
+    std::span<const CellSenseRange> ranges) {
+  return SetMany(cell_sense_range_, ranges, tolerance_, std::identity{},
+                 [&] { return client_->SetAllCellSenseRanges(ranges); });
+}
+
+Result<CellSenseRange> CachedScpiClient::GetCellSenseRange(unsigned int cell) {
+  return GetOne(cell_sense_range_, cell,
+                [&] { return client_->GetCellSenseRange(cell); });
+}
+
+Result<std::array<CellSenseRange, kCellCount>>
+CachedScpiClient::GetAllCellSenseRanges() {
+  return GetAll(cell_sense_range_,
+                [&] { return client_->GetAllCellSenseRanges(); });
+}
+
+ErrorCode CachedScpiClient::SetAnalogOutput(unsigned int channel,
+                                            float voltage) {
+  return SetOne(analog_output_, channel, ClampAnalogOut(voltage),
+                tolerance_,
+                [&] { return client_->SetAnalogOutput(channel, voltage); });
+}
+
+ErrorCode CachedScpiClient::SetAllAnalogOutputs(float voltage) {
+  return SetAll(analog_output_, ClampAnalogOut(voltage), tolerance_,
+                [&] { return client_->SetAllAnalogOutputs(voltage); });
+}
+
+ErrorCode CachedScpiClient::SetAllAnalogOutputs(
+    std::span<const float> voltages) {
+  return SetManyDelta(
+      analog_output_, voltages, tolerance_, ClampAnalogOut,
+      [&] { return client_->SetAllAnalogOutputs(voltages); },
+      [&](auto prev) {
+        return client_->SetAnalogOutputsDelta(prev, voltages);
+      });
+}
+
+Result<float> CachedScpiClient::GetAnalogOutput(unsigned int channel) {
+  return GetOne(analog_output_, channel,
+                [&] { return client_->GetAnalogOutput(channel); });
+}
+
+Result<std::array<float, kAnalogOutputCount>>
+CachedScpiClient::GetAllAnalogOutputs() {
+  return GetAll(analog_output_,
+                [&] { return client_->GetAllAnalogOutputs(); });
+}
+
+ErrorCode CachedScpiClient::SetDigitalOutput(unsigned int channel,
+                                             bool level) {
+  return SetOne(digital_output_, channel, level, tolerance_,
+                [&] { return client_->SetDigitalOutput(channel, level); });
+}
+
+ErrorCode CachedScpiClient::SetAllDigitalOutputs(bool level) {
+  return SetAll(digital_output_, level, tolerance_,
+                [&] { return client_->SetAllDigitalOutputs(level); });
+}
+
+Result<bool> CachedScpiClient::GetDigitalOutput(unsigned int channel) {
+  return GetOne(digital_output_, channel,
+                [&] { return client_->GetDigitalOutput(channel); });
+}
+
+Result<std::array<bool, kDigitalOutputCount>>
+CachedScpiClient::GetAllDigitalOutputs() {
+  return GetAll(digital_output_,
+                [&] { return client_->GetAllDigitalOutputs(); });
+}
+
+ErrorCode CachedScpiClient::SetGlobalModelInput(unsigned int index,
+                                                float value) {
+  return SetOne(global_model_input_, index, value, tolerance_,
+                [&] { return client_->SetGlobalModelInput(index, value); });
+}
+
+ErrorCode CachedScpiClient::SetAllGlobalModelInputs(float value) {
+  return SetAll(global_model_input_, value, tolerance_,
+                [&] { return client_->SetAllGlobalModelInputs(value); });
+}
+
+ErrorCode CachedScpiClient::SetAllGlobalModelInputs(
+    std::span<const float> values) {
+  return SetManyDelta(
+      global_model_input_, values, tolerance_, std::identity{},
+      [&] { return client_->SetAllGlobalModelInputs(values); },
+      [&](auto prev) {
+        return client_->SetGlobalModelInputsDelta(prev, values);
+      });
+}
+
+Result<float> CachedScpiClient::GetGlobalModelInput(unsigned int index) {
+  return GetOne(global_model_input_, index,
+                [&] { return client_->GetGlobalModelInput(index); });
+}
+
+Result<std::array<float, kGlobalModelInputCount>>
+CachedScpiClient::GetAllGlobalModelInputs() {
+  return GetAll(global_model_input_,
+                [&] { return client_->GetAllGlobalModelInputs(); });
+}
+
+ErrorCode CachedScpiClient::SetLocalModelInput(unsigned int index,
+                                               float value) {
+  return SetOne(local_model_input_, index, value, tolerance_,
+                [&] { return client_->SetLocalModelInput(index, value); });
+}
+
+ErrorCode CachedScpiClient::SetAllLocalModelInputs(float value) {
+  return SetAll(local_model_input_, value, tolerance_,
+                [&] { return client_->SetAllLocalModelInputs(value); });
+}
+
+ErrorCode CachedScpiClient::SetAllLocalModelInputs(
+    std::span<const float> values) {
+  return SetManyDelta(
+      local_model_input_, values, tolerance_, std::identity{},
+      [&] { return client_->SetAllLocalModelInputs(values); },
+      [&](auto prev) {
+        return client_->SetLocalModelInputsDelta(prev, values);
+      });
+}
+
+Result<float> CachedScpiClient::GetLocalModelInput(unsigned int index) {
+  return GetOne(local_model_input_, index,
+                [&] { return client_->GetLocalModelInput(index); });
+}
+
+Result<std::array<float, kLocalModelInputCount>>
+CachedScpiClient::GetAllLocalModelInputs() {
+  return GetAll(local_model_input_,
+                [&] { return client_->GetAllLocalModelInputs(); });
+}
+
+}  // namespace bci::abs
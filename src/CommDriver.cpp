@@ -0,0 +1,23 @@
+/*
+ * Copyright (c) 2024, Bloomy Controls, Inc. All rights reserved.
+ *
+ * Use of this source code is governed by a BSD-3-clause license that can be
+ * found in the LICENSE file or at https://opensource.org/license/BSD-3-Clause
+ */
+
+#include <bci/abs/CommDriver.h>
+
+#include <memory>
+
+#include "TransactionLock.h"
+
+namespace bci::abs::drivers {
+
+std::shared_ptr<detail::TransactionLock> CommDriver::GetTransactionLock() {
+  if (!lock_) {
+    lock_ = std::make_shared<detail::TransactionLock>();
+  }
+  return lock_;
+}
+
+}  // namespace bci::abs::drivers
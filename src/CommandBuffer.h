@@ -0,0 +1,198 @@
+/*
+ * Copyright (c) 2024, Bloomy Controls, Inc. All rights reserved.
+ *
+ * Use of this source code is governed by a BSD-3-clause license that can be
+ * found in the LICENSE file or at https://opensource.org/license/BSD-3-Clause
+ */
+
+#ifndef ABS_SCPI_DRIVER_SRC_COMMANDBUFFER_H
+#define ABS_SCPI_DRIVER_SRC_COMMANDBUFFER_H
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string_view>
+#include <utility>
+
+namespace bci::abs::scpi {
+
+// Fixed-capacity command string built on the stack. Formatting past the end
+// truncates the command and marks the buffer as overflowed instead of
+// allocating.
+template <std::size_t kCapacity>
+class CommandBuffer {
+ public:
+  CommandBuffer() noexcept : size_{}, overflowed_{} {}
+
+  CommandBuffer(const CommandBuffer&) = delete;
+  CommandBuffer& operator=(const CommandBuffer&) = delete;
+
+  template <class... Args>
+  void Append(fmt::format_string<Args...> fmt, Args&&... args) {
+    const auto avail = kCapacity - size_;
+    const auto res = fmt::format_to_n(buf_.data() + size_, avail, fmt,
+                                      std::forward<Args>(args)...);
+    if (res.size > avail) {
+      overflowed_ = true;
+      size_ = kCapacity;
+    } else {
+      size_ += res.size;
+    }
+  }
+
+  constexpr void Append(std::string_view str) noexcept {
+    if (str.size() > kCapacity - size_) {
+      overflowed_ = true;
+      str = str.substr(0, kCapacity - size_);
+    }
+    std::ranges::copy(str, buf_.begin() + size_);
+    size_ += str.size();
+  }
+
+  // Append value with kDecimals digits after the decimal point, the same as
+  // Append("{:.<kDecimals>f}", value) but without a trip through fmt for the
+  // finite values a setpoint takes.
+  template <unsigned int kDecimals>
+  void AppendFixed(float value) {
+    static_assert(kDecimals <= 6, "scaled value must be exact in a double");
+
+    constexpr auto kScale = [] {
+      std::uint64_t scale = 1;
+      for (unsigned int i = 0; i < kDecimals; ++i) {
+        scale *= 10;
+      }
+      return static_cast<double>(scale);
+    }();
+
+    // a float times 10^6 or less is exact in a double, so rounding it to the
+    // nearest integer (ties to even) matches fmt's rounding of the exact value
+    const auto scaled =
+        std::nearbyint(std::fabs(static_cast<double>(value)) * kScale);
+    if (!(scaled < 1e15)) {
+      Append("{:.{}f}", value, kDecimals);
+      return;
+    }
+
+    std::array<char, 24> digits;
+    auto pos = digits.size();
+    auto n = static_cast<std::uint64_t>(scaled);
+    for (unsigned int i = 0; i < kDecimals; ++i, n /= 10) {
+      digits[--pos] = static_cast<char>('0' + n % 10);
+    }
+    if (kDecimals > 0) {
+      digits[--pos] = '.';
+    }
+    do {
+      digits[--pos] = static_cast<char>('0' + n % 10);
+      n /= 10;
+    } while (n > 0);
+    if (std::signbit(value)) {
+      digits[--pos] = '-';
+    }
+
+    Append(std::string_view{digits.data() + pos, digits.size() - pos});
+  }
+
+  constexpr bool Overflowed() const noexcept { return overflowed_; }
+
+  constexpr std::string_view View() const noexcept {
+    return {buf_.data(), size_};
+  }
+
+ private:
+  std::array<char, kCapacity> buf_;
+  std::size_t size_;
+  bool overflowed_;
+};
+
+// Append the commands which change each channel from prev[i] to next[i],
+// skipping channels whose value is unchanged. Channels are numbered from 1.
+//
+// Channels changing to the same value share one command on a channel list, such
+// as ":SOUR:VOLT 1.0000,(@1,3:5);", while a value only one channel changes to
+// uses the shorter single-channel form, such as ":SOUR2:VOLT 2.0000;". The
+// commands are never longer than setting every channel individually.
+//
+// prefix and suffix surround the channel number in the single-channel form
+// (":SOUR" and ":VOLT" above). Values are passed through limit(value), such as
+// a clamp, before being compared, and format_value(buf, value) appends a value.
+// prev and next must be the same size, no more than kMaxChannels. Returns
+// whether any channel changed.
+template <std::size_t kMaxChannels, std::size_t kCapacity, class Limit,
+          class Format>
+bool AppendChanges(CommandBuffer<kCapacity>& buf, std::string_view prefix,
+                   std::string_view suffix, std::span<const float> prev,
+                   std::span<const float> next, Limit&& limit,
+                   Format&& format_value) {
+  const auto count = std::min(next.size(), kMaxChannels);
+  std::array<float, kMaxChannels> from{};
+  std::array<float, kMaxChannels> to{};
+  std::array<bool, kMaxChannels> done{};
+  for (std::size_t i = 0; i < count; ++i) {
+    from[i] = limit(prev[i]);
+    to[i] = limit(next[i]);
+    done[i] = from[i] == to[i];
+  }
+
+  bool changed = false;
+  for (std::size_t i = 0; i < count; ++i) {
+    if (done[i]) {
+      continue;
+    }
+
+    // ascending channel numbers sharing this value
+    std::array<std::size_t, kMaxChannels> group{};
+    std::size_t group_len = 0;
+    group[group_len++] = i + 1;
+    for (std::size_t j = i + 1; j < count; ++j) {
+      if (!done[j] && to[j] == to[i]) {
+        done[j] = true;
+        group[group_len++] = j + 1;
+      }
+    }
+
+    changed = true;
+    buf.Append(prefix);
+    if (group_len == 1) {
+      buf.Append("{}", group[0]);
+      buf.Append(suffix);
+      buf.Append(" ");
+      format_value(buf, to[i]);
+      buf.Append(";");
+      continue;
+    }
+
+    buf.Append(suffix);
+    buf.Append(" ");
+    format_value(buf, to[i]);
+    buf.Append(",(@");
+    // runs of three or more consecutive channels are shorter as a range
+    for (std::size_t k = 0; k < group_len;) {
+      std::size_t end = k;
+      while (end + 1 < group_len && group[end + 1] == group[end] + 1) {
+        ++end;
+      }
+      if (k > 0) {
+        buf.Append(",");
+      }
+      if (end - k >= 2) {
+        buf.Append("{}:{}", group[k], group[end]);
+        k = end + 1;
+      } else {
+        buf.Append("{}", group[k]);
+        ++k;
+      }
+    }
+    buf.Append(");");
+  }
+  return changed;
+}
+
+}  // namespace bci::abs::scpi
+
+#endif /* ABS_SCPI_DRIVER_SRC_COMMANDBUFFER_H */
@@ -0,0 +1,117 @@
+/*
+ * Copyright (c) 2024, Bloomy Controls, Inc. All rights reserved.
+ *
+ * Use of this source code is governed by a BSD-3-clause license that can be
+ * found in the LICENSE file or at https://opensource.org/license/BSD-3-Clause
+ */
+
+#ifndef ABS_SCPI_DRIVER_SRC_COMMANDTABLE_H
+#define ABS_SCPI_DRIVER_SRC_COMMANDTABLE_H
+
+#include <bci/abs/CommonTypes.h>
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <string_view>
+
+namespace bci::abs::scpi {
+
+// String literal usable as a template argument.
+template <std::size_t N>
+struct Literal {
+  constexpr Literal(const char (&str)[N]) noexcept {
+    std::copy_n(str, N, chars);
+  }
+
+  constexpr std::string_view View() const noexcept { return {chars, N - 1}; }
+
+  char chars[N];
+};
+
+namespace detail {
+
+template <std::size_t kLen>
+struct TableEntry {
+  std::array<char, kLen> chars;
+  std::size_t size;
+};
+
+constexpr std::size_t DigitCount(std::size_t n) noexcept {
+  std::size_t digits = 1;
+  for (; n >= 10; n /= 10) {
+    ++digits;
+  }
+  return digits;
+}
+
+// Every "<head><n><tail>", or "<head>(@1:<n>)<tail>" if list, for n from 1
+// through count.
+template <Literal kHead, Literal kTail, std::size_t kCount, bool kList>
+constexpr auto MakeTable() noexcept {
+  constexpr std::string_view kOpen = kList ? "(@1:" : "";
+  constexpr std::string_view kClose = kList ? ")" : "";
+  constexpr auto kLen = kHead.View().size() + kOpen.size() +
+                        DigitCount(kCount) + kClose.size() +
+                        kTail.View().size();
+
+  std::array<TableEntry<kLen>, kCount> table{};
+  for (std::size_t n = 1; n <= kCount; ++n) {
+    auto& entry = table[n - 1];
+    auto out = std::ranges::copy(kHead.View(), entry.chars.begin()).out;
+    out = std::ranges::copy(kOpen, out).out;
+
+    std::array<char, DigitCount(kCount)> digits{};
+    std::size_t len = 0;
+    for (auto v = n; v > 0; v /= 10) {
+      digits[len++] = static_cast<char>('0' + v % 10);
+    }
+    out = std::reverse_copy(digits.begin(), digits.begin() + len, out);
+
+    out = std::ranges::copy(kClose, out).out;
+    out = std::ranges::copy(kTail.View(), out).out;
+    entry.size = static_cast<std::size_t>(out - entry.chars.begin());
+  }
+  return table;
+}
+
+template <Literal kHead, Literal kTail, std::size_t kCount, bool kList>
+inline constexpr auto kTable = MakeTable<kHead, kTail, kCount, kList>();
+
+}  // namespace detail
+
+// Command for one channel of kCount, built at compile time. For example,
+// ChannelCommand<"SOUR", ":VOLT?\r\n", kCellCount>(2) is "SOUR3:VOLT?\r\n".
+// index must be less than kCount.
+template <Literal kHead, Literal kTail, std::size_t kCount>
+constexpr std::string_view ChannelCommand(std::size_t index) noexcept {
+  const auto& entry = detail::kTable<kHead, kTail, kCount, false>[index];
+  return {entry.chars.data(), entry.size};
+}
+
+// Command for the first count channels of kCount, built at compile time. For
+// example, ChannelListCommand<"MEAS:VOLT? ", "\r\n", kCellCount>(4) is
+// "MEAS:VOLT? (@1:4)\r\n". count must be from 1 through kCount.
+template <Literal kHead, Literal kTail, std::size_t kCount>
+constexpr std::string_view ChannelListCommand(std::size_t count) noexcept {
+  const auto& entry = detail::kTable<kHead, kTail, kCount, true>[count - 1];
+  return {entry.chars.data(), entry.size};
+}
+
+static_assert(ChannelCommand<"SOUR", ":VOLT?\r\n", 8>(0) == "SOUR1:VOLT?\r\n");
+static_assert(ChannelCommand<"MOD:OUT", "?\r\n", 36>(35) == "MOD:OUT36?\r\n");
+static_assert(ChannelListCommand<"OUTP? ", "\r\n", 8>(8) ==
+              "OUTP? (@1:8)\r\n");
+
+// Compound query read by MeasureSnapshot(), covering every channel.
+inline constexpr std::string_view kSnapshotCommand =
+    "MEAS:VOLT? (@1:8);:MEAS:CURR? (@1:8);:OUTP:MODE? (@1:8);"
+    ":AUX:AIN? (@1:8);:AUX:DIN? (@1:4);:SYST:ALARM?\r\n";
+
+static_assert(kCellCount == 8 && kAnalogInputCount == 8 &&
+                  kDigitalInputCount == 4,
+              "kSnapshotCommand must list every channel");
+
+}  // namespace bci::abs::scpi
+
+#endif /* ABS_SCPI_DRIVER_SRC_COMMANDTABLE_H */
@@ -0,0 +1,230 @@
+/*
+ * Copyright (c) 2024, Bloomy Controls, Inc. All rights reserved.
+ *
+ * Use of this source code is governed by a BSD-3-clause license that can be
+ * found in the LICENSE file or at https://opensource.org/license/BSD-3-Clause
+ */
+
+#include <bci/abs/ContinuousAcquisition.h>
+#include <bci/abs/ScpiClient.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <span>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "SpscRing.h"
+
+namespace bci::abs {
+
+using ec = ErrorCode;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+using WallDuration = std::chrono::system_clock::duration;
+
+// A client and the samples taken from it.
+struct Poller {
+  explicit Poller(std::size_t capacity) : client{}, ring{capacity}, thread{} {}
+
+  ScpiClient client;
+  SpscRing<AcquisitionSample> ring;
+  std::thread thread;
+};
+
+}  // namespace
+
+struct ContinuousAcquisition::Impl {
+  Impl(std::vector<ScpiClient>&& clients, std::chrono::nanoseconds period,
+       std::size_t capacity);
+
+  ErrorCode Start();
+
+  void Stop() noexcept;
+
+  std::size_t Read(std::span<AcquisitionSample> samples);
+
+  // pollers_ is a deque so that pollers never move
+  std::deque<Poller> pollers_;
+  std::chrono::nanoseconds period_;
+  std::atomic<std::uint64_t> dropped_;
+  bool running_;
+
+  // index of the poller read from first by the next Read()
+  std::size_t next_read_;
+
+  // for waking the pollers to stop
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  bool stop_;
+
+ private:
+  void Poll(std::size_t index);
+};
+
+ContinuousAcquisition::Impl::Impl(std::vector<ScpiClient>&& clients,
+                                  std::chrono::nanoseconds period,
+                                  std::size_t capacity)
+    : pollers_{},
+      period_{period},
+      dropped_{0},
+      running_{false},
+      next_read_{0},
+      mutex_{},
+      cv_{},
+      stop_{false} {
+  try {
+    for (auto& client : clients) {
+      auto& p = pollers_.emplace_back(capacity);
+      p.client = std::move(client);
+      p.client.SetThreadSafe(true);
+    }
+  } catch (...) {
+    // the caller keeps the clients if construction fails
+    for (std::size_t i = 0; i < pollers_.size(); ++i) {
+      clients[i] = std::move(pollers_[i].client);
+    }
+    throw;
+  }
+}
+
+ErrorCode ContinuousAcquisition::Impl::Start() {
+  if (running_) {
+    return ec::kSuccess;
+  }
+
+  if (pollers_.empty() || period_ <= std::chrono::nanoseconds::zero()) {
+    return ec::kInvalidArgument;
+  }
+
+  stop_ = false;
+  for (std::size_t i = 0; i < pollers_.size(); ++i) {
+    pollers_[i].thread = std::thread([this, i] { Poll(i); });
+  }
+  running_ = true;
+
+  return ec::kSuccess;
+}
+
+void ContinuousAcquisition::Impl::Stop() noexcept {
+  if (!running_) {
+    return;
+  }
+
+  {
+    std::lock_guard lock{mutex_};
+    stop_ = true;
+  }
+  cv_.notify_all();
+  for (auto& p : pollers_) {
+    p.thread.join();
+  }
+  running_ = false;
+}
+
+std::size_t ContinuousAcquisition::Impl::Read(
+    std::span<AcquisitionSample> samples) {
+  // take one sample from each client in turn so that a busy client can't fill
+  // the buffer at the expense of the others
+  std::size_t count = 0;
+  std::size_t idle = 0;
+  while (count < samples.size() && idle < pollers_.size()) {
+    auto& p = pollers_[next_read_];
+    next_read_ = (next_read_ + 1) % pollers_.size();
+    if (p.ring.TryPop(samples[count])) {
+      ++count;
+      idle = 0;
+    } else {
+      ++idle;
+    }
+  }
+  return count;
+}
+
+void ContinuousAcquisition::Impl::Poll(std::size_t index) {
+  auto& p = pollers_[index];
+  auto next = Clock::now();
+  std::uint64_t sequence = 0;
+
+  std::unique_lock lock{mutex_};
+  while (!stop_) {
+    lock.unlock();
+
+    const auto wall_start = std::chrono::system_clock::now();
+    const auto start = Clock::now();
+    auto snapshot = p.client.MeasureSnapshot();
+    const auto elapsed = Clock::now() - start;
+
+    AcquisitionSample sample{};
+    sample.timestamp = wall_start + std::chrono::duration_cast<WallDuration>(
+                                        elapsed / 2);
+    sample.sequence = sequence;
+    sample.device = index;
+    sample.error = snapshot ? ec::kSuccess : snapshot.error();
+    if (snapshot) {
+      sample.snapshot = *snapshot;
+    }
+    if (!p.ring.TryPush(sample)) {
+      dropped_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // schedule from the start time rather than from now so the rate doesn't
+    // drift, skipping any periods this poll overran
+    next += period_;
+    ++sequence;
+    if (const auto now = Clock::now(); now >= next) {
+      const auto missed = (now - next) / period_ + 1;
+      next += missed * period_;
+      sequence += static_cast<std::uint64_t>(missed);
+    }
+
+    lock.lock();
+    cv_.wait_until(lock, next, [this] { return stop_; });
+  }
+}
+
+ContinuousAcquisition::ContinuousAcquisition(std::vector<ScpiClient>&& clients,
+                                             std::chrono::nanoseconds period,
+                                             std::size_t capacity)
+    : impl_{std::make_unique<Impl>(std::move(clients), period, capacity)} {}
+
+ContinuousAcquisition::~ContinuousAcquisition() { impl_->Stop(); }
+
+ErrorCode ContinuousAcquisition::Start() { return impl_->Start(); }
+
+void ContinuousAcquisition::Stop() noexcept { impl_->Stop(); }
+
+bool ContinuousAcquisition::IsRunning() const noexcept {
+  return impl_->running_;
+}
+
+std::size_t ContinuousAcquisition::Read(std::span<AcquisitionSample> samples) {
+  return impl_->Read(samples);
+}
+
+std::uint64_t ContinuousAcquisition::DroppedSamples() const noexcept {
+  return impl_->dropped_.load(std::memory_order_relaxed);
+}
+
+std::size_t ContinuousAcquisition::Size() const noexcept {
+  return impl_->pollers_.size();
+}
+
+ScpiClient& ContinuousAcquisition::operator[](std::size_t index) noexcept {
+  return impl_->pollers_[index].client;
+}
+
+const ScpiClient& ContinuousAcquisition::operator[](
+    std::size_t index) const noexcept {
+  return impl_->pollers_[index].client;
+}
+
+}  // namespace bci::abs
@@ -0,0 +1,244 @@
+/*
+ * Copyright (c) 2024, Bloomy Controls, Inc. All rights reserved.
+ *
+ * Use of this source code is governed by a BSD-3-clause license that can be
+ * found in the LICENSE file or at https://opensource.org/license/BSD-3-Clause
+ */
+
+#include <bci/abs/DeviceGroup.h>
+#include <bci/abs/ScpiClient.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <latch>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace bci::abs {
+
+// Fixed-size pool of worker threads.
+struct DeviceGroup::Impl {
+  explicit Impl(std::size_t threads);
+
+  ~Impl();
+
+  // Call task(i) for all i < count using the workers and the calling thread.
+  void Run(std::size_t count, const std::function<void(std::size_t)>& task);
+
+ private:
+  void Worker();
+
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::deque<std::function<void()>> jobs_;
+  bool stop_;
+  std::vector<std::thread> threads_;
+};
+
+DeviceGroup::Impl::Impl(std::size_t threads)
+    : mutex_{}, cv_{}, jobs_{}, stop_{false}, threads_{} {
+  threads_.reserve(threads);
+  for (std::size_t i = 0; i < threads; ++i) {
+    threads_.emplace_back([this] { Worker(); });
+  }
+}
+
+DeviceGroup::Impl::~Impl() {
+  {
+    std::lock_guard lock{mutex_};
+    stop_ = true;
+  }
+  cv_.notify_all();
+  for (auto& t : threads_) {
+    t.join();
+  }
+}
+
+void DeviceGroup::Impl::Run(std::size_t count,
+                            const std::function<void(std::size_t)>& task) {
+  if (count == 0) {
+    return;
+  }
+
+  // the calling thread takes part, so it needs one fewer helper
+  const auto helpers = std::min(threads_.size(), count - 1);
+
+  std::atomic<std::size_t> next{0};
+  const auto drain = [&] {
+    for (auto i = next++; i < count; i = next++) {
+      task(i);
+    }
+  };
+
+  std::latch done{static_cast<std::ptrdiff_t>(helpers)};
+  {
+    std::lock_guard lock{mutex_};
+    for (std::size_t i = 0; i < helpers; ++i) {
+      jobs_.emplace_back([&] {
+        drain();
+        done.count_down();
+      });
+    }
+  }
+  cv_.notify_all();
+
+  drain();
+  done.wait();
+}
+
+void DeviceGroup::Impl::Worker() {
+  for (;;) {
+    std::function<void()> job;
+    {
+      std::unique_lock lock{mutex_};
+      cv_.wait(lock, [this] { return stop_ || !jobs_.empty(); });
+      if (stop_ && jobs_.empty()) {
+        return;
+      }
+      job = std::move(jobs_.front());
+      jobs_.pop_front();
+    }
+    job();
+  }
+}
+
+DeviceGroup::DeviceGroup(std::vector<ScpiClient> clients,
+                         std::size_t max_threads)
+    : clients_{std::move(clients)}, broadcast_{}, impl_{} {
+  // one device per thread, counting the calling thread
+  auto threads = clients_.empty() ? 0 : clients_.size() - 1;
+  if (max_threads > 0) {
+    threads = std::min(threads, max_threads - 1);
+  }
+  impl_ = std::make_unique<Impl>(threads);
+}
+
+DeviceGroup::DeviceGroup(DeviceGroup&& other) noexcept = default;
+
+DeviceGroup& DeviceGroup::operator=(DeviceGroup&& rhs) noexcept = default;
+
+DeviceGroup::~DeviceGroup() = default;
+
+std::size_t DeviceGroup::Size() const noexcept { return clients_.size(); }
+
+ScpiClient& DeviceGroup::operator[](std::size_t index) noexcept {
+  return clients_[index];
+}
+
+const ScpiClient& DeviceGroup::operator[](std::size_t index) const noexcept {
+  return clients_[index];
+}
+
+void DeviceGroup::SetBroadcastDriver(
+    std::shared_ptr<drivers::CommDriver> driver) noexcept {
+  broadcast_.SetDriver(std::move(driver));
+}
+
+std::shared_ptr<const drivers::CommDriver> DeviceGroup::GetBroadcastDriver()
+    const noexcept {
+  return broadcast_.GetDriver();
+}
+
+void DeviceGroup::Run(const std::function<void(std::size_t)>& task) const {
+  if (impl_) {
+    impl_->Run(clients_.size(), task);
+  }
+}
+
+std::vector<ErrorCode> DeviceGroup::Broadcast(
+    const std::function<ErrorCode(const ScpiClient&)>& set) const {
+  if (!broadcast_.GetDriver()) {
+    return ForEach(set);
+  }
+
+  return std::vector<ErrorCode>(clients_.size(), set(broadcast_));
+}
+
+std::vector<Result<DeviceInfo>> DeviceGroup::GetDeviceInfo() const {
+  return ForEach([](const ScpiClient& c) { return c.GetDeviceInfo(); });
+}
+
+std::vector<Result<std::uint32_t>> DeviceGroup::GetAlarms() const {
+  return ForEach([](const ScpiClient& c) { return c.GetAlarms(); });
+}
+
+std::vector<ErrorCode> DeviceGroup::EnableCellsMasked(unsigned int cells,
+                                                      bool en) const {
+  return Broadcast(
+      [=](const ScpiClient& c) { return c.EnableCellsMasked(cells, en); });
+}
+
+std::vector<ErrorCode> DeviceGroup::SetAllCellVoltages(float voltage) const {
+  return Broadcast(
+      [=](const ScpiClient& c) { return c.SetAllCellVoltages(voltage); });
+}
+
+std::vector<ErrorCode> DeviceGroup::SetAllCellVoltages(
+    std::span<const float> voltages) const {
+  return Broadcast(
+      [=](const ScpiClient& c) { return c.SetAllCellVoltages(voltages); });
+}
+
+std::vector<ErrorCode> DeviceGroup::SetAllCellSourcing(float limit) const {
+  return Broadcast(
+      [=](const ScpiClient& c) { return c.SetAllCellSourcing(limit); });
+}
+
+std::vector<ErrorCode> DeviceGroup::SetAllCellSinking(float limit) const {
+  return Broadcast(
+      [=](const ScpiClient& c) { return c.SetAllCellSinking(limit); });
+}
+
+std::vector<Result<std::array<float, kCellCount>>>
+DeviceGroup::MeasureAllCellVoltages() const {
+  return ForEach(
+      [](const ScpiClient& c) { return c.MeasureAllCellVoltages(); });
+}
+
+std::vector<Result<std::array<float, kCellCount>>>
+DeviceGroup::MeasureAllCellCurrents() const {
+  return ForEach(
+      [](const ScpiClient& c) { return c.MeasureAllCellCurrents(); });
+}
+
+std::vector<ErrorCode> DeviceGroup::SetAllGlobalModelInputs(float value) const {
+  return Broadcast(
+      [=](const ScpiClient& c) { return c.SetAllGlobalModelInputs(value); });
+}
+
+std::vector<ErrorCode> DeviceGroup::SetAllGlobalModelInputs(
+    std::span<const float> values) const {
+  return Broadcast(
+      [=](const ScpiClient& c) { return c.SetAllGlobalModelInputs(values); });
+}
+
+std::vector<ErrorCode> DeviceGroup::ExchangeModelIO(
+    std::span<const ModelExchange> exchanges) const {
+  if (exchanges.size() != clients_.size()) {
+    return std::vector<ErrorCode>(clients_.size(), ErrorCode::kInvalidArgument);
+  }
+
+  std::vector<ErrorCode> results(clients_.size());
+  Run([&](std::size_t i) {
+    const auto& io = exchanges[i];
+    results[i] = clients_[i].ExchangeModelIO(io.global_inputs,
+                                             io.local_inputs, io.outputs);
+  });
+  return results;
+}
+
+std::vector<Result<MeasurementSnapshot>> DeviceGroup::MeasureSnapshot() const {
+  return ForEach([](const ScpiClient& c) { return c.MeasureSnapshot(); });
+}
+
+}  // namespace bci::abs
@@ -10,9 +10,17 @@
 #include <bci/abs/SerialDriver.h>
 #include <bci/abs/UdpMulticastDriver.h>
 
+#include <algorithm>
 #include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <mutex>
 #include <string>
 #include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
 
 #include "ScpiUtil.h"
 #include "Util.h"
@@ -22,72 +30,252 @@ namespace bci::abs {
 using ec = ErrorCode;
 using util::Err;
 
-Result<EthernetDeviceList> MulticastDiscovery(std::string_view interface_ip) {
-  EthernetDeviceList devices;
+namespace {
+
+using Clock = std::chrono::steady_clock;
 
+// Adaptive timeouts are this many times the response time of the first reply,
+// measured once.
+constexpr unsigned int kTimeoutScale = 4;
+
+// Floor for adaptive timeouts, allowing for units on the network which reply
+// later than the first.
+constexpr unsigned int kMinMulticastTimeoutMs = 20;
+
+unsigned int AdaptiveTimeout(Clock::duration response_time,
+                             unsigned int min_ms, unsigned int max_ms) {
+  using std::chrono::milliseconds;
+  const auto ms = std::chrono::ceil<milliseconds>(response_time).count();
+  const auto scaled = static_cast<unsigned int>(ms) * kTimeoutScale;
+  return std::min(std::max(scaled, min_ms), max_ms);
+}
+
+// Get the serial number from an identification response.
+Result<std::string> ParseSerial(std::string_view idn_resp) {
+  std::array<std::string_view, 4> idn;
+  if (scpi::SplitRespMnemonics(idn_resp, idn) != ec::kSuccess) {
+    return Err(ec::kInvalidResponse);
+  }
+  return std::string(idn[2]);
+}
+
+template <class Found>
+ErrorCode ScanMulticast(std::string_view interface_ip, unsigned int timeout_ms,
+                        bool adaptive, std::size_t receive_buffer_size,
+                        const std::atomic<bool>& stop, Found&& found) {
   drivers::UdpMcastDriver driver;
 
-  ec ret = driver.Open(interface_ip);
+  ec ret = driver.SetReceiveBufferSize(receive_buffer_size);
   if (ret != ec::kSuccess) {
-    return Err(ret);
+    return ret;
   }
 
+  ret = driver.Open(interface_ip);
+  if (ret != ec::kSuccess) {
+    return ret;
+  }
+
+  const auto start = Clock::now();
   ret = driver.Write("*IDN?\r\n", 100);
   if (ret != ec::kSuccess) {
-    return Err(ret);
+    return ret;
   }
 
-  bool done = false;
-  while (!done) {
-    if (auto resp = driver.ReadLineFrom(100)) {
-      std::array<std::string_view, 4> idn;
-      if (scpi::SplitRespMnemonics(resp->data, idn) != ErrorCode::kSuccess) {
-        return Err(ErrorCode::kInvalidResponse);
+  // units reply at about the same time, so if allowed, once the first has
+  // replied there is no need to wait out the full timeout after the last
+  unsigned int wait_ms = timeout_ms;
+  bool first = adaptive;
+  while (!stop) {
+    auto batch = driver.ReadBatchFrom(wait_ms);
+    if (!batch) {
+      return batch.error() == ec::kReadTimedOut ? ec::kSuccess : batch.error();
+    }
+
+    if (first) {
+      wait_ms = AdaptiveTimeout(Clock::now() - start, kMinMulticastTimeoutMs,
+                                timeout_ms);
+      first = false;
+    }
+
+    for (const auto& resp : *batch) {
+      auto serial = ParseSerial(resp.data);
+      if (!serial) {
+        return serial.error();
       }
-      devices.emplace_back(resp->ip, std::string(idn[2]));
-    } else {
-      done = true;
+      found(EthernetDevice{std::string(resp.ip), std::move(*serial)});
+    }
+  }
+
+  return ec::kSuccess;
+}
+
+template <class Found>
+ErrorCode ScanSerial(const std::string& port, std::uint8_t first_id,
+                     std::uint8_t last_id, unsigned int timeout_ms,
+                     const std::atomic<bool>& stop, Found&& found) {
+  drivers::SerialDriver driver;
+
+  ec ret = driver.Open(port);
+  if (ret != ec::kSuccess) {
+    return ret;
+  }
+
+  // a response doesn't say which ID sent it, so each ID gets the full timeout
+  // lest a slow unit's reply be credited to the next ID, and anything late
+  // from the previous ID is discarded before each query
+  for (unsigned int id = first_id; id <= last_id && !stop; ++id) {
+    ret = driver.DiscardInput();
+    if (ret != ec::kSuccess) {
+      return ret;
+    }
+
+    driver.SetDeviceID(id);
+    ret = driver.Write("*IDN?\r\n", 100);
+    if (ret != ec::kSuccess) {
+      return ret;
+    }
+
+    auto resp = driver.ReadLine(timeout_ms);
+    if (!resp) {
       if (resp.error() != ec::kReadTimedOut) {
-        return Err(resp.error());
+        return resp.error();
       }
+      continue;
     }
+
+    auto serial = ParseSerial(*resp);
+    if (!serial) {
+      return serial.error();
+    }
+    found(SerialDevice{static_cast<std::uint8_t>(id), std::move(*serial)});
   }
 
-  return devices;
+  return ec::kSuccess;
 }
 
-Result<SerialDeviceList> SerialDiscovery(std::string_view port,
-                                         std::uint8_t first_id,
-                                         std::uint8_t last_id) {
-  SerialDeviceList devices;
+// State shared by the scans of one Discover() call.
+class DiscoveryState {
+ public:
+  explicit DiscoveryState(unsigned int max_devices) noexcept
+      : max_devices_{max_devices}, count_{}, error_{ec::kSuccess}, stop_{} {}
+
+  const std::atomic<bool>& Stopped() const noexcept { return stop_; }
 
-  if (last_id < first_id) {
-    return Err(ec::kInvalidArgument);
+  // Report a device to its callback, unless the scan has already stopped.
+  template <class Callback, class... Args>
+  void Found(const Callback& callback, Args&&... args) {
+    std::lock_guard lock{mutex_};
+    if (stop_) {
+      return;
+    }
+    if (callback) {
+      callback(std::forward<Args>(args)...);
+    }
+    if (max_devices_ != 0 && ++count_ >= max_devices_) {
+      stop_ = true;
+    }
   }
 
-  drivers::SerialDriver driver;
+  void Finished(ErrorCode error) {
+    std::lock_guard lock{mutex_};
+    if (error_ == ec::kSuccess) {
+      error_ = error;
+    }
+  }
+
+  ErrorCode Error() const {
+    std::lock_guard lock{mutex_};
+    return error_;
+  }
+
+ private:
+  unsigned int max_devices_;
+  unsigned int count_;
+  ErrorCode error_;
+  std::atomic<bool> stop_;
+  mutable std::mutex mutex_;
+};
+
+}  // namespace
+
+ErrorCode Discover(const DiscoveryOptions& options,
+                   const EthernetDiscoveryCallback& on_ethernet,
+                   const SerialDiscoveryCallback& on_serial) {
+  if (!options.serial_ports.empty() && options.last_id < options.first_id) {
+    return ec::kInvalidArgument;
+  }
+
+  DiscoveryState state{options.max_devices};
+
+  std::vector<std::function<void()>> scans;
+  scans.reserve(options.interfaces.size() + options.serial_ports.size());
+  for (const auto& iface : options.interfaces) {
+    scans.emplace_back([&] {
+      state.Finished(ScanMulticast(
+          iface, options.multicast_timeout_ms,
+          options.adaptive_multicast_timeout,
+          options.multicast_receive_buffer_size, state.Stopped(),
+          [&](const EthernetDevice& dev) { state.Found(on_ethernet, dev); }));
+    });
+  }
+  for (const auto& port : options.serial_ports) {
+    scans.emplace_back([&] {
+      state.Finished(ScanSerial(port, options.first_id, options.last_id,
+                                options.serial_timeout_ms, state.Stopped(),
+                                [&](const SerialDevice& dev) {
+                                  state.Found(on_serial, port, dev);
+                                }));
+    });
+  }
+
+  if (scans.size() == 1) {
+    scans.front()();
+    return state.Error();
+  }
+
+  std::vector<std::thread> threads;
+  threads.reserve(scans.size());
+  for (auto& scan : scans) {
+    threads.emplace_back(std::move(scan));
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
 
-  ec ret = driver.Open(std::string(port));
+  return state.Error();
+}
+
+Result<EthernetDeviceList> MulticastDiscovery(std::string_view interface_ip) {
+  EthernetDeviceList devices;
+
+  DiscoveryOptions options;
+  options.interfaces.emplace_back(interface_ip);
+
+  const ec ret = Discover(
+      options, [&](const EthernetDevice& dev) { devices.push_back(dev); }, {});
   if (ret != ec::kSuccess) {
     return Err(ret);
   }
 
-  int total = last_id - first_id + 1;
+  return devices;
+}
 
-  for (int i = 0; i < total; ++i) {
-    driver.SetDeviceID(first_id + i);
-    ret = driver.Write("*IDN?\r\n", 100);
-    if (auto resp = driver.ReadLine(50)) {
-      std::array<std::string_view, 4> idn;
-      if (scpi::SplitRespMnemonics(*resp, idn) != ErrorCode::kSuccess) {
-        return Err(ErrorCode::kInvalidResponse);
-      }
-      devices.emplace_back(first_id + i, std::string(idn[2]));
-    } else {
-      if (resp.error() != ec::kReadTimedOut) {
-        return Err(resp.error());
-      }
-    }
+Result<SerialDeviceList> SerialDiscovery(std::string_view port,
+                                         std::uint8_t first_id,
+                                         std::uint8_t last_id) {
+  SerialDeviceList devices;
+
+  DiscoveryOptions options;
+  options.serial_ports.emplace_back(port);
+  options.first_id = first_id;
+  options.last_id = last_id;
+
+  const ec ret = Discover(options, {},
+                          [&](const std::string&, const SerialDevice& dev) {
+                            devices.push_back(dev);
+                          });
+  if (ret != ec::kSuccess) {
+    return Err(ret);
   }
 
   return devices;
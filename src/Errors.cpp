@@ -61,6 +61,12 @@ const char* ErrorMessage(ErrorCode ec) noexcept {
       return "Allocation failed";
     case ErrorCode::kUnexpectedException:
       return "Unexpected exception";
+    case ErrorCode::kFileError:
+      return "Failed to create or open file";
+    case ErrorCode::kInvalidFile:
+      return "Invalid file format";
+    case ErrorCode::kResponseTooLong:
+      return "Response too long";
   }
 
   return "Unknown error";
@@ -0,0 +1,148 @@
+/*
+ * Copyright (c) 2024, Bloomy Controls, Inc. All rights reserved.
+ *
+ * Use of this source code is governed by a BSD-3-clause license that can be
+ * found in the LICENSE file or at https://opensource.org/license/BSD-3-Clause
+ */
+
+#ifndef ABS_SCPI_DRIVER_SRC_INSTRUMENTUTIL_H
+#define ABS_SCPI_DRIVER_SRC_INSTRUMENTUTIL_H
+
+#include <bci/abs/CommonTypes.h>
+#include <bci/abs/Instrumentation.h>
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <string_view>
+
+namespace bci::abs::instr {
+
+using Clock = std::chrono::steady_clock;
+
+/// Storage for a command mnemonic. Longer mnemonics are truncated.
+using MnemonicBuffer = std::array<char, 64>;
+
+inline std::chrono::nanoseconds Since(Clock::time_point start) noexcept {
+  return Clock::now() - start;
+}
+
+/**
+ * @brief Reduce a command to its mnemonic by dropping parameters, numeric
+ * suffixes, leading colons, and the terminator, keeping the ';' between the
+ * elements of a compound command.
+ *
+ * @param[in] command command as sent to the device
+ * @param[out] buf buffer to hold the mnemonic
+ *
+ * @return A view of the mnemonic within @a buf.
+ */
+constexpr std::string_view CommandMnemonic(std::string_view command,
+                                           MnemonicBuffer& buf) noexcept {
+  std::size_t len = 0;
+  bool in_header = true;
+  bool in_quotes = false;
+  bool element_start = true;
+  for (char c : command) {
+    if (len == buf.size() || c == '\r' || c == '\n') {
+      break;
+    }
+
+    if (in_quotes) {
+      in_quotes = c != '"';
+    } else if (c == '"') {
+      in_quotes = true;
+    } else if (c == ';') {
+      buf[len++] = ';';
+      in_header = true;
+      element_start = true;
+    } else if (in_header) {
+      if (c == ' ') {
+        in_header = false;
+      } else if (!(element_start && c == ':') && !(c >= '0' && c <= '9')) {
+        buf[len++] = c;
+        element_start = false;
+      }
+    }
+  }
+  return {buf.data(), len};
+}
+
+/**
+ * @brief Report a client transaction to a sink.
+ *
+ * @param[in] sink instrumentation sink
+ * @param[in] command command sent
+ * @param[in] bytes_received length of the response, if any
+ * @param[in] write_time time spent writing the command
+ * @param[in] read_time time spent waiting for the response
+ * @param[in] error result of the transaction
+ */
+inline void ReportCall(InstrumentationSink& sink, std::string_view command,
+                       std::size_t bytes_received,
+                       std::chrono::nanoseconds write_time,
+                       std::chrono::nanoseconds read_time,
+                       ErrorCode error) noexcept {
+  MnemonicBuffer buf;
+  sink.Record({CallSource::kClient, CommandMnemonic(command, buf),
+               command.size(), bytes_received, write_time, read_time, error,
+               0});
+}
+
+/**
+ * @brief Perform a driver write and report it to a sink, if there is one.
+ *
+ * @param[in] sink instrumentation sink, may be null
+ * @param[in] data data being written
+ * @param[in] write function performing the write and returning an ErrorCode
+ *
+ * @return The result of the write.
+ */
+template <class F>
+ErrorCode ReportWrite(InstrumentationSink* sink, std::string_view data,
+                      F&& write) {
+  if (!sink) {
+    return write();
+  }
+
+  const auto start = Clock::now();
+  const auto res = write();
+  const auto elapsed = Since(start);
+
+  MnemonicBuffer buf;
+  sink->Record({CallSource::kDriver, CommandMnemonic(data, buf), data.size(),
+                0, elapsed, {}, res, 0});
+  return res;
+}
+
+/**
+ * @brief Perform a driver read and report it to a sink, if there is one.
+ *
+ * @param[in] sink instrumentation sink, may be null
+ * @param[in] read function performing the read and returning a Result holding
+ * the line read
+ * @param[in] retries if not null, the number of retries made by the read,
+ * read once it returns
+ *
+ * @return The result of the read.
+ */
+template <class F>
+auto ReportRead(InstrumentationSink* sink, F&& read,
+                const unsigned int* retries = nullptr) {
+  if (!sink) {
+    return read();
+  }
+
+  const auto start = Clock::now();
+  auto res = read();
+  const auto elapsed = Since(start);
+
+  sink->Record({CallSource::kDriver, {}, 0, res ? res->size() : 0, {}, elapsed,
+                res ? ErrorCode::kSuccess : res.error(),
+                retries ? *retries : 0});
+  return res;
+}
+
+}  // namespace bci::abs::instr
+
+#endif /* ABS_SCPI_DRIVER_SRC_INSTRUMENTUTIL_H */
@@ -0,0 +1,267 @@
+/*
+ * Copyright (c) 2024, Bloomy Controls, Inc. All rights reserved.
+ *
+ * Use of this source code is governed by a BSD-3-clause license that can be
+ * found in the LICENSE file or at https://opensource.org/license/BSD-3-Clause
+ */
+
+#include <bci/abs/Instrumentation.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "Util.h"
+
+namespace bci::abs {
+
+using util::Err;
+using ec = ErrorCode;
+
+namespace {
+
+// Latencies are bucketed log-linearly: each power of two is split into
+// 2^kSubBits buckets, and values below 2^kSubBits ns get one bucket each.
+constexpr unsigned int kSubBits = 3;
+constexpr unsigned int kSubCount = 1U << kSubBits;
+
+// Latencies of 2^kMaxBits ns (about 68 seconds) and up share the last bucket.
+constexpr unsigned int kMaxBits = 36;
+constexpr std::size_t kBucketCount = (kMaxBits - kSubBits + 2) * kSubCount;
+
+constexpr std::size_t kSlotCount = 128;
+constexpr std::size_t kMaxNameLen = 64;
+
+constexpr std::size_t BucketIndex(std::uint64_t ns) noexcept {
+  if (ns < kSubCount) {
+    return static_cast<std::size_t>(ns);
+  }
+  const unsigned int msb = std::bit_width(ns) - 1;
+  if (msb > kMaxBits) {
+    return kBucketCount - 1;
+  }
+  const auto shift = msb - kSubBits;
+  return (msb - kSubBits + 1) * kSubCount + ((ns >> shift) & (kSubCount - 1));
+}
+
+// Largest latency which falls in a bucket.
+constexpr std::uint64_t BucketUpperBound(std::size_t index) noexcept {
+  if (index < kSubCount) {
+    return index;
+  }
+  const auto shift = index / kSubCount - 1;
+  const auto sub = index % kSubCount;
+  return ((kSubCount + sub + 1) << shift) - 1;
+}
+
+static_assert(BucketIndex(7) == 7);
+static_assert(BucketIndex(8) == 8);
+static_assert(BucketIndex(15) == 15);
+static_assert(BucketIndex(16) == 16);
+static_assert(BucketUpperBound(BucketIndex(1000)) >= 1000);
+static_assert(BucketIndex((std::uint64_t{1} << (kMaxBits + 1)) - 1) ==
+              kBucketCount - 1);
+
+// FNV-1a, never returning 0 so that 0 can mark an empty slot.
+constexpr std::uint64_t HashName(std::string_view name) noexcept {
+  std::uint64_t hash = 14695981039346656037ULL;
+  for (char c : name) {
+    hash ^= static_cast<unsigned char>(c);
+    hash *= 1099511628211ULL;
+  }
+  return hash ? hash : 1;
+}
+
+bool IsTimeout(ErrorCode error) noexcept {
+  return error == ec::kReadTimedOut || error == ec::kSendTimedOut ||
+         error == ec::kConnectionTimedOut;
+}
+
+// Statistics for a single command. Commands are identified by the hash of
+// their mnemonic alone, so recording never has to wait for the name to be
+// stored.
+struct Slot {
+  std::atomic<std::uint64_t> hash{0};
+  std::atomic<bool> named{false};
+  std::array<char, kMaxNameLen> name{};
+  std::size_t name_len{0};
+  std::atomic<std::uint64_t> count{0};
+  std::atomic<std::uint64_t> errors{0};
+  std::atomic<std::uint64_t> timeouts{0};
+  std::atomic<std::uint64_t> max{0};
+  std::array<std::atomic<std::uint64_t>, kBucketCount> buckets{};
+
+  LatencyStats Stats() const noexcept;
+
+  void Reset() noexcept;
+};
+
+LatencyStats Slot::Stats() const noexcept {
+  std::array<std::uint64_t, kBucketCount> snapshot;
+  std::uint64_t total = 0;
+  for (std::size_t i = 0; i < kBucketCount; ++i) {
+    snapshot[i] = buckets[i].load(std::memory_order_relaxed);
+    total += snapshot[i];
+  }
+
+  LatencyStats stats{};
+  stats.count = count.load(std::memory_order_relaxed);
+  stats.errors = errors.load(std::memory_order_relaxed);
+  stats.timeouts = timeouts.load(std::memory_order_relaxed);
+  const auto max_ns = max.load(std::memory_order_relaxed);
+  stats.max = std::chrono::nanoseconds(max_ns);
+
+  // take the bucket containing the sample at each rank, reporting the bucket's
+  // upper bound but never more than the maximum seen
+  const auto percentile = [&](std::uint64_t num, std::uint64_t den) {
+    const auto rank = std::max<std::uint64_t>((total * num + den - 1) / den, 1);
+    std::uint64_t seen = 0;
+    for (std::size_t i = 0; i < kBucketCount; ++i) {
+      seen += snapshot[i];
+      if (seen >= rank) {
+        return std::chrono::nanoseconds(
+            std::min(BucketUpperBound(i), max_ns));
+      }
+    }
+    return std::chrono::nanoseconds(max_ns);
+  };
+
+  if (total > 0) {
+    stats.p50 = percentile(50, 100);
+    stats.p99 = percentile(99, 100);
+  }
+
+  return stats;
+}
+
+void Slot::Reset() noexcept {
+  count.store(0, std::memory_order_relaxed);
+  errors.store(0, std::memory_order_relaxed);
+  timeouts.store(0, std::memory_order_relaxed);
+  max.store(0, std::memory_order_relaxed);
+  for (auto& b : buckets) {
+    b.store(0, std::memory_order_relaxed);
+  }
+}
+
+}  // namespace
+
+// Open-addressed table of slots. Slots are claimed with a compare-exchange on
+// their hash and are never released.
+struct LatencyHistogram::Impl {
+  // Find the slot for a command, claiming an empty one if needed. Returns
+  // nullptr if the table is full.
+  Slot* Claim(std::string_view name) noexcept;
+
+  // Find the slot for a command which has already been recorded.
+  const Slot* Find(std::string_view name) const noexcept;
+
+  std::array<Slot, kSlotCount> slots;
+};
+
+Slot* LatencyHistogram::Impl::Claim(std::string_view name) noexcept {
+  name = name.substr(0, kMaxNameLen);
+  const auto hash = HashName(name);
+  for (std::size_t i = 0; i < kSlotCount; ++i) {
+    auto& slot = slots[(hash + i) % kSlotCount];
+    auto current = slot.hash.load(std::memory_order_acquire);
+    if (current == 0 &&
+        slot.hash.compare_exchange_strong(current, hash,
+                                          std::memory_order_acq_rel)) {
+      std::ranges::copy(name, slot.name.begin());
+      slot.name_len = name.size();
+      slot.named.store(true, std::memory_order_release);
+      return &slot;
+    }
+    if (current == hash) {
+      return &slot;
+    }
+  }
+  return nullptr;
+}
+
+const Slot* LatencyHistogram::Impl::Find(
+    std::string_view name) const noexcept {
+  name = name.substr(0, kMaxNameLen);
+  const auto hash = HashName(name);
+  for (std::size_t i = 0; i < kSlotCount; ++i) {
+    const auto& slot = slots[(hash + i) % kSlotCount];
+    const auto current = slot.hash.load(std::memory_order_acquire);
+    if (current == hash) {
+      return &slot;
+    }
+    if (current == 0) {
+      break;
+    }
+  }
+  return nullptr;
+}
+
+LatencyHistogram::LatencyHistogram() : impl_{std::make_unique<Impl>()} {}
+
+LatencyHistogram::~LatencyHistogram() = default;
+
+void LatencyHistogram::Record(const CallEvent& event) noexcept {
+  if (event.source != CallSource::kClient) {
+    return;
+  }
+
+  auto* slot = impl_->Claim(event.command);
+  if (!slot) {
+    return;
+  }
+
+  const auto total = event.write_time + event.read_time;
+  const auto ns =
+      static_cast<std::uint64_t>(std::max<std::int64_t>(total.count(), 0));
+
+  slot->count.fetch_add(1, std::memory_order_relaxed);
+  if (event.error != ec::kSuccess) {
+    slot->errors.fetch_add(1, std::memory_order_relaxed);
+  }
+  if (IsTimeout(event.error)) {
+    slot->timeouts.fetch_add(1, std::memory_order_relaxed);
+  }
+  slot->buckets[BucketIndex(ns)].fetch_add(1, std::memory_order_relaxed);
+
+  auto max = slot->max.load(std::memory_order_relaxed);
+  while (ns > max && !slot->max.compare_exchange_weak(
+                         max, ns, std::memory_order_relaxed)) {
+  }
+}
+
+Result<LatencyStats> LatencyHistogram::Stats(std::string_view command) const {
+  if (const auto* slot = impl_->Find(command)) {
+    return slot->Stats();
+  }
+  return Err(ec::kInvalidArgument);
+}
+
+std::vector<std::pair<std::string, LatencyStats>> LatencyHistogram::AllStats()
+    const {
+  std::vector<std::pair<std::string, LatencyStats>> stats;
+  for (const auto& slot : impl_->slots) {
+    if (slot.named.load(std::memory_order_acquire)) {
+      stats.emplace_back(std::string(slot.name.data(), slot.name_len),
+                         slot.Stats());
+    }
+  }
+  return stats;
+}
+
+void LatencyHistogram::Reset() noexcept {
+  for (auto& slot : impl_->slots) {
+    slot.Reset();
+  }
+}
+
+}  // namespace bci::abs
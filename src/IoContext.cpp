@@ -0,0 +1,73 @@
+/*
+ * Copyright (c) 2024, Bloomy Controls, Inc. All rights reserved.
+ *
+ * Use of this source code is governed by a BSD-3-clause license that can be
+ * found in the LICENSE file or at https://opensource.org/license/BSD-3-Clause
+ */
+
+#include <bci/abs/IoContext.h>
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "IoContextImpl.h"
+
+namespace bci::abs {
+
+IoContext::IoContext() : IoContext(0) {}
+
+IoContext::IoContext(std::size_t threads) : impl_(std::make_unique<Impl>()) {
+  if (threads == 0) {
+    return;
+  }
+
+  impl_->work.emplace(impl_->io_service.get_executor());
+  impl_->threads.reserve(threads);
+  for (std::size_t i = 0; i < threads; ++i) {
+    impl_->threads.emplace_back([this] { impl_->io_service.run(); });
+  }
+}
+
+IoContext::~IoContext() {
+  impl_->work.reset();
+  impl_->io_service.stop();
+  for (auto& t : impl_->threads) {
+    t.join();
+  }
+}
+
+std::size_t IoContext::ThreadCount() const noexcept {
+  return impl_->threads.size();
+}
+
+std::size_t IoContext::Run() { return impl_->io_service.run(); }
+
+std::size_t IoContext::RunOne() { return impl_->io_service.run_one(); }
+
+std::size_t IoContext::Poll() { return impl_->io_service.poll(); }
+
+void IoContext::Stop() {
+  impl_->stop_requested = true;
+  impl_->io_service.stop();
+
+  std::lock_guard lock{impl_->waits_mutex};
+  for (auto* wait : impl_->waits) {
+    wait->Wake();
+  }
+}
+
+bool IoContext::Stopped() const noexcept {
+  return impl_->io_service.stopped();
+}
+
+void IoContext::Restart() {
+  // the workers are gone, so blocking calls would never complete
+  if (impl_->threads.empty()) {
+    impl_->stop_requested = false;
+  }
+  impl_->io_service.restart();
+}
+
+}  // namespace bci::abs
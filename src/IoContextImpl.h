@@ -0,0 +1,184 @@
+/*
+ * Copyright (c) 2024, Bloomy Controls, Inc. All rights reserved.
+ *
+ * Use of this source code is governed by a BSD-3-clause license that can be
+ * found in the LICENSE file or at https://opensource.org/license/BSD-3-Clause
+ */
+
+#ifndef ABS_SCPI_DRIVER_SRC_IOCONTEXTIMPL_H
+#define ABS_SCPI_DRIVER_SRC_IOCONTEXTIMPL_H
+
+#include <bci/abs/IoContext.h>
+
+#include <atomic>
+#include <boost/asio/executor_work_guard.hpp>
+#include <boost/asio/io_service.hpp>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace bci::abs {
+
+struct IoContext::Impl {
+  using WorkGuard =
+      boost::asio::executor_work_guard<boost::asio::io_service::executor_type>;
+
+  boost::asio::io_service io_service;
+
+  // Keeps the workers running while there is no work.
+  std::optional<WorkGuard> work;
+
+  std::vector<std::thread> threads;
+
+  // Set by Stop(), so blocking calls can tell a deliberate stop from running
+  // out of work.
+  std::atomic<bool> stop_requested{false};
+
+  // Blocking calls waiting for the workers, woken by Stop().
+  std::mutex waits_mutex;
+  std::vector<drivers::BlockingWait*> waits;
+};
+
+namespace drivers {
+
+// Lets a blocking call wait for an asynchronous operation it started.
+//
+// Without worker threads, the calling thread runs the io_service until the
+// operation completes, restarting it if it runs out of work, so only one thread
+// may wait at a time. With worker threads, the workers call the operation's
+// handlers, so the calling thread sleeps until signalled instead.
+//
+// If the IoContext is stopped first, the wait is abandoned: Wait() returns
+// false, and the operation's handler, should it ever run, stores nothing. The
+// wait is shared with the handler so that it outlives an abandoned call.
+class BlockingWait {
+ public:
+  // Passed to the operation. Its handler calls it with a function which stores
+  // the results, which only runs if the caller is still waiting.
+  class Done {
+   public:
+    explicit Done(std::shared_ptr<BlockingWait> wait) noexcept
+        : wait_{std::move(wait)} {}
+
+    template <class Store>
+    void operator()(Store&& store) const {
+      wait_->Complete(std::forward<Store>(store));
+    }
+
+   private:
+    std::shared_ptr<BlockingWait> wait_;
+  };
+
+  // context is null for a private io_service, which can't be stopped.
+  BlockingWait(boost::asio::io_service& io_service,
+               IoContext::Impl* context) noexcept
+      : io_service_{io_service},
+        context_{context},
+        threaded_{context && !context->threads.empty()},
+        done_{false},
+        abandoned_{false} {}
+
+  BlockingWait(const BlockingWait&) = delete;
+  BlockingWait& operator=(const BlockingWait&) = delete;
+
+  // Whether the IoContext has been stopped, so no operation should start.
+  bool Stopped() const noexcept {
+    return context_ && context_->stop_requested;
+  }
+
+  // Run f, which starts the operation, unless the wait has been abandoned.
+  template <class F>
+  void Start(F&& f) {
+    std::lock_guard lock{mutex_};
+    if (!abandoned_) {
+      f();
+    }
+  }
+
+  // Store the results with store() and mark the operation complete, unless the
+  // wait has been abandoned.
+  template <class Store>
+  void Complete(Store&& store) {
+    {
+      std::lock_guard lock{mutex_};
+      if (abandoned_) {
+        return;
+      }
+      store();
+      done_ = true;
+    }
+    cv_.notify_one();
+  }
+
+  // Block until the operation completes. Returns false if the IoContext was
+  // stopped first.
+  bool Wait() {
+    if (threaded_) {
+      Register();
+      {
+        std::unique_lock lock{mutex_};
+        cv_.wait(lock, [this] { return done_ || Stopped(); });
+      }
+      Unregister();
+      return Finish();
+    }
+
+    while (!done_) {
+      if (io_service_.stopped()) {
+        // a shared io_service stops whenever it runs out of work, but one
+        // stopped on purpose must stay stopped
+        if (Stopped()) {
+          return Finish();
+        }
+        io_service_.restart();
+      }
+      io_service_.run_one();
+    }
+    return true;
+  }
+
+  // Wake the waiting thread to see that the IoContext has stopped.
+  void Wake() {
+    // the lock keeps the wakeup from landing between the waiter checking the
+    // stop flag and going to sleep
+    std::lock_guard lock{mutex_};
+    cv_.notify_one();
+  }
+
+ private:
+  boost::asio::io_service& io_service_;
+  IoContext::Impl* context_;
+  bool threaded_;
+  // set under mutex_, but polled without it while running the io_service
+  std::atomic<bool> done_;
+  bool abandoned_;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+
+  // Abandon the wait unless the operation completed.
+  bool Finish() {
+    std::lock_guard lock{mutex_};
+    abandoned_ = !done_;
+    return done_;
+  }
+
+  void Register() {
+    std::lock_guard lock{context_->waits_mutex};
+    context_->waits.push_back(this);
+  }
+
+  void Unregister() {
+    std::lock_guard lock{context_->waits_mutex};
+    std::erase(context_->waits, this);
+  }
+};
+
+}  // namespace drivers
+
+}  // namespace bci::abs
+
+#endif /* ABS_SCPI_DRIVER_SRC_IOCONTEXTIMPL_H */
@@ -0,0 +1,43 @@
+/*
+ * Copyright (c) 2024, Bloomy Controls, Inc. All rights reserved.
+ *
+ * Use of this source code is governed by a BSD-3-clause license that can be
+ * found in the LICENSE file or at https://opensource.org/license/BSD-3-Clause
+ */
+
+#ifndef ABS_SCPI_DRIVER_SRC_LIMITS_H
+#define ABS_SCPI_DRIVER_SRC_LIMITS_H
+
+#include <algorithm>
+
+namespace bci::abs::limits {
+
+// Timeout for writing a command, shared by every client.
+inline constexpr unsigned int kWriteTimeoutMs = 10;
+
+inline constexpr float kMaxVoltage = 5.0f;
+inline constexpr float kMaxSourcing = 5.0f;
+inline constexpr float kMaxSinking = 5.0f;
+inline constexpr float kMaxAnalogOutVoltage = 10.0f;
+
+// Clamp setpoints the way they are sent to the unit.
+
+constexpr float ClampVoltage(float v) noexcept {
+  return std::clamp(v, 0.0f, kMaxVoltage);
+}
+
+constexpr float ClampSourcing(float v) noexcept {
+  return std::clamp(v, 0.0f, kMaxSourcing);
+}
+
+constexpr float ClampSinking(float v) noexcept {
+  return std::clamp(v, -kMaxSinking, kMaxSinking);
+}
+
+constexpr float ClampAnalogOut(float v) noexcept {
+  return std::clamp(v, -kMaxAnalogOutVoltage, kMaxAnalogOutVoltage);
+}
+
+}  // namespace bci::abs::limits
+
+#endif /* ABS_SCPI_DRIVER_SRC_LIMITS_H */
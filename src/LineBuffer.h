@@ -0,0 +1,125 @@
+/*
+ * Copyright (c) 2024, Bloomy Controls, Inc. All rights reserved.
+ *
+ * Use of this source code is governed by a BSD-3-clause license that can be
+ * found in the LICENSE file or at https://opensource.org/license/BSD-3-Clause
+ */
+
+#ifndef ABS_SCPI_DRIVER_SRC_LINEBUFFER_H
+#define ABS_SCPI_DRIVER_SRC_LINEBUFFER_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <utility>
+
+#include "ScpiUtil.h"
+
+namespace bci::abs::drivers {
+
+// Growable contiguous receive buffer which frames responses. Data is received
+// directly into the free space at the end of the buffer, and complete
+// responses are handed out as views into it. The buffer never grows past
+// scpi::kMaxResponseSize.
+class LineBuffer {
+ public:
+  explicit LineBuffer(std::size_t capacity = 4096)
+      : buf_{std::make_unique_for_overwrite<char[]>(capacity)},
+        capacity_{capacity},
+        begin_{},
+        end_{},
+        scanned_{} {}
+
+  LineBuffer(const LineBuffer&) = delete;
+  LineBuffer& operator=(const LineBuffer&) = delete;
+
+  // Get free space of at least min_free bytes at the end of the buffer to
+  // receive into, moving unread data to the front or growing if needed. The
+  // space is smaller once the buffer can grow no more, and empty if it's full
+  // of unread data, which can only happen if a response is missing its
+  // terminator.
+  std::span<char> Prepare(std::size_t min_free = 1024) {
+    if (capacity_ - end_ < min_free) {
+      if (begin_ > 0) {
+        std::memmove(buf_.get(), buf_.get() + begin_, end_ - begin_);
+        end_ -= begin_;
+        scanned_ -= begin_;
+        begin_ = 0;
+      }
+
+      if (capacity_ - end_ < min_free) {
+        const auto capacity =
+            std::min(std::max(capacity_ * 2, end_ + min_free),
+                     std::max(capacity_, scpi::kMaxResponseSize));
+        if (capacity > capacity_) {
+          auto buf = std::make_unique_for_overwrite<char[]>(capacity);
+          std::memcpy(buf.get(), buf_.get(), end_);
+          buf_ = std::move(buf);
+          capacity_ = capacity;
+        }
+      }
+    }
+
+    return {buf_.get() + end_, capacity_ - end_};
+  }
+
+  // Mark len bytes of the space returned by Prepare() as received.
+  void Commit(std::size_t len) noexcept { end_ += len; }
+
+  // Find the length of the first complete response, including its newline.
+  //
+  // Every response ends with a newline, so new data is first checked for one
+  // with memchr() and only framed (see scpi::FindResponseEnd()) once there is
+  // one. Data already checked is never searched for a newline again.
+  std::optional<std::size_t> FindLine() noexcept {
+    if (scanned_ == end_) {
+      return std::nullopt;
+    }
+
+    const auto* start = buf_.get() + scanned_;
+    if (!std::memchr(start, '\n', end_ - scanned_)) {
+      scanned_ = end_;
+      return std::nullopt;
+    }
+
+    // a newline inside a binary block does not end the response, but one
+    // which does can only arrive later
+    if (auto len = scpi::FindResponseEnd(Data())) {
+      return len;
+    }
+    scanned_ = end_;
+    return std::nullopt;
+  }
+
+  // Unread data.
+  std::string_view Data() const noexcept {
+    return {buf_.get() + begin_, end_ - begin_};
+  }
+
+  // Discard len bytes of unread data.
+  void Consume(std::size_t len) noexcept {
+    begin_ += std::min(len, end_ - begin_);
+    scanned_ = std::max(scanned_, begin_);
+    if (begin_ == end_) {
+      Clear();
+    }
+  }
+
+  // Discard all unread data.
+  void Clear() noexcept { begin_ = end_ = scanned_ = 0; }
+
+ private:
+  std::unique_ptr<char[]> buf_;
+  std::size_t capacity_;
+  std::size_t begin_;
+  std::size_t end_;
+  std::size_t scanned_;
+};
+
+}  // namespace bci::abs::drivers
+
+#endif /* ABS_SCPI_DRIVER_SRC_LINEBUFFER_H */
@@ -0,0 +1,455 @@
+/*
+ * Copyright (c) 2024, Bloomy Controls, Inc. All rights reserved.
+ *
+ * Use of this source code is governed by a BSD-3-clause license that can be
+ * found in the LICENSE file or at https://opensource.org/license/BSD-3-Clause
+ */
+
+#include <bci/abs/Instrumentation.h>
+#include <bci/abs/ManagedTcpDriver.h>
+#include <bci/abs/TcpDriver.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+
+#include "InstrumentUtil.h"
+#include "ScpiUtil.h"
+#include "Util.h"
+
+namespace bci::abs::drivers {
+
+using util::Err;
+using ec = ErrorCode;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr std::string_view kProbe = "*IDN?\r\n";
+
+// Whether an error leaves the connection unusable, or its stream out of step
+// with the commands sent.
+constexpr bool IsConnectionError(ErrorCode error) noexcept {
+  return error == ec::kSendFailed || error == ec::kSendTimedOut ||
+         error == ec::kReadFailed || error == ec::kReadTimedOut ||
+         error == ec::kNotConnected;
+}
+
+}  // namespace
+
+struct ManagedTcpDriver::Impl {
+  explicit Impl(const ManagedTcpDriver& owner);
+
+  ~Impl();
+
+  ErrorCode Connect(std::string_view ip, unsigned int timeout_ms,
+                    const ManagedTcpOptions& options);
+
+  void Close() noexcept;
+
+  bool IsConnected() const noexcept { return active_ok_; }
+
+  ErrorCode Write(std::string_view data, unsigned int timeout_ms);
+
+  // Perform read(active driver) on the active connection.
+  template <class Read>
+  auto ReadActive(Read&& read) -> decltype(read(std::declval<TcpDriver&>()));
+
+ private:
+  const ManagedTcpDriver& owner_;
+  std::string ip_;
+  ManagedTcpOptions options_;
+  // the owner's sink when Connect() was called, since the background thread
+  // can't read the owner's while the caller may replace it
+  std::shared_ptr<InstrumentationSink> sink_;
+
+  // held by callers and by the background thread while they use the active
+  // connection or replace it, and always taken before mutex_
+  std::mutex io_mutex_;
+  std::unique_ptr<TcpDriver> active_;
+  std::atomic<bool> active_ok_;
+  // queries written on the active connection whose replies haven't been read
+  unsigned int outstanding_replies_;
+  // incremented whenever the active connection is lost, so a read can tell
+  // that its query went out on a connection which is gone
+  std::uint64_t generation_;
+  std::uint64_t write_generation_;
+  Clock::time_point last_activity_;
+  Clock::time_point lost_at_;
+
+  // guards the standby state and stop_; the background thread uses standby_
+  // without the lock while it isn't ready
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::unique_ptr<TcpDriver> standby_;
+  bool standby_ready_;
+  bool stop_;
+  std::thread thread_;
+
+  // Body of the background thread.
+  void Serve();
+
+  // Check the standby and, if idle, the active connection.
+  void Check();
+
+  // Close the active connection after error and swap in the standby if it's
+  // ready. io_mutex_ must be held.
+  void Fail(ErrorCode error);
+
+  // Make the standby the active connection if it's ready. io_mutex_ must be
+  // held.
+  bool Promote();
+
+  // Send the health check query on a connection and wait for its response.
+  ErrorCode Probe(TcpDriver& driver) const;
+
+  // Delay before the next attempt after the given number of failed attempts.
+  std::chrono::milliseconds Backoff(unsigned int failures) const;
+
+  void Report(const ConnectionEvent& event) const;
+};
+
+ManagedTcpDriver::ManagedTcpDriver() : impl_(std::make_unique<Impl>(*this)) {}
+
+ManagedTcpDriver::~ManagedTcpDriver() { Close(); }
+
+ErrorCode ManagedTcpDriver::Connect(std::string_view ip,
+                                    unsigned int timeout_ms) {
+  return impl_->Connect(ip, timeout_ms, ManagedTcpOptions{});
+}
+
+ErrorCode ManagedTcpDriver::Connect(std::string_view ip,
+                                    unsigned int timeout_ms,
+                                    const ManagedTcpOptions& options) {
+  return impl_->Connect(ip, timeout_ms, options);
+}
+
+void ManagedTcpDriver::Close() noexcept { impl_->Close(); }
+
+bool ManagedTcpDriver::IsConnected() const { return impl_->IsConnected(); }
+
+ErrorCode ManagedTcpDriver::Write(std::string_view data,
+                                  unsigned int timeout_ms) const {
+  return instr::ReportWrite(Instrumentation(), data,
+                            [&] { return impl_->Write(data, timeout_ms); });
+}
+
+Result<std::string> ManagedTcpDriver::ReadLine(unsigned int timeout_ms) const {
+  return instr::ReportRead(Instrumentation(), [&] {
+    return impl_->ReadActive(
+        [&](TcpDriver& driver) { return driver.ReadLine(timeout_ms); });
+  });
+}
+
+Result<std::string_view> ManagedTcpDriver::ReadLineInto(
+    std::span<char> buf, unsigned int timeout_ms) const {
+  return instr::ReportRead(Instrumentation(), [&] {
+    return impl_->ReadActive([&](TcpDriver& driver) {
+      return driver.ReadLineInto(buf, timeout_ms);
+    });
+  });
+}
+
+ManagedTcpDriver::Impl::Impl(const ManagedTcpDriver& owner)
+    : owner_{owner},
+      ip_{},
+      options_{},
+      sink_{},
+      io_mutex_{},
+      active_{std::make_unique<TcpDriver>()},
+      active_ok_{false},
+      outstanding_replies_{0},
+      generation_{0},
+      write_generation_{0},
+      last_activity_{},
+      lost_at_{},
+      mutex_{},
+      cv_{},
+      standby_{std::make_unique<TcpDriver>()},
+      standby_ready_{false},
+      stop_{false},
+      thread_{} {}
+
+ManagedTcpDriver::Impl::~Impl() { Close(); }
+
+ErrorCode ManagedTcpDriver::Impl::Connect(std::string_view ip,
+                                          unsigned int timeout_ms,
+                                          const ManagedTcpOptions& options) {
+  Close();
+
+  ip_ = ip;
+  options_ = options;
+  sink_ = owner_.GetInstrumentation();
+
+  const auto ret = active_->Connect(ip_, timeout_ms, options_.socket);
+  if (ret != ec::kSuccess) {
+    return ret;
+  }
+
+  active_ok_ = true;
+  outstanding_replies_ = 0;
+  generation_ = 0;
+  write_generation_ = 0;
+  last_activity_ = Clock::now();
+  standby_ready_ = false;
+  stop_ = false;
+  thread_ = std::thread([this] { Serve(); });
+
+  return ec::kSuccess;
+}
+
+void ManagedTcpDriver::Impl::Close() noexcept {
+  {
+    std::lock_guard lock{mutex_};
+    stop_ = true;
+  }
+  cv_.notify_all();
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+
+  active_->Close();
+  standby_->Close();
+  active_ok_ = false;
+  standby_ready_ = false;
+}
+
+ErrorCode ManagedTcpDriver::Impl::Write(std::string_view data,
+                                        unsigned int timeout_ms) {
+  std::lock_guard lock{io_mutex_};
+  if (!active_ok_ && !Promote()) {
+    return ec::kNotConnected;
+  }
+
+  const auto ret = active_->Write(data, timeout_ms);
+  if (ret != ec::kSuccess) {
+    if (IsConnectionError(ret)) {
+      Fail(ret);
+    }
+    return ret;
+  }
+
+  write_generation_ = generation_;
+  if (scpi::IsQuery(data)) {
+    ++outstanding_replies_;
+  }
+  last_activity_ = Clock::now();
+  return ec::kSuccess;
+}
+
+template <class Read>
+auto ManagedTcpDriver::Impl::ReadActive(Read&& read)
+    -> decltype(read(std::declval<TcpDriver&>())) {
+  std::lock_guard lock{io_mutex_};
+  if (outstanding_replies_ > 0) {
+    --outstanding_replies_;
+  }
+
+  // the response to a query sent on a lost connection will never come
+  if (!active_ok_ || write_generation_ != generation_) {
+    return Err(ec::kNotConnected);
+  }
+
+  auto res = read(*active_);
+  if (!res) {
+    if (IsConnectionError(res.error())) {
+      Fail(res.error());
+    }
+    return res;
+  }
+
+  last_activity_ = Clock::now();
+  return res;
+}
+
+void ManagedTcpDriver::Impl::Serve() {
+  const auto interval = std::chrono::milliseconds(options_.health_interval_ms);
+  auto next_check = Clock::now() + interval;
+  auto next_attempt = Clock::now();
+  unsigned int failures = 0;
+
+  std::unique_lock lock{mutex_};
+  while (!stop_) {
+    // a standby is needed to replace a lost connection even when the options
+    // don't keep one otherwise
+    const bool want_standby =
+        !standby_ready_ && (options_.standby || !active_ok_);
+
+    if (want_standby && Clock::now() >= next_attempt) {
+      lock.unlock();
+      const auto ret =
+          standby_->Connect(ip_, options_.connect_timeout_ms, options_.socket);
+      if (ret == ec::kSuccess) {
+        failures = 0;
+        {
+          std::lock_guard io_lock{io_mutex_};
+          {
+            std::lock_guard state_lock{mutex_};
+            standby_ready_ = true;
+          }
+          if (!active_ok_) {
+            Promote();
+          }
+        }
+      } else {
+        ++failures;
+        Report({ConnectionEventType::kConnectFailed, ret, {}, failures});
+        next_attempt = Clock::now() + Backoff(failures);
+      }
+      lock.lock();
+      continue;
+    }
+
+    if (Clock::now() >= next_check) {
+      lock.unlock();
+      Check();
+      next_check = Clock::now() + interval;
+      lock.lock();
+      continue;
+    }
+
+    cv_.wait_until(lock,
+                   want_standby ? std::min(next_check, next_attempt)
+                                : next_check);
+  }
+}
+
+void ManagedTcpDriver::Impl::Check() {
+  bool probe_standby = false;
+  {
+    // keep the standby from being promoted while it's in use
+    std::lock_guard lock{mutex_};
+    std::swap(probe_standby, standby_ready_);
+  }
+  if (probe_standby) {
+    const bool ok = Probe(*standby_) == ec::kSuccess;
+    if (!ok) {
+      standby_->Close();
+    }
+    std::lock_guard lock{mutex_};
+    standby_ready_ = ok;
+  }
+
+  // a caller holding the lock is using the connection, which is as good a
+  // check as any
+  std::unique_lock io_lock{io_mutex_, std::try_to_lock};
+  if (!io_lock) {
+    return;
+  }
+
+  if (!active_ok_) {
+    Promote();
+    return;
+  }
+
+  // a reply still to be read would be taken as the probe's
+  if (outstanding_replies_ > 0 ||
+      Clock::now() - last_activity_ <
+          std::chrono::milliseconds(options_.health_interval_ms)) {
+    return;
+  }
+
+  // hand calls to the standby, which was just checked, and probe the active
+  // connection without the lock as the next standby
+  std::unique_ptr<TcpDriver> probed;
+  {
+    std::lock_guard lock{mutex_};
+    if (standby_ready_) {
+      probed = std::exchange(active_, std::move(standby_));
+      standby_ready_ = false;
+    }
+  }
+  if (probed) {
+    last_activity_ = Clock::now();
+    io_lock.unlock();
+
+    const bool ok = Probe(*probed) == ec::kSuccess;
+    if (!ok) {
+      probed->Close();
+    }
+    // nothing else touches the standby while it isn't ready
+    std::lock_guard lock{mutex_};
+    standby_ = std::move(probed);
+    standby_ready_ = ok;
+    return;
+  }
+
+  // without a standby, calls wait for the probe
+  const auto ret = Probe(*active_);
+  if (ret != ec::kSuccess) {
+    Fail(ret);
+    return;
+  }
+  last_activity_ = Clock::now();
+}
+
+void ManagedTcpDriver::Impl::Fail(ErrorCode error) {
+  active_->Close();
+  active_ok_ = false;
+  outstanding_replies_ = 0;
+  ++generation_;
+  lost_at_ = Clock::now();
+  Report({ConnectionEventType::kLost, error, {}, 0});
+
+  if (!Promote()) {
+    cv_.notify_all();
+  }
+}
+
+bool ManagedTcpDriver::Impl::Promote() {
+  {
+    std::lock_guard lock{mutex_};
+    if (!standby_ready_) {
+      return false;
+    }
+    std::swap(active_, standby_);
+    standby_ready_ = false;
+  }
+  // the old connection becomes the next standby
+  cv_.notify_all();
+
+  active_ok_ = true;
+  outstanding_replies_ = 0;
+  last_activity_ = Clock::now();
+  Report({ConnectionEventType::kRestored, ec::kSuccess, instr::Since(lost_at_),
+          0});
+  return true;
+}
+
+ErrorCode ManagedTcpDriver::Impl::Probe(TcpDriver& driver) const {
+  const auto ret = driver.Write(kProbe, options_.probe_timeout_ms);
+  if (ret != ec::kSuccess) {
+    return ret;
+  }
+
+  const auto resp = driver.ReadLine(options_.probe_timeout_ms);
+  return resp ? ec::kSuccess : resp.error();
+}
+
+std::chrono::milliseconds ManagedTcpDriver::Impl::Backoff(
+    unsigned int failures) const {
+  const auto shift = std::min(failures - 1, 31U);
+  const auto delay =
+      std::min<std::uint64_t>(std::uint64_t{options_.initial_backoff_ms}
+                                  << shift,
+                              options_.max_backoff_ms);
+  return std::chrono::milliseconds(delay);
+}
+
+void ManagedTcpDriver::Impl::Report(const ConnectionEvent& event) const {
+  if (sink_) {
+    sink_->RecordConnection(event);
+  }
+}
+
+}  // namespace bci::abs::drivers
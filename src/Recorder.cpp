@@ -0,0 +1,375 @@
+/*
+ * Copyright (c) 2024, Bloomy Controls, Inc. All rights reserved.
+ *
+ * Use of this source code is governed by a BSD-3-clause license that can be
+ * found in the LICENSE file or at https://opensource.org/license/BSD-3-Clause
+ */
+
+#include <bci/abs/Recorder.h>
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <atomic>
+#include <boost/interprocess/exceptions.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <new>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "RecordingFormat.h"
+
+namespace bci::abs {
+
+using ec = ErrorCode;
+namespace bip = boost::interprocess;
+namespace rec = recording;
+
+namespace {
+
+std::int64_t ToNanoseconds(std::chrono::system_clock::time_point t) {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             t.time_since_epoch())
+      .count();
+}
+
+// Rows per block for a file of at most max_file_size bytes, or 0 if not even
+// two rows fit.
+std::size_t BlockRows(std::size_t max_file_size) {
+  const auto rows = max_file_size > rec::kHeaderSize
+                        ? (max_file_size - rec::kHeaderSize) / rec::kRowSize
+                        : 0;
+  return std::min(rows, rec::kBlockRows) & ~std::size_t{1};
+}
+
+}  // namespace
+
+struct Recorder::Impl {
+  // The file series of one device.
+  struct Series {
+    unsigned int sequence{0};
+    bip::mapped_region region{};
+    rec::Header* header{};
+    std::int64_t last_timestamp{std::numeric_limits<std::int64_t>::min()};
+  };
+
+  Impl(std::string path_prefix, std::size_t max_file_size,
+       std::size_t max_devices)
+      : prefix{std::move(path_prefix)},
+        block_rows{BlockRows(max_file_size)},
+        blocks{block_rows ? (max_file_size - rec::kHeaderSize) /
+                                rec::BlockSize(block_rows)
+                          : 0},
+        max_devices{max_devices},
+        series{} {}
+
+  // Append a row, with the measurements if there are any.
+  ErrorCode Append(std::size_t device, std::int64_t timestamp, ErrorCode error,
+                   const MeasurementSnapshot* snapshot,
+                   std::span<const float> model_outputs);
+
+  ErrorCode OpenNext(std::size_t device, Series& s);
+
+  std::string prefix;
+  std::size_t block_rows;
+  std::size_t blocks;
+  std::size_t max_devices;
+  std::vector<Series> series;
+};
+
+ErrorCode Recorder::Impl::OpenNext(std::size_t device, Series& s) {
+  s.region = {};
+  s.header = nullptr;
+
+  const auto path = fmt::format("{}.dev{}.{:04}.absrec", prefix, device,
+                                s.sequence++);
+
+  // the file is sized up front, so it is sparse until it fills where the
+  // filesystem supports that; elsewhere, rows are filled in block by block
+  // from the start, so the filesystem never has to zero a large gap
+  if (!std::ofstream(path, std::ios::binary | std::ios::trunc)) {
+    return ec::kFileError;
+  }
+  std::error_code err;
+  std::filesystem::resize_file(path, rec::FileSize(blocks, block_rows), err);
+  if (err) {
+    return ec::kFileError;
+  }
+
+  try {
+    bip::file_mapping mapping(path.c_str(), bip::read_write);
+    s.region = bip::mapped_region(mapping, bip::read_write);
+  } catch (const bip::interprocess_exception&) {
+    return ec::kFileError;
+  }
+
+  s.header = new (s.region.get_address()) rec::Header{};
+  s.header->magic = rec::kMagic;
+  s.header->version = rec::kVersion;
+  s.header->header_size = rec::kHeaderSize;
+  s.header->capacity = blocks * block_rows;
+  s.header->device = device;
+  s.header->cell_count = kCellCount;
+  s.header->analog_input_count = kAnalogInputCount;
+  s.header->model_output_count = kModelOutputCount;
+  s.header->block_rows = static_cast<std::uint32_t>(block_rows);
+  s.last_timestamp = std::numeric_limits<std::int64_t>::min();
+
+  return ec::kSuccess;
+}
+
+ErrorCode Recorder::Impl::Append(std::size_t device, std::int64_t timestamp,
+                                 ErrorCode error,
+                                 const MeasurementSnapshot* snapshot,
+                                 std::span<const float> model_outputs) {
+  if (blocks == 0) {
+    return ec::kInvalidArgument;
+  }
+
+  if (device >= max_devices) {
+    return ec::kInvalidArgument;
+  }
+
+  if (device >= series.size()) {
+    series.resize(device + 1);
+  }
+  auto& s = series[device];
+
+  // readers search by time, so a file's timestamps must never go backwards
+  if (!s.header || s.header->rows == s.header->capacity ||
+      timestamp < s.last_timestamp) {
+    if (const auto ret = OpenNext(device, s); ret != ec::kSuccess) {
+      return ret;
+    }
+  }
+
+  const auto row = s.header->rows;
+
+  auto* base = static_cast<char*>(s.region.get_address());
+  const auto column = [&]<class T>(unsigned int col, T value) {
+    *reinterpret_cast<T*>(base + rec::ValueOffset(col, row, block_rows)) =
+        value;
+  };
+
+  constexpr float kNaN = std::numeric_limits<float>::quiet_NaN();
+
+  column(rec::kTimestamp, timestamp);
+  column(rec::kError, static_cast<std::int32_t>(error));
+  column(rec::kAlarms, snapshot ? snapshot->alarms : std::uint32_t{});
+  column(rec::kDigitalInputs,
+         snapshot ? std::uint32_t{snapshot->digital_inputs} : std::uint32_t{});
+  for (unsigned int i = 0; i < kCellCount; ++i) {
+    column(rec::kCellVoltages + i,
+           snapshot ? snapshot->cell_voltages[i] : kNaN);
+    column(rec::kCellCurrents + i,
+           snapshot ? snapshot->cell_currents[i] : kNaN);
+  }
+  for (unsigned int i = 0; i < kAnalogInputCount; ++i) {
+    column(rec::kAnalogInputs + i,
+           snapshot ? snapshot->analog_inputs[i] : kNaN);
+  }
+  for (unsigned int i = 0; i < kModelOutputCount; ++i) {
+    column(rec::kModelOutputs + i,
+           i < model_outputs.size() ? model_outputs[i] : kNaN);
+  }
+
+  // publish the row to readers only once it is complete
+  std::atomic_ref<std::uint64_t>{s.header->rows}.store(
+      row + 1, std::memory_order_release);
+  s.last_timestamp = timestamp;
+
+  return ec::kSuccess;
+}
+
+Recorder::Recorder(std::string path_prefix, std::size_t max_file_size,
+                   std::size_t max_devices)
+    : impl_{std::make_unique<Impl>(std::move(path_prefix), max_file_size,
+                                   max_devices)} {}
+
+Recorder::Recorder(Recorder&& other) noexcept = default;
+
+Recorder& Recorder::operator=(Recorder&& rhs) noexcept = default;
+
+Recorder::~Recorder() = default;
+
+ErrorCode Recorder::Record(const AcquisitionSample& sample) {
+  const auto* snapshot =
+      sample.error == ec::kSuccess ? &sample.snapshot : nullptr;
+  return impl_->Append(sample.device, ToNanoseconds(sample.timestamp),
+                       sample.error, snapshot, {});
+}
+
+ErrorCode Recorder::Record(std::span<const AcquisitionSample> samples) {
+  for (const auto& sample : samples) {
+    if (const auto ret = Record(sample); ret != ec::kSuccess) {
+      return ret;
+    }
+  }
+  return ec::kSuccess;
+}
+
+ErrorCode Recorder::Record(std::size_t device,
+                           std::chrono::system_clock::time_point timestamp,
+                           const MeasurementSnapshot& snapshot,
+                           std::span<const float> model_outputs) {
+  return impl_->Append(device, ToNanoseconds(timestamp), ec::kSuccess,
+                       &snapshot, model_outputs);
+}
+
+ErrorCode Recorder::Flush() {
+  for (auto& s : impl_->series) {
+    if (s.header && !s.region.flush()) {
+      return ec::kFileError;
+    }
+  }
+  return ec::kSuccess;
+}
+
+void Recorder::Close() noexcept { impl_->series.clear(); }
+
+struct RecordingReader::Impl {
+  bip::mapped_region region{};
+  const rec::Header* header{};
+
+  template <class T>
+  ColumnView<T> Column(unsigned int column) const noexcept {
+    const auto rows = std::atomic_ref<std::uint64_t>{
+        const_cast<std::uint64_t&>(header->rows)}.load(
+        std::memory_order_acquire);
+    const auto block_rows = header->block_rows;
+    return {static_cast<const std::byte*>(region.get_address()) +
+                rec::ValueOffset(column, 0, block_rows),
+            rec::BlockSize(block_rows), block_rows,
+            static_cast<std::size_t>(rows)};
+  }
+};
+
+RecordingReader::RecordingReader() noexcept : impl_{} {}
+
+RecordingReader::RecordingReader(RecordingReader&& other) noexcept = default;
+
+RecordingReader& RecordingReader::operator=(RecordingReader&& rhs) noexcept =
+    default;
+
+RecordingReader::~RecordingReader() = default;
+
+ErrorCode RecordingReader::Open(const std::string& path) {
+  Close();
+
+  auto impl = std::make_unique<Impl>();
+  try {
+    bip::file_mapping mapping(path.c_str(), bip::read_only);
+    impl->region = bip::mapped_region(mapping, bip::read_only);
+  } catch (const bip::interprocess_exception&) {
+    return ec::kFileError;
+  }
+
+  if (impl->region.get_size() < rec::kHeaderSize) {
+    return ec::kInvalidFile;
+  }
+
+  const auto* header =
+      static_cast<const rec::Header*>(impl->region.get_address());
+  if (header->magic != rec::kMagic || header->version != rec::kVersion ||
+      header->header_size != rec::kHeaderSize ||
+      header->cell_count != kCellCount ||
+      header->analog_input_count != kAnalogInputCount ||
+      header->model_output_count != kModelOutputCount ||
+      header->block_rows == 0 ||
+      header->capacity % header->block_rows != 0 ||
+      header->rows > header->capacity ||
+      impl->region.get_size() <
+          rec::FileSize(header->capacity / header->block_rows,
+                        header->block_rows)) {
+    return ec::kInvalidFile;
+  }
+
+  impl->header = header;
+  impl_ = std::move(impl);
+
+  return ec::kSuccess;
+}
+
+void RecordingReader::Close() noexcept { impl_.reset(); }
+
+std::size_t RecordingReader::Size() const noexcept {
+  return Timestamps().size();
+}
+
+std::size_t RecordingReader::Device() const noexcept {
+  return impl_ ? static_cast<std::size_t>(impl_->header->device) : 0;
+}
+
+std::pair<std::size_t, std::size_t> RecordingReader::Find(
+    std::chrono::system_clock::time_point begin,
+    std::chrono::system_clock::time_point end) const noexcept {
+  const auto ts = Timestamps();
+  const auto first = std::ranges::lower_bound(ts, ToNanoseconds(begin));
+  const auto last = std::ranges::lower_bound(first, ts.end(),
+                                             ToNanoseconds(end));
+  return {static_cast<std::size_t>(first - ts.begin()),
+          static_cast<std::size_t>(last - ts.begin())};
+}
+
+ColumnView<std::int64_t> RecordingReader::Timestamps() const noexcept {
+  return impl_ ? impl_->Column<std::int64_t>(rec::kTimestamp)
+               : ColumnView<std::int64_t>{};
+}
+
+ColumnView<std::int32_t> RecordingReader::Errors() const noexcept {
+  return impl_ ? impl_->Column<std::int32_t>(rec::kError)
+               : ColumnView<std::int32_t>{};
+}
+
+ColumnView<std::uint32_t> RecordingReader::Alarms() const noexcept {
+  return impl_ ? impl_->Column<std::uint32_t>(rec::kAlarms)
+               : ColumnView<std::uint32_t>{};
+}
+
+ColumnView<std::uint32_t> RecordingReader::DigitalInputs()
+    const noexcept {
+  return impl_ ? impl_->Column<std::uint32_t>(rec::kDigitalInputs)
+               : ColumnView<std::uint32_t>{};
+}
+
+ColumnView<float> RecordingReader::CellVoltages(
+    unsigned int cell) const noexcept {
+  if (!impl_ || cell >= kCellCount) {
+    return {};
+  }
+  return impl_->Column<float>(rec::kCellVoltages + cell);
+}
+
+ColumnView<float> RecordingReader::CellCurrents(
+    unsigned int cell) const noexcept {
+  if (!impl_ || cell >= kCellCount) {
+    return {};
+  }
+  return impl_->Column<float>(rec::kCellCurrents + cell);
+}
+
+ColumnView<float> RecordingReader::AnalogInputs(
+    unsigned int channel) const noexcept {
+  if (!impl_ || channel >= kAnalogInputCount) {
+    return {};
+  }
+  return impl_->Column<float>(rec::kAnalogInputs + channel);
+}
+
+ColumnView<float> RecordingReader::ModelOutputs(
+    unsigned int index) const noexcept {
+  if (!impl_ || index >= kModelOutputCount) {
+    return {};
+  }
+  return impl_->Column<float>(rec::kModelOutputs + index);
+}
+
+}  // namespace bci::abs
@@ -0,0 +1,101 @@
+/*
+ * Copyright (c) 2024, Bloomy Controls, Inc. All rights reserved.
+ *
+ * Use of this source code is governed by a BSD-3-clause license that can be
+ * found in the LICENSE file or at https://opensource.org/license/BSD-3-Clause
+ */
+
+#ifndef ABS_SCPI_DRIVER_SRC_RECORDINGFORMAT_H
+#define ABS_SCPI_DRIVER_SRC_RECORDINGFORMAT_H
+
+#include <bci/abs/CommonTypes.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// Layout of the files written by Recorder.
+//
+// A file starts with a header padded to kHeaderSize, followed by blocks of
+// `block_rows` rows. Within a block, each value has a column of `block_rows`
+// entries, stored in the order of the Column enum. The file grows a block at a
+// time as rows are added, so writes stay close to its end.
+namespace bci::abs::recording {
+
+inline constexpr std::array<char, 8> kMagic{'A', 'B', 'S', 'R', 'E', 'C', 0, 0};
+inline constexpr std::uint32_t kVersion = 2;
+inline constexpr std::size_t kHeaderSize = 4096;
+
+// Rows per block, unless the maximum file size only allows fewer.
+inline constexpr std::size_t kBlockRows = 4096;
+
+struct Header {
+  std::array<char, 8> magic;
+  std::uint32_t version;
+  std::uint32_t header_size;
+  std::uint64_t capacity;
+  // rows written so far, updated once each row is complete
+  std::uint64_t rows;
+  std::uint64_t device;
+  std::uint32_t cell_count;
+  std::uint32_t analog_input_count;
+  std::uint32_t model_output_count;
+  std::uint32_t block_rows;
+};
+
+static_assert(sizeof(Header) <= kHeaderSize);
+
+enum Column : unsigned int {
+  kTimestamp,
+  kError,
+  kAlarms,
+  kDigitalInputs,
+  kCellVoltages,
+  kCellCurrents = kCellVoltages + kCellCount,
+  kAnalogInputs = kCellCurrents + kCellCount,
+  kModelOutputs = kAnalogInputs + kAnalogInputCount,
+  kColumnCount = kModelOutputs + kModelOutputCount,
+};
+
+// Bytes per row of each column. Only timestamps are wider than 4 bytes.
+constexpr std::size_t ColumnWidth(unsigned int column) noexcept {
+  return column == kTimestamp ? sizeof(std::int64_t) : 4;
+}
+
+inline constexpr std::size_t kRowSize =
+    sizeof(std::int64_t) + 4 * (kColumnCount - 1);
+
+// Offset of a column from the start of a block.
+constexpr std::size_t ColumnOffset(unsigned int column,
+                                   std::size_t block_rows) noexcept {
+  std::size_t offset = 0;
+  for (unsigned int i = 0; i < column; ++i) {
+    offset += ColumnWidth(i) * block_rows;
+  }
+  return offset;
+}
+
+constexpr std::size_t BlockSize(std::size_t block_rows) noexcept {
+  return kRowSize * block_rows;
+}
+
+// Offset of a row's value in a column from the start of the file.
+constexpr std::size_t ValueOffset(unsigned int column, std::size_t row,
+                                  std::size_t block_rows) noexcept {
+  return kHeaderSize + row / block_rows * BlockSize(block_rows) +
+         ColumnOffset(column, block_rows) +
+         row % block_rows * ColumnWidth(column);
+}
+
+constexpr std::size_t FileSize(std::size_t blocks,
+                               std::size_t block_rows) noexcept {
+  return kHeaderSize + blocks * BlockSize(block_rows);
+}
+
+// An even number of rows per block keeps every block's timestamps aligned.
+static_assert(BlockSize(2) % alignof(std::int64_t) == 0);
+static_assert(kBlockRows % 2 == 0);
+
+}  // namespace bci::abs::recording
+
+#endif /* ABS_SCPI_DRIVER_SRC_RECORDINGFORMAT_H */
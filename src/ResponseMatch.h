@@ -0,0 +1,51 @@
+/*
+ * Copyright (c) 2024, Bloomy Controls, Inc. All rights reserved.
+ *
+ * Use of this source code is governed by a BSD-3-clause license that can be
+ * found in the LICENSE file or at https://opensource.org/license/BSD-3-Clause
+ */
+
+#ifndef ABS_SCPI_DRIVER_SRC_RESPONSEMATCH_H
+#define ABS_SCPI_DRIVER_SRC_RESPONSEMATCH_H
+
+#include <boost/asio/read_until.hpp>
+#include <cstddef>
+#include <iterator>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+#include "ScpiUtil.h"
+
+namespace bci::abs::drivers {
+
+// Match condition for boost::asio::read_until() which finds the end of a
+// response. This is normally the first newline, but binary blocks may contain
+// newlines, so these are skipped (see scpi::FindResponseEnd()).
+//
+// Only for use with boost::asio::streambuf, which stores its data contiguously.
+struct ResponseEndMatch {
+  template <class Iterator>
+  std::pair<Iterator, bool> operator()(Iterator begin, Iterator end) const {
+    if (begin == end) {
+      return {begin, false};
+    }
+
+    const std::string_view data(&*begin, std::distance(begin, end));
+    if (auto len = scpi::FindResponseEnd(data)) {
+      return {std::next(begin, static_cast<std::ptrdiff_t>(*len)), true};
+    }
+
+    // keep searching from the start, since the response can only be framed
+    // from its beginning
+    return {begin, false};
+  }
+};
+
+}  // namespace bci::abs::drivers
+
+template <>
+struct boost::asio::is_match_condition<bci::abs::drivers::ResponseEndMatch>
+    : std::true_type {};
+
+#endif /* ABS_SCPI_DRIVER_SRC_RESPONSEMATCH_H */
@@ -0,0 +1,134 @@
+/*
+ * Copyright (c) 2024, Bloomy Controls, Inc. All rights reserved.
+ *
+ * Use of this source code is governed by a BSD-3-clause license that can be
+ * found in the LICENSE file or at https://opensource.org/license/BSD-3-Clause
+ */
+
+#ifndef ABS_SCPI_DRIVER_SRC_RTTESTIMATOR_H
+#define ABS_SCPI_DRIVER_SRC_RTTESTIMATOR_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+
+namespace bci::abs::drivers {
+
+// Round-trip time estimator and retransmission timeout, computed as TCP does
+// (RFC 6298): the timeout is the smoothed round-trip time plus four times its
+// variation, doubled for each consecutive timeout until a new sample arrives.
+class RttEstimator {
+ public:
+  using Duration = std::chrono::nanoseconds;
+
+  constexpr RttEstimator() noexcept
+      : srtt_{}, rttvar_{}, min_rtt_{}, has_sample_{false}, backoff_{0} {}
+
+  // Add a round-trip time measured for a request which was only sent once.
+  constexpr void AddSample(Duration rtt) noexcept {
+    if (!has_sample_) {
+      srtt_ = rtt;
+      rttvar_ = rtt / 2;
+      min_rtt_ = rtt;
+      has_sample_ = true;
+    } else {
+      const auto err = rtt > srtt_ ? rtt - srtt_ : srtt_ - rtt;
+      rttvar_ = (3 * rttvar_ + err) / 4;
+      srtt_ = (7 * srtt_ + rtt) / 8;
+      min_rtt_ = std::min(min_rtt_, rtt);
+    }
+    backoff_ = 0;
+  }
+
+  // Note that a request timed out, doubling the following timeouts.
+  constexpr void Backoff() noexcept {
+    backoff_ = std::min(backoff_ + 1, kMaxBackoff);
+  }
+
+  constexpr void Reset() noexcept { *this = RttEstimator{}; }
+
+  constexpr bool HasSample() const noexcept { return has_sample_; }
+
+  constexpr Duration SmoothedRtt() const noexcept { return srtt_; }
+
+  constexpr Duration RttVariation() const noexcept { return rttvar_; }
+
+  // Shortest round-trip time seen.
+  constexpr Duration MinRtt() const noexcept { return min_rtt_; }
+
+  // Timeout in milliseconds for the next request's attempt-th retry (0 for
+  // the first send), rounded up and limited to [min_ms, max_ms]. max_ms if
+  // there is no sample yet.
+  constexpr unsigned int TimeoutMs(unsigned int attempt, unsigned int min_ms,
+                                   unsigned int max_ms) const noexcept {
+    if (!has_sample_) {
+      return max_ms;
+    }
+
+    const auto rto = srtt_ + std::max(Duration{kGranularity}, 4 * rttvar_);
+    const auto shift = std::min(backoff_ + attempt, kMaxBackoff);
+    const auto ms = std::chrono::ceil<std::chrono::milliseconds>(rto).count()
+                    << shift;
+    return static_cast<unsigned int>(std::clamp<std::int64_t>(
+        ms, std::min(min_ms, max_ms), max_ms));
+  }
+
+ private:
+  static constexpr std::chrono::microseconds kGranularity{100};
+  static constexpr unsigned int kMaxBackoff = 6;
+
+  Duration srtt_;
+  Duration rttvar_;
+  Duration min_rtt_;
+  bool has_sample_;
+  unsigned int backoff_;
+};
+
+// Period during which responses to requests which timed out may still arrive.
+// Each timeout extends it from the time of the timeout, not from the request's
+// deadline, which has already passed after the final attempt.
+class LateResponseWindow {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  constexpr LateResponseWindow() noexcept : end_{} {}
+
+  // Note a timeout at now, after which a response may take up to wait.
+  constexpr void Extend(Clock::time_point now, Clock::duration wait) noexcept {
+    end_ = std::max(end_, now + wait);
+  }
+
+  constexpr bool Contains(Clock::time_point t) const noexcept {
+    return t < end_;
+  }
+
+  constexpr void Reset() noexcept { end_ = {}; }
+
+ private:
+  Clock::time_point end_;
+};
+
+static_assert(RttEstimator{}.TimeoutMs(0, 5, 150) == 150);
+static_assert([] {
+  RttEstimator rtt;
+  rtt.AddSample(std::chrono::milliseconds(2));
+  return rtt.TimeoutMs(0, 1, 150) == 6 && rtt.TimeoutMs(1, 1, 150) == 12 &&
+         rtt.TimeoutMs(0, 10, 150) == 10 && rtt.TimeoutMs(6, 1, 150) == 150;
+}());
+
+// a response arriving just after the final timeout of a read falls in the
+// window, though the read's deadline has passed
+static_assert([] {
+  using std::chrono::milliseconds;
+  const LateResponseWindow::Clock::time_point deadline{milliseconds(100)};
+  LateResponseWindow late;
+  late.Extend(deadline, milliseconds(100));
+  return late.Contains(deadline + milliseconds(1)) &&
+         late.Contains(deadline + milliseconds(99)) &&
+         !late.Contains(deadline + milliseconds(100)) &&
+         !LateResponseWindow{}.Contains(deadline);
+}());
+
+}  // namespace bci::abs::drivers
+
+#endif /* ABS_SCPI_DRIVER_SRC_RTTESTIMATOR_H */
@@ -5,80 +5,181 @@
  * found in the LICENSE file or at https://opensource.org/license/BSD-3-Clause
  */
 
+#include <bci/abs/CommDriver.h>
 #include <bci/abs/ScpiClient.h>
+#include <bci/abs/SerialDriver.h>
+#include <bci/abs/TcpDriver.h>
+#include <bci/abs/UdpDriver.h>
+#include <bci/abs/UdpMulticastDriver.h>
 #include <fmt/core.h>
 
 #include <memory>
 #include <string>
 #include <string_view>
+#include <type_traits>
 #include <utility>
 
+#include "InstrumentUtil.h"
+#include "Limits.h"
+#include "TransactionLock.h"
 #include "Util.h"
 
 namespace bci::abs {
 
-static constexpr unsigned int kWriteTimeoutMs = 10;
-
 using util::Err;
 using ec = ErrorCode;
 
-ScpiClient::ScpiClient() noexcept : ScpiClient(nullptr) {}
+// Write a query and read its response, reporting the transaction to the sink if
+// there is one.
+template <class W, class R>
+static auto Transact(InstrumentationSink* sink, std::string_view buf,
+                     W&& write, R&& read) -> decltype(read()) {
+  if (!sink) {
+    if (auto res = write(); res != ec::kSuccess) {
+      return Err(res);
+    }
+    return read();
+  }
 
-ScpiClient::ScpiClient(std::shared_ptr<drivers::CommDriver> driver) noexcept
-    : driver_{std::move(driver)}, read_timeout_ms_{150U} {}
+  const auto start = instr::Clock::now();
+  if (auto res = write(); res != ec::kSuccess) {
+    instr::ReportCall(*sink, buf, 0, instr::Since(start), {}, res);
+    return Err(res);
+  }
+  const auto write_time = instr::Since(start);
+
+  const auto read_start = instr::Clock::now();
+  auto resp = read();
+  instr::ReportCall(*sink, buf, resp ? resp->size() : 0, write_time,
+                    instr::Since(read_start),
+                    resp ? ec::kSuccess : resp.error());
+  return resp;
+}
 
-ScpiClient::ScpiClient(ScpiClient&& other) noexcept
+template <class Driver>
+BasicScpiClient<Driver>::BasicScpiClient() noexcept
+    : BasicScpiClient(nullptr) {}
+
+template <class Driver>
+BasicScpiClient<Driver>::BasicScpiClient(
+    std::shared_ptr<Driver> driver) noexcept
+    : driver_{std::move(driver)}, read_timeout_ms_{150U}, sink_{}, lock_{} {
+  static_assert(std::is_base_of_v<drivers::CommDriver, Driver>,
+                "Driver must be a CommDriver");
+}
+
+template <class Driver>
+BasicScpiClient<Driver>::BasicScpiClient(BasicScpiClient&& other) noexcept
     : driver_{std::move(other.driver_)},
-      read_timeout_ms_{std::move(other.read_timeout_ms_)} {}
+      read_timeout_ms_{std::move(other.read_timeout_ms_)},
+      sink_{std::move(other.sink_)},
+      lock_{std::move(other.lock_)} {}
 
-ScpiClient& ScpiClient::operator=(ScpiClient&& rhs) noexcept {
+template <class Driver>
+BasicScpiClient<Driver>& BasicScpiClient<Driver>::operator=(
+    BasicScpiClient&& rhs) noexcept {
   driver_ = std::move(rhs.driver_);
   read_timeout_ms_ = std::move(rhs.read_timeout_ms_);
+  sink_ = std::move(rhs.sink_);
+  lock_ = std::move(rhs.lock_);
   return *this;
 }
 
-std::shared_ptr<drivers::CommDriver> ScpiClient::GetDriver() noexcept {
+template <class Driver>
+std::shared_ptr<Driver> BasicScpiClient<Driver>::GetDriver() noexcept {
   return driver_;
 }
 
-std::shared_ptr<const drivers::CommDriver> ScpiClient::GetDriver()
+template <class Driver>
+std::shared_ptr<const Driver> BasicScpiClient<Driver>::GetDriver()
     const noexcept {
   return driver_;
 }
 
-void ScpiClient::SetDriver(
-    std::shared_ptr<drivers::CommDriver> driver) noexcept {
+template <class Driver>
+void BasicScpiClient<Driver>::SetDriver(
+    std::shared_ptr<Driver> driver) noexcept {
   driver_ = std::move(driver);
+  if (lock_) {
+    SetThreadSafe(true);
+  }
 }
 
-unsigned int ScpiClient::SetReadTimeout(unsigned int timeout_ms) noexcept {
+template <class Driver>
+unsigned int BasicScpiClient<Driver>::SetReadTimeout(
+    unsigned int timeout_ms) noexcept {
   return std::exchange(read_timeout_ms_, timeout_ms);
 }
 
-ErrorCode ScpiClient::SetTargetDeviceID(unsigned int id) {
+template <class Driver>
+void BasicScpiClient<Driver>::SetInstrumentation(
+    std::shared_ptr<InstrumentationSink> sink) noexcept {
+  sink_ = std::move(sink);
+}
+
+template <class Driver>
+std::shared_ptr<InstrumentationSink>
+BasicScpiClient<Driver>::GetInstrumentation() const noexcept {
+  return sink_;
+}
+
+template <class Driver>
+void BasicScpiClient<Driver>::SetThreadSafe(bool enable) {
+  if (!enable) {
+    lock_.reset();
+  } else if (driver_) {
+    // clients sharing a driver must share its lock
+    lock_ = driver_->GetTransactionLock();
+  } else if (!lock_) {
+    lock_ = std::make_shared<detail::TransactionLock>();
+  }
+}
+
+template <class Driver>
+bool BasicScpiClient<Driver>::IsThreadSafe() const noexcept {
+  return static_cast<bool>(lock_);
+}
+
+template <class Driver>
+ErrorCode BasicScpiClient<Driver>::SetTargetDeviceID(unsigned int id) {
   if (driver_) {
+    // don't retarget the driver in the middle of another thread's transaction
+    detail::TransactionLock::Guard guard{lock_.get(), true};
     driver_->SetDeviceID(id);
     return ec::kSuccess;
   }
   return ec::kInvalidDriverHandle;
 }
 
-Result<unsigned int> ScpiClient::GetTargetDeviceID() const {
+template <class Driver>
+Result<unsigned int> BasicScpiClient<Driver>::GetTargetDeviceID() const {
   if (!driver_) {
     return Err(ec::kInvalidDriverHandle);
   }
   return driver_->GetDeviceID();
 }
 
-ErrorCode ScpiClient::Send(std::string_view buf) const {
+template <class Driver>
+ErrorCode BasicScpiClient<Driver>::Send(std::string_view buf) const {
   if (!driver_) {
     return ec::kInvalidDriverHandle;
   }
 
-  return driver_->Write(buf, kWriteTimeoutMs);
+  detail::TransactionLock::Guard guard{lock_.get(), true};
+
+  if (!sink_) {
+    return Write(buf);
+  }
+
+  const auto start = instr::Clock::now();
+  const auto res = Write(buf);
+  instr::ReportCall(*sink_, buf, 0, instr::Since(start), {}, res);
+  return res;
 }
 
-Result<std::string> ScpiClient::SendAndRecv(std::string_view buf) const {
+template <class Driver>
+Result<std::string> BasicScpiClient<Driver>::SendAndRecv(
+    std::string_view buf) const {
   if (!driver_) {
     return Err(ec::kInvalidDriverHandle);
   }
@@ -87,11 +188,38 @@ Result<std::string> ScpiClient::SendAndRecv(std::string_view buf) const {
     return Err(ec::kReceiveNotAllowed);
   }
 
-  auto res = driver_->Write(buf, kWriteTimeoutMs);
-  if (res != ErrorCode::kSuccess) {
-    return Err(res);
+  detail::TransactionLock::Guard guard{lock_.get(), false};
+  return Transact(
+      sink_.get(), buf, [&] { return Write(buf); },
+      [&] { return driver_->ReadLine(read_timeout_ms_); });
+}
+
+template <class Driver>
+Result<std::string_view> BasicScpiClient<Driver>::SendAndRecv(
+    std::string_view buf, std::span<char> resp_buf) const {
+  if (!driver_) {
+    return Err(ec::kInvalidDriverHandle);
   }
-  return driver_->ReadLine(read_timeout_ms_);
+
+  if (driver_->IsSendOnly()) {
+    return Err(ec::kReceiveNotAllowed);
+  }
+
+  detail::TransactionLock::Guard guard{lock_.get(), false};
+  return Transact(
+      sink_.get(), buf, [&] { return Write(buf); },
+      [&] { return driver_->ReadLineInto(resp_buf, read_timeout_ms_); });
+}
+
+template <class Driver>
+ErrorCode BasicScpiClient<Driver>::Write(std::string_view buf) const {
+  return driver_->Write(buf, limits::kWriteTimeoutMs);
 }
 
+template class BasicScpiClient<drivers::CommDriver>;
+template class BasicScpiClient<drivers::TcpDriver>;
+template class BasicScpiClient<drivers::UdpDriver>;
+template class BasicScpiClient<drivers::UdpMcastDriver>;
+template class BasicScpiClient<drivers::SerialDriver>;
+
 }  // namespace bci::abs
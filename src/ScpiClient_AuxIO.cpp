@@ -5,16 +5,24 @@
  * found in the LICENSE file or at https://opensource.org/license/BSD-3-Clause
  */
 
+#include <bci/abs/CommDriver.h>
 #include <bci/abs/ScpiClient.h>
+#include <bci/abs/SerialDriver.h>
+#include <bci/abs/TcpDriver.h>
+#include <bci/abs/UdpDriver.h>
+#include <bci/abs/UdpMulticastDriver.h>
 #include <fmt/core.h>
 #include <fmt/ranges.h>
 
 #include <algorithm>
 #include <array>
-#include <iterator>
+#include <cstddef>
 #include <span>
 #include <string_view>
 
+#include "CommandBuffer.h"
+#include "CommandTable.h"
+#include "Limits.h"
 #include "ScpiUtil.h"
 #include "Util.h"
 
@@ -25,38 +33,46 @@ static constexpr unsigned int kDigitalOutputsMask =
 static constexpr unsigned int kAnalogOutputsMask =
     ((1U << kAnalogOutputCount) - 1);
 
-static constexpr float kMaxAnalogOutVoltage = 10.0f;
+// Longest entry of the bulk analog output command, ":AUX:AOUT8 -10.000;".
+static constexpr std::size_t kAnalogOutEntryLen = 19;
 
 using util::Err;
 using ec = ErrorCode;
 
-ErrorCode ScpiClient::SetAnalogOutput(unsigned int channel,
-                                      float voltage) const {
+template <class Driver>
+ErrorCode BasicScpiClient<Driver>::SetAnalogOutput(unsigned int channel,
+                                                   float voltage) const {
   if (channel >= kAnalogOutputCount) {
     return ec::kChannelIndexOutOfRange;
   }
 
-  voltage = std::clamp(voltage, -kMaxAnalogOutVoltage, kMaxAnalogOutVoltage);
+  voltage = limits::ClampAnalogOut(voltage);
 
-  char buf[64]{};
-  fmt::format_to_n(buf, sizeof(buf) - 1, "AUX:AOUT{} {:.3f}\r\n", channel + 1,
-                   voltage);
+  scpi::CommandBuffer<64> buf;
+  buf.Append(
+      scpi::ChannelCommand<"AUX:AOUT", " ", kAnalogOutputCount>(channel));
+  buf.AppendFixed<3>(voltage);
+  buf.Append("\r\n");
 
-  return Send(buf);
+  return Send(buf.View());
 }
 
-ErrorCode ScpiClient::SetAllAnalogOutputs(float voltage) const {
-  voltage = std::clamp(voltage, -kMaxAnalogOutVoltage, kMaxAnalogOutVoltage);
+template <class Driver>
+ErrorCode BasicScpiClient<Driver>::SetAllAnalogOutputs(float voltage) const {
+  voltage = limits::ClampAnalogOut(voltage);
 
-  char buf[64]{};
-  fmt::format_to_n(buf, sizeof(buf) - 1, "AUX:AOUT {:.3f},(@1:{})\r\n", voltage,
-                   kAnalogOutputCount);
+  scpi::CommandBuffer<64> buf;
+  buf.Append("AUX:AOUT ");
+  buf.AppendFixed<3>(voltage);
+  buf.Append(scpi::ChannelListCommand<",", "\r\n", kAnalogOutputCount>(
+      kAnalogOutputCount));
 
-  return Send(buf);
+  return Send(buf.View());
 }
 
-ErrorCode ScpiClient::SetAllAnalogOutputs(const float* voltages,
-                                          std::size_t count) const {
+template <class Driver>
+ErrorCode BasicScpiClient<Driver>::SetAllAnalogOutputs(
+    const float* voltages, std::size_t count) const {
   if ((count > 0 && !voltages) || count > kAnalogOutputCount) {
     return ec::kInvalidArgument;
   }
@@ -65,32 +81,37 @@ ErrorCode ScpiClient::SetAllAnalogOutputs(const float* voltages,
     return ec::kSuccess;
   }
 
-  std::string buf;
-  // try to do only one allocation
-  buf.reserve(count * 21 + 2);
+  scpi::CommandBuffer<kAnalogOutputCount * kAnalogOutEntryLen + 2> buf;
   for (std::size_t i = 0; i < count; ++i) {
-    fmt::format_to(
-        std::back_inserter(buf), ":AUX:AOUT{} {:.3f};", i + 1,
-        std::clamp(voltages[i], -kMaxAnalogOutVoltage, kMaxAnalogOutVoltage));
+    buf.Append(scpi::ChannelCommand<":AUX:AOUT", " ", kAnalogOutputCount>(i));
+    buf.AppendFixed<3>(limits::ClampAnalogOut(voltages[i]));
+    buf.Append(";");
   }
-  buf += "\r\n";
+  buf.Append("\r\n");
 
-  return Send(buf);
+  if (buf.Overflowed()) {
+    return ec::kBufferTooSmall;
+  }
+
+  return Send(buf.View());
 }
 
-ErrorCode ScpiClient::SetAllAnalogOutputs(
+template <class Driver>
+ErrorCode BasicScpiClient<Driver>::SetAllAnalogOutputs(
     std::span<const float> voltages) const {
   return SetAllAnalogOutputs(voltages.data(), voltages.size());
 }
 
-ErrorCode ScpiClient::SetAllAnalogOutputs(
+template <class Driver>
+ErrorCode BasicScpiClient<Driver>::SetAllAnalogOutputs(
     const std::array<float, kAnalogOutputCount>& voltages) const {
   return SetAllAnalogOutputs(voltages.data(), voltages.size());
 }
 
-ErrorCode ScpiClient::SetMultipleAnalogOutputs(unsigned int channels,
-                                               float voltage) const {
-  voltage = std::clamp(voltage, -kMaxAnalogOutVoltage, kMaxAnalogOutVoltage);
+template <class Driver>
+ErrorCode BasicScpiClient<Driver>::SetMultipleAnalogOutputs(
+    unsigned int channels, float voltage) const {
+  voltage = limits::ClampAnalogOut(voltage);
 
   channels &= kAnalogOutputsMask;
   if (channels) {
@@ -108,37 +129,77 @@ ErrorCode ScpiClient::SetMultipleAnalogOutputs(unsigned int channels,
     }
 
     std::span chan_list{which_chans.data(), count};
-    char buf[64]{};
-    fmt::format_to_n(buf, sizeof(buf) - 1, "AUX:AOUT {:.3f},(@{})\r\n", voltage,
-                     fmt::join(chan_list, ","));
-    return Send(buf);
+    scpi::CommandBuffer<64> buf;
+    buf.Append("AUX:AOUT ");
+    buf.AppendFixed<3>(voltage);
+    buf.Append(",(@{})\r\n", fmt::join(chan_list, ","));
+    return Send(buf.View());
   }
 
   return ec::kSuccess;
 }
 
-Result<float> ScpiClient::GetAnalogOutput(unsigned int channel) const {
+template <class Driver>
+ErrorCode BasicScpiClient<Driver>::SetAnalogOutputsDelta(
+    std::span<const float> prev, std::span<const float> next) const {
+  if (prev.size() != next.size() || next.size() > kAnalogOutputCount) {
+    return ec::kInvalidArgument;
+  }
+
+  scpi::CommandBuffer<kAnalogOutputCount * kAnalogOutEntryLen + 2> buf;
+  const bool changed = scpi::AppendChanges<kAnalogOutputCount>(
+      buf, ":AUX:AOUT", "", prev, next,
+      [](float v) {
+        return limits::ClampAnalogOut(v);
+      },
+      [](auto& b, float v) { b.template AppendFixed<3>(v); });
+  if (!changed) {
+    return ec::kSuccess;
+  }
+  buf.Append("\r\n");
+
+  if (buf.Overflowed()) {
+    return ec::kBufferTooSmall;
+  }
+
+  return Send(buf.View());
+}
+
+template <class Driver>
+ErrorCode BasicScpiClient<Driver>::SetAnalogOutputsDelta(
+    const std::array<float, kAnalogOutputCount>& prev,
+    const std::array<float, kAnalogOutputCount>& next) const {
+  return SetAnalogOutputsDelta(std::span{prev}, std::span{next});
+}
+
+template <class Driver>
+Result<float> BasicScpiClient<Driver>::GetAnalogOutput(
+    unsigned int channel) const {
   if (channel >= kAnalogOutputCount) {
     return Err(ec::kChannelIndexOutOfRange);
   }
 
-  char buf[32]{};
-  fmt::format_to_n(buf, sizeof(buf) - 1, "AUX:AOUT{}?\r\n", channel + 1);
+  const auto cmd =
+      scpi::ChannelCommand<"AUX:AOUT", "?\r\n", kAnalogOutputCount>(channel);
 
-  return SendAndRecv(buf).and_then(scpi::ParseFloatResponse);
+  scpi::ResponseBuffer resp_buf;
+  return SendAndRecv(cmd, resp_buf).and_then(scpi::ParseFloatResponse);
 }
 
-Result<std::array<float, kAnalogOutputCount>> ScpiClient::GetAllAnalogOutputs()
-    const {
-  char buf[32]{};
-  fmt::format_to_n(buf, sizeof(buf) - 1, "AUX:AOUT? (@1:{})\r\n",
-                   kAnalogOutputCount);
-  return SendAndRecv(buf).and_then(
+template <class Driver>
+Result<std::array<float, kAnalogOutputCount>>
+BasicScpiClient<Driver>::GetAllAnalogOutputs() const {
+  constexpr auto cmd =
+      scpi::ChannelListCommand<"AUX:AOUT? ", "\r\n", kAnalogOutputCount>(
+          kAnalogOutputCount);
+  scpi::ResponseBuffer resp_buf;
+  return SendAndRecv(cmd, resp_buf).and_then(
       scpi::ParseRespFloatArray<kAnalogOutputCount>);
 }
 
-ErrorCode ScpiClient::GetAllAnalogOutputs(float* voltages,
-                                          std::size_t count) const {
+template <class Driver>
+ErrorCode BasicScpiClient<Driver>::GetAllAnalogOutputs(
+    float* voltages, std::size_t count) const {
   if ((!voltages && count > 0) || count > kAnalogOutputCount) {
     return ec::kInvalidArgument;
   }
@@ -147,10 +208,11 @@ ErrorCode ScpiClient::GetAllAnalogOutputs(float* voltages,
     return ec::kSuccess;
   }
 
-  char buf[32]{};
-  fmt::format_to_n(buf, sizeof(buf) - 1, "AUX:AOUT? (@1:{})\r\n", count);
+  const auto cmd =
+      scpi::ChannelListCommand<"AUX:AOUT? ", "\r\n", kAnalogOutputCount>(count);
 
-  auto resp = SendAndRecv(buf);
+  scpi::ResponseBuffer resp_buf;
+  auto resp = SendAndRecv(cmd, resp_buf);
   if (!resp) {
     return resp.error();
   }
@@ -158,36 +220,47 @@ ErrorCode ScpiClient::GetAllAnalogOutputs(float* voltages,
   return scpi::SplitRespFloats(*resp, std::span{voltages, count});
 }
 
-ErrorCode ScpiClient::GetAllAnalogOutputs(
+template <class Driver>
+ErrorCode BasicScpiClient<Driver>::GetAllAnalogOutputs(
     std::array<float, kAnalogOutputCount>& voltages) const {
   return GetAllAnalogOutputs(voltages.data(), voltages.size());
 }
 
-ErrorCode ScpiClient::GetAllAnalogOutputs(std::span<float> voltages) const {
+template <class Driver>
+ErrorCode BasicScpiClient<Driver>::GetAllAnalogOutputs(
+    std::span<float> voltages) const {
   return GetAllAnalogOutputs(voltages.data(), voltages.size());
 }
 
-ErrorCode ScpiClient::SetDigitalOutput(unsigned int channel, bool level) const {
+template <class Driver>
+ErrorCode BasicScpiClient<Driver>::SetDigitalOutput(unsigned int channel,
+                                                    bool level) const {
   if (channel >= kDigitalOutputCount) {
     return ec::kChannelIndexOutOfRange;
   }
 
-  char buf[32]{};
-  fmt::format_to_n(buf, sizeof(buf) - 1, "AUX:DOUT{} {:d}\r\n", channel + 1,
-                   level);
+  scpi::CommandBuffer<32> buf;
+  buf.Append(
+      scpi::ChannelCommand<"AUX:DOUT", " ", kDigitalOutputCount>(channel));
+  buf.Append(level ? "1" : "0");
+  buf.Append("\r\n");
 
-  return Send(buf);
+  return Send(buf.View());
 }
 
-ErrorCode ScpiClient::SetAllDigitalOutputs(bool level) const {
-  char buf[64]{};
-  fmt::format_to_n(buf, sizeof(buf) - 1, "AUX:DOUT {:d},(@1:{})\r\n", level,
-                   kDigitalOutputCount);
-  return Send(buf);
+template <class Driver>
+ErrorCode BasicScpiClient<Driver>::SetAllDigitalOutputs(bool level) const {
+  scpi::CommandBuffer<64> buf;
+  buf.Append("AUX:DOUT ");
+  buf.Append(level ? "1" : "0");
+  buf.Append(scpi::ChannelListCommand<",", "\r\n", kDigitalOutputCount>(
+      kDigitalOutputCount));
+  return Send(buf.View());
 }
 
-ErrorCode ScpiClient::SetAllDigitalOutputsMasked(unsigned int channels,
-                                                 bool level) const {
+template <class Driver>
+ErrorCode BasicScpiClient<Driver>::SetAllDigitalOutputsMasked(
+    unsigned int channels, bool level) const {
   channels &= kDigitalOutputsMask;
   if (channels != 0) {
     // avoid allocation by pre-computing the indices so fmt can format them at
@@ -201,20 +274,24 @@ ErrorCode ScpiClient::SetAllDigitalOutputsMasked(unsigned int channels,
       }
     }
     std::span chan_list{which_chans.data(), count};
-    char buf[64]{};
-    fmt::format_to_n(buf, sizeof(buf) - 1, "AUX:DOUT {:d},(@{})\r\n", level,
-                     fmt::join(chan_list, ","));
-    return Send(buf);
+    scpi::CommandBuffer<64> buf;
+    buf.Append("AUX:DOUT ");
+    buf.Append(level ? "1" : "0");
+    buf.Append(",(@{})\r\n", fmt::join(chan_list, ","));
+    return Send(buf.View());
   }
   return ec::kSuccess;
 }
 
-ErrorCode ScpiClient::SetAllDigitalOutputs(
+template <class Driver>
+ErrorCode BasicScpiClient<Driver>::SetAllDigitalOutputs(
     const std::array<bool, kDigitalOutputCount>& levels) const {
   return SetAllDigitalOutputs(std::span{levels});
 }
 
-ErrorCode ScpiClient::SetAllDigitalOutputs(std::span<const bool> levels) const {
+template <class Driver>
+ErrorCode BasicScpiClient<Driver>::SetAllDigitalOutputs(
+    std::span<const bool> levels) const {
   const auto count =
       std::min(levels.size(), static_cast<std::size_t>(kDigitalOutputCount));
   if (count == 0) {
@@ -249,27 +326,34 @@ ErrorCode ScpiClient::SetAllDigitalOutputs(std::span<const bool> levels) const {
   return ec::kSuccess;
 }
 
-Result<bool> ScpiClient::GetDigitalOutput(unsigned int channel) const {
+template <class Driver>
+Result<bool> BasicScpiClient<Driver>::GetDigitalOutput(
+    unsigned int channel) const {
   if (channel >= kDigitalOutputCount) {
     return Err(ec::kChannelIndexOutOfRange);
   }
 
-  char buf[32]{};
-  fmt::format_to_n(buf, sizeof(buf) - 1, "AUX:DOUT{}?\r\n", channel + 1);
+  const auto cmd =
+      scpi::ChannelCommand<"AUX:DOUT", "?\r\n", kDigitalOutputCount>(channel);
 
-  return SendAndRecv(buf).and_then(scpi::ParseBoolResponse);
+  scpi::ResponseBuffer resp_buf;
+  return SendAndRecv(cmd, resp_buf).and_then(scpi::ParseBoolResponse);
 }
 
-Result<std::array<bool, kDigitalOutputCount>> ScpiClient::GetAllDigitalOutputs()
-    const {
-  char buf[64]{};
-  fmt::format_to_n(buf, sizeof(buf) - 1, "AUX:DOUT? (@1:{})\r\n",
-                   kDigitalOutputCount);
-  return SendAndRecv(buf).and_then(
+template <class Driver>
+Result<std::array<bool, kDigitalOutputCount>>
+BasicScpiClient<Driver>::GetAllDigitalOutputs() const {
+  constexpr auto cmd =
+      scpi::ChannelListCommand<"AUX:DOUT? ", "\r\n", kDigitalOutputCount>(
+          kDigitalOutputCount);
+  scpi::ResponseBuffer resp_buf;
+  return SendAndRecv(cmd, resp_buf).and_then(
       scpi::ParseRespBoolArray<kDigitalOutputCount>);
 }
 
-Result<unsigned int> ScpiClient::GetAllDigitalOutputsMasked() const {
+template <class Driver>
+Result<unsigned int>
+BasicScpiClient<Driver>::GetAllDigitalOutputsMasked() const {
   auto resp = GetAllDigitalOutputs();
   if (!resp) {
     return Err(resp.error());
@@ -285,28 +369,34 @@ Result<unsigned int> ScpiClient::GetAllDigitalOutputsMasked() const {
   return mask;
 }
 
-Result<float> ScpiClient::MeasureAnalogInput(unsigned int channel) const {
+template <class Driver>
+Result<float> BasicScpiClient<Driver>::MeasureAnalogInput(
+    unsigned int channel) const {
   if (channel >= kAnalogInputCount) {
     return Err(ec::kChannelIndexOutOfRange);
   }
 
-  char buf[32]{};
-  fmt::format_to_n(buf, sizeof(buf) - 1, "AUX:AIN{}?\r\n", channel + 1);
+  const auto cmd =
+      scpi::ChannelCommand<"AUX:AIN", "?\r\n", kAnalogInputCount>(channel);
 
-  return SendAndRecv(buf).and_then(scpi::ParseFloatResponse);
+  scpi::ResponseBuffer resp_buf;
+  return SendAndRecv(cmd, resp_buf).and_then(scpi::ParseFloatResponse);
 }
 
+template <class Driver>
 Result<std::array<float, kAnalogInputCount>>
-ScpiClient::MeasureAllAnalogInputs() const {
-  char buf[64]{};
-  fmt::format_to_n(buf, sizeof(buf) - 1, "AUX:AIN? (@1:{})\r\n",
-                   kAnalogInputCount);
-  return SendAndRecv(buf).and_then(
+BasicScpiClient<Driver>::MeasureAllAnalogInputs() const {
+  constexpr auto cmd =
+      scpi::ChannelListCommand<"AUX:AIN? ", "\r\n", kAnalogInputCount>(
+          kAnalogInputCount);
+  scpi::ResponseBuffer resp_buf;
+  return SendAndRecv(cmd, resp_buf).and_then(
       scpi::ParseRespFloatArray<kAnalogInputCount>);
 }
 
-ErrorCode ScpiClient::MeasureAllAnalogInputs(float* voltages,
-                                             std::size_t count) const {
+template <class Driver>
+ErrorCode BasicScpiClient<Driver>::MeasureAllAnalogInputs(
+    float* voltages, std::size_t count) const {
   if ((!voltages && count > 0) || count > kAnalogInputCount) {
     return ec::kInvalidArgument;
   }
@@ -315,10 +405,11 @@ ErrorCode ScpiClient::MeasureAllAnalogInputs(float* voltages,
     return ec::kSuccess;
   }
 
-  char buf[32]{};
-  fmt::format_to_n(buf, sizeof(buf) - 1, "AUX:AIN? (@1:{})\r\n", count);
+  const auto cmd =
+      scpi::ChannelListCommand<"AUX:AIN? ", "\r\n", kAnalogInputCount>(count);
 
-  auto resp = SendAndRecv(buf);
+  scpi::ResponseBuffer resp_buf;
+  auto resp = SendAndRecv(cmd, resp_buf);
   if (!resp) {
     return resp.error();
   }
@@ -326,36 +417,46 @@ ErrorCode ScpiClient::MeasureAllAnalogInputs(float* voltages,
   return scpi::SplitRespFloats(*resp, std::span{voltages, count});
 }
 
-ErrorCode ScpiClient::MeasureAllAnalogInputs(
+template <class Driver>
+ErrorCode BasicScpiClient<Driver>::MeasureAllAnalogInputs(
     std::array<float, kAnalogInputCount>& voltages) const {
   return MeasureAllAnalogInputs(voltages.data(), voltages.size());
 }
 
-ErrorCode ScpiClient::MeasureAllAnalogInputs(std::span<float> voltages) const {
+template <class Driver>
+ErrorCode BasicScpiClient<Driver>::MeasureAllAnalogInputs(
+    std::span<float> voltages) const {
   return MeasureAllAnalogInputs(voltages.data(), voltages.size());
 }
 
-Result<bool> ScpiClient::MeasureDigitalInput(unsigned int channel) const {
+template <class Driver>
+Result<bool> BasicScpiClient<Driver>::MeasureDigitalInput(
+    unsigned int channel) const {
   if (channel >= kDigitalInputCount) {
     return Err(ec::kChannelIndexOutOfRange);
   }
 
-  char buf[32]{};
-  fmt::format_to_n(buf, sizeof(buf) - 1, "AUX:DIN{}?\r\n", channel + 1);
+  const auto cmd =
+      scpi::ChannelCommand<"AUX:DIN", "?\r\n", kDigitalInputCount>(channel);
 
-  return SendAndRecv(buf).and_then(scpi::ParseBoolResponse);
+  scpi::ResponseBuffer resp_buf;
+  return SendAndRecv(cmd, resp_buf).and_then(scpi::ParseBoolResponse);
 }
 
+template <class Driver>
 Result<std::array<bool, kDigitalInputCount>>
-ScpiClient::MeasureAllDigitalInputs() const {
-  char buf[64]{};
-  fmt::format_to_n(buf, sizeof(buf) - 1, "AUX:DIN? (@1:{})\r\n",
-                   kDigitalInputCount);
-  return SendAndRecv(buf).and_then(
+BasicScpiClient<Driver>::MeasureAllDigitalInputs() const {
+  constexpr auto cmd =
+      scpi::ChannelListCommand<"AUX:DIN? ", "\r\n", kDigitalInputCount>(
+          kDigitalInputCount);
+  scpi::ResponseBuffer resp_buf;
+  return SendAndRecv(cmd, resp_buf).and_then(
       scpi::ParseRespBoolArray<kDigitalInputCount>);
 }
 
-Result<unsigned int> ScpiClient::MeasureAllDigitalInputsMasked() const {
+template <class Driver>
+Result<unsigned int>
+BasicScpiClient<Driver>::MeasureAllDigitalInputsMasked() const {
   auto resp = MeasureAllDigitalInputs();
   if (!resp) {
     return Err(resp.error());
@@ -371,4 +472,10 @@ Result<unsigned int> ScpiClient::MeasureAllDigitalInputsMasked() const {
   return mask;
 }
 
+template class BasicScpiClient<drivers::CommDriver>;
+template class BasicScpiClient<drivers::TcpDriver>;
+template class BasicScpiClient<drivers::UdpDriver>;
+template class BasicScpiClient<drivers::UdpMcastDriver>;
+template class BasicScpiClient<drivers::SerialDriver>;
+
 }  // namespace bci::abs
@@ -5,16 +5,24 @@
  * found in the LICENSE file or at https://opensource.org/license/BSD-3-Clause
  */
 
+#include <bci/abs/CommDriver.h>
 #include <bci/abs/ScpiClient.h>
+#include <bci/abs/SerialDriver.h>
+#include <bci/abs/TcpDriver.h>
+#include <bci/abs/UdpDriver.h>
+#include <bci/abs/UdpMulticastDriver.h>
 #include <fmt/core.h>
 #include <fmt/ranges.h>
 
 #include <array>
-#include <iterator>
+#include <cstddef>
 #include <span>
 #include <string>
 #include <string_view>
 
+#include "CommandBuffer.h"
+#include "CommandTable.h"
+#include "Limits.h"
 #include "ScpiUtil.h"
 #include "Util.h"
 
@@ -22,25 +30,34 @@ namespace bci::abs {
 
 static constexpr unsigned int kCellsMask = ((1U << kCellCount) - 1);
 
-static constexpr float kMaxVoltage = 5.0f;
-static constexpr float kMaxSourcing = 5.0f;
-static constexpr float kMaxSinking = 5.0f;
+// Longest entry of each bulk command, e.g. ":SOUR8:CURR:SNK -5.0000;".
+static constexpr std::size_t kVoltageEntryLen = 19;
+static constexpr std::size_t kSourcingEntryLen = 23;
+static constexpr std::size_t kSinkingEntryLen = 24;
+static constexpr std::size_t kFaultEntryLen = 18;
+static constexpr std::size_t kSenseRangeEntryLen = 17;
 
 using util::Err;
 using ec = ErrorCode;
 
-ErrorCode ScpiClient::EnableCell(unsigned int cell, bool en) const {
+template <class Driver>
+ErrorCode BasicScpiClient<Driver>::EnableCell(unsigned int cell,
+                                              bool en) const {
   if (cell >= kCellCount) {
     return ec::kChannelIndexOutOfRange;
   }
 
-  char buf[32]{};
-  fmt::format_to_n(buf, sizeof(buf) - 1, "OUTP{} {:d}\r\n", cell + 1, en);
+  scpi::CommandBuffer<32> buf;
+  buf.Append(scpi::ChannelCommand<"OUTP", " ", kCellCount>(cell));
+  buf.Append(en ? "1" : "0");
+  buf.Append("\r\n");
 
-  return Send(buf);
+  return Send(buf.View());
 }
 
-ErrorCode ScpiClient::EnableCellsMasked(unsigned int cells, bool en) const {
+template <class Driver>
+ErrorCode BasicScpiClient<Driver>::EnableCellsMasked(unsigned int cells,
+                                                     bool en) const {
   cells &= kCellsMask;
   if (cells != 0) {
     // we can avoid allocations by using an array of indices
@@ -52,32 +69,39 @@ ErrorCode ScpiClient::EnableCellsMasked(unsigned int cells, bool en) const {
       }
     }
     std::span chan_list{which_cells.data(), count};
-    char buf[64]{};
-    fmt::format_to_n(buf, sizeof(buf) - 1, "OUTP {:d},(@{})\r\n", en,
-                     fmt::join(chan_list, ","));
-    return Send(buf);
+    scpi::CommandBuffer<64> buf;
+    buf.Append("OUTP ");
+    buf.Append(en ? "1" : "0");
+    buf.Append(",(@{})\r\n", fmt::join(chan_list, ","));
+    return Send(buf.View());
   }
   return ec::kSuccess;
 }
 
-Result<bool> ScpiClient::GetCellEnabled(unsigned int cell) const {
+template <class Driver>
+Result<bool> BasicScpiClient<Driver>::GetCellEnabled(unsigned int cell) const {
   if (cell >= kCellCount) {
     return Err(ec::kChannelIndexOutOfRange);
   }
 
-  char buf[32]{};
-  fmt::format_to_n(buf, sizeof(buf) - 1, "OUTP{}?\r\n", cell + 1);
+  const auto cmd = scpi::ChannelCommand<"OUTP", "?\r\n", kCellCount>(cell);
 
-  return SendAndRecv(buf).and_then(scpi::ParseBoolResponse);
+  scpi::ResponseBuffer resp_buf;
+  return SendAndRecv(cmd, resp_buf).and_then(scpi::ParseBoolResponse);
 }
 
-Result<std::array<bool, kCellCount>> ScpiClient::GetAllCellsEnabled() const {
-  char buf[64]{};
-  fmt::format_to_n(buf, sizeof(buf) - 1, "OUTP? (@1:{})\r\n", kCellCount);
-  return SendAndRecv(buf).and_then(scpi::ParseRespBoolArray<kCellCount>);
+template <class Driver>
+Result<std::array<bool, kCellCount>>
+BasicScpiClient<Driver>::GetAllCellsEnabled() const {
+  constexpr auto cmd =
+      scpi::ChannelListCommand<"OUTP? ", "\r\n", kCellCount>(kCellCount);
+  scpi::ResponseBuffer resp_buf;
+  return SendAndRecv(cmd, resp_buf)
+      .and_then(scpi::ParseRespBoolArray<kCellCount>);
 }
 
-Result<unsigned int> ScpiClient::GetAllCellsEnabledMasked() const {
+template <class Driver>
+Result<unsigned int> BasicScpiClient<Driver>::GetAllCellsEnabledMasked() const {
   auto resp = GetAllCellsEnabled();
   if (!resp) {
     return Err(resp.error());
@@ -93,32 +117,38 @@ Result<unsigned int> ScpiClient::GetAllCellsEnabledMasked() const {
   return mask;
 }
 
-ErrorCode ScpiClient::SetCellVoltage(unsigned int cell, float voltage) const {
+template <class Driver>
+ErrorCode BasicScpiClient<Driver>::SetCellVoltage(unsigned int cell,
+                                                  float voltage) const {
   if (cell >= kCellCount) {
     return ec::kChannelIndexOutOfRange;
   }
 
-  voltage = std::clamp(voltage, 0.0f, kMaxVoltage);
+  voltage = limits::ClampVoltage(voltage);
 
-  char buf[64]{};
-  fmt::format_to_n(buf, sizeof(buf) - 1, "SOUR{}:VOLT {:.4f}\r\n", cell + 1,
-                   voltage);
+  scpi::CommandBuffer<64> buf;
+  buf.Append(scpi::ChannelCommand<"SOUR", ":VOLT ", kCellCount>(cell));
+  buf.AppendFixed<4>(voltage);
+  buf.Append("\r\n");
 
-  return Send(buf);
+  return Send(buf.View());
 }
 
-ErrorCode ScpiClient::SetAllCellVoltages(float voltage) const {
-  voltage = std::clamp(voltage, 0.0f, kMaxVoltage);
+template <class Driver>
+ErrorCode BasicScpiClient<Driver>::SetAllCellVoltages(float voltage) const {
+  voltage = limits::ClampVoltage(voltage);
 
-  char buf[64]{};
-  fmt::format_to_n(buf, sizeof(buf) - 1, "SOUR:VOLT {:.4f},(@1:{})\r\n",
-                   voltage, kCellCount);
+  scpi::CommandBuffer<64> buf;
+  buf.Append("SOUR:VOLT ");
+  buf.AppendFixed<4>(voltage);
+  buf.Append(scpi::ChannelListCommand<",", "\r\n", kCellCount>(kCellCount));
 
-  return Send(buf);
+  return Send(buf.View());
 }
 
-ErrorCode ScpiClient::SetAllCellVoltages(const float* voltages,
-                                         std::size_t count) const {
+template <class Driver>
+ErrorCode BasicScpiClient<Driver>::SetAllCellVoltages(const float* voltages,
+                                                      std::size_t count) const {
   if ((count > 0 && !voltages) || count > kCellCount) {
     return ec::kInvalidArgument;
   }
@@ -127,31 +157,37 @@ ErrorCode ScpiClient::SetAllCellVoltages(const float* voltages,
     return ec::kSuccess;
   }
 
-  std::string buf;
-  // try to do only one allocation
-  buf.reserve(count * 19 + 2);
+  scpi::CommandBuffer<kCellCount * kVoltageEntryLen + 2> buf;
   for (std::size_t i = 0; i < count; ++i) {
-    fmt::format_to(std::back_inserter(buf), ":SOUR{}:VOLT {:.4f};", i + 1,
-                   std::clamp(voltages[i], 0.0f, kMaxVoltage));
+    buf.Append(scpi::ChannelCommand<":SOUR", ":VOLT ", kCellCount>(i));
+    buf.AppendFixed<4>(limits::ClampVoltage(voltages[i]));
+    buf.Append(";");
   }
-  buf += "\r\n";
+  buf.Append("\r\n");
 
-  return Send(buf);
+  if (buf.Overflowed()) {
+    return ec::kBufferTooSmall;
+  }
+
+  return Send(buf.View());
 }
 
-ErrorCode ScpiClient::SetAllCellVoltages(
+template <class Driver>
+ErrorCode BasicScpiClient<Driver>::SetAllCellVoltages(
     std::span<const float> voltages) const {
   return SetAllCellVoltages(voltages.data(), voltages.size());
 }
 
-ErrorCode ScpiClient::SetAllCellVoltages(
+template <class Driver>
+ErrorCode BasicScpiClient<Driver>::SetAllCellVoltages(
     const std::array<float, kCellCount>& voltages) const {
   return SetAllCellVoltages(voltages.data(), voltages.size());
 }
 
-ErrorCode ScpiClient::SetMultipleCellVoltages(unsigned int cells,
-                                              float voltage) const {
-  voltage = std::clamp(voltage, 0.0f, kMaxVoltage);
+template <class Driver>
+ErrorCode BasicScpiClient<Driver>::SetMultipleCellVoltages(
+    unsigned int cells, float voltage) const {
+  voltage = limits::ClampVoltage(voltage);
 
   cells &= kCellsMask;
   if (cells) {
@@ -168,35 +204,73 @@ ErrorCode ScpiClient::SetMultipleCellVoltages(unsigned int cells,
     }
 
     std::span chan_list{which_cells.data(), count};
-    char buf[64]{};
-    fmt::format_to_n(buf, sizeof(buf) - 1, "SOUR:VOLT {:.4f},(@{})\r\n",
-                     voltage, fmt::join(chan_list, ","));
-    return Send(buf);
+    scpi::CommandBuffer<64> buf;
+    buf.Append("SOUR:VOLT ");
+    buf.AppendFixed<4>(voltage);
+    buf.Append(",(@{})\r\n", fmt::join(chan_list, ","));
+    return Send(buf.View());
   }
 
   return ec::kSuccess;
 }
 
-Result<float> ScpiClient::GetCellVoltageTarget(unsigned int cell) const {
+template <class Driver>
+ErrorCode BasicScpiClient<Driver>::SetCellVoltagesDelta(
+    std::span<const float> prev, std::span<const float> next) const {
+  if (prev.size() != next.size() || next.size() > kCellCount) {
+    return ec::kInvalidArgument;
+  }
+
+  scpi::CommandBuffer<kCellCount * kVoltageEntryLen + 2> buf;
+  const bool changed = scpi::AppendChanges<kCellCount>(
+      buf, ":SOUR", ":VOLT", prev, next,
+      [](float v) { return limits::ClampVoltage(v); },
+      [](auto& b, float v) { b.template AppendFixed<4>(v); });
+  if (!changed) {
+    return ec::kSuccess;
+  }
+  buf.Append("\r\n");
+
+  if (buf.Overflowed()) {
+    return ec::kBufferTooSmall;
+  }
+
+  return Send(buf.View());
+}
+
+template <class Driver>
+ErrorCode BasicScpiClient<Driver>::SetCellVoltagesDelta(
+    const std::array<float, kCellCount>& prev,
+    const std::array<float, kCellCount>& next) const {
+  return SetCellVoltagesDelta(std::span{prev}, std::span{next});
+}
+
+template <class Driver>
+Result<float> BasicScpiClient<Driver>::GetCellVoltageTarget(
+    unsigned int cell) const {
   if (cell >= kCellCount) {
     return Err(ec::kChannelIndexOutOfRange);
   }
 
-  char buf[32]{};
-  fmt::format_to_n(buf, sizeof(buf) - 1, "SOUR{}:VOLT?\r\n", cell + 1);
+  const auto cmd = scpi::ChannelCommand<"SOUR", ":VOLT?\r\n", kCellCount>(cell);
 
-  return SendAndRecv(buf).and_then(scpi::ParseFloatResponse);
+  scpi::ResponseBuffer resp_buf;
+  return SendAndRecv(cmd, resp_buf).and_then(scpi::ParseFloatResponse);
 }
 
-Result<std::array<float, kCellCount>> ScpiClient::GetAllCellVoltageTargets()
-    const {
-  char buf[32]{};
-  fmt::format_to_n(buf, sizeof(buf) - 1, "SOUR:VOLT? (@1:{})\r\n", kCellCount);
-  return SendAndRecv(buf).and_then(scpi::ParseRespFloatArray<kCellCount>);
+template <class Driver>
+Result<std::array<float, kCellCount>>
+BasicScpiClient<Driver>::GetAllCellVoltageTargets() const {
+  constexpr auto cmd =
+      scpi::ChannelListCommand<"SOUR:VOLT? ", "\r\n", kCellCount>(kCellCount);
+  scpi::ResponseBuffer resp_buf;
+  return SendAndRecv(cmd, resp_buf)
+      .and_then(scpi::ParseRespFloatArray<kCellCount>);
 }
 
-ErrorCode ScpiClient::GetAllCellVoltageTargets(float* voltages,
-                                               std::size_t count) const {
+template <class Driver>
+ErrorCode BasicScpiClient<Driver>::GetAllCellVoltageTargets(
+    float* voltages, std::size_t count) const {
   if ((!voltages && count > 0) || count > kCellCount) {
     return ec::kInvalidArgument;
   }
@@ -205,10 +279,11 @@ ErrorCode ScpiClient::GetAllCellVoltageTargets(float* voltages,
     return ec::kSuccess;
   }
 
-  char buf[32]{};
-  fmt::format_to_n(buf, sizeof(buf) - 1, "SOUR:VOLT? (@1:{})\r\n", count);
+  const auto cmd =
+      scpi::ChannelListCommand<"SOUR:VOLT? ", "\r\n", kCellCount>(count);
 
-  auto resp = SendAndRecv(buf);
+  scpi::ResponseBuffer resp_buf;
+  auto resp = SendAndRecv(cmd, resp_buf);
   if (!resp) {
     return resp.error();
   }
@@ -216,43 +291,51 @@ ErrorCode ScpiClient::GetAllCellVoltageTargets(float* voltages,
   return scpi::SplitRespFloats(*resp, std::span{voltages, count});
 }
 
-ErrorCode ScpiClient::GetAllCellVoltageTargets(
+template <class Driver>
+ErrorCode BasicScpiClient<Driver>::GetAllCellVoltageTargets(
     std::array<float, kCellCount>& voltages) const {
   return GetAllCellVoltageTargets(voltages.data(), voltages.size());
 }
 
-ErrorCode ScpiClient::GetAllCellVoltageTargets(
+template <class Driver>
+ErrorCode BasicScpiClient<Driver>::GetAllCellVoltageTargets(
     std::span<float> voltages) const {
   return GetAllCellVoltageTargets(voltages.data(), voltages.size());
 }
 
-ErrorCode ScpiClient::SetCellSourcing(unsigned int cell, float limit) const {
+template <class Driver>
+ErrorCode BasicScpiClient<Driver>::SetCellSourcing(unsigned int cell,
+                                                   float limit) const {
   if (cell >= kCellCount) {
     return ec::kChannelIndexOutOfRange;
   }
 
-  limit = std::clamp(limit, 0.0f, kMaxSourcing);
+  limit = limits::ClampSourcing(limit);
 
-  char buf[64]{};
-  fmt::format_to_n(buf, sizeof(buf) - 1, "SOUR{}:CURR:SRC {:.4f}\r\n", cell + 1,
-                   limit);
+  scpi::CommandBuffer<64> buf;
+  buf.Append(scpi::ChannelCommand<"SOUR", ":CURR:SRC ", kCellCount>(cell));
+  buf.AppendFixed<4>(limit);
+  buf.Append("\r\n");
 
-  return Send(buf);
+  return Send(buf.View());
 }
 
-ErrorCode ScpiClient::SetAllCellSourcing(float limit) const {
-  limit = std::clamp(limit, 0.0f, kMaxSourcing);
+template <class Driver>
+ErrorCode BasicScpiClient<Driver>::SetAllCellSourcing(float limit) const {
+  limit = limits::ClampSourcing(limit);
 
-  char buf[64]{};
-  fmt::format_to_n(buf, sizeof(buf) - 1, "SOUR:CURR:SRC {:.4f},(@1:{})\r\n",
-                   limit, kCellCount);
+  scpi::CommandBuffer<64> buf;
+  buf.Append("SOUR:CURR:SRC ");
+  buf.AppendFixed<4>(limit);
+  buf.Append(scpi::ChannelListCommand<",", "\r\n", kCellCount>(kCellCount));
 
-  return Send(buf);
+  return Send(buf.View());
 }
 
-ErrorCode ScpiClient::SetAllCellSourcing(const float* limits,
-                                         std::size_t count) const {
-  if ((count > 0 && !limits) || count > kCellCount) {
+template <class Driver>
+ErrorCode BasicScpiClient<Driver>::SetAllCellSourcing(
+    const float* cell_limits, std::size_t count) const {
+  if ((count > 0 && !cell_limits) || count > kCellCount) {
     return ec::kInvalidArgument;
   }
 
@@ -260,30 +343,37 @@ ErrorCode ScpiClient::SetAllCellSourcing(const float* limits,
     return ec::kSuccess;
   }
 
-  std::string buf;
-  // try to do only one allocation
-  buf.reserve(count * 23 + 2);
+  scpi::CommandBuffer<kCellCount * kSourcingEntryLen + 2> buf;
   for (std::size_t i = 0; i < count; ++i) {
-    fmt::format_to(std::back_inserter(buf), ":SOUR{}:CURR:SRC {:.4f};", i + 1,
-                   std::clamp(limits[i], 0.0f, kMaxSourcing));
+    buf.Append(scpi::ChannelCommand<":SOUR", ":CURR:SRC ", kCellCount>(i));
+    buf.AppendFixed<4>(limits::ClampSourcing(cell_limits[i]));
+    buf.Append(";");
+  }
+  buf.Append("\r\n");
+
+  if (buf.Overflowed()) {
+    return ec::kBufferTooSmall;
   }
-  buf += "\r\n";
 
-  return Send(buf);
+  return Send(buf.View());
 }
 
-ErrorCode ScpiClient::SetAllCellSourcing(std::span<const float> limits) const {
+template <class Driver>
+ErrorCode BasicScpiClient<Driver>::SetAllCellSourcing(
+    std::span<const float> limits) const {
   return SetAllCellSourcing(limits.data(), limits.size());
 }
 
-ErrorCode ScpiClient::SetAllCellSourcing(
+template <class Driver>
+ErrorCode BasicScpiClient<Driver>::SetAllCellSourcing(
     const std::array<float, kCellCount>& limits) const {
   return SetAllCellSourcing(limits.data(), limits.size());
 }
 
-ErrorCode ScpiClient::SetMultipleCellSourcing(unsigned int cells,
-                                              float limit) const {
-  limit = std::clamp(limit, 0.0f, kMaxSourcing);
+template <class Driver>
+ErrorCode BasicScpiClient<Driver>::SetMultipleCellSourcing(unsigned int cells,
+                                                           float limit) const {
+  limit = limits::ClampSourcing(limit);
 
   cells &= kCellsMask;
   if (cells) {
@@ -300,36 +390,75 @@ ErrorCode ScpiClient::SetMultipleCellSourcing(unsigned int cells,
     }
 
     std::span chan_list{which_cells.data(), count};
-    char buf[64]{};
-    fmt::format_to_n(buf, sizeof(buf) - 1, "SOUR:CURR:SRC {:.4f},(@{})\r\n",
-                     limit, fmt::join(chan_list, ","));
-    return Send(buf);
+    scpi::CommandBuffer<64> buf;
+    buf.Append("SOUR:CURR:SRC ");
+    buf.AppendFixed<4>(limit);
+    buf.Append(",(@{})\r\n", fmt::join(chan_list, ","));
+    return Send(buf.View());
   }
 
   return ec::kSuccess;
 }
 
-Result<float> ScpiClient::GetCellSourcingLimit(unsigned int cell) const {
+template <class Driver>
+ErrorCode BasicScpiClient<Driver>::SetCellSourcingDelta(
+    std::span<const float> prev, std::span<const float> next) const {
+  if (prev.size() != next.size() || next.size() > kCellCount) {
+    return ec::kInvalidArgument;
+  }
+
+  scpi::CommandBuffer<kCellCount * kSourcingEntryLen + 2> buf;
+  const bool changed = scpi::AppendChanges<kCellCount>(
+      buf, ":SOUR", ":CURR:SRC", prev, next,
+      [](float v) { return limits::ClampSourcing(v); },
+      [](auto& b, float v) { b.template AppendFixed<4>(v); });
+  if (!changed) {
+    return ec::kSuccess;
+  }
+  buf.Append("\r\n");
+
+  if (buf.Overflowed()) {
+    return ec::kBufferTooSmall;
+  }
+
+  return Send(buf.View());
+}
+
+template <class Driver>
+ErrorCode BasicScpiClient<Driver>::SetCellSourcingDelta(
+    const std::array<float, kCellCount>& prev,
+    const std::array<float, kCellCount>& next) const {
+  return SetCellSourcingDelta(std::span{prev}, std::span{next});
+}
+
+template <class Driver>
+Result<float> BasicScpiClient<Driver>::GetCellSourcingLimit(
+    unsigned int cell) const {
   if (cell >= kCellCount) {
     return Err(ec::kChannelIndexOutOfRange);
   }
 
-  char buf[32]{};
-  fmt::format_to_n(buf, sizeof(buf) - 1, "SOUR{}:CURR:SRC?\r\n", cell + 1);
+  const auto cmd =
+      scpi::ChannelCommand<"SOUR", ":CURR:SRC?\r\n", kCellCount>(cell);
 
-  return SendAndRecv(buf).and_then(scpi::ParseFloatResponse);
+  scpi::ResponseBuffer resp_buf;
+  return SendAndRecv(cmd, resp_buf).and_then(scpi::ParseFloatResponse);
 }
 
-Result<std::array<float, kCellCount>> ScpiClient::GetAllCellSourcingLimits()
-    const {
-  char buf[32]{};
-  fmt::format_to_n(buf, sizeof(buf) - 1, "SOUR:CURR:SRC? (@1:{})\r\n",
-                   kCellCount);
-  return SendAndRecv(buf).and_then(scpi::ParseRespFloatArray<kCellCount>);
+template <class Driver>
+Result<std::array<float, kCellCount>>
+BasicScpiClient<Driver>::GetAllCellSourcingLimits() const {
+  constexpr auto cmd =
+      scpi::ChannelListCommand<"SOUR:CURR:SRC? ", "\r\n", kCellCount>(
+          kCellCount);
+  scpi::ResponseBuffer resp_buf;
+  return SendAndRecv(cmd, resp_buf)
+      .and_then(scpi::ParseRespFloatArray<kCellCount>);
 }
 
-ErrorCode ScpiClient::GetAllCellSourcingLimits(float* limits,
-                                               std::size_t count) const {
+template <class Driver>
+ErrorCode BasicScpiClient<Driver>::GetAllCellSourcingLimits(
+    float* limits, std::size_t count) const {
   if ((!limits && count > 0) || count > kCellCount) {
     return ec::kInvalidArgument;
   }
@@ -338,10 +467,11 @@ ErrorCode ScpiClient::GetAllCellSourcingLimits(float* limits,
     return ec::kSuccess;
   }
 
-  char buf[32]{};
-  fmt::format_to_n(buf, sizeof(buf) - 1, "SOUR:CURR:SRC? (@1:{})\r\n", count);
+  const auto cmd =
+      scpi::ChannelListCommand<"SOUR:CURR:SRC? ", "\r\n", kCellCount>(count);
 
-  auto resp = SendAndRecv(buf);
+  scpi::ResponseBuffer resp_buf;
+  auto resp = SendAndRecv(cmd, resp_buf);
   if (!resp) {
     return resp.error();
   }
@@ -349,42 +479,51 @@ ErrorCode ScpiClient::GetAllCellSourcingLimits(float* limits,
   return scpi::SplitRespFloats(*resp, std::span{limits, count});
 }
 
-ErrorCode ScpiClient::GetAllCellSourcingLimits(
+template <class Driver>
+ErrorCode BasicScpiClient<Driver>::GetAllCellSourcingLimits(
     std::array<float, kCellCount>& limits) const {
   return GetAllCellSourcingLimits(limits.data(), limits.size());
 }
 
-ErrorCode ScpiClient::GetAllCellSourcingLimits(std::span<float> limits) const {
+template <class Driver>
+ErrorCode BasicScpiClient<Driver>::GetAllCellSourcingLimits(
+    std::span<float> limits) const {
   return GetAllCellSourcingLimits(limits.data(), limits.size());
 }
 
-ErrorCode ScpiClient::SetCellSinking(unsigned int cell, float limit) const {
+template <class Driver>
+ErrorCode BasicScpiClient<Driver>::SetCellSinking(unsigned int cell,
+                                                  float limit) const {
   if (cell >= kCellCount) {
     return ec::kChannelIndexOutOfRange;
   }
 
-  limit = std::clamp(limit, -kMaxSinking, kMaxSinking);
+  limit = limits::ClampSinking(limit);
 
-  char buf[64]{};
-  fmt::format_to_n(buf, sizeof(buf) - 1, "SOUR{}:CURR:SNK {:.4f}\r\n", cell + 1,
-                   limit);
+  scpi::CommandBuffer<64> buf;
+  buf.Append(scpi::ChannelCommand<"SOUR", ":CURR:SNK ", kCellCount>(cell));
+  buf.AppendFixed<4>(limit);
+  buf.Append("\r\n");
 
-  return Send(buf);
+  return Send(buf.View());
 }
 
-ErrorCode ScpiClient::SetAllCellSinking(float limit) const {
-  limit = std::clamp(limit, -kMaxSinking, kMaxSinking);
+template <class Driver>
+ErrorCode BasicScpiClient<Driver>::SetAllCellSinking(float limit) const {
+  limit = limits::ClampSinking(limit);
 
-  char buf[64]{};
-  fmt::format_to_n(buf, sizeof(buf) - 1, "SOUR:CURR:SNK {:.4f},(@1:{})\r\n",
-                   limit, kCellCount);
+  scpi::CommandBuffer<64> buf;
+  buf.Append("SOUR:CURR:SNK ");
+  buf.AppendFixed<4>(limit);
+  buf.Append(scpi::ChannelListCommand<",", "\r\n", kCellCount>(kCellCount));
 
-  return Send(buf);
+  return Send(buf.View());
 }
 
-ErrorCode ScpiClient::SetAllCellSinking(const float* limits,
-                                        std::size_t count) const {
-  if ((count > 0 && !limits) || count > kCellCount) {
+template <class Driver>
+ErrorCode BasicScpiClient<Driver>::SetAllCellSinking(
+    const float* cell_limits, std::size_t count) const {
+  if ((count > 0 && !cell_limits) || count > kCellCount) {
     return ec::kInvalidArgument;
   }
 
@@ -392,30 +531,37 @@ ErrorCode ScpiClient::SetAllCellSinking(const float* limits,
     return ec::kSuccess;
   }
 
-  std::string buf;
-  // try to do only one allocation
-  buf.reserve(count * 23 + 2);
+  scpi::CommandBuffer<kCellCount * kSinkingEntryLen + 2> buf;
   for (std::size_t i = 0; i < count; ++i) {
-    fmt::format_to(std::back_inserter(buf), ":SOUR{}:CURR:SNK {:.4f};", i + 1,
-                   std::clamp(limits[i], -kMaxSinking, kMaxSinking));
+    buf.Append(scpi::ChannelCommand<":SOUR", ":CURR:SNK ", kCellCount>(i));
+    buf.AppendFixed<4>(limits::ClampSinking(cell_limits[i]));
+    buf.Append(";");
+  }
+  buf.Append("\r\n");
+
+  if (buf.Overflowed()) {
+    return ec::kBufferTooSmall;
   }
-  buf += "\r\n";
 
-  return Send(buf);
+  return Send(buf.View());
 }
 
-ErrorCode ScpiClient::SetAllCellSinking(std::span<const float> limits) const {
+template <class Driver>
+ErrorCode BasicScpiClient<Driver>::SetAllCellSinking(
+    std::span<const float> limits) const {
   return SetAllCellSinking(limits.data(), limits.size());
 }
 
-ErrorCode ScpiClient::SetAllCellSinking(
+template <class Driver>
+ErrorCode BasicScpiClient<Driver>::SetAllCellSinking(
     const std::array<float, kCellCount>& limits) const {
   return SetAllCellSinking(limits.data(), limits.size());
 }
 
-ErrorCode ScpiClient::SetMultipleCellSinking(unsigned int cells,
-                                             float limit) const {
-  limit = std::clamp(limit, -kMaxSinking, kMaxSinking);
+template <class Driver>
+ErrorCode BasicScpiClient<Driver>::SetMultipleCellSinking(unsigned int cells,
+                                                          float limit) const {
+  limit = limits::ClampSinking(limit);
 
   cells &= kCellsMask;
   if (cells) {
@@ -432,36 +578,75 @@ ErrorCode ScpiClient::SetMultipleCellSinking(unsigned int cells,
     }
 
     std::span chan_list{which_cells.data(), count};
-    char buf[64]{};
-    fmt::format_to_n(buf, sizeof(buf) - 1, "SOUR:CURR:SNK {:.4f},(@{})\r\n",
-                     limit, fmt::join(chan_list, ","));
-    return Send(buf);
+    scpi::CommandBuffer<64> buf;
+    buf.Append("SOUR:CURR:SNK ");
+    buf.AppendFixed<4>(limit);
+    buf.Append(",(@{})\r\n", fmt::join(chan_list, ","));
+    return Send(buf.View());
   }
 
   return ec::kSuccess;
 }
 
-Result<float> ScpiClient::GetCellSinkingLimit(unsigned int cell) const {
+template <class Driver>
+ErrorCode BasicScpiClient<Driver>::SetCellSinkingDelta(
+    std::span<const float> prev, std::span<const float> next) const {
+  if (prev.size() != next.size() || next.size() > kCellCount) {
+    return ec::kInvalidArgument;
+  }
+
+  scpi::CommandBuffer<kCellCount * kSinkingEntryLen + 2> buf;
+  const bool changed = scpi::AppendChanges<kCellCount>(
+      buf, ":SOUR", ":CURR:SNK", prev, next,
+      [](float v) { return limits::ClampSinking(v); },
+      [](auto& b, float v) { b.template AppendFixed<4>(v); });
+  if (!changed) {
+    return ec::kSuccess;
+  }
+  buf.Append("\r\n");
+
+  if (buf.Overflowed()) {
+    return ec::kBufferTooSmall;
+  }
+
+  return Send(buf.View());
+}
+
+template <class Driver>
+ErrorCode BasicScpiClient<Driver>::SetCellSinkingDelta(
+    const std::array<float, kCellCount>& prev,
+    const std::array<float, kCellCount>& next) const {
+  return SetCellSinkingDelta(std::span{prev}, std::span{next});
+}
+
+template <class Driver>
+Result<float> BasicScpiClient<Driver>::GetCellSinkingLimit(
+    unsigned int cell) const {
   if (cell >= kCellCount) {
     return Err(ec::kChannelIndexOutOfRange);
   }
 
-  char buf[32]{};
-  fmt::format_to_n(buf, sizeof(buf) - 1, "SOUR{}:CURR:SNK?\r\n", cell + 1);
+  const auto cmd =
+      scpi::ChannelCommand<"SOUR", ":CURR:SNK?\r\n", kCellCount>(cell);
 
-  return SendAndRecv(buf).and_then(scpi::ParseFloatResponse);
+  scpi::ResponseBuffer resp_buf;
+  return SendAndRecv(cmd, resp_buf).and_then(scpi::ParseFloatResponse);
 }
 
-Result<std::array<float, kCellCount>> ScpiClient::GetAllCellSinkingLimits()
-    const {
-  char buf[32]{};
-  fmt::format_to_n(buf, sizeof(buf) - 1, "SOUR:CURR:SNK? (@1:{})\r\n",
-                   kCellCount);
-  return SendAndRecv(buf).and_then(scpi::ParseRespFloatArray<kCellCount>);
+template <class Driver>
+Result<std::array<float, kCellCount>>
+BasicScpiClient<Driver>::GetAllCellSinkingLimits() const {
+  constexpr auto cmd =
+      scpi::ChannelListCommand<"SOUR:CURR:SNK? ", "\r\n", kCellCount>(
+          kCellCount);
+  scpi::ResponseBuffer resp_buf;
+  return SendAndRecv(cmd, resp_buf)
+      .and_then(scpi::ParseRespFloatArray<kCellCount>);
 }
 
-ErrorCode ScpiClient::GetAllCellSinkingLimits(float* limits,
-                                              std::size_t count) const {
+template <class Driver>
+ErrorCode BasicScpiClient<Driver>::GetAllCellSinkingLimits(
+    float* limits, std::size_t count) const {
   if ((!limits && count > 0) || count > kCellCount) {
     return ec::kInvalidArgument;
   }
@@ -470,10 +655,11 @@ ErrorCode ScpiClient::GetAllCellSinkingLimits(float* limits,
     return ec::kSuccess;
   }
 
-  char buf[32]{};
-  fmt::format_to_n(buf, sizeof(buf) - 1, "SOUR:CURR:SNK? (@1:{})\r\n", count);
+  const auto cmd =
+      scpi::ChannelListCommand<"SOUR:CURR:SNK? ", "\r\n", kCellCount>(count);
 
-  auto resp = SendAndRecv(buf);
+  scpi::ResponseBuffer resp_buf;
+  auto resp = SendAndRecv(cmd, resp_buf);
   if (!resp) {
     return resp.error();
   }
@@ -481,16 +667,21 @@ ErrorCode ScpiClient::GetAllCellSinkingLimits(float* limits,
   return scpi::SplitRespFloats(*resp, std::span{limits, count});
 }
 
-ErrorCode ScpiClient::GetAllCellSinkingLimits(
+template <class Driver>
+ErrorCode BasicScpiClient<Driver>::GetAllCellSinkingLimits(
     std::array<float, kCellCount>& limits) const {
   return GetAllCellSinkingLimits(limits.data(), limits.size());
 }
 
-ErrorCode ScpiClient::GetAllCellSinkingLimits(std::span<float> limits) const {
+template <class Driver>
+ErrorCode BasicScpiClient<Driver>::GetAllCellSinkingLimits(
+    std::span<float> limits) const {
   return GetAllCellSinkingLimits(limits.data(), limits.size());
 }
 
-ErrorCode ScpiClient::SetCellFault(unsigned int cell, CellFault fault) const {
+template <class Driver>
+ErrorCode BasicScpiClient<Driver>::SetCellFault(unsigned int cell,
+                                                CellFault fault) const {
   if (cell >= kCellCount) {
     return ec::kChannelIndexOutOfRange;
   }
@@ -500,27 +691,32 @@ ErrorCode ScpiClient::SetCellFault(unsigned int cell, CellFault fault) const {
     return ec::kInvalidFaultType;
   }
 
-  char buf[32]{};
-  fmt::format_to_n(buf, sizeof(buf) - 1, "OUTP{}:FAUL {}\r\n", cell + 1, fstr);
+  scpi::CommandBuffer<32> buf;
+  buf.Append(scpi::ChannelCommand<"OUTP", ":FAUL ", kCellCount>(cell));
+  buf.Append(fstr);
+  buf.Append("\r\n");
 
-  return Send(buf);
+  return Send(buf.View());
 }
 
-ErrorCode ScpiClient::SetAllCellFaults(CellFault fault) const {
+template <class Driver>
+ErrorCode BasicScpiClient<Driver>::SetAllCellFaults(CellFault fault) const {
   auto fstr = scpi::CellFaultMnemonic(fault);
   if (fstr.empty()) {
     return ec::kInvalidFaultType;
   }
 
-  char buf[64]{};
-  fmt::format_to_n(buf, sizeof(buf) - 1, "OUTP:FAUL {},(@1:{})\r\n", fstr,
-                   kCellCount);
+  scpi::CommandBuffer<64> buf;
+  buf.Append("OUTP:FAUL ");
+  buf.Append(fstr);
+  buf.Append(scpi::ChannelListCommand<",", "\r\n", kCellCount>(kCellCount));
 
-  return Send(buf);
+  return Send(buf.View());
 }
 
-ErrorCode ScpiClient::SetAllCellFaults(const CellFault* faults,
-                                       std::size_t count) const {
+template <class Driver>
+ErrorCode BasicScpiClient<Driver>::SetAllCellFaults(const CellFault* faults,
+                                                    std::size_t count) const {
   if ((count > 0 && !faults) || count > kCellCount) {
     return ec::kInvalidArgument;
   }
@@ -529,33 +725,40 @@ ErrorCode ScpiClient::SetAllCellFaults(const CellFault* faults,
     return ec::kSuccess;
   }
 
-  std::string buf;
-  // try to do only one allocation
-  buf.reserve(count * 18 + 2);
+  scpi::CommandBuffer<kCellCount * kFaultEntryLen + 2> buf;
   for (std::size_t i = 0; i < count; ++i) {
     auto fstr = scpi::CellFaultMnemonic(faults[i]);
     if (fstr.empty()) {
       return ec::kInvalidFaultType;
     }
-    fmt::format_to(std::back_inserter(buf), ":OUTP{}:FAUL {};", i + 1, fstr);
+    buf.Append(scpi::ChannelCommand<":OUTP", ":FAUL ", kCellCount>(i));
+    buf.Append(fstr);
+    buf.Append(";");
   }
-  buf += "\r\n";
+  buf.Append("\r\n");
 
-  return Send(buf);
+  if (buf.Overflowed()) {
+    return ec::kBufferTooSmall;
+  }
+
+  return Send(buf.View());
 }
 
-ErrorCode ScpiClient::SetAllCellFaults(
+template <class Driver>
+ErrorCode BasicScpiClient<Driver>::SetAllCellFaults(
     std::span<const CellFault> faults) const {
   return SetAllCellFaults(faults.data(), faults.size());
 }
 
-ErrorCode ScpiClient::SetAllCellFaults(
+template <class Driver>
+ErrorCode BasicScpiClient<Driver>::SetAllCellFaults(
     const std::array<CellFault, kCellCount>& faults) const {
   return SetAllCellFaults(faults.data(), faults.size());
 }
 
-ErrorCode ScpiClient::SetMultipleCellFaults(unsigned int cells,
-                                            CellFault fault) const {
+template <class Driver>
+ErrorCode BasicScpiClient<Driver>::SetMultipleCellFaults(
+    unsigned int cells, CellFault fault) const {
   cells &= kCellsMask;
   if (cells) {
     if (cells == kCellsMask) {
@@ -576,34 +779,42 @@ ErrorCode ScpiClient::SetMultipleCellFaults(unsigned int cells,
     }
 
     std::span chan_list{which_cells.data(), count};
-    char buf[64]{};
-    fmt::format_to_n(buf, sizeof(buf) - 1, "OUTP:FAUL {},(@{})\r\n", fstr,
-                     fmt::join(chan_list, ","));
-    return Send(buf);
+    scpi::CommandBuffer<64> buf;
+    buf.Append("OUTP:FAUL ");
+    buf.Append(fstr);
+    buf.Append(",(@{})\r\n", fmt::join(chan_list, ","));
+    return Send(buf.View());
   }
 
   return ec::kSuccess;
 }
 
-Result<CellFault> ScpiClient::GetCellFault(unsigned int cell) const {
+template <class Driver>
+Result<CellFault> BasicScpiClient<Driver>::GetCellFault(
+    unsigned int cell) const {
   if (cell >= kCellCount) {
     return Err(ec::kChannelIndexOutOfRange);
   }
 
-  char buf[32]{};
-  fmt::format_to_n(buf, sizeof(buf) - 1, "OUTP{}:FAUL?\r\n", cell + 1);
+  const auto cmd = scpi::ChannelCommand<"OUTP", ":FAUL?\r\n", kCellCount>(cell);
 
-  return SendAndRecv(buf).and_then(scpi::ParseCellFault);
+  scpi::ResponseBuffer resp_buf;
+  return SendAndRecv(cmd, resp_buf).and_then(scpi::ParseCellFault);
 }
 
-Result<std::array<CellFault, kCellCount>> ScpiClient::GetAllCellFaults() const {
-  char buf[32]{};
-  fmt::format_to_n(buf, sizeof(buf) - 1, "OUTP:FAUL? (@1:{})\r\n", kCellCount);
-  return SendAndRecv(buf).and_then(scpi::ParseCellFaultArray<kCellCount>);
+template <class Driver>
+Result<std::array<CellFault, kCellCount>>
+BasicScpiClient<Driver>::GetAllCellFaults() const {
+  constexpr auto cmd =
+      scpi::ChannelListCommand<"OUTP:FAUL? ", "\r\n", kCellCount>(kCellCount);
+  scpi::ResponseBuffer resp_buf;
+  return SendAndRecv(cmd, resp_buf)
+      .and_then(scpi::ParseCellFaultArray<kCellCount>);
 }
 
-ErrorCode ScpiClient::GetAllCellFaults(CellFault* faults,
-                                       std::size_t count) const {
+template <class Driver>
+ErrorCode BasicScpiClient<Driver>::GetAllCellFaults(CellFault* faults,
+                                                    std::size_t count) const {
   if ((!faults && count > 0) || count > kCellCount) {
     return ec::kInvalidArgument;
   }
@@ -612,10 +823,11 @@ ErrorCode ScpiClient::GetAllCellFaults(CellFault* faults,
     return ec::kSuccess;
   }
 
-  char buf[32]{};
-  fmt::format_to_n(buf, sizeof(buf) - 1, "OUTP:FAUL? (@1:{})\r\n", count);
+  const auto cmd =
+      scpi::ChannelListCommand<"OUTP:FAUL? ", "\r\n", kCellCount>(count);
 
-  auto resp = SendAndRecv(buf);
+  scpi::ResponseBuffer resp_buf;
+  auto resp = SendAndRecv(cmd, resp_buf);
   if (!resp) {
     return resp.error();
   }
@@ -624,17 +836,21 @@ ErrorCode ScpiClient::GetAllCellFaults(CellFault* faults,
                                   scpi::ParseCellFault);
 }
 
-ErrorCode ScpiClient::GetAllCellFaults(
+template <class Driver>
+ErrorCode BasicScpiClient<Driver>::GetAllCellFaults(
     std::array<CellFault, kCellCount>& faults) const {
   return GetAllCellFaults(faults.data(), faults.size());
 }
 
-ErrorCode ScpiClient::GetAllCellFaults(std::span<CellFault> faults) const {
+template <class Driver>
+ErrorCode BasicScpiClient<Driver>::GetAllCellFaults(
+    std::span<CellFault> faults) const {
   return GetAllCellFaults(faults.data(), faults.size());
 }
 
-ErrorCode ScpiClient::SetCellSenseRange(unsigned int cell,
-                                        CellSenseRange range) const {
+template <class Driver>
+ErrorCode BasicScpiClient<Driver>::SetCellSenseRange(
+    unsigned int cell, CellSenseRange range) const {
   if (cell >= kCellCount) {
     return ec::kChannelIndexOutOfRange;
   }
@@ -644,27 +860,33 @@ ErrorCode ScpiClient::SetCellSenseRange(unsigned int cell,
     return ec::kInvalidSenseRange;
   }
 
-  char buf[32]{};
-  fmt::format_to_n(buf, sizeof(buf) - 1, "SENS{}:RANG {}\r\n", cell + 1, rstr);
+  scpi::CommandBuffer<32> buf;
+  buf.Append(scpi::ChannelCommand<"SENS", ":RANG ", kCellCount>(cell));
+  buf.Append(rstr);
+  buf.Append("\r\n");
 
-  return Send(buf);
+  return Send(buf.View());
 }
 
-ErrorCode ScpiClient::SetAllCellSenseRanges(CellSenseRange range) const {
+template <class Driver>
+ErrorCode BasicScpiClient<Driver>::SetAllCellSenseRanges(
+    CellSenseRange range) const {
   auto rstr = scpi::CellSenseRangeMnemonic(range);
   if (rstr.empty()) {
     return ec::kInvalidSenseRange;
   }
 
-  char buf[64]{};
-  fmt::format_to_n(buf, sizeof(buf) - 1, "SENS:RANG {},(@1:{})\r\n", rstr,
-                   kCellCount);
+  scpi::CommandBuffer<64> buf;
+  buf.Append("SENS:RANG ");
+  buf.Append(rstr);
+  buf.Append(scpi::ChannelListCommand<",", "\r\n", kCellCount>(kCellCount));
 
-  return Send(buf);
+  return Send(buf.View());
 }
 
-ErrorCode ScpiClient::SetAllCellSenseRanges(const CellSenseRange* ranges,
-                                            std::size_t count) const {
+template <class Driver>
+ErrorCode BasicScpiClient<Driver>::SetAllCellSenseRanges(
+    const CellSenseRange* ranges, std::size_t count) const {
   if ((count > 0 && !ranges) || count > kCellCount) {
     return ec::kInvalidArgument;
   }
@@ -673,51 +895,63 @@ ErrorCode ScpiClient::SetAllCellSenseRanges(const CellSenseRange* ranges,
     return ec::kSuccess;
   }
 
-  std::string buf;
-  // try to do only one allocation
-  buf.reserve(count * 17 + 2);
+  scpi::CommandBuffer<kCellCount * kSenseRangeEntryLen + 2> buf;
   for (std::size_t i = 0; i < count; ++i) {
     auto rstr = scpi::CellSenseRangeMnemonic(ranges[i]);
     if (rstr.empty()) {
       return ec::kInvalidSenseRange;
     }
-    fmt::format_to(std::back_inserter(buf), ":SENS{}:RANG {};", i + 1, rstr);
+    buf.Append(scpi::ChannelCommand<":SENS", ":RANG ", kCellCount>(i));
+    buf.Append(rstr);
+    buf.Append(";");
+  }
+  buf.Append("\r\n");
+
+  if (buf.Overflowed()) {
+    return ec::kBufferTooSmall;
   }
-  buf += "\r\n";
 
-  return Send(buf);
+  return Send(buf.View());
 }
 
-ErrorCode ScpiClient::SetAllCellSenseRanges(
+template <class Driver>
+ErrorCode BasicScpiClient<Driver>::SetAllCellSenseRanges(
     std::span<const CellSenseRange> ranges) const {
   return SetAllCellSenseRanges(ranges.data(), ranges.size());
 }
 
-ErrorCode ScpiClient::SetAllCellSenseRanges(
+template <class Driver>
+ErrorCode BasicScpiClient<Driver>::SetAllCellSenseRanges(
     const std::array<CellSenseRange, kCellCount>& ranges) const {
   return SetAllCellSenseRanges(ranges.data(), ranges.size());
 }
 
-Result<CellSenseRange> ScpiClient::GetCellSenseRange(unsigned int cell) const {
+template <class Driver>
+Result<CellSenseRange> BasicScpiClient<Driver>::GetCellSenseRange(
+    unsigned int cell) const {
   if (cell >= kCellCount) {
     return Err(ec::kChannelIndexOutOfRange);
   }
 
-  char buf[32]{};
-  fmt::format_to_n(buf, sizeof(buf) - 1, "SENS{}:RANG?\r\n", cell + 1);
+  const auto cmd = scpi::ChannelCommand<"SENS", ":RANG?\r\n", kCellCount>(cell);
 
-  return SendAndRecv(buf).and_then(scpi::ParseCellSenseRange);
+  scpi::ResponseBuffer resp_buf;
+  return SendAndRecv(cmd, resp_buf).and_then(scpi::ParseCellSenseRange);
 }
 
+template <class Driver>
 Result<std::array<CellSenseRange, kCellCount>>
-ScpiClient::GetAllCellSenseRanges() const {
-  char buf[32]{};
-  fmt::format_to_n(buf, sizeof(buf) - 1, "SENS:RANG? (@1:{})\r\n", kCellCount);
-  return SendAndRecv(buf).and_then(scpi::ParseCellSenseRangeArray<kCellCount>);
+BasicScpiClient<Driver>::GetAllCellSenseRanges() const {
+  constexpr auto cmd =
+      scpi::ChannelListCommand<"SENS:RANG? ", "\r\n", kCellCount>(kCellCount);
+  scpi::ResponseBuffer resp_buf;
+  return SendAndRecv(cmd, resp_buf)
+      .and_then(scpi::ParseCellSenseRangeArray<kCellCount>);
 }
 
-ErrorCode ScpiClient::GetAllCellSenseRanges(CellSenseRange* ranges,
-                                            std::size_t count) const {
+template <class Driver>
+ErrorCode BasicScpiClient<Driver>::GetAllCellSenseRanges(
+    CellSenseRange* ranges, std::size_t count) const {
   if ((!ranges && count > 0) || count > kCellCount) {
     return ec::kInvalidArgument;
   }
@@ -726,10 +960,11 @@ ErrorCode ScpiClient::GetAllCellSenseRanges(CellSenseRange* ranges,
     return ec::kSuccess;
   }
 
-  char buf[32]{};
-  fmt::format_to_n(buf, sizeof(buf) - 1, "SENS:RANG? (@1:{})\r\n", count);
+  const auto cmd =
+      scpi::ChannelListCommand<"SENS:RANG? ", "\r\n", kCellCount>(count);
 
-  auto resp = SendAndRecv(buf);
+  scpi::ResponseBuffer resp_buf;
+  auto resp = SendAndRecv(cmd, resp_buf);
   if (!resp) {
     return resp.error();
   }
@@ -738,46 +973,56 @@ ErrorCode ScpiClient::GetAllCellSenseRanges(CellSenseRange* ranges,
                                   scpi::ParseCellSenseRange);
 }
 
-ErrorCode ScpiClient::GetAllCellSenseRanges(
+template <class Driver>
+ErrorCode BasicScpiClient<Driver>::GetAllCellSenseRanges(
     std::array<CellSenseRange, kCellCount>& ranges) const {
   return GetAllCellSenseRanges(ranges.data(), ranges.size());
 }
 
-ErrorCode ScpiClient::GetAllCellSenseRanges(
+template <class Driver>
+ErrorCode BasicScpiClient<Driver>::GetAllCellSenseRanges(
     std::span<CellSenseRange> ranges) const {
   return GetAllCellSenseRanges(ranges.data(), ranges.size());
 }
 
-ErrorCode ScpiClient::EnableCellNoiseFilter(bool en) const {
-  char buf[64]{};
-  fmt::format_to_n(buf, sizeof(buf) - 1, "CONF:MEAS:FILT {:d}\r\n", en);
-  return Send(buf);
+template <class Driver>
+ErrorCode BasicScpiClient<Driver>::EnableCellNoiseFilter(bool en) const {
+  return Send(en ? "CONF:MEAS:FILT 1\r\n" : "CONF:MEAS:FILT 0\r\n");
 }
 
-Result<bool> ScpiClient::GetCellNoiseFilterEnabled() const {
-  return SendAndRecv("CONF:MEAS:FILT?\r\n").and_then(scpi::ParseBoolResponse);
+template <class Driver>
+Result<bool> BasicScpiClient<Driver>::GetCellNoiseFilterEnabled() const {
+  scpi::ResponseBuffer resp_buf;
+  return SendAndRecv("CONF:MEAS:FILT?\r\n", resp_buf)
+      .and_then(scpi::ParseBoolResponse);
 }
 
-Result<float> ScpiClient::MeasureCellVoltage(unsigned int cell) const {
+template <class Driver>
+Result<float> BasicScpiClient<Driver>::MeasureCellVoltage(
+    unsigned int cell) const {
   if (cell >= kCellCount) {
     return Err(ec::kChannelIndexOutOfRange);
   }
 
-  char buf[32]{};
-  fmt::format_to_n(buf, sizeof(buf) - 1, "MEAS{}:VOLT?\r\n", cell + 1);
+  const auto cmd = scpi::ChannelCommand<"MEAS", ":VOLT?\r\n", kCellCount>(cell);
 
-  return SendAndRecv(buf).and_then(scpi::ParseFloatResponse);
+  scpi::ResponseBuffer resp_buf;
+  return SendAndRecv(cmd, resp_buf).and_then(scpi::ParseFloatResponse);
 }
 
-Result<std::array<float, kCellCount>> ScpiClient::MeasureAllCellVoltages()
-    const {
-  char buf[32]{};
-  fmt::format_to_n(buf, sizeof(buf) - 1, "MEAS:VOLT? (@1:{})\r\n", kCellCount);
-  return SendAndRecv(buf).and_then(scpi::ParseRespFloatArray<kCellCount>);
+template <class Driver>
+Result<std::array<float, kCellCount>>
+BasicScpiClient<Driver>::MeasureAllCellVoltages() const {
+  constexpr auto cmd =
+      scpi::ChannelListCommand<"MEAS:VOLT? ", "\r\n", kCellCount>(kCellCount);
+  scpi::ResponseBuffer resp_buf;
+  return SendAndRecv(cmd, resp_buf)
+      .and_then(scpi::ParseRespFloatArray<kCellCount>);
 }
 
-ErrorCode ScpiClient::MeasureAllCellVoltages(float* voltages,
-                                             std::size_t count) const {
+template <class Driver>
+ErrorCode BasicScpiClient<Driver>::MeasureAllCellVoltages(
+    float* voltages, std::size_t count) const {
   if ((!voltages && count > 0) || count > kCellCount) {
     return ec::kInvalidArgument;
   }
@@ -786,10 +1031,11 @@ ErrorCode ScpiClient::MeasureAllCellVoltages(float* voltages,
     return ec::kSuccess;
   }
 
-  char buf[32]{};
-  fmt::format_to_n(buf, sizeof(buf) - 1, "MEAS:VOLT? (@1:{})\r\n", count);
+  const auto cmd =
+      scpi::ChannelListCommand<"MEAS:VOLT? ", "\r\n", kCellCount>(count);
 
-  auto resp = SendAndRecv(buf);
+  scpi::ResponseBuffer resp_buf;
+  auto resp = SendAndRecv(cmd, resp_buf);
   if (!resp) {
     return resp.error();
   }
@@ -797,35 +1043,44 @@ ErrorCode ScpiClient::MeasureAllCellVoltages(float* voltages,
   return scpi::SplitRespFloats(*resp, std::span{voltages, count});
 }
 
-ErrorCode ScpiClient::MeasureAllCellVoltages(
+template <class Driver>
+ErrorCode BasicScpiClient<Driver>::MeasureAllCellVoltages(
     std::array<float, kCellCount>& voltages) const {
   return MeasureAllCellVoltages(voltages.data(), voltages.size());
 }
 
-ErrorCode ScpiClient::MeasureAllCellVoltages(std::span<float> voltages) const {
+template <class Driver>
+ErrorCode BasicScpiClient<Driver>::MeasureAllCellVoltages(
+    std::span<float> voltages) const {
   return MeasureAllCellVoltages(voltages.data(), voltages.size());
 }
 
-Result<float> ScpiClient::MeasureCellCurrent(unsigned int cell) const {
+template <class Driver>
+Result<float> BasicScpiClient<Driver>::MeasureCellCurrent(
+    unsigned int cell) const {
   if (cell >= kCellCount) {
     return Err(ec::kChannelIndexOutOfRange);
   }
 
-  char buf[32]{};
-  fmt::format_to_n(buf, sizeof(buf) - 1, "MEAS{}:CURR?\r\n", cell + 1);
+  const auto cmd = scpi::ChannelCommand<"MEAS", ":CURR?\r\n", kCellCount>(cell);
 
-  return SendAndRecv(buf).and_then(scpi::ParseFloatResponse);
+  scpi::ResponseBuffer resp_buf;
+  return SendAndRecv(cmd, resp_buf).and_then(scpi::ParseFloatResponse);
 }
 
-Result<std::array<float, kCellCount>> ScpiClient::MeasureAllCellCurrents()
-    const {
-  char buf[32]{};
-  fmt::format_to_n(buf, sizeof(buf) - 1, "MEAS:CURR? (@1:{})\r\n", kCellCount);
-  return SendAndRecv(buf).and_then(scpi::ParseRespFloatArray<kCellCount>);
+template <class Driver>
+Result<std::array<float, kCellCount>>
+BasicScpiClient<Driver>::MeasureAllCellCurrents() const {
+  constexpr auto cmd =
+      scpi::ChannelListCommand<"MEAS:CURR? ", "\r\n", kCellCount>(kCellCount);
+  scpi::ResponseBuffer resp_buf;
+  return SendAndRecv(cmd, resp_buf)
+      .and_then(scpi::ParseRespFloatArray<kCellCount>);
 }
 
-ErrorCode ScpiClient::MeasureAllCellCurrents(float* currents,
-                                             std::size_t count) const {
+template <class Driver>
+ErrorCode BasicScpiClient<Driver>::MeasureAllCellCurrents(
+    float* currents, std::size_t count) const {
   if ((!currents && count > 0) || count > kCellCount) {
     return ec::kInvalidArgument;
   }
@@ -834,10 +1089,11 @@ ErrorCode ScpiClient::MeasureAllCellCurrents(float* currents,
     return ec::kSuccess;
   }
 
-  char buf[32]{};
-  fmt::format_to_n(buf, sizeof(buf) - 1, "MEAS:CURR? (@1:{})\r\n", count);
+  const auto cmd =
+      scpi::ChannelListCommand<"MEAS:CURR? ", "\r\n", kCellCount>(count);
 
-  auto resp = SendAndRecv(buf);
+  scpi::ResponseBuffer resp_buf;
+  auto resp = SendAndRecv(cmd, resp_buf);
   if (!resp) {
     return resp.error();
   }
@@ -845,36 +1101,44 @@ ErrorCode ScpiClient::MeasureAllCellCurrents(float* currents,
   return scpi::SplitRespFloats(*resp, std::span{currents, count});
 }
 
-ErrorCode ScpiClient::MeasureAllCellCurrents(
+template <class Driver>
+ErrorCode BasicScpiClient<Driver>::MeasureAllCellCurrents(
     std::array<float, kCellCount>& currents) const {
   return MeasureAllCellCurrents(currents.data(), currents.size());
 }
 
-ErrorCode ScpiClient::MeasureAllCellCurrents(std::span<float> currents) const {
+template <class Driver>
+ErrorCode BasicScpiClient<Driver>::MeasureAllCellCurrents(
+    std::span<float> currents) const {
   return MeasureAllCellCurrents(currents.data(), currents.size());
 }
 
-Result<CellMode> ScpiClient::GetCellOperatingMode(unsigned int cell) const {
+template <class Driver>
+Result<CellMode> BasicScpiClient<Driver>::GetCellOperatingMode(
+    unsigned int cell) const {
   if (cell >= kCellCount) {
     return Err(ec::kChannelIndexOutOfRange);
   }
 
-  char buf[32]{};
-  fmt::format_to_n(buf, sizeof(buf) - 1, "OUTP{}:MODE?\r\n", cell + 1);
+  const auto cmd = scpi::ChannelCommand<"OUTP", ":MODE?\r\n", kCellCount>(cell);
 
-  return SendAndRecv(buf).and_then(scpi::ParseCellOperatingMode);
+  scpi::ResponseBuffer resp_buf;
+  return SendAndRecv(cmd, resp_buf).and_then(scpi::ParseCellOperatingMode);
 }
 
-Result<std::array<CellMode, kCellCount>> ScpiClient::GetAllCellOperatingModes()
-    const {
-  char buf[32]{};
-  fmt::format_to_n(buf, sizeof(buf) - 1, "OUTP:MODE? (@1:{})\r\n", kCellCount);
-  return SendAndRecv(buf).and_then(
+template <class Driver>
+Result<std::array<CellMode, kCellCount>>
+BasicScpiClient<Driver>::GetAllCellOperatingModes() const {
+  constexpr auto cmd =
+      scpi::ChannelListCommand<"OUTP:MODE? ", "\r\n", kCellCount>(kCellCount);
+  scpi::ResponseBuffer resp_buf;
+  return SendAndRecv(cmd, resp_buf).and_then(
       scpi::ParseCellOperatingModeArray<kCellCount>);
 }
 
-ErrorCode ScpiClient::GetAllCellOperatingModes(CellMode* modes,
-                                               std::size_t count) const {
+template <class Driver>
+ErrorCode BasicScpiClient<Driver>::GetAllCellOperatingModes(
+    CellMode* modes, std::size_t count) const {
   if ((!modes && count > 0) || count > kCellCount) {
     return ec::kInvalidArgument;
   }
@@ -883,10 +1147,11 @@ ErrorCode ScpiClient::GetAllCellOperatingModes(CellMode* modes,
     return ec::kSuccess;
   }
 
-  char buf[32]{};
-  fmt::format_to_n(buf, sizeof(buf) - 1, "OUTP:MODE? (@1:{})\r\n", count);
+  const auto cmd =
+      scpi::ChannelListCommand<"OUTP:MODE? ", "\r\n", kCellCount>(count);
 
-  auto resp = SendAndRecv(buf);
+  scpi::ResponseBuffer resp_buf;
+  auto resp = SendAndRecv(cmd, resp_buf);
   if (!resp) {
     return resp.error();
   }
@@ -895,14 +1160,22 @@ ErrorCode ScpiClient::GetAllCellOperatingModes(CellMode* modes,
                                   scpi::ParseCellOperatingMode);
 }
 
-ErrorCode ScpiClient::GetAllCellOperatingModes(
+template <class Driver>
+ErrorCode BasicScpiClient<Driver>::GetAllCellOperatingModes(
     std::array<CellMode, kCellCount>& modes) const {
   return GetAllCellOperatingModes(modes.data(), modes.size());
 }
 
-ErrorCode ScpiClient::GetAllCellOperatingModes(
+template <class Driver>
+ErrorCode BasicScpiClient<Driver>::GetAllCellOperatingModes(
     std::span<CellMode> modes) const {
   return GetAllCellOperatingModes(modes.data(), modes.size());
 }
 
+template class BasicScpiClient<drivers::CommDriver>;
+template class BasicScpiClient<drivers::TcpDriver>;
+template class BasicScpiClient<drivers::UdpDriver>;
+template class BasicScpiClient<drivers::UdpMcastDriver>;
+template class BasicScpiClient<drivers::SerialDriver>;
+
 }  // namespace bci::abs
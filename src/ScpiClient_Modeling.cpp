@@ -5,69 +5,111 @@
  * found in the LICENSE file or at https://opensource.org/license/BSD-3-Clause
  */
 
+#include <bci/abs/CommDriver.h>
 #include <bci/abs/ScpiClient.h>
+#include <bci/abs/SerialDriver.h>
+#include <bci/abs/TcpDriver.h>
+#include <bci/abs/UdpDriver.h>
+#include <bci/abs/UdpMulticastDriver.h>
 #include <fmt/core.h>
 #include <fmt/ranges.h>
 
 #include <array>
-#include <iterator>
+#include <cstddef>
 #include <span>
 #include <string_view>
 
+#include "CommandBuffer.h"
+#include "CommandTable.h"
 #include "ScpiUtil.h"
 #include "Util.h"
 
 namespace bci::abs {
 
+// Longest entry of the bulk model input commands, with room for any float in
+// its shortest form, e.g. ":MOD:GLOB8 -1.17549435e-38;".
+static constexpr std::size_t kModelInputEntryLen = 28;
+
+// Longest model I/O exchange: every input, then ":MOD:OUT? (@1:36)\r\n".
+static constexpr std::size_t kModelExchangeLen =
+    (kGlobalModelInputCount + kLocalModelInputCount) * kModelInputEntryLen + 20;
+
 using util::Err;
 using ec = ErrorCode;
 
-Result<std::uint8_t> ScpiClient::GetModelStatus() const {
-  return SendAndRecv("MOD:STAT?\r\n")
+template <class Driver>
+Result<std::uint8_t> BasicScpiClient<Driver>::GetModelStatus() const {
+  scpi::ResponseBuffer resp_buf;
+  return SendAndRecv("MOD:STAT?\r\n", resp_buf)
       .and_then(scpi::ParseIntResponse<std::uint8_t>);
 }
 
-ErrorCode ScpiClient::LoadModel() const { return Send("MOD:LOAD\r\n"); }
+template <class Driver>
+ErrorCode BasicScpiClient<Driver>::LoadModel() const {
+  return Send("MOD:LOAD\r\n");
+}
 
-ErrorCode ScpiClient::StartModel() const { return Send("MOD:START\r\n"); }
+template <class Driver>
+ErrorCode BasicScpiClient<Driver>::StartModel() const {
+  return Send("MOD:START\r\n");
+}
 
-ErrorCode ScpiClient::StopModel() const { return Send("MOD:STOP\r\n"); }
+template <class Driver>
+ErrorCode BasicScpiClient<Driver>::StopModel() const {
+  return Send("MOD:STOP\r\n");
+}
 
-ErrorCode ScpiClient::UnloadModel() const { return Send("MOD:UNLOAD\r\n"); }
+template <class Driver>
+ErrorCode BasicScpiClient<Driver>::UnloadModel() const {
+  return Send("MOD:UNLOAD\r\n");
+}
 
-Result<ModelInfo> ScpiClient::GetModelInfo() const {
-  auto res =
-      SendAndRecv("MOD:INFO?\r\n").and_then(scpi::ParseStringArrayResponse<2>);
+template <class Driver>
+Result<ModelInfo> BasicScpiClient<Driver>::GetModelInfo() const {
+  scpi::ResponseBuffer resp_buf;
+  auto res = SendAndRecv("MOD:INFO?\r\n", resp_buf)
+                 .and_then(scpi::ParseStringArrayResponse<2>);
   if (!res) {
     return Err(res.error());
   }
   return ModelInfo{std::move(res->at(0)), std::move(res->at(1))};
 }
 
-Result<std::string> ScpiClient::GetModelId() const {
-  return SendAndRecv("MOD:ID?\r\n").and_then(scpi::ParseStringResponse);
+template <class Driver>
+Result<std::string> BasicScpiClient<Driver>::GetModelId() const {
+  scpi::ResponseBuffer resp_buf;
+  return SendAndRecv("MOD:ID?\r\n", resp_buf)
+      .and_then(scpi::ParseStringResponse);
 }
 
-ErrorCode ScpiClient::SetGlobalModelInput(unsigned int index,
-                                          float value) const {
+template <class Driver>
+ErrorCode BasicScpiClient<Driver>::SetGlobalModelInput(unsigned int index,
+                                                       float value) const {
   if (index >= kGlobalModelInputCount) {
     return ec::kChannelIndexOutOfRange;
   }
 
-  char buf[64]{};
-  fmt::format_to_n(buf, sizeof(buf) - 1, "MOD:GLOB{} {}\r\n", index + 1, value);
-  return Send(buf);
+  scpi::CommandBuffer<64> buf;
+  buf.Append(
+      scpi::ChannelCommand<"MOD:GLOB", " ", kGlobalModelInputCount>(index));
+  buf.Append("{}", value);
+  buf.Append("\r\n");
+  return Send(buf.View());
 }
 
-ErrorCode ScpiClient::SetAllGlobalModelInputs(float value) const {
-  char buf[64]{};
-  fmt::format_to_n(buf, sizeof(buf) - 1, "MOD:GLOB {},(@1:{})\r\n", value,
-                   kGlobalModelInputCount);
-  return Send(buf);
+template <class Driver>
+ErrorCode BasicScpiClient<Driver>::SetAllGlobalModelInputs(float value) const {
+  scpi::CommandBuffer<64> buf;
+  buf.Append("MOD:GLOB ");
+  buf.Append("{}", value);
+  buf.Append(scpi::ChannelListCommand<",", "\r\n", kGlobalModelInputCount>(
+      kGlobalModelInputCount));
+  return Send(buf.View());
 }
 
-ErrorCode ScpiClient::SetAllGlobalModelInputs(const float* values,
-                                              std::size_t count) const {
+template <class Driver>
+ErrorCode BasicScpiClient<Driver>::SetAllGlobalModelInputs(
+    const float* values, std::size_t count) const {
   if ((count > 0 && !values) || count > kGlobalModelInputCount) {
     return ec::kInvalidArgument;
   }
@@ -76,50 +118,92 @@ ErrorCode ScpiClient::SetAllGlobalModelInputs(const float* values,
     return ec::kSuccess;
   }
 
-  std::string buf;
-  // try to do one allocation
-  buf.reserve(count * 30);
+  scpi::CommandBuffer<kGlobalModelInputCount * kModelInputEntryLen + 2> buf;
   for (std::size_t i = 0; i < count; ++i) {
-    fmt::format_to(std::back_inserter(buf), ":MOD:GLOB{} {};", i + 1,
-                   values[i]);
+    buf.Append(
+        scpi::ChannelCommand<":MOD:GLOB", " ", kGlobalModelInputCount>(i));
+    buf.Append("{}", values[i]);
+    buf.Append(";");
+  }
+  buf.Append("\r\n");
+
+  if (buf.Overflowed()) {
+    return ec::kBufferTooSmall;
   }
-  buf += "\r\n";
 
-  return Send(buf);
+  return Send(buf.View());
 }
 
-ErrorCode ScpiClient::SetAllGlobalModelInputs(
+template <class Driver>
+ErrorCode BasicScpiClient<Driver>::SetAllGlobalModelInputs(
     std::span<const float> values) const {
   return SetAllGlobalModelInputs(values.data(), values.size());
 }
 
-ErrorCode ScpiClient::SetAllGlobalModelInputs(
+template <class Driver>
+ErrorCode BasicScpiClient<Driver>::SetAllGlobalModelInputs(
     const std::array<float, kGlobalModelInputCount>& values) const {
   return SetAllGlobalModelInputs(values.data(), values.size());
 }
 
-Result<float> ScpiClient::GetGlobalModelInput(unsigned int index) const {
+template <class Driver>
+ErrorCode BasicScpiClient<Driver>::SetGlobalModelInputsDelta(
+    std::span<const float> prev, std::span<const float> next) const {
+  if (prev.size() != next.size() || next.size() > kGlobalModelInputCount) {
+    return ec::kInvalidArgument;
+  }
+
+  scpi::CommandBuffer<kGlobalModelInputCount * kModelInputEntryLen + 2> buf;
+  const bool changed = scpi::AppendChanges<kGlobalModelInputCount>(
+      buf, ":MOD:GLOB", "", prev, next, [](float v) { return v; },
+      [](auto& b, float v) { b.Append("{}", v); });
+  if (!changed) {
+    return ec::kSuccess;
+  }
+  buf.Append("\r\n");
+
+  if (buf.Overflowed()) {
+    return ec::kBufferTooSmall;
+  }
+
+  return Send(buf.View());
+}
+
+template <class Driver>
+ErrorCode BasicScpiClient<Driver>::SetGlobalModelInputsDelta(
+    const std::array<float, kGlobalModelInputCount>& prev,
+    const std::array<float, kGlobalModelInputCount>& next) const {
+  return SetGlobalModelInputsDelta(std::span{prev}, std::span{next});
+}
+
+template <class Driver>
+Result<float> BasicScpiClient<Driver>::GetGlobalModelInput(
+    unsigned int index) const {
   if (index >= kGlobalModelInputCount) {
     return Err(ec::kChannelIndexOutOfRange);
   }
 
-  char buf[32]{};
-  fmt::format_to_n(buf, sizeof(buf) - 1, "MOD:GLOB{}?\r\n", index + 1);
+  const auto cmd =
+      scpi::ChannelCommand<"MOD:GLOB", "?\r\n", kGlobalModelInputCount>(index);
 
-  return SendAndRecv(buf).and_then(scpi::ParseFloatResponse);
+  scpi::ResponseBuffer resp_buf;
+  return SendAndRecv(cmd, resp_buf).and_then(scpi::ParseFloatResponse);
 }
 
+template <class Driver>
 Result<std::array<float, kGlobalModelInputCount>>
-ScpiClient::GetAllGlobalModelInputs() const {
-  char buf[32]{};
-  fmt::format_to_n(buf, sizeof(buf) - 1, "MOD:GLOB? (@1:{})\r\n",
-                   kGlobalModelInputCount);
-  return SendAndRecv(buf).and_then(
+BasicScpiClient<Driver>::GetAllGlobalModelInputs() const {
+  constexpr auto cmd =
+      scpi::ChannelListCommand<"MOD:GLOB? ", "\r\n", kGlobalModelInputCount>(
+          kGlobalModelInputCount);
+  scpi::ResponseBuffer resp_buf;
+  return SendAndRecv(cmd, resp_buf).and_then(
       scpi::ParseRespFloatArray<kGlobalModelInputCount>);
 }
 
-ErrorCode ScpiClient::GetAllGlobalModelInputs(float* values,
-                                              std::size_t count) const {
+template <class Driver>
+ErrorCode BasicScpiClient<Driver>::GetAllGlobalModelInputs(
+    float* values, std::size_t count) const {
   if ((!values && count > 0) || count > kGlobalModelInputCount) {
     return ec::kInvalidArgument;
   }
@@ -128,10 +212,12 @@ ErrorCode ScpiClient::GetAllGlobalModelInputs(float* values,
     return ec::kSuccess;
   }
 
-  char buf[32]{};
-  fmt::format_to_n(buf, sizeof(buf) - 1, "MOD:GLOB? (@1:{})\r\n", count);
+  const auto cmd =
+      scpi::ChannelListCommand<"MOD:GLOB? ", "\r\n", kGlobalModelInputCount>(
+          count);
 
-  auto resp = SendAndRecv(buf);
+  scpi::ResponseBuffer resp_buf;
+  auto resp = SendAndRecv(cmd, resp_buf);
   if (!resp) {
     return resp.error();
   }
@@ -139,35 +225,46 @@ ErrorCode ScpiClient::GetAllGlobalModelInputs(float* values,
   return scpi::SplitRespFloats(*resp, std::span{values, count});
 }
 
-ErrorCode ScpiClient::GetAllGlobalModelInputs(
+template <class Driver>
+ErrorCode BasicScpiClient<Driver>::GetAllGlobalModelInputs(
     std::array<float, kGlobalModelInputCount>& values) const {
   return GetAllGlobalModelInputs(values.data(), values.size());
 }
 
-ErrorCode ScpiClient::GetAllGlobalModelInputs(std::span<float> values) const {
+template <class Driver>
+ErrorCode BasicScpiClient<Driver>::GetAllGlobalModelInputs(
+    std::span<float> values) const {
   return GetAllGlobalModelInputs(values.data(), values.size());
 }
 
-ErrorCode ScpiClient::SetLocalModelInput(unsigned int index,
-                                         float value) const {
+template <class Driver>
+ErrorCode BasicScpiClient<Driver>::SetLocalModelInput(unsigned int index,
+                                                      float value) const {
   if (index >= kLocalModelInputCount) {
     return ec::kChannelIndexOutOfRange;
   }
 
-  char buf[64]{};
-  fmt::format_to_n(buf, sizeof(buf) - 1, "MOD:LOC{} {}\r\n", index + 1, value);
-  return Send(buf);
+  scpi::CommandBuffer<64> buf;
+  buf.Append(
+      scpi::ChannelCommand<"MOD:LOC", " ", kLocalModelInputCount>(index));
+  buf.Append("{}", value);
+  buf.Append("\r\n");
+  return Send(buf.View());
 }
 
-ErrorCode ScpiClient::SetAllLocalModelInputs(float value) const {
-  char buf[64]{};
-  fmt::format_to_n(buf, sizeof(buf) - 1, "MOD:LOC {},(@1:{})\r\n", value,
-                   kLocalModelInputCount);
-  return Send(buf);
+template <class Driver>
+ErrorCode BasicScpiClient<Driver>::SetAllLocalModelInputs(float value) const {
+  scpi::CommandBuffer<64> buf;
+  buf.Append("MOD:LOC ");
+  buf.Append("{}", value);
+  buf.Append(scpi::ChannelListCommand<",", "\r\n", kLocalModelInputCount>(
+      kLocalModelInputCount));
+  return Send(buf.View());
 }
 
-ErrorCode ScpiClient::SetAllLocalModelInputs(const float* values,
-                                             std::size_t count) const {
+template <class Driver>
+ErrorCode BasicScpiClient<Driver>::SetAllLocalModelInputs(
+    const float* values, std::size_t count) const {
   if ((count > 0 && !values) || count > kLocalModelInputCount) {
     return ec::kInvalidArgument;
   }
@@ -176,49 +273,91 @@ ErrorCode ScpiClient::SetAllLocalModelInputs(const float* values,
     return ec::kSuccess;
   }
 
-  std::string buf;
-  // try to do one allocation
-  buf.reserve(count * 30);
+  scpi::CommandBuffer<kLocalModelInputCount * kModelInputEntryLen + 2> buf;
   for (std::size_t i = 0; i < count; ++i) {
-    fmt::format_to(std::back_inserter(buf), ":MOD:LOC{} {};", i + 1, values[i]);
+    buf.Append(scpi::ChannelCommand<":MOD:LOC", " ", kLocalModelInputCount>(i));
+    buf.Append("{}", values[i]);
+    buf.Append(";");
+  }
+  buf.Append("\r\n");
+
+  if (buf.Overflowed()) {
+    return ec::kBufferTooSmall;
   }
-  buf += "\r\n";
 
-  return Send(buf);
+  return Send(buf.View());
 }
 
-ErrorCode ScpiClient::SetAllLocalModelInputs(
+template <class Driver>
+ErrorCode BasicScpiClient<Driver>::SetAllLocalModelInputs(
     std::span<const float> values) const {
   return SetAllLocalModelInputs(values.data(), values.size());
 }
 
-ErrorCode ScpiClient::SetAllLocalModelInputs(
+template <class Driver>
+ErrorCode BasicScpiClient<Driver>::SetAllLocalModelInputs(
     const std::array<float, kLocalModelInputCount>& values) const {
   return SetAllLocalModelInputs(values.data(), values.size());
 }
 
-Result<float> ScpiClient::GetLocalModelInput(unsigned int index) const {
+template <class Driver>
+ErrorCode BasicScpiClient<Driver>::SetLocalModelInputsDelta(
+    std::span<const float> prev, std::span<const float> next) const {
+  if (prev.size() != next.size() || next.size() > kLocalModelInputCount) {
+    return ec::kInvalidArgument;
+  }
+
+  scpi::CommandBuffer<kLocalModelInputCount * kModelInputEntryLen + 2> buf;
+  const bool changed = scpi::AppendChanges<kLocalModelInputCount>(
+      buf, ":MOD:LOC", "", prev, next, [](float v) { return v; },
+      [](auto& b, float v) { b.Append("{}", v); });
+  if (!changed) {
+    return ec::kSuccess;
+  }
+  buf.Append("\r\n");
+
+  if (buf.Overflowed()) {
+    return ec::kBufferTooSmall;
+  }
+
+  return Send(buf.View());
+}
+
+template <class Driver>
+ErrorCode BasicScpiClient<Driver>::SetLocalModelInputsDelta(
+    const std::array<float, kLocalModelInputCount>& prev,
+    const std::array<float, kLocalModelInputCount>& next) const {
+  return SetLocalModelInputsDelta(std::span{prev}, std::span{next});
+}
+
+template <class Driver>
+Result<float> BasicScpiClient<Driver>::GetLocalModelInput(
+    unsigned int index) const {
   if (index >= kLocalModelInputCount) {
     return Err(ec::kChannelIndexOutOfRange);
   }
 
-  char buf[32]{};
-  fmt::format_to_n(buf, sizeof(buf) - 1, "MOD:LOC{}?\r\n", index + 1);
+  const auto cmd =
+      scpi::ChannelCommand<"MOD:LOC", "?\r\n", kLocalModelInputCount>(index);
 
-  return SendAndRecv(buf).and_then(scpi::ParseFloatResponse);
+  scpi::ResponseBuffer resp_buf;
+  return SendAndRecv(cmd, resp_buf).and_then(scpi::ParseFloatResponse);
 }
 
+template <class Driver>
 Result<std::array<float, kLocalModelInputCount>>
-ScpiClient::GetAllLocalModelInputs() const {
-  char buf[32]{};
-  fmt::format_to_n(buf, sizeof(buf) - 1, "MOD:LOC? (@1:{})\r\n",
-                   kLocalModelInputCount);
-  return SendAndRecv(buf).and_then(
+BasicScpiClient<Driver>::GetAllLocalModelInputs() const {
+  constexpr auto cmd =
+      scpi::ChannelListCommand<"MOD:LOC? ", "\r\n", kLocalModelInputCount>(
+          kLocalModelInputCount);
+  scpi::ResponseBuffer resp_buf;
+  return SendAndRecv(cmd, resp_buf).and_then(
       scpi::ParseRespFloatArray<kLocalModelInputCount>);
 }
 
-ErrorCode ScpiClient::GetAllLocalModelInputs(float* values,
-                                             std::size_t count) const {
+template <class Driver>
+ErrorCode BasicScpiClient<Driver>::GetAllLocalModelInputs(
+    float* values, std::size_t count) const {
   if ((!values && count > 0) || count > kLocalModelInputCount) {
     return ec::kInvalidArgument;
   }
@@ -227,10 +366,12 @@ ErrorCode ScpiClient::GetAllLocalModelInputs(float* values,
     return ec::kSuccess;
   }
 
-  char buf[32]{};
-  fmt::format_to_n(buf, sizeof(buf) - 1, "MOD:LOC? (@1:{})\r\n", count);
+  const auto cmd =
+      scpi::ChannelListCommand<"MOD:LOC? ", "\r\n", kLocalModelInputCount>(
+          count);
 
-  auto resp = SendAndRecv(buf);
+  scpi::ResponseBuffer resp_buf;
+  auto resp = SendAndRecv(cmd, resp_buf);
   if (!resp) {
     return resp.error();
   }
@@ -238,38 +379,47 @@ ErrorCode ScpiClient::GetAllLocalModelInputs(float* values,
   return scpi::SplitRespFloats(*resp, std::span{values, count});
 }
 
-ErrorCode ScpiClient::GetAllLocalModelInputs(
+template <class Driver>
+ErrorCode BasicScpiClient<Driver>::GetAllLocalModelInputs(
     std::array<float, kLocalModelInputCount>& values) const {
   return GetAllLocalModelInputs(values.data(), values.size());
 }
 
-ErrorCode ScpiClient::GetAllLocalModelInputs(std::span<float> values) const {
+template <class Driver>
+ErrorCode BasicScpiClient<Driver>::GetAllLocalModelInputs(
+    std::span<float> values) const {
   return GetAllLocalModelInputs(values.data(), values.size());
 }
 
-Result<float> ScpiClient::GetModelOutput(unsigned int index) const {
+template <class Driver>
+Result<float> BasicScpiClient<Driver>::GetModelOutput(
+    unsigned int index) const {
   if (index >= kModelOutputCount) {
     return Err(ec::kChannelIndexOutOfRange);
   }
 
-  char buf[32]{};
-  fmt::format_to_n(buf, sizeof(buf) - 1, "MOD:OUT{}?\r\n", index + 1);
+  const auto cmd =
+      scpi::ChannelCommand<"MOD:OUT", "?\r\n", kModelOutputCount>(index);
 
-  return SendAndRecv(buf).and_then(scpi::ParseFloatResponse);
+  scpi::ResponseBuffer resp_buf;
+  return SendAndRecv(cmd, resp_buf).and_then(scpi::ParseFloatResponse);
 }
 
-Result<std::array<float, kModelOutputCount>> ScpiClient::GetAllModelOutputs()
-    const {
-  char buf[32]{};
-  fmt::format_to_n(buf, sizeof(buf) - 1, "MOD:OUT? (@1:{})\r\n",
-                   kModelOutputCount);
+template <class Driver>
+Result<std::array<float, kModelOutputCount>>
+BasicScpiClient<Driver>::GetAllModelOutputs() const {
+  constexpr auto cmd =
+      scpi::ChannelListCommand<"MOD:OUT? ", "\r\n", kModelOutputCount>(
+          kModelOutputCount);
 
-  return SendAndRecv(buf).and_then(
+  scpi::ResponseBuffer resp_buf;
+  return SendAndRecv(cmd, resp_buf).and_then(
       scpi::ParseRespFloatArray<kModelOutputCount>);
 }
 
-ErrorCode ScpiClient::GetAllModelOutputs(float* outputs,
-                                         std::size_t count) const {
+template <class Driver>
+ErrorCode BasicScpiClient<Driver>::GetAllModelOutputs(float* outputs,
+                                                      std::size_t count) const {
   if ((!outputs && count > 0) || count > kModelOutputCount) {
     return ec::kInvalidArgument;
   }
@@ -278,11 +428,12 @@ ErrorCode ScpiClient::GetAllModelOutputs(float* outputs,
     return ec::kSuccess;
   }
 
-  char buf[32]{};
-  fmt::format_to_n(buf, sizeof(buf) - 1, "MOD:OUT? (@1:{})\r\n",
-                   kModelOutputCount);
+  constexpr auto cmd =
+      scpi::ChannelListCommand<"MOD:OUT? ", "\r\n", kModelOutputCount>(
+          kModelOutputCount);
 
-  auto resp = SendAndRecv(buf);
+  scpi::ResponseBuffer resp_buf;
+  auto resp = SendAndRecv(cmd, resp_buf);
   if (!resp) {
     return resp.error();
   }
@@ -295,13 +446,81 @@ ErrorCode ScpiClient::GetAllModelOutputs(float* outputs,
   return ec::kSuccess;
 }
 
-ErrorCode ScpiClient::GetAllModelOutputs(
+template <class Driver>
+ErrorCode BasicScpiClient<Driver>::GetAllModelOutputs(
     std::array<float, kModelOutputCount>& outputs) const {
   return GetAllModelOutputs(outputs.data(), outputs.size());
 }
 
-ErrorCode ScpiClient::GetAllModelOutputs(std::span<float> outputs) const {
+template <class Driver>
+ErrorCode BasicScpiClient<Driver>::GetAllModelOutputs(
+    std::span<float> outputs) const {
   return GetAllModelOutputs(outputs.data(), outputs.size());
 }
 
+template <class Driver>
+ErrorCode BasicScpiClient<Driver>::ExchangeModelIO(
+    std::span<const float> global_inputs, std::span<const float> local_inputs,
+    std::span<float> outputs) const {
+  if (global_inputs.size() > kGlobalModelInputCount ||
+      local_inputs.size() > kLocalModelInputCount ||
+      outputs.size() > kModelOutputCount) {
+    return ec::kInvalidArgument;
+  }
+
+  if (global_inputs.empty() && local_inputs.empty() && outputs.empty()) {
+    return ec::kSuccess;
+  }
+
+  scpi::CommandBuffer<kModelExchangeLen> buf;
+  for (std::size_t i = 0; i < global_inputs.size(); ++i) {
+    buf.Append(
+        scpi::ChannelCommand<":MOD:GLOB", " ", kGlobalModelInputCount>(i));
+    buf.Append("{}", global_inputs[i]);
+    buf.Append(";");
+  }
+  for (std::size_t i = 0; i < local_inputs.size(); ++i) {
+    buf.Append(scpi::ChannelCommand<":MOD:LOC", " ", kLocalModelInputCount>(i));
+    buf.Append("{}", local_inputs[i]);
+    buf.Append(";");
+  }
+
+  if (outputs.empty()) {
+    buf.Append("\r\n");
+    return buf.Overflowed() ? ec::kBufferTooSmall : Send(buf.View());
+  }
+
+  // the unit sets the inputs before answering the query, which is the only
+  // part of the message with a response
+  buf.Append(scpi::ChannelListCommand<":MOD:OUT? ", "\r\n", kModelOutputCount>(
+      outputs.size()));
+
+  if (buf.Overflowed()) {
+    return ec::kBufferTooSmall;
+  }
+
+  scpi::ResponseBuffer resp_buf;
+  auto resp = SendAndRecv(buf.View(), resp_buf);
+  if (!resp) {
+    return resp.error();
+  }
+
+  return scpi::SplitRespFloats(*resp, outputs);
+}
+
+template <class Driver>
+ErrorCode BasicScpiClient<Driver>::ExchangeModelIO(
+    const std::array<float, kGlobalModelInputCount>& global_inputs,
+    const std::array<float, kLocalModelInputCount>& local_inputs,
+    std::array<float, kModelOutputCount>& outputs) const {
+  return ExchangeModelIO(std::span{global_inputs}, std::span{local_inputs},
+                         std::span{outputs});
+}
+
+template class BasicScpiClient<drivers::CommDriver>;
+template class BasicScpiClient<drivers::TcpDriver>;
+template class BasicScpiClient<drivers::UdpDriver>;
+template class BasicScpiClient<drivers::UdpMcastDriver>;
+template class BasicScpiClient<drivers::SerialDriver>;
+
 }  // namespace bci::abs
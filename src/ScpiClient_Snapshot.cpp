@@ -0,0 +1,33 @@
+/*
+ * Copyright (c) 2024, Bloomy Controls, Inc. All rights reserved.
+ *
+ * Use of this source code is governed by a BSD-3-clause license that can be
+ * found in the LICENSE file or at https://opensource.org/license/BSD-3-Clause
+ */
+
+#include <bci/abs/CommDriver.h>
+#include <bci/abs/ScpiClient.h>
+#include <bci/abs/SerialDriver.h>
+#include <bci/abs/TcpDriver.h>
+#include <bci/abs/UdpDriver.h>
+#include <bci/abs/UdpMulticastDriver.h>
+
+#include "CommandTable.h"
+#include "ScpiUtil.h"
+
+namespace bci::abs {
+
+template <class Driver>
+Result<MeasurementSnapshot> BasicScpiClient<Driver>::MeasureSnapshot() const {
+  scpi::ResponseBuffer resp_buf;
+  return SendAndRecv(scpi::kSnapshotCommand, resp_buf)
+      .and_then(scpi::ParseMeasurementSnapshot);
+}
+
+template class BasicScpiClient<drivers::CommDriver>;
+template class BasicScpiClient<drivers::TcpDriver>;
+template class BasicScpiClient<drivers::UdpDriver>;
+template class BasicScpiClient<drivers::UdpMcastDriver>;
+template class BasicScpiClient<drivers::SerialDriver>;
+
+}  // namespace bci::abs
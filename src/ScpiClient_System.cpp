@@ -5,44 +5,57 @@
  * found in the LICENSE file or at https://opensource.org/license/BSD-3-Clause
  */
 
+#include <bci/abs/CommDriver.h>
 #include <bci/abs/ScpiClient.h>
+#include <bci/abs/SerialDriver.h>
+#include <bci/abs/TcpDriver.h>
+#include <bci/abs/UdpDriver.h>
+#include <bci/abs/UdpMulticastDriver.h>
 #include <fmt/core.h>
 
 #include <array>
+#include <cstddef>
 #include <cstdint>
+#include <span>
 #include <string>
 #include <string_view>
+#include <utility>
 
 #include "ScpiUtil.h"
 #include "Util.h"
 
 namespace bci::abs {
 
-using util::Err;
-using ec = ErrorCode;
+// Number of errors read from the error queue per transaction, and the query
+// which reads them. Each query answers "0,..." once the queue is empty.
+static constexpr std::size_t kErrorBatchSize = 8;
+static constexpr std::string_view kErrorBatchQuery =
+    "SYST:ERR?;:SYST:ERR?;:SYST:ERR?;:SYST:ERR?;"
+    ":SYST:ERR?;:SYST:ERR?;:SYST:ERR?;:SYST:ERR?\r\n";
 
-Result<DeviceInfo> ScpiClient::GetDeviceInfo() const {
-  auto res = SendAndRecv("*IDN?\r\n");
-  if (!res) {
-    return Err(res.error());
-  }
+// Most transactions spent draining the error queue, in case it never empties.
+static constexpr std::size_t kMaxErrorBatches = 16;
 
-  std::array<std::string_view, 4> idn;
-  if (scpi::SplitRespMnemonics(*res, idn) != ErrorCode::kSuccess) {
-    return Err(ErrorCode::kInvalidResponse);
-  }
+using util::Err;
+using ec = ErrorCode;
 
-  return DeviceInfo{std::string(idn[1]), std::string(idn[2]),
-                    std::string(idn[3])};
+template <class Driver>
+Result<DeviceInfo> BasicScpiClient<Driver>::GetDeviceInfo() const {
+  scpi::ResponseBuffer resp_buf;
+  return SendAndRecv("*IDN?\r\n", resp_buf).and_then(scpi::ParseDeviceInfo);
 }
 
-Result<std::uint8_t> ScpiClient::GetDeviceId() const {
-  return SendAndRecv("CONF:COMM:SER:ID?\r\n")
+template <class Driver>
+Result<std::uint8_t> BasicScpiClient<Driver>::GetDeviceId() const {
+  scpi::ResponseBuffer resp_buf;
+  return SendAndRecv("CONF:COMM:SER:ID?\r\n", resp_buf)
       .and_then(scpi::ParseIntResponse<std::uint8_t>);
 }
 
-Result<EthernetConfig> ScpiClient::GetIPAddress() const {
-  auto resp = SendAndRecv("CONF:COMM:SOCK:ADDR?\r\n")
+template <class Driver>
+Result<EthernetConfig> BasicScpiClient<Driver>::GetIPAddress() const {
+  scpi::ResponseBuffer resp_buf;
+  auto resp = SendAndRecv("CONF:COMM:SOCK:ADDR?\r\n", resp_buf)
                   .and_then(scpi::ParseStringArrayResponse<2>);
   if (!resp) {
     return Err(resp.error());
@@ -50,8 +63,9 @@ Result<EthernetConfig> ScpiClient::GetIPAddress() const {
   return EthernetConfig{std::move(resp->at(0)), std::move(resp->at(1))};
 }
 
-ErrorCode ScpiClient::SetIPAddress(std::string_view ip,
-                                   std::string_view netmask) const {
+template <class Driver>
+ErrorCode BasicScpiClient<Driver>::SetIPAddress(
+    std::string_view ip, std::string_view netmask) const {
   if (ip.size() > 15 || netmask.size() > 15) {
     return ec::kInvalidIPAddress;
   }
@@ -67,38 +81,112 @@ ErrorCode ScpiClient::SetIPAddress(std::string_view ip,
   return Send(buf);
 }
 
-Result<std::string> ScpiClient::GetCalibrationDate() const {
-  return SendAndRecv("CAL:DATE?\r\n").and_then(scpi::ParseStringResponse);
+template <class Driver>
+Result<std::string> BasicScpiClient<Driver>::GetCalibrationDate() const {
+  scpi::ResponseBuffer resp_buf;
+  return SendAndRecv("CAL:DATE?\r\n", resp_buf)
+      .and_then(scpi::ParseStringResponse);
 }
 
-Result<int> ScpiClient::GetErrorCount() const {
-  return SendAndRecv("SYST:ERR:COUN?\r\n")
+template <class Driver>
+Result<int> BasicScpiClient<Driver>::GetErrorCount() const {
+  scpi::ResponseBuffer resp_buf;
+  return SendAndRecv("SYST:ERR:COUN?\r\n", resp_buf)
       .and_then(scpi::ParseIntResponse<int>);
 }
 
-Result<ScpiError> ScpiClient::GetNextError() const {
-  return SendAndRecv("SYST:ERR?\r\n").and_then(scpi::ParseScpiError);
+template <class Driver>
+Result<ScpiError> BasicScpiClient<Driver>::GetNextError() const {
+  scpi::ResponseBuffer resp_buf;
+  return SendAndRecv("SYST:ERR?\r\n", resp_buf).and_then(scpi::ParseScpiError);
+}
+
+template <class Driver>
+Result<ScpiErrorList> BasicScpiClient<Driver>::DrainErrors() const {
+  ScpiErrorList errors;
+  for (std::size_t batch = 0; batch < kMaxErrorBatches; ++batch) {
+    // error messages may be long, so don't limit the response's size
+    auto resp = SendAndRecv(kErrorBatchQuery);
+    if (!resp) {
+      return Err(resp.error());
+    }
+
+    std::array<std::string_view, kErrorBatchSize> parts{};
+    if (auto e = scpi::SplitCompoundResp(*resp, std::span{parts});
+        e != ec::kSuccess) {
+      return Err(e);
+    }
+
+    for (auto part : parts) {
+      auto err = scpi::ParseScpiError(part);
+      if (!err) {
+        return Err(err.error());
+      }
+      if (err->err_code == 0) {
+        return errors;
+      }
+      errors.push_back(std::move(*err));
+    }
+  }
+
+  return errors;
 }
 
-ErrorCode ScpiClient::ClearErrors() const { return Send("*CLS\r\n"); }
+template <class Driver>
+ErrorCode BasicScpiClient<Driver>::ClearErrors() const {
+  return Send("*CLS\r\n");
+}
 
-Result<std::uint32_t> ScpiClient::GetAlarms() const {
-  return SendAndRecv("SYST:ALARM?\r\n")
+template <class Driver>
+Result<std::uint32_t> BasicScpiClient<Driver>::GetAlarms() const {
+  scpi::ResponseBuffer resp_buf;
+  return SendAndRecv("SYST:ALARM?\r\n", resp_buf)
       .and_then(scpi::ParseIntResponse<std::uint32_t>);
 }
 
-Result<bool> ScpiClient::GetInterlockState() const {
-  return SendAndRecv("SYST:INT?\r\n").and_then(scpi::ParseBoolResponse);
+template <class Driver>
+Result<bool> BasicScpiClient<Driver>::GetInterlockState() const {
+  scpi::ResponseBuffer resp_buf;
+  return SendAndRecv("SYST:INT?\r\n", resp_buf)
+      .and_then(scpi::ParseBoolResponse);
 }
 
-ErrorCode ScpiClient::AssertSoftwareInterlock() const {
+template <class Driver>
+Result<DeviceHealth> BasicScpiClient<Driver>::GetHealth() const {
+  scpi::ResponseBuffer resp_buf;
+  return SendAndRecv("SYST:ALARM?;:SYST:INT?;:SYST:ERR:COUN?\r\n", resp_buf)
+      .and_then(scpi::ParseDeviceHealth);
+}
+
+template <class Driver>
+ErrorCode BasicScpiClient<Driver>::AssertSoftwareInterlock() const {
   return Send("SYST:ALARM:RAISE\r\n");
 }
 
-ErrorCode ScpiClient::ClearRecoverableAlarms() const {
+template <class Driver>
+ErrorCode BasicScpiClient<Driver>::ClearRecoverableAlarms() const {
   return Send("SYST:ALARM:CLEAR\r\n");
 }
 
-ErrorCode ScpiClient::Reboot() const { return Send("*RST\r\n"); }
+template <class Driver>
+ErrorCode BasicScpiClient<Driver>::Reboot() const { return Send("*RST\r\n"); }
+
+template <class Driver>
+ErrorCode BasicScpiClient<Driver>::SetBinaryTransfer(bool en) const {
+  return Send(en ? "FORM REAL,32\r\n" : "FORM ASC\r\n");
+}
+
+template <class Driver>
+Result<bool> BasicScpiClient<Driver>::GetBinaryTransfer() const {
+  scpi::ResponseBuffer resp_buf;
+  return SendAndRecv("FORM?\r\n", resp_buf)
+      .and_then(scpi::ParseDataFormat);
+}
+
+template class BasicScpiClient<drivers::CommDriver>;
+template class BasicScpiClient<drivers::TcpDriver>;
+template class BasicScpiClient<drivers::UdpDriver>;
+template class BasicScpiClient<drivers::UdpMcastDriver>;
+template class BasicScpiClient<drivers::SerialDriver>;
 
 }  // namespace bci::abs
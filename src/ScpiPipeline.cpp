@@ -0,0 +1,470 @@
+/*
+ * Copyright (c) 2024, Bloomy Controls, Inc. All rights reserved.
+ *
+ * Use of this source code is governed by a BSD-3-clause license that can be
+ * found in the LICENSE file or at https://opensource.org/license/BSD-3-Clause
+ */
+
+#include <bci/abs/ScpiClient.h>
+#include <bci/abs/ScpiPipeline.h>
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "CommandTable.h"
+#include "InstrumentUtil.h"
+#include "ScpiUtil.h"
+#include "TransactionLock.h"
+#include "Util.h"
+
+namespace bci::abs {
+
+using util::Err;
+using ec = ErrorCode;
+
+namespace {
+
+// Build a completion which parses a reply into a result.
+template <class T, class F>
+auto ParseInto(Result<T>& out, F&& parse) {
+  return [&out, parse = std::forward<F>(parse)](Result<std::string> resp) {
+    out = std::move(resp).and_then(parse);
+  };
+}
+
+}  // namespace
+
+ScpiPipeline::ScpiPipeline(const ScpiClient& client) noexcept
+    : client_{&client}, queries_{} {}
+
+ScpiPipeline::ScpiPipeline(ScpiPipeline&& other) noexcept = default;
+
+ScpiPipeline& ScpiPipeline::operator=(ScpiPipeline&& rhs) noexcept = default;
+
+ScpiPipeline::~ScpiPipeline() = default;
+
+std::size_t ScpiPipeline::Size() const noexcept { return queries_.size(); }
+
+void ScpiPipeline::Clear() noexcept { queries_.clear(); }
+
+ErrorCode ScpiPipeline::Execute() const {
+  const auto fail_from = [this](std::size_t first, ec e) {
+    for (std::size_t i = first; i < queries_.size(); ++i) {
+      queries_[i].on_reply(Err(e));
+    }
+    return e;
+  };
+
+  if (queries_.empty()) {
+    return ec::kSuccess;
+  }
+
+  const auto& driver = client_->driver_;
+  if (!driver) {
+    return fail_from(0, ec::kInvalidDriverHandle);
+  }
+
+  if (driver->IsSendOnly()) {
+    return fail_from(0, ec::kReceiveNotAllowed);
+  }
+
+  // the whole pipeline is one transaction, as replies are matched by order
+  detail::TransactionLock::Guard guard{client_->lock_.get(), false};
+
+  // each query is reported once its reply arrives, with the time spent waiting
+  // for that reply after the previous one
+  auto* sink = client_->sink_.get();
+  std::vector<std::chrono::nanoseconds> write_times(sink ? queries_.size() : 0);
+  const auto now = [sink] {
+    return sink ? instr::Clock::now() : instr::Clock::time_point{};
+  };
+
+  // put every command on the wire before waiting for any replies
+  ec ret = ec::kSuccess;
+  std::size_t sent = 0;
+  for (; sent < queries_.size(); ++sent) {
+    const auto start = now();
+    ret = client_->Write(queries_[sent].command);
+    if (sink) {
+      write_times[sent] = instr::Since(start);
+    }
+    if (ret != ec::kSuccess) {
+      if (sink) {
+        instr::ReportCall(*sink, queries_[sent].command, 0, write_times[sent],
+                          {}, ret);
+      }
+      break;
+    }
+  }
+
+  for (std::size_t i = 0; i < sent; ++i) {
+    const auto start = now();
+    auto resp = driver->ReadLine(client_->read_timeout_ms_);
+    if (sink) {
+      instr::ReportCall(*sink, queries_[i].command, resp ? resp->size() : 0,
+                        write_times[i], instr::Since(start),
+                        resp ? ec::kSuccess : resp.error());
+    }
+    if (!resp) {
+      // replies are matched to queries by order, so a missing reply leaves the
+      // rest unusable
+      return fail_from(i, resp.error());
+    }
+    queries_[i].on_reply(std::move(resp));
+  }
+
+  if (ret != ec::kSuccess) {
+    return fail_from(sent, ret);
+  }
+
+  return ec::kSuccess;
+}
+
+void ScpiPipeline::Queue(std::string command, Completion on_reply) {
+  queries_.push_back({std::move(command), std::move(on_reply)});
+}
+
+void ScpiPipeline::GetDeviceInfo(Result<DeviceInfo>& out) {
+  Queue("*IDN?\r\n", ParseInto(out, scpi::ParseDeviceInfo));
+}
+
+void ScpiPipeline::GetDeviceId(Result<std::uint8_t>& out) {
+  Queue("CONF:COMM:SER:ID?\r\n",
+        ParseInto(out, scpi::ParseIntResponse<std::uint8_t>));
+}
+
+void ScpiPipeline::GetErrorCount(Result<int>& out) {
+  Queue("SYST:ERR:COUN?\r\n", ParseInto(out, scpi::ParseIntResponse<int>));
+}
+
+void ScpiPipeline::GetAlarms(Result<std::uint32_t>& out) {
+  Queue("SYST:ALARM?\r\n",
+        ParseInto(out, scpi::ParseIntResponse<std::uint32_t>));
+}
+
+void ScpiPipeline::GetInterlockState(Result<bool>& out) {
+  Queue("SYST:INT?\r\n", ParseInto(out, scpi::ParseBoolResponse));
+}
+
+void ScpiPipeline::GetCellEnabled(unsigned int cell, Result<bool>& out) {
+  if (cell >= kCellCount) {
+    out = Err(ec::kChannelIndexOutOfRange);
+    return;
+  }
+
+  const auto cmd = scpi::ChannelCommand<"OUTP", "?\r\n", kCellCount>(cell);
+  Queue(std::string{cmd}, ParseInto(out, scpi::ParseBoolResponse));
+}
+
+void ScpiPipeline::GetAllCellsEnabled(
+    Result<std::array<bool, kCellCount>>& out) {
+  constexpr auto cmd =
+      scpi::ChannelListCommand<"OUTP? ", "\r\n", kCellCount>(kCellCount);
+  Queue(std::string{cmd}, ParseInto(out, scpi::ParseRespBoolArray<kCellCount>));
+}
+
+void ScpiPipeline::GetAllCellsEnabledMasked(Result<unsigned int>& out) {
+  constexpr auto cmd =
+      scpi::ChannelListCommand<"OUTP? ", "\r\n", kCellCount>(kCellCount);
+  Queue(std::string{cmd}, ParseInto(out, scpi::ParseRespBoolMask<kCellCount>));
+}
+
+void ScpiPipeline::GetCellVoltageTarget(unsigned int cell, Result<float>& out) {
+  if (cell >= kCellCount) {
+    out = Err(ec::kChannelIndexOutOfRange);
+    return;
+  }
+
+  const auto cmd = scpi::ChannelCommand<"SOUR", ":VOLT?\r\n", kCellCount>(cell);
+  Queue(std::string{cmd}, ParseInto(out, scpi::ParseFloatResponse));
+}
+
+void ScpiPipeline::GetAllCellVoltageTargets(
+    Result<std::array<float, kCellCount>>& out) {
+  constexpr auto cmd =
+      scpi::ChannelListCommand<"SOUR:VOLT? ", "\r\n", kCellCount>(kCellCount);
+  Queue(std::string{cmd},
+        ParseInto(out, scpi::ParseRespFloatArray<kCellCount>));
+}
+
+void ScpiPipeline::GetCellSourcingLimit(unsigned int cell, Result<float>& out) {
+  if (cell >= kCellCount) {
+    out = Err(ec::kChannelIndexOutOfRange);
+    return;
+  }
+
+  const auto cmd =
+      scpi::ChannelCommand<"SOUR", ":CURR:SRC?\r\n", kCellCount>(cell);
+  Queue(std::string{cmd}, ParseInto(out, scpi::ParseFloatResponse));
+}
+
+void ScpiPipeline::GetAllCellSourcingLimits(
+    Result<std::array<float, kCellCount>>& out) {
+  constexpr auto cmd =
+      scpi::ChannelListCommand<"SOUR:CURR:SRC? ", "\r\n", kCellCount>(
+          kCellCount);
+  Queue(std::string{cmd},
+        ParseInto(out, scpi::ParseRespFloatArray<kCellCount>));
+}
+
+void ScpiPipeline::GetCellSinkingLimit(unsigned int cell, Result<float>& out) {
+  if (cell >= kCellCount) {
+    out = Err(ec::kChannelIndexOutOfRange);
+    return;
+  }
+
+  const auto cmd =
+      scpi::ChannelCommand<"SOUR", ":CURR:SNK?\r\n", kCellCount>(cell);
+  Queue(std::string{cmd}, ParseInto(out, scpi::ParseFloatResponse));
+}
+
+void ScpiPipeline::GetAllCellSinkingLimits(
+    Result<std::array<float, kCellCount>>& out) {
+  constexpr auto cmd =
+      scpi::ChannelListCommand<"SOUR:CURR:SNK? ", "\r\n", kCellCount>(
+          kCellCount);
+  Queue(std::string{cmd},
+        ParseInto(out, scpi::ParseRespFloatArray<kCellCount>));
+}
+
+void ScpiPipeline::GetCellFault(unsigned int cell, Result<CellFault>& out) {
+  if (cell >= kCellCount) {
+    out = Err(ec::kChannelIndexOutOfRange);
+    return;
+  }
+
+  const auto cmd = scpi::ChannelCommand<"OUTP", ":FAUL?\r\n", kCellCount>(cell);
+  Queue(std::string{cmd}, ParseInto(out, scpi::ParseCellFault));
+}
+
+void ScpiPipeline::GetAllCellFaults(
+    Result<std::array<CellFault, kCellCount>>& out) {
+  constexpr auto cmd =
+      scpi::ChannelListCommand<"OUTP:FAUL? ", "\r\n", kCellCount>(kCellCount);
+  Queue(std::string{cmd},
+        ParseInto(out, scpi::ParseCellFaultArray<kCellCount>));
+}
+
+void ScpiPipeline::GetCellSenseRange(unsigned int cell,
+                                     Result<CellSenseRange>& out) {
+  if (cell >= kCellCount) {
+    out = Err(ec::kChannelIndexOutOfRange);
+    return;
+  }
+
+  const auto cmd = scpi::ChannelCommand<"SENS", ":RANG?\r\n", kCellCount>(cell);
+  Queue(std::string{cmd}, ParseInto(out, scpi::ParseCellSenseRange));
+}
+
+void ScpiPipeline::GetAllCellSenseRanges(
+    Result<std::array<CellSenseRange, kCellCount>>& out) {
+  constexpr auto cmd =
+      scpi::ChannelListCommand<"SENS:RANG? ", "\r\n", kCellCount>(kCellCount);
+  Queue(std::string{cmd},
+        ParseInto(out, scpi::ParseCellSenseRangeArray<kCellCount>));
+}
+
+void ScpiPipeline::MeasureCellVoltage(unsigned int cell, Result<float>& out) {
+  if (cell >= kCellCount) {
+    out = Err(ec::kChannelIndexOutOfRange);
+    return;
+  }
+
+  const auto cmd = scpi::ChannelCommand<"MEAS", ":VOLT?\r\n", kCellCount>(cell);
+  Queue(std::string{cmd}, ParseInto(out, scpi::ParseFloatResponse));
+}
+
+void ScpiPipeline::MeasureAllCellVoltages(
+    Result<std::array<float, kCellCount>>& out) {
+  constexpr auto cmd =
+      scpi::ChannelListCommand<"MEAS:VOLT? ", "\r\n", kCellCount>(kCellCount);
+  Queue(std::string{cmd},
+        ParseInto(out, scpi::ParseRespFloatArray<kCellCount>));
+}
+
+void ScpiPipeline::MeasureCellCurrent(unsigned int cell, Result<float>& out) {
+  if (cell >= kCellCount) {
+    out = Err(ec::kChannelIndexOutOfRange);
+    return;
+  }
+
+  const auto cmd = scpi::ChannelCommand<"MEAS", ":CURR?\r\n", kCellCount>(cell);
+  Queue(std::string{cmd}, ParseInto(out, scpi::ParseFloatResponse));
+}
+
+void ScpiPipeline::MeasureAllCellCurrents(
+    Result<std::array<float, kCellCount>>& out) {
+  constexpr auto cmd =
+      scpi::ChannelListCommand<"MEAS:CURR? ", "\r\n", kCellCount>(kCellCount);
+  Queue(std::string{cmd},
+        ParseInto(out, scpi::ParseRespFloatArray<kCellCount>));
+}
+
+void ScpiPipeline::GetCellOperatingMode(unsigned int cell,
+                                        Result<CellMode>& out) {
+  if (cell >= kCellCount) {
+    out = Err(ec::kChannelIndexOutOfRange);
+    return;
+  }
+
+  const auto cmd = scpi::ChannelCommand<"OUTP", ":MODE?\r\n", kCellCount>(cell);
+  Queue(std::string{cmd}, ParseInto(out, scpi::ParseCellOperatingMode));
+}
+
+void ScpiPipeline::GetAllCellOperatingModes(
+    Result<std::array<CellMode, kCellCount>>& out) {
+  constexpr auto cmd =
+      scpi::ChannelListCommand<"OUTP:MODE? ", "\r\n", kCellCount>(kCellCount);
+  Queue(std::string{cmd},
+        ParseInto(out, scpi::ParseCellOperatingModeArray<kCellCount>));
+}
+
+void ScpiPipeline::GetAnalogOutput(unsigned int channel, Result<float>& out) {
+  if (channel >= kAnalogOutputCount) {
+    out = Err(ec::kChannelIndexOutOfRange);
+    return;
+  }
+
+  const auto cmd =
+      scpi::ChannelCommand<"AUX:AOUT", "?\r\n", kAnalogOutputCount>(channel);
+  Queue(std::string{cmd}, ParseInto(out, scpi::ParseFloatResponse));
+}
+
+void ScpiPipeline::GetAllAnalogOutputs(
+    Result<std::array<float, kAnalogOutputCount>>& out) {
+  constexpr auto cmd =
+      scpi::ChannelListCommand<"AUX:AOUT? ", "\r\n", kAnalogOutputCount>(
+          kAnalogOutputCount);
+  Queue(std::string{cmd},
+        ParseInto(out, scpi::ParseRespFloatArray<kAnalogOutputCount>));
+}
+
+void ScpiPipeline::GetDigitalOutput(unsigned int channel, Result<bool>& out) {
+  if (channel >= kDigitalOutputCount) {
+    out = Err(ec::kChannelIndexOutOfRange);
+    return;
+  }
+
+  const auto cmd =
+      scpi::ChannelCommand<"AUX:DOUT", "?\r\n", kDigitalOutputCount>(channel);
+  Queue(std::string{cmd}, ParseInto(out, scpi::ParseBoolResponse));
+}
+
+void ScpiPipeline::GetAllDigitalOutputsMasked(Result<unsigned int>& out) {
+  constexpr auto cmd =
+      scpi::ChannelListCommand<"AUX:DOUT? ", "\r\n", kDigitalOutputCount>(
+          kDigitalOutputCount);
+  Queue(std::string{cmd},
+        ParseInto(out, scpi::ParseRespBoolMask<kDigitalOutputCount>));
+}
+
+void ScpiPipeline::MeasureAnalogInput(unsigned int channel,
+                                      Result<float>& out) {
+  if (channel >= kAnalogInputCount) {
+    out = Err(ec::kChannelIndexOutOfRange);
+    return;
+  }
+
+  const auto cmd =
+      scpi::ChannelCommand<"AUX:AIN", "?\r\n", kAnalogInputCount>(channel);
+  Queue(std::string{cmd}, ParseInto(out, scpi::ParseFloatResponse));
+}
+
+void ScpiPipeline::MeasureAllAnalogInputs(
+    Result<std::array<float, kAnalogInputCount>>& out) {
+  constexpr auto cmd =
+      scpi::ChannelListCommand<"AUX:AIN? ", "\r\n", kAnalogInputCount>(
+          kAnalogInputCount);
+  Queue(std::string{cmd},
+        ParseInto(out, scpi::ParseRespFloatArray<kAnalogInputCount>));
+}
+
+void ScpiPipeline::MeasureDigitalInput(unsigned int channel,
+                                       Result<bool>& out) {
+  if (channel >= kDigitalInputCount) {
+    out = Err(ec::kChannelIndexOutOfRange);
+    return;
+  }
+
+  const auto cmd =
+      scpi::ChannelCommand<"AUX:DIN", "?\r\n", kDigitalInputCount>(channel);
+  Queue(std::string{cmd}, ParseInto(out, scpi::ParseBoolResponse));
+}
+
+void ScpiPipeline::MeasureAllDigitalInputsMasked(Result<unsigned int>& out) {
+  constexpr auto cmd =
+      scpi::ChannelListCommand<"AUX:DIN? ", "\r\n", kDigitalInputCount>(
+          kDigitalInputCount);
+  Queue(std::string{cmd},
+        ParseInto(out, scpi::ParseRespBoolMask<kDigitalInputCount>));
+}
+
+void ScpiPipeline::GetModelStatus(Result<std::uint8_t>& out) {
+  Queue("MOD:STAT?\r\n", ParseInto(out, scpi::ParseIntResponse<std::uint8_t>));
+}
+
+void ScpiPipeline::GetGlobalModelInput(unsigned int index, Result<float>& out) {
+  if (index >= kGlobalModelInputCount) {
+    out = Err(ec::kChannelIndexOutOfRange);
+    return;
+  }
+
+  const auto cmd =
+      scpi::ChannelCommand<"MOD:GLOB", "?\r\n", kGlobalModelInputCount>(index);
+  Queue(std::string{cmd}, ParseInto(out, scpi::ParseFloatResponse));
+}
+
+void ScpiPipeline::GetAllGlobalModelInputs(
+    Result<std::array<float, kGlobalModelInputCount>>& out) {
+  constexpr auto cmd =
+      scpi::ChannelListCommand<"MOD:GLOB? ", "\r\n", kGlobalModelInputCount>(
+          kGlobalModelInputCount);
+  Queue(std::string{cmd},
+        ParseInto(out, scpi::ParseRespFloatArray<kGlobalModelInputCount>));
+}
+
+void ScpiPipeline::GetLocalModelInput(unsigned int index, Result<float>& out) {
+  if (index >= kLocalModelInputCount) {
+    out = Err(ec::kChannelIndexOutOfRange);
+    return;
+  }
+
+  const auto cmd =
+      scpi::ChannelCommand<"MOD:LOC", "?\r\n", kLocalModelInputCount>(index);
+  Queue(std::string{cmd}, ParseInto(out, scpi::ParseFloatResponse));
+}
+
+void ScpiPipeline::GetAllLocalModelInputs(
+    Result<std::array<float, kLocalModelInputCount>>& out) {
+  constexpr auto cmd =
+      scpi::ChannelListCommand<"MOD:LOC? ", "\r\n", kLocalModelInputCount>(
+          kLocalModelInputCount);
+  Queue(std::string{cmd},
+        ParseInto(out, scpi::ParseRespFloatArray<kLocalModelInputCount>));
+}
+
+void ScpiPipeline::GetModelOutput(unsigned int index, Result<float>& out) {
+  if (index >= kModelOutputCount) {
+    out = Err(ec::kChannelIndexOutOfRange);
+    return;
+  }
+
+  const auto cmd =
+      scpi::ChannelCommand<"MOD:OUT", "?\r\n", kModelOutputCount>(index);
+  Queue(std::string{cmd}, ParseInto(out, scpi::ParseFloatResponse));
+}
+
+void ScpiPipeline::GetAllModelOutputs(
+    Result<std::array<float, kModelOutputCount>>& out) {
+  constexpr auto cmd =
+      scpi::ChannelListCommand<"MOD:OUT? ", "\r\n", kModelOutputCount>(
+          kModelOutputCount);
+  Queue(std::string{cmd},
+        ParseInto(out, scpi::ParseRespFloatArray<kModelOutputCount>));
+}
+
+}  // namespace bci::abs
@@ -9,7 +9,10 @@
 
 #include <bci/abs/CommonTypes.h>
 
+#include <array>
+#include <cstdint>
 #include <optional>
+#include <span>
 #include <string>
 #include <string_view>
 
@@ -144,4 +147,98 @@ Result<ScpiError> ParseScpiError(std::string_view str) {
   return ScpiError{*err_num, *std::move(err_msg)};
 }
 
+Result<bool> ParseDataFormat(std::string_view str) {
+  str = util::Trim(str);
+
+  const auto type = util::Trim(str.substr(0, str.find(',')));
+  if (type == "REAL") {
+    return true;
+  }
+  if (type == "ASC" || type == "ASCII") {
+    return false;
+  }
+
+  return Err(ec::kInvalidResponse);
+}
+
+Result<DeviceInfo> ParseDeviceInfo(std::string_view str) {
+  std::array<std::string_view, 4> idn;
+  if (SplitRespMnemonics(str, idn) != ec::kSuccess) {
+    return Err(ec::kInvalidResponse);
+  }
+
+  return DeviceInfo{std::string(idn[1]), std::string(idn[2]),
+                    std::string(idn[3])};
+}
+
+Result<MeasurementSnapshot> ParseMeasurementSnapshot(std::string_view str) {
+  std::array<std::string_view, 6> parts{};
+  auto e = SplitCompoundResp(str, std::span{parts});
+  if (e != ec::kSuccess) {
+    return Err(e);
+  }
+
+  MeasurementSnapshot snapshot{};
+
+  e = SplitRespFloats(parts[0], snapshot.cell_voltages);
+  if (e != ec::kSuccess) {
+    return Err(e);
+  }
+
+  e = SplitRespFloats(parts[1], snapshot.cell_currents);
+  if (e != ec::kSuccess) {
+    return Err(e);
+  }
+
+  e = ParseRespMnemonics(parts[2], std::span{snapshot.cell_modes},
+                         ParseCellOperatingMode);
+  if (e != ec::kSuccess) {
+    return Err(e);
+  }
+
+  e = SplitRespFloats(parts[3], snapshot.analog_inputs);
+  if (e != ec::kSuccess) {
+    return Err(e);
+  }
+
+  auto digital_inputs = ParseRespBoolMask<kDigitalInputCount>(parts[4]);
+  if (!digital_inputs) {
+    return Err(digital_inputs.error());
+  }
+  snapshot.digital_inputs = *digital_inputs;
+
+  auto alarms = ParseIntResponse<std::uint32_t>(parts[5]);
+  if (!alarms) {
+    return Err(alarms.error());
+  }
+  snapshot.alarms = *alarms;
+
+  return snapshot;
+}
+
+Result<DeviceHealth> ParseDeviceHealth(std::string_view str) {
+  std::array<std::string_view, 3> parts{};
+  auto e = SplitCompoundResp(str, std::span{parts});
+  if (e != ec::kSuccess) {
+    return Err(e);
+  }
+
+  auto alarms = ParseIntResponse<std::uint32_t>(parts[0]);
+  if (!alarms) {
+    return Err(alarms.error());
+  }
+
+  auto interlock = ParseBoolResponse(parts[1]);
+  if (!interlock) {
+    return Err(interlock.error());
+  }
+
+  auto error_count = ParseIntResponse<int>(parts[2]);
+  if (!error_count) {
+    return Err(error_count.error());
+  }
+
+  return DeviceHealth{*alarms, *interlock, *error_count};
+}
+
 }  // namespace bci::abs::scpi
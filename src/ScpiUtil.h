@@ -10,45 +10,264 @@
 
 #include <bci/abs/CommonTypes.h>
 
+#include <algorithm>
+#include <array>
+#include <bit>
 #include <concepts>
+#include <cstddef>
+#include <cstdint>
 #include <optional>
 #include <ranges>
 #include <span>
 #include <string>
 #include <string_view>
+#include <system_error>
 #include <utility>
 
+#include <fast_float/fast_float.h>
+
 #include "StringUtil.h"
 #include "Util.h"
 
 namespace bci::abs::scpi {
 
-template <std::size_t kLen>
-constexpr ErrorCode SplitRespFloats(std::string_view resp,
-                                    std::span<float, kLen> out) {
-  resp = util::Trim(resp);
+// Stack buffer for reading a single response, large enough for any reply the
+// ABS sends (the longest are the 36 model outputs).
+using ResponseBuffer = std::array<char, 1024>;
+
+// Most data the stream drivers buffer while waiting for the end of a response.
+// Far more than any response needs, but it bounds the memory used if the
+// terminator never comes.
+inline constexpr std::size_t kMaxResponseSize = 1024 * 1024;
+
+// Location of an IEEE 488.2 definite-length block, "#<n><len><data>", where n
+// is the number of digits in len. Offsets are from the start of the response.
+struct BlockHeader {
+  std::size_t start;  // offset of the '#'
+  std::size_t data;   // offset of the first data byte
+  std::size_t end;    // offset one past the last data byte
+};
+
+// Parse the header of a definite-length block at the start of a response,
+// ignoring leading whitespace. Returns nothing if the response doesn't start
+// with a complete block header.
+constexpr std::optional<BlockHeader> ParseBlockHeader(
+    std::string_view resp) noexcept {
+  std::size_t start = 0;
+  while (start < resp.size() && util::IsTrimChar(resp[start])) {
+    ++start;
+  }
 
-  std::size_t i = 0;
-  for (const auto val : std::views::split(resp, ',')) {
-    if (i >= out.size()) {
-      return ErrorCode::kInvalidResponse;
+  if (resp.size() - start < 2 || resp[start] != '#' ||
+      resp[start + 1] < '1' || resp[start + 1] > '9') {
+    return std::nullopt;
+  }
+
+  const std::size_t digits = resp[start + 1] - '0';
+  const std::size_t data = start + 2 + digits;
+  if (resp.size() < data) {
+    return std::nullopt;
+  }
+
+  std::size_t len = 0;
+  for (std::size_t i = start + 2; i < data; ++i) {
+    if (resp[i] < '0' || resp[i] > '9') {
+      return std::nullopt;
     }
+    len = len * 10 + static_cast<std::size_t>(resp[i] - '0');
+  }
 
-    if (auto v = util::StrViewToFloat(
-            std::string_view(&*val.begin(), std::ranges::distance(val)))) {
-      out[i++] = *v;
-    } else {
-      return ErrorCode::kInvalidResponse;
+  return BlockHeader{start, data, data + len};
+}
+
+// Find the end of the first complete response in data received from a
+// stream, returning its length including the terminating newline. Unlike
+// searching for the first newline, this skips over binary blocks (which may
+// contain newlines) anywhere in a compound response, as well as quoted
+// strings. Only '"' quotes a string, as in the ABS's string responses, so an
+// apostrophe in an error message can't hide the terminator. Returns nothing if
+// the response is incomplete.
+constexpr std::optional<std::size_t> FindResponseEnd(
+    std::string_view data) noexcept {
+  std::size_t pos = 0;
+  bool element_start = true;
+  bool in_quotes = false;
+  while (pos < data.size()) {
+    if (element_start) {
+      element_start = false;
+      if (auto block = ParseBlockHeader(data.substr(pos))) {
+        pos += block->end;
+        continue;
+      }
+    }
+
+    const char c = data[pos++];
+    if (c == '"') {
+      in_quotes = !in_quotes;
+    } else if (in_quotes) {
+      continue;
+    } else if (c == ';') {
+      element_start = true;
+    } else if (c == '\n') {
+      return pos;
     }
   }
 
-  if (i < out.size()) {
+  return std::nullopt;
+}
+
+static_assert(FindResponseEnd("1.5\n2.5\n") == 4);
+static_assert(FindResponseEnd("-100,\"Can't parse\"\n") == 19);
+static_assert(!FindResponseEnd("0,\"line\nbreak"));
+static_assert(FindResponseEnd("#15a\nbc;1\n") == 10);
+
+// Whether a command expects a response, that is, whether any element of it is a
+// query.
+constexpr bool IsQuery(std::string_view command) noexcept {
+  bool in_quotes = false;
+  for (char c : command) {
+    if (c == '"') {
+      in_quotes = !in_quotes;
+    } else if (c == '?' && !in_quotes) {
+      return true;
+    }
+  }
+  return false;
+}
+
+static_assert(IsQuery("SOUR1:VOLT?\r\n"));
+static_assert(IsQuery("SOUR1:VOLT 1;:SOUR1:VOLT?\r\n"));
+static_assert(!IsQuery("SOUR1:VOLT 1\r\n"));
+static_assert(!IsQuery("SYST:NAME \"who?\"\r\n"));
+
+// Whether a command may be sent again if its response is lost. Every element
+// must be a query, and none may read the error queue, since that removes the
+// errors read.
+constexpr bool IsRepeatableQuery(std::string_view command) noexcept {
+  const auto upper = [](char c) {
+    return c >= 'a' && c <= 'z' ? static_cast<char>(c - 'a' + 'A') : c;
+  };
+  const auto reads_errors = [&](std::string_view header) {
+    for (std::string_view prefix : {"SYST:ERR", "SYSTEM:ERR"}) {
+      if (header.size() >= prefix.size() &&
+          std::ranges::equal(header.substr(0, prefix.size()), prefix, {},
+                             upper)) {
+        return true;
+      }
+    }
+    return false;
+  };
+
+  bool any = false;
+  bool in_quotes = false;
+  std::size_t start = 0;
+  for (std::size_t i = 0; i <= command.size(); ++i) {
+    if (i < command.size()) {
+      if (command[i] == '"') {
+        in_quotes = !in_quotes;
+      }
+      if (in_quotes || command[i] != ';') {
+        continue;
+      }
+    }
+
+    auto element = util::Trim(command.substr(start, i - start));
+    start = i + 1;
+    if (element.starts_with(':')) {
+      element.remove_prefix(1);
+    }
+    if (element.empty()) {
+      continue;
+    }
+
+    const auto header = element.substr(0, element.find(' '));
+    if (!header.ends_with('?') || reads_errors(header)) {
+      return false;
+    }
+    any = true;
+  }
+  return any;
+}
+
+static_assert(IsRepeatableQuery("MEAS:VOLT? (@1:8)\r\n"));
+static_assert(IsRepeatableQuery("*IDN?;:MEAS1:CURR?\r\n"));
+static_assert(!IsRepeatableQuery("SOUR1:VOLT 1;:SOUR1:VOLT?\r\n"));
+static_assert(!IsRepeatableQuery("SYST:ERR?\r\n"));
+static_assert(!IsRepeatableQuery(":syst:err:coun?\r\n"));
+static_assert(!IsRepeatableQuery("SOUR1:VOLT 1\r\n"));
+
+// Decode a definite-length block of big-endian single-precision floats, as
+// sent with FORM REAL,32.
+template <std::size_t kLen>
+constexpr ErrorCode DecodeFloatBlock(std::string_view resp,
+                                     const BlockHeader& block,
+                                     std::span<float, kLen> out) {
+  if (block.end > resp.size() || !util::Trim(resp.substr(block.end)).empty()) {
+    return ErrorCode::kInvalidResponse;
+  }
+
+  if (block.end - block.data != out.size() * sizeof(float)) {
     return ErrorCode::kInvalidResponse;
   }
 
+  for (std::size_t i = 0; i < out.size(); ++i) {
+    std::uint32_t bits{};
+    for (std::size_t b = 0; b < sizeof(float); ++b) {
+      bits = (bits << 8) |
+             static_cast<unsigned char>(resp[block.data + i * 4 + b]);
+    }
+    out[i] = std::bit_cast<float>(bits);
+  }
+
   return ErrorCode::kSuccess;
 }
 
+// Parses the values in a single pass: each number is parsed in place and the
+// parser's end position is expected to land on the next comma, so elements
+// never need to be located or trimmed separately. Binary blocks are decoded
+// directly.
+template <std::size_t kLen>
+constexpr ErrorCode SplitRespFloats(std::string_view resp,
+                                    std::span<float, kLen> out) {
+  if (auto block = ParseBlockHeader(resp)) {
+    return DecodeFloatBlock(resp, *block, out);
+  }
+
+  if (out.empty()) {
+    return util::Trim(resp).empty() ? ErrorCode::kSuccess
+                                    : ErrorCode::kInvalidResponse;
+  }
+
+  const char* it = resp.data();
+  const char* const end = it + resp.size();
+
+  const auto skip_space = [&] {
+    while (it != end && util::IsTrimChar(*it)) {
+      ++it;
+    }
+  };
+
+  for (std::size_t i = 0;;) {
+    skip_space();
+    auto [ptr, ec] = fast_float::from_chars(it, end, out[i]);
+    if (ec != std::errc()) {
+      return ErrorCode::kInvalidResponse;
+    }
+
+    it = ptr;
+    skip_space();
+
+    if (++i == out.size()) {
+      return it == end ? ErrorCode::kSuccess : ErrorCode::kInvalidResponse;
+    }
+
+    if (it == end || *it != ',') {
+      return ErrorCode::kInvalidResponse;
+    }
+    ++it;
+  }
+}
+
 template <std::size_t kLen>
 constexpr ErrorCode SplitRespFloats(std::string_view resp,
                                     std::array<float, kLen>& out) {
@@ -109,6 +328,88 @@ constexpr Result<std::array<bool, kLen>> ParseRespBoolArray(
   return res;
 }
 
+template <std::size_t kLen>
+constexpr Result<unsigned int> ParseRespBoolMask(std::string_view resp) {
+  std::array<bool, kLen> res{};
+  auto e = SplitRespBools(resp, res);
+  if (e != ErrorCode::kSuccess) {
+    return util::Err(e);
+  }
+
+  unsigned int mask{};
+  for (std::size_t i = 0; i < kLen; ++i) {
+    if (res[i]) {
+      mask |= (1U << i);
+    }
+  }
+
+  return mask;
+}
+
+// Split the response to a compound query (several queries joined with ';')
+// into the responses to each query. Separators inside quoted strings and
+// binary blocks are ignored, and binary blocks are not trimmed. Response
+// strings are always double-quoted, so apostrophes are ordinary characters.
+template <std::size_t kLen>
+constexpr ErrorCode SplitCompoundResp(std::string_view resp,
+                                      std::span<std::string_view, kLen> out) {
+  std::size_t i = 0;
+  std::size_t start = 0;
+  std::optional<BlockHeader> block;
+  bool in_quotes = false;
+  for (std::size_t pos = 0; pos <= resp.size(); ++pos) {
+    if (pos == start) {
+      block = ParseBlockHeader(resp.substr(start));
+      if (block) {
+        block->start += start;
+        block->data += start;
+        block->end += start;
+        if (block->end > resp.size()) {
+          return ErrorCode::kInvalidResponse;
+        }
+        pos = block->end;
+      }
+    }
+
+    if (pos < resp.size()) {
+      const char c = resp[pos];
+      if (c == '"') {
+        in_quotes = !in_quotes;
+      }
+      if (in_quotes || c != ';') {
+        continue;
+      }
+    }
+
+    if (i >= out.size()) {
+      return ErrorCode::kInvalidResponse;
+    }
+
+    if (block) {
+      if (!util::Trim(resp.substr(block->end, pos - block->end)).empty()) {
+        return ErrorCode::kInvalidResponse;
+      }
+      out[i++] = resp.substr(block->start, block->end - block->start);
+    } else {
+      out[i++] = util::Trim(resp.substr(start, pos - start));
+    }
+    start = pos + 1;
+  }
+
+  if (i < out.size()) {
+    return ErrorCode::kInvalidResponse;
+  }
+
+  return ErrorCode::kSuccess;
+}
+
+static_assert([] {
+  std::array<std::string_view, 3> parts{};
+  return SplitCompoundResp("Bloomy's;\"a;'b\";1", std::span{parts}) ==
+             ErrorCode::kSuccess &&
+         parts[0] == "Bloomy's" && parts[1] == "\"a;'b\"" && parts[2] == "1";
+}());
+
 template <std::size_t kLen>
 constexpr ErrorCode SplitRespMnemonics(std::string_view resp,
                                        std::span<std::string_view, kLen> out) {
@@ -185,10 +486,12 @@ constexpr ErrorCode ParseRespMnemonics(std::string_view resp,
 }
 
 constexpr Result<float> ParseFloatResponse(std::string_view text) {
-  if (auto f = util::StrViewToFloat(text)) {
-    return *f;
+  float f{};
+  auto e = SplitRespFloats(text, std::span<float, 1>{&f, 1});
+  if (e != ErrorCode::kSuccess) {
+    return util::Err(e);
   }
-  return util::Err(ErrorCode::kInvalidResponse);
+  return f;
 }
 
 constexpr Result<bool> ParseBoolResponse(std::string_view text) {
@@ -334,6 +637,18 @@ Result<std::string> ParseStringResponse(std::string_view str);
 
 Result<ScpiError> ParseScpiError(std::string_view str);
 
+// Parse the response to FORM?, returning true for REAL,32 and false for ASCII.
+Result<bool> ParseDataFormat(std::string_view str);
+
+Result<DeviceInfo> ParseDeviceInfo(std::string_view str);
+
+// Parse the response to the compound query sent by
+// ScpiClient::MeasureSnapshot().
+Result<MeasurementSnapshot> ParseMeasurementSnapshot(std::string_view str);
+
+// Parse the response to the compound query sent by ScpiClient::GetHealth().
+Result<DeviceHealth> ParseDeviceHealth(std::string_view str);
+
 template <std::size_t kLen>
 static Result<std::array<std::string, kLen>> ParseStringArrayResponse(
     std::string_view str) {
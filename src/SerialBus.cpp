@@ -0,0 +1,336 @@
+/*
+ * Copyright (c) 2024, Bloomy Controls, Inc. All rights reserved.
+ *
+ * Use of this source code is governed by a BSD-3-clause license that can be
+ * found in the LICENSE file or at https://opensource.org/license/BSD-3-Clause
+ */
+
+#include <bci/abs/SerialBus.h>
+#include <bci/abs/SerialDriver.h>
+
+#include <algorithm>
+#include <array>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+
+#include "InstrumentUtil.h"
+#include "ScpiUtil.h"
+#include "Util.h"
+
+namespace bci::abs::drivers {
+
+using util::Err;
+using ec = ErrorCode;
+
+namespace {
+
+constexpr unsigned int kBroadcastId = 32;
+
+}  // namespace
+
+struct SerialBus::Impl {
+  // A transaction waiting for the bus. Jobs live on the waiting caller's stack.
+  struct Job {
+    // command to send, if any
+    std::string_view command;
+    unsigned int id;
+    bool query;
+    unsigned int timeout_ms;
+    bool done;
+    ErrorCode error;
+    std::string response;
+  };
+
+  Impl();
+
+  ErrorCode Open(const std::string& port);
+
+  void Close() noexcept;
+
+  // Stop the bus thread. Queued jobs fail.
+  void Stop() noexcept;
+
+  // Queue a job and wait for the bus thread to complete it.
+  void Run(Job& job);
+
+ private:
+  SerialDriver driver_;
+
+  // held by the bus thread for each transaction, and while opening or closing
+  // the port
+  std::mutex driver_mutex_;
+
+  std::mutex mutex_;
+  std::condition_variable work_cv_;
+  std::condition_variable done_cv_;
+  std::array<std::deque<Job*>, kBroadcastId + 1> queues_;
+  unsigned int next_id_;
+  bool open_;
+  bool stopping_;
+  std::thread thread_;
+
+  // Body of the bus thread.
+  void Serve();
+
+  // Take the next job to perform, if any. mutex_ must be held.
+  Job* NextJob();
+
+  // Perform a job on the port. driver_mutex_ must be held.
+  void Execute(Job& job);
+
+  // Fail every queued job matching pred. mutex_ must be held.
+  template <class Pred>
+  void FailQueued(ErrorCode error, Pred&& pred);
+};
+
+// Driver for a single device on the bus. Queries are held until the client
+// reads their response, then sent and read back as a single transaction.
+class SerialBus::DeviceDriver final : public CommDriver {
+ public:
+  DeviceDriver(std::shared_ptr<SerialBus::Impl> bus, unsigned int id)
+      : bus_{std::move(bus)}, id_{std::min(id, kBroadcastId)} {}
+
+  ErrorCode Write(std::string_view data,
+                  unsigned int timeout_ms) const override {
+    return instr::ReportWrite(Instrumentation(), data, [&] {
+      if (scpi::IsQuery(data) && !IsSendOnly()) {
+        pending_.emplace_back(data);
+        return ec::kSuccess;
+      }
+
+      Impl::Job job{data, id_, false, timeout_ms, false, ec::kSuccess, {}};
+      bus_->Run(job);
+      if (job.error != ec::kSuccess) {
+        pending_.clear();
+      }
+      return job.error;
+    });
+  }
+
+  Result<std::string> ReadLine(unsigned int timeout_ms) const override {
+    return instr::ReportRead(Instrumentation(), [&]() -> Result<std::string> {
+      auto job = Transact(timeout_ms);
+      if (job.error != ec::kSuccess) {
+        return Err(job.error);
+      }
+      return std::move(job.response);
+    });
+  }
+
+  Result<std::string_view> ReadLineInto(
+      std::span<char> buf, unsigned int timeout_ms) const override {
+    return instr::ReportRead(
+        Instrumentation(), [&]() -> Result<std::string_view> {
+          const auto job = Transact(timeout_ms);
+          if (job.error != ec::kSuccess) {
+            return Err(job.error);
+          }
+          if (job.response.size() > buf.size()) {
+            return Err(ec::kBufferTooSmall);
+          }
+          std::ranges::copy(job.response, buf.begin());
+          return std::string_view(buf.data(), job.response.size());
+        });
+  }
+
+  unsigned int GetDeviceID() const override { return id_; }
+
+  bool IsSendOnly() const override { return id_ >= kBroadcastId; }
+
+ private:
+  std::shared_ptr<SerialBus::Impl> bus_;
+  unsigned int id_;
+
+  // queries written but not yet read, oldest first; unsynchronized, like the
+  // rest of a driver's state
+  mutable std::deque<std::string> pending_;
+
+  // Send the oldest pending query, if any, and read its response.
+  Impl::Job Transact(unsigned int timeout_ms) const {
+    std::string command;
+    if (!pending_.empty()) {
+      command = std::move(pending_.front());
+      pending_.pop_front();
+    }
+
+    Impl::Job job{command, id_, true, timeout_ms, false, ec::kSuccess, {}};
+    bus_->Run(job);
+    job.command = {};
+    // after a failure, the queries still pending would be sent for reads
+    // expecting the responses of later ones
+    if (job.error != ec::kSuccess) {
+      pending_.clear();
+    }
+    return job;
+  }
+};
+
+SerialBus::SerialBus() : impl_(std::make_shared<Impl>()) {}
+
+SerialBus::~SerialBus() { impl_->Stop(); }
+
+ErrorCode SerialBus::Open(const std::string& port) { return impl_->Open(port); }
+
+void SerialBus::Close() noexcept { impl_->Close(); }
+
+std::shared_ptr<CommDriver> SerialBus::Device(unsigned int id) const {
+  return std::make_shared<DeviceDriver>(impl_, id);
+}
+
+SerialBus::Impl::Impl()
+    : driver_(),
+      driver_mutex_(),
+      mutex_(),
+      work_cv_(),
+      done_cv_(),
+      queues_(),
+      next_id_{},
+      open_{false},
+      stopping_{false},
+      thread_([this] { Serve(); }) {}
+
+ErrorCode SerialBus::Impl::Open(const std::string& port) {
+  std::lock_guard driver_lock{driver_mutex_};
+  const auto res = driver_.Open(port);
+  if (res == ec::kSuccess) {
+    std::lock_guard lock{mutex_};
+    open_ = !stopping_;
+  }
+  return res;
+}
+
+void SerialBus::Impl::Close() noexcept {
+  {
+    std::lock_guard lock{mutex_};
+    open_ = false;
+    FailQueued(ec::kNotConnected, [](const Job&) { return true; });
+  }
+
+  // waits for the current transaction, if any
+  std::lock_guard driver_lock{driver_mutex_};
+  driver_.Close();
+}
+
+void SerialBus::Impl::Stop() noexcept {
+  {
+    std::lock_guard lock{mutex_};
+    stopping_ = true;
+  }
+  work_cv_.notify_all();
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+  Close();
+}
+
+void SerialBus::Impl::Run(Job& job) {
+  std::unique_lock lock{mutex_};
+  if (!open_) {
+    job.error = ec::kNotConnected;
+    return;
+  }
+
+  queues_[job.id].push_back(&job);
+  work_cv_.notify_one();
+  done_cv_.wait(lock, [&] { return job.done; });
+}
+
+void SerialBus::Impl::Serve() {
+  std::unique_lock lock{mutex_};
+  for (;;) {
+    Job* job{};
+    work_cv_.wait(lock, [&] { return stopping_ || (job = NextJob()); });
+    if (stopping_) {
+      // anything still queued is failed by Close()
+      return;
+    }
+
+    lock.unlock();
+    {
+      std::lock_guard driver_lock{driver_mutex_};
+      Execute(*job);
+    }
+    lock.lock();
+
+    // an unresponsive device would make each of its queued queries wait out
+    // the same timeout, holding up the rest of the bus
+    if (job->error == ec::kReadTimedOut) {
+      FailQueued(ec::kReadTimedOut, [id = job->id](const Job& queued) {
+        return queued.id == id && queued.query;
+      });
+    }
+
+    job->done = true;
+    done_cv_.notify_all();
+  }
+}
+
+SerialBus::Impl::Job* SerialBus::Impl::NextJob() {
+  // broadcasts don't wait for a response, so send them first
+  if (auto& q = queues_[kBroadcastId]; !q.empty()) {
+    auto* job = q.front();
+    q.pop_front();
+    return job;
+  }
+
+  for (unsigned int i = 0; i < kBroadcastId; ++i) {
+    const auto id = (next_id_ + i) % kBroadcastId;
+    if (auto& q = queues_[id]; !q.empty()) {
+      auto* job = q.front();
+      q.pop_front();
+      next_id_ = id + 1;
+      return job;
+    }
+  }
+
+  return nullptr;
+}
+
+void SerialBus::Impl::Execute(Job& job) {
+  driver_.SetDeviceID(job.id);
+
+  if (!job.command.empty()) {
+    job.error = driver_.Write(job.command, job.timeout_ms);
+    if (job.error != ec::kSuccess) {
+      return;
+    }
+  }
+
+  if (job.query) {
+    auto resp = driver_.ReadLine(job.timeout_ms);
+    if (resp) {
+      job.response = std::move(*resp);
+    } else {
+      job.error = resp.error();
+    }
+  }
+}
+
+template <class Pred>
+void SerialBus::Impl::FailQueued(ErrorCode error, Pred&& pred) {
+  bool failed = false;
+  for (auto& q : queues_) {
+    std::erase_if(q, [&](Job* job) {
+      if (!pred(*job)) {
+        return false;
+      }
+      job->error = error;
+      job->done = true;
+      failed = true;
+      return true;
+    });
+  }
+  if (failed) {
+    done_cv_.notify_all();
+  }
+}
+
+}  // namespace bci::abs::drivers
@@ -5,42 +5,65 @@
  * found in the LICENSE file or at https://opensource.org/license/BSD-3-Clause
  */
 
+#include <bci/abs/IoContext.h>
 #include <bci/abs/SerialDriver.h>
 #include <fmt/core.h>
 
 #include <algorithm>
+#include <array>
 #include <atomic>
 #include <boost/asio.hpp>
 #include <boost/asio/deadline_timer.hpp>
 #include <boost/asio/read_until.hpp>
 #include <boost/asio/serial_port.hpp>
+#include <boost/asio/strand.hpp>
 #include <boost/asio/streambuf.hpp>
 #include <boost/asio/write.hpp>
+#include <cstddef>
 #include <memory>
+#include <span>
 #include <string>
 #include <string_view>
 
-#include "Util.h"
+#ifndef _WIN32
+#include <termios.h>
+#endif
+
+#ifdef __linux__
+#include <linux/serial.h>
+#include <sys/ioctl.h>
+#endif
 
-using boost::asio::deadline_timer;
+#include "InstrumentUtil.h"
+#include "IoContextImpl.h"
+#include "ResponseMatch.h"
+#include "Util.h"
 
 namespace bci::abs::drivers {
 
 using util::Err;
 
 struct SerialDriver::Impl {
-  Impl();
+  // Use the shared context if given, otherwise create a private io_service.
+  explicit Impl(IoContext::Impl* shared_context);
 
   ~Impl();
 
-  ErrorCode Open(const std::string& port);
+  ErrorCode Open(const std::string& port, const SerialOptions& options);
 
   void Close() noexcept;
 
   ErrorCode Write(std::string_view data, unsigned int timeout_ms);
 
+  ErrorCode Flush();
+
+  ErrorCode DiscardInput();
+
   Result<std::string> ReadLine(unsigned int timeout_ms);
 
+  Result<std::string_view> ReadLineInto(std::span<char> buf,
+                                        unsigned int timeout_ms);
+
   void SetDeviceID(unsigned int id);
 
   unsigned int GetDeviceID() const;
@@ -48,33 +71,78 @@ struct SerialDriver::Impl {
   bool IsBroadcast() const;
 
  private:
-  boost::asio::io_service io_service_;
+  std::unique_ptr<boost::asio::io_service> owned_io_service_;
+  boost::asio::io_service& io_service_;
+  boost::asio::strand<boost::asio::io_service::executor_type> strand_;
   boost::asio::serial_port port_;
   boost::asio::deadline_timer deadline_;
   boost::asio::streambuf input_buffer_;
   unsigned int dev_id_;
   std::atomic<bool> timeout_;
+  // null for a private io_service
+  IoContext::Impl* context_;
+  bool pipeline_;
+
+  // "@{id} " for the current device ID
+  std::array<char, 8> prefix_buf_;
+  std::size_t prefix_len_;
+
+  // broadcast commands held by the pipelining mode, prefixes included
+  std::string held_;
+
+  void StartDeadline(unsigned int timeout_ms);
+
+  // Set the port's low latency flag where supported.
+  void SetLowLatency();
 
-  void CheckDeadline();
+  // Start an asynchronous operation on the strand with start(done), and block
+  // until its handler calls done(store), where store() stores the results.
+  // Returns false without waiting if the IoContext is stopped.
+  template <class Start>
+  bool RunBlocking(Start&& start);
+
+  // Wait for a complete line and return its length including the newline.
+  Result<std::size_t> WaitForLine(unsigned int timeout_ms);
 };
 
-SerialDriver::SerialDriver() : impl_(std::make_shared<Impl>()) {}
+SerialDriver::SerialDriver() : impl_(std::make_shared<Impl>(nullptr)) {}
+
+SerialDriver::SerialDriver(IoContext& io_context)
+    : impl_(std::make_shared<Impl>(io_context.impl_.get())) {}
 
 SerialDriver::~SerialDriver() { Close(); }
 
 ErrorCode SerialDriver::Open(const std::string& port) {
-  return impl_->Open(port);
+  return impl_->Open(port, SerialOptions{});
+}
+
+ErrorCode SerialDriver::Open(const std::string& port,
+                             const SerialOptions& options) {
+  return impl_->Open(port, options);
 }
 
 void SerialDriver::Close() noexcept { impl_->Close(); }
 
 ErrorCode SerialDriver::Write(std::string_view data,
                               unsigned int timeout_ms) const {
-  return impl_->Write(data, timeout_ms);
+  return instr::ReportWrite(Instrumentation(), data,
+                            [&] { return impl_->Write(data, timeout_ms); });
 }
 
+ErrorCode SerialDriver::Flush() const { return impl_->Flush(); }
+
+ErrorCode SerialDriver::DiscardInput() const { return impl_->DiscardInput(); }
+
 Result<std::string> SerialDriver::ReadLine(unsigned int timeout_ms) const {
-  return impl_->ReadLine(timeout_ms);
+  return instr::ReportRead(Instrumentation(),
+                           [&] { return impl_->ReadLine(timeout_ms); });
+}
+
+Result<std::string_view> SerialDriver::ReadLineInto(
+    std::span<char> buf, unsigned int timeout_ms) const {
+  return instr::ReportRead(Instrumentation(), [&] {
+    return impl_->ReadLineInto(buf, timeout_ms);
+  });
 }
 
 void SerialDriver::SetDeviceID(unsigned int id) { impl_->SetDeviceID(id); }
@@ -83,20 +151,30 @@ unsigned int SerialDriver::GetDeviceID() const { return impl_->GetDeviceID(); }
 
 bool SerialDriver::IsSendOnly() const { return impl_->IsBroadcast(); }
 
-SerialDriver::Impl::Impl()
-    : io_service_(),
-      port_(io_service_),
-      deadline_(io_service_),
-      input_buffer_(),
+SerialDriver::Impl::Impl(IoContext::Impl* shared_context)
+    : owned_io_service_(shared_context
+                            ? nullptr
+                            : std::make_unique<boost::asio::io_service>()),
+      io_service_(shared_context ? shared_context->io_service
+                                 : *owned_io_service_),
+      strand_(boost::asio::make_strand(io_service_)),
+      port_(strand_),
+      deadline_(strand_),
+      input_buffer_(scpi::kMaxResponseSize),
       dev_id_{},
-      timeout_{} {
-  deadline_.expires_at(boost::posix_time::pos_infin);
-  CheckDeadline();
+      timeout_{},
+      context_(shared_context),
+      pipeline_{},
+      prefix_buf_{},
+      prefix_len_{},
+      held_{} {
+  SetDeviceID(0);
 }
 
 SerialDriver::Impl::~Impl() { Close(); }
 
-ErrorCode SerialDriver::Impl::Open(const std::string& port) {
+ErrorCode SerialDriver::Impl::Open(const std::string& port,
+                                   const SerialOptions& options) {
   boost::system::error_code ec{};
 
   if (port_.is_open()) {
@@ -110,7 +188,7 @@ ErrorCode SerialDriver::Impl::Open(const std::string& port) {
 
   using boost::asio::serial_port;
 
-  port_.set_option(serial_port::baud_rate(115200), ec);
+  port_.set_option(serial_port::baud_rate(options.baud_rate), ec);
   if (ec) {
     return ErrorCode::kFailedToConfigurePort;
   }
@@ -137,11 +215,24 @@ ErrorCode SerialDriver::Impl::Open(const std::string& port) {
     return ErrorCode::kFailedToConfigurePort;
   }
 
+  if (options.low_latency) {
+    SetLowLatency();
+  }
+
+  pipeline_ = options.pipeline_broadcasts;
+  held_.clear();
+
   return ErrorCode::kSuccess;
 }
 
 void SerialDriver::Impl::Close() noexcept {
+  if (port_.is_open()) {
+    static_cast<void>(Flush());
+  }
+  held_.clear();
+
   boost::system::error_code ignored;
+  deadline_.cancel(ignored);
   port_.close(ignored);
 }
 
@@ -153,18 +244,48 @@ ErrorCode SerialDriver::Impl::Write(std::string_view data,
     return ErrorCode::kNotConnected;
   }
 
-  char dev_id_buf[8]{};
-  fmt::format_to_n(dev_id_buf, sizeof(dev_id_buf) - 1, "@{} ", dev_id_);
-  std::string_view dev_id_str{dev_id_buf};
+  const std::string_view prefix{prefix_buf_.data(), prefix_len_};
+
+  if (pipeline_ && IsBroadcast()) {
+    held_.append(prefix);
+    held_.append(data);
+    return held_.size() >= kPipelineBufferSize ? Flush()
+                                               : ErrorCode::kSuccess;
+  }
+
+  // send anything held, the prefix, and the data in one write
+  const std::array<boost::asio::const_buffer, 3> bufs{
+      boost::asio::buffer(held_),
+      boost::asio::buffer(prefix),
+      boost::asio::buffer(data),
+  };
 
   boost::system::error_code ec{};
 
-  boost::asio::write(port_, boost::asio::buffer(dev_id_str), ec);
+  const auto written = boost::asio::write(port_, bufs, ec);
+  // commands which didn't go out stay held for the next write
+  held_.erase(0, std::min(written, held_.size()));
   if (ec) {
     return ErrorCode::kSendFailed;
   }
 
-  boost::asio::write(port_, boost::asio::buffer(data), ec);
+  return ErrorCode::kSuccess;
+}
+
+ErrorCode SerialDriver::Impl::Flush() {
+  if (!port_.is_open()) {
+    return ErrorCode::kNotConnected;
+  }
+
+  if (held_.empty()) {
+    return ErrorCode::kSuccess;
+  }
+
+  boost::system::error_code ec{};
+
+  const auto written =
+      boost::asio::write(port_, boost::asio::buffer(held_), ec);
+  held_.erase(0, written);
   if (ec) {
     return ErrorCode::kSendFailed;
   }
@@ -172,54 +293,160 @@ ErrorCode SerialDriver::Impl::Write(std::string_view data,
   return ErrorCode::kSuccess;
 }
 
-Result<std::string> SerialDriver::Impl::ReadLine(unsigned int timeout_ms) {
+ErrorCode SerialDriver::Impl::DiscardInput() {
   if (!port_.is_open()) {
-    return Err(ErrorCode::kNotConnected);
+    return ErrorCode::kNotConnected;
   }
 
-  timeout_ = false;
-  deadline_.expires_from_now(boost::posix_time::milliseconds(timeout_ms));
+  input_buffer_.consume(input_buffer_.size());
 
-  boost::system::error_code ec = boost::asio::error::would_block;
+  // also drop what the OS has received but asio hasn't read yet
+#ifdef _WIN32
+  if (!::PurgeComm(port_.native_handle(), PURGE_RXCLEAR)) {
+    return ErrorCode::kReadFailed;
+  }
+#else
+  if (::tcflush(port_.native_handle(), TCIFLUSH) != 0) {
+    return ErrorCode::kReadFailed;
+  }
+#endif
 
-  const auto read_handler = [&](auto&& e, auto&&) { ec = e; };
-  boost::asio::async_read_until(port_, input_buffer_, '\n', read_handler);
+  return ErrorCode::kSuccess;
+}
 
-  do {
-    io_service_.run_one();
-  } while (ec == boost::asio::error::would_block);
+Result<std::string> SerialDriver::Impl::ReadLine(unsigned int timeout_ms) {
+  return WaitForLine(timeout_ms).map([this](std::size_t len) {
+    // a binary block may contain newlines, so copy exactly one response
+    const auto* data = static_cast<const char*>(input_buffer_.data().data());
+    std::string line(data, len - 1);
+    input_buffer_.consume(len);
+    return line;
+  });
+}
+
+Result<std::string_view> SerialDriver::Impl::ReadLineInto(
+    std::span<char> buf, unsigned int timeout_ms) {
+  auto len = WaitForLine(timeout_ms);
+  if (!len) {
+    return Err(len.error());
+  }
+
+  // drop the newline, but consume the whole line even if it doesn't fit so
+  // the next read starts at the next line
+  const auto line_len = *len - 1;
+  if (line_len > buf.size()) {
+    input_buffer_.consume(*len);
+    return Err(ErrorCode::kBufferTooSmall);
+  }
+
+  boost::asio::buffer_copy(boost::asio::buffer(buf.data(), line_len),
+                           input_buffer_.data());
+  input_buffer_.consume(*len);
+
+  return std::string_view(buf.data(), line_len);
+}
+
+Result<std::size_t> SerialDriver::Impl::WaitForLine(unsigned int timeout_ms) {
+  if (!port_.is_open()) {
+    return Err(ErrorCode::kNotConnected);
+  }
+
+  if (auto ret = Flush(); ret != ErrorCode::kSuccess) {
+    return Err(ret);
+  }
+
+  boost::system::error_code ec;
+  std::size_t line_len{};
+
+  const bool completed = RunBlocking([&](auto done) {
+    StartDeadline(timeout_ms);
+    boost::asio::async_read_until(port_, input_buffer_, ResponseEndMatch{},
+                                  [&, done](auto&& e, std::size_t len) {
+                                    done([&] {
+                                      boost::system::error_code ignored;
+                                      deadline_.cancel(ignored);
+                                      ec = e;
+                                      line_len = len;
+                                    });
+                                  });
+  });
+
+  if (!completed) {
+    return Err(ErrorCode::kNotConnected);
+  }
 
   if (timeout_) {
     return Err(ErrorCode::kReadTimedOut);
   }
 
+  // the buffer filled up without a terminator, so discard it
+  if (ec == boost::asio::error::not_found) {
+    input_buffer_.consume(input_buffer_.size());
+    return Err(ErrorCode::kResponseTooLong);
+  }
+
   if (ec) {
     return Err(ErrorCode::kReadFailed);
   }
 
-  std::string line;
-  std::istream is(&input_buffer_);
-  std::getline(is, line);
-
-  return line;
+  return line_len;
 }
 
 void SerialDriver::Impl::SetDeviceID(unsigned int id) {
   dev_id_ = std::clamp(id, 0U, 32U);
+  prefix_len_ = fmt::format_to_n(prefix_buf_.data(), prefix_buf_.size(),
+                                 "@{} ", dev_id_)
+                    .size;
 }
 
 unsigned int SerialDriver::Impl::GetDeviceID() const { return dev_id_; }
 
 bool SerialDriver::Impl::IsBroadcast() const { return dev_id_ > 31; }
 
-void SerialDriver::Impl::CheckDeadline() {
-  if (deadline_.expires_at() <= deadline_timer::traits_type::now()) {
-    timeout_ = true;
-    port_.cancel();
-    deadline_.expires_at(boost::posix_time::pos_infin);
+template <class Start>
+bool SerialDriver::Impl::RunBlocking(Start&& start) {
+  auto wait = std::make_shared<BlockingWait>(io_service_, context_);
+  if (wait->Stopped()) {
+    return false;
+  }
+  // start is only used while the caller is still waiting
+  boost::asio::post(strand_, [&start, wait] {
+    wait->Start([&] { start(BlockingWait::Done{wait}); });
+  });
+  if (!wait->Wait()) {
+    // nothing runs the stopped io_service, so it's safe to cancel from here,
+    // which keeps the operation from using the caller's buffers if it's
+    // restarted
+    boost::system::error_code ignored;
+    port_.cancel(ignored);
+    deadline_.cancel(ignored);
+    return false;
   }
+  return true;
+}
 
-  deadline_.async_wait([&](auto&&) { this->CheckDeadline(); });
+void SerialDriver::Impl::SetLowLatency() {
+#ifdef __linux__
+  // not every serial driver supports this, and it's only an optimization
+  serial_struct serial{};
+  const int fd = port_.native_handle();
+  if (::ioctl(fd, TIOCGSERIAL, &serial) == 0) {
+    serial.flags |= ASYNC_LOW_LATENCY;
+    static_cast<void>(::ioctl(fd, TIOCSSERIAL, &serial));
+  }
+#endif
+}
+
+void SerialDriver::Impl::StartDeadline(unsigned int timeout_ms) {
+  timeout_ = false;
+  deadline_.expires_from_now(boost::posix_time::milliseconds(timeout_ms));
+  deadline_.async_wait([this](const boost::system::error_code& e) {
+    if (e != boost::asio::error::operation_aborted) {
+      timeout_ = true;
+      boost::system::error_code ignored;
+      port_.cancel(ignored);
+    }
+  });
 }
 
 }  // namespace bci::abs::drivers
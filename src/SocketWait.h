@@ -0,0 +1,55 @@
+/*
+ * Copyright (c) 2024, Bloomy Controls, Inc. All rights reserved.
+ *
+ * Use of this source code is governed by a BSD-3-clause license that can be
+ * found in the LICENSE file or at https://opensource.org/license/BSD-3-Clause
+ */
+
+#ifndef ABS_SCPI_DRIVER_SRC_SOCKETWAIT_H
+#define ABS_SCPI_DRIVER_SRC_SOCKETWAIT_H
+
+#include <boost/asio.hpp>
+#include <chrono>
+
+#ifndef _WIN32
+#include <poll.h>
+#endif
+
+namespace bci::abs::drivers {
+
+using PollClock = std::chrono::steady_clock;
+
+// Direction to wait for in WaitSocket().
+enum class SocketWait { kRead, kWrite };
+
+// Block until a socket in non-blocking mode is ready or the deadline passes,
+// without involving an io_service. Returns false once the deadline has passed.
+// Errors and interruptions report the socket as ready, so the caller's next
+// operation on it sees the actual result.
+template <class Socket>
+bool WaitSocket(Socket& socket, SocketWait dir,
+                PollClock::time_point deadline) {
+  using std::chrono::ceil;
+  using std::chrono::milliseconds;
+
+  const auto remaining = ceil<milliseconds>(deadline - PollClock::now());
+  if (remaining.count() <= 0) {
+    return false;
+  }
+
+#ifdef _WIN32
+  WSAPOLLFD pfd{};
+  pfd.fd = socket.native_handle();
+  pfd.events = dir == SocketWait::kRead ? POLLRDNORM : POLLWRNORM;
+  return ::WSAPoll(&pfd, 1, static_cast<int>(remaining.count())) != 0;
+#else
+  pollfd pfd{};
+  pfd.fd = socket.native_handle();
+  pfd.events = dir == SocketWait::kRead ? POLLIN : POLLOUT;
+  return ::poll(&pfd, 1, static_cast<int>(remaining.count())) != 0;
+#endif
+}
+
+}  // namespace bci::abs::drivers
+
+#endif /* ABS_SCPI_DRIVER_SRC_SOCKETWAIT_H */
@@ -0,0 +1,67 @@
+/*
+ * Copyright (c) 2024, Bloomy Controls, Inc. All rights reserved.
+ *
+ * Use of this source code is governed by a BSD-3-clause license that can be
+ * found in the LICENSE file or at https://opensource.org/license/BSD-3-Clause
+ */
+
+#ifndef ABS_SCPI_DRIVER_SRC_SPSCRING_H
+#define ABS_SCPI_DRIVER_SRC_SPSCRING_H
+
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <vector>
+
+namespace bci::abs {
+
+// Bounded lock-free queue for one producer thread and one consumer thread.
+template <class T>
+class SpscRing {
+ public:
+  // The capacity is rounded up to a power of two.
+  explicit SpscRing(std::size_t capacity)
+      : slots_(std::bit_ceil(capacity < 1 ? 1 : capacity)),
+        mask_{slots_.size() - 1},
+        head_{0},
+        tail_{0} {}
+
+  SpscRing(const SpscRing&) = delete;
+  SpscRing& operator=(const SpscRing&) = delete;
+
+  // Add a value, or return false if the queue is full. Producer only.
+  bool TryPush(const T& value) {
+    const auto tail = tail_.load(std::memory_order_relaxed);
+    if (tail - head_.load(std::memory_order_acquire) == slots_.size()) {
+      return false;
+    }
+    slots_[tail & mask_] = value;
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Take the oldest value, or return false if the queue is empty. Consumer
+  // only.
+  bool TryPop(T& out) {
+    const auto head = head_.load(std::memory_order_relaxed);
+    if (head == tail_.load(std::memory_order_acquire)) {
+      return false;
+    }
+    out = slots_[head & mask_];
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+ private:
+  // keeps the producer's and consumer's indices on separate cache lines
+  static constexpr std::size_t kCacheLine = 64;
+
+  std::vector<T> slots_;
+  std::size_t mask_;
+  alignas(kCacheLine) std::atomic<std::size_t> head_;
+  alignas(kCacheLine) std::atomic<std::size_t> tail_;
+};
+
+}  // namespace bci::abs
+
+#endif /* ABS_SCPI_DRIVER_SRC_SPSCRING_H */
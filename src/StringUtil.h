@@ -21,6 +21,11 @@ namespace bci::abs::util {
 
 inline constexpr std::string_view kTrimChars{" \t\v\r\n\0"};
 
+inline constexpr bool IsTrimChar(char c) noexcept {
+  return c == ' ' || c == '\t' || c == '\v' || c == '\r' || c == '\n' ||
+         c == '\0';
+}
+
 inline constexpr std::string_view Trim(std::string_view v) noexcept {
   if (v.size() == 0) {
     return v;
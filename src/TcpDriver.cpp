@@ -5,18 +5,28 @@
  * found in the LICENSE file or at https://opensource.org/license/BSD-3-Clause
  */
 
+#include <bci/abs/IoContext.h>
 #include <bci/abs/TcpDriver.h>
 
+#include <algorithm>
 #include <boost/asio.hpp>
 #include <boost/asio/deadline_timer.hpp>
 #include <boost/asio/ip/tcp.hpp>
-#include <boost/asio/read_until.hpp>
-#include <boost/asio/streambuf.hpp>
+#include <boost/asio/strand.hpp>
 #include <boost/asio/write.hpp>
+#include <chrono>
+#include <cstddef>
 #include <memory>
+#include <optional>
+#include <span>
 #include <string>
 #include <string_view>
+#include <utility>
 
+#include "InstrumentUtil.h"
+#include "IoContextImpl.h"
+#include "LineBuffer.h"
+#include "SocketWait.h"
 #include "Util.h"
 
 using boost::asio::deadline_timer;
@@ -26,12 +36,14 @@ namespace bci::abs::drivers {
 
 using util::Err;
 
-struct TcpDriver::Impl {
-  Impl();
+struct TcpDriver::Impl : std::enable_shared_from_this<TcpDriver::Impl> {
+  // Use the shared context if given, otherwise create a private io_service.
+  explicit Impl(IoContext::Impl* shared_context);
 
   ~Impl();
 
-  ErrorCode Connect(std::string_view ip, unsigned int timeout_ms);
+  ErrorCode Connect(std::string_view ip, unsigned int timeout_ms,
+                    const TcpOptions& options);
 
   void Close() noexcept;
 
@@ -39,50 +51,120 @@ struct TcpDriver::Impl {
 
   Result<std::string> ReadLine(unsigned int timeout_ms);
 
+  Result<std::string_view> ReadLineInto(std::span<char> buf,
+                                        unsigned int timeout_ms);
+
+  void AsyncWrite(std::string_view data, unsigned int timeout_ms,
+                  WriteHandler handler);
+
+  void AsyncReadLine(unsigned int timeout_ms, ReadHandler handler);
+
  private:
-  boost::asio::io_service io_service_;
+  std::unique_ptr<boost::asio::io_service> owned_io_service_;
+  boost::asio::io_service& io_service_;
+  boost::asio::strand<boost::asio::io_service::executor_type> strand_;
   boost::asio::ip::tcp::socket socket_;
   boost::asio::deadline_timer deadline_;
-  boost::asio::streambuf input_buffer_;
+  LineBuffer input_buffer_;
   bool did_timeout_;
+  // null for a private io_service
+  IoContext::Impl* context_;
 
   void StartDeadline(unsigned int timeout_ms);
+
+  // Start an asynchronous operation on the strand with start(done), and block
+  // until its handler calls done(store), where store() stores the results.
+  // Returns false without waiting if the IoContext is stopped.
+  template <class Start>
+  bool RunBlocking(Start&& start);
+
+  // Wait for a complete line and return its length including the newline.
+  Result<std::size_t> WaitForLine(unsigned int timeout_ms);
+
+  // Receive whatever has arrived without blocking. Returns the length of a
+  // complete line including the newline if the input buffer now holds one.
+  std::optional<std::size_t> ReceiveNow(boost::system::error_code& ec);
+
+  // Receive until the input buffer holds a complete line, then call handler
+  // with the error and the line's length including the newline.
+  template <class Handler>
+  void ReceiveLine(Handler&& handler);
+
+  // Move a line of length len out of the input buffer.
+  std::string TakeLine(std::size_t len);
+
+  // Move a line of length len out of the input buffer into buf.
+  Result<std::string_view> TakeLine(std::size_t len, std::span<char> buf);
+
+  // Map the error of a failed read to an error code. A response too long to
+  // buffer is discarded.
+  ErrorCode ReadError(const boost::system::error_code& ec);
 };
 
-TcpDriver::TcpDriver() : impl_(std::make_shared<Impl>()) {}
+TcpDriver::TcpDriver() : impl_(std::make_shared<Impl>(nullptr)) {}
+
+TcpDriver::TcpDriver(IoContext& io_context)
+    : impl_(std::make_shared<Impl>(io_context.impl_.get())) {}
 
 TcpDriver::~TcpDriver() { Close(); }
 
 ErrorCode TcpDriver::Connect(std::string_view ip, unsigned int timeout_ms) {
-  return impl_->Connect(ip, timeout_ms);
+  return impl_->Connect(ip, timeout_ms, TcpOptions{});
+}
+
+ErrorCode TcpDriver::Connect(std::string_view ip, unsigned int timeout_ms,
+                             const TcpOptions& options) {
+  return impl_->Connect(ip, timeout_ms, options);
 }
 
 void TcpDriver::Close() noexcept { impl_->Close(); }
 
 ErrorCode TcpDriver::Write(std::string_view data,
                            unsigned int timeout_ms) const {
-  return impl_->Write(data, timeout_ms);
+  return instr::ReportWrite(Instrumentation(), data,
+                            [&] { return impl_->Write(data, timeout_ms); });
 }
 
 Result<std::string> TcpDriver::ReadLine(unsigned int timeout_ms) const {
-  return impl_->ReadLine(timeout_ms);
+  return instr::ReportRead(Instrumentation(),
+                           [&] { return impl_->ReadLine(timeout_ms); });
 }
 
-TcpDriver::Impl::Impl()
-    : io_service_(),
-      socket_(io_service_),
-      deadline_(io_service_),
-      input_buffer_(),
-      did_timeout_(false) {
-  boost::system::error_code ignored;
-  socket_.set_option(boost::asio::socket_base::linger(false, 0), ignored);
-  socket_.set_option(boost::asio::socket_base::keep_alive(true), ignored);
+Result<std::string_view> TcpDriver::ReadLineInto(
+    std::span<char> buf, unsigned int timeout_ms) const {
+  return instr::ReportRead(Instrumentation(), [&] {
+    return impl_->ReadLineInto(buf, timeout_ms);
+  });
+}
+
+void TcpDriver::AsyncWrite(std::string_view data, unsigned int timeout_ms,
+                           WriteHandler handler) const {
+  impl_->AsyncWrite(data, timeout_ms, std::move(handler));
+}
+
+void TcpDriver::AsyncReadLine(unsigned int timeout_ms,
+                              ReadHandler handler) const {
+  impl_->AsyncReadLine(timeout_ms, std::move(handler));
 }
 
+TcpDriver::Impl::Impl(IoContext::Impl* shared_context)
+    : owned_io_service_(shared_context
+                            ? nullptr
+                            : std::make_unique<boost::asio::io_service>()),
+      io_service_(shared_context ? shared_context->io_service
+                                 : *owned_io_service_),
+      strand_(boost::asio::make_strand(io_service_)),
+      socket_(strand_),
+      deadline_(strand_),
+      input_buffer_(),
+      did_timeout_(false),
+      context_(shared_context) {}
+
 TcpDriver::Impl::~Impl() { Close(); }
 
 ErrorCode TcpDriver::Impl::Connect(std::string_view ip,
-                                   unsigned int timeout_ms) {
+                                   unsigned int timeout_ms,
+                                   const TcpOptions& options) {
   boost::system::error_code ec{};
 
   auto addr = boost::asio::ip::make_address_v4(ip, ec);
@@ -92,18 +174,49 @@ ErrorCode TcpDriver::Impl::Connect(std::string_view ip,
 
   tcp::endpoint endpoint(addr, 5025);
 
-  StartDeadline(timeout_ms);
+  Close();
+  input_buffer_.Clear();
+
+  // open the socket up front so that the options (buffer sizes in particular)
+  // apply to the connection handshake
+  socket_.open(endpoint.protocol(), ec);
+  if (!ec) {
+    // blocking calls try the socket directly before falling back to the
+    // io_service (asynchronous operations are unaffected)
+    socket_.non_blocking(true, ec);
+  }
+  if (ec) {
+    return ErrorCode::kConnectionFailed;
+  }
 
-  // would_block is never set from async_functions, so it's a safe way to signal
-  // an incomplete async operation
-  ec = boost::asio::error::would_block;
+  boost::system::error_code ignored;
+  socket_.set_option(boost::asio::socket_base::linger(false, 0), ignored);
+  socket_.set_option(boost::asio::socket_base::keep_alive(true), ignored);
+  socket_.set_option(tcp::no_delay(options.no_delay), ignored);
+  if (options.send_buffer_size > 0) {
+    socket_.set_option(boost::asio::socket_base::send_buffer_size(
+                           static_cast<int>(options.send_buffer_size)),
+                       ignored);
+  }
+  if (options.receive_buffer_size > 0) {
+    socket_.set_option(boost::asio::socket_base::receive_buffer_size(
+                           static_cast<int>(options.receive_buffer_size)),
+                       ignored);
+  }
 
-  const auto connect_handler = [&](auto&& e) { ec = e; };
-  socket_.async_connect(endpoint, connect_handler);
+  const bool completed = RunBlocking([&](auto done) {
+    StartDeadline(timeout_ms);
+    socket_.async_connect(endpoint, [&, done](auto&& e) {
+      done([&] {
+        deadline_.cancel(ignored);
+        ec = e;
+      });
+    });
+  });
 
-  do {
-    io_service_.run_one();
-  } while (ec == boost::asio::error::would_block);
+  if (!completed) {
+    return ErrorCode::kNotConnected;
+  }
 
   if (ec) {
     if (did_timeout_) {
@@ -134,16 +247,52 @@ ErrorCode TcpDriver::Impl::Write(std::string_view data,
     return ErrorCode::kNotConnected;
   }
 
-  StartDeadline(timeout_ms);
+  // commands almost always fit in the socket's send buffer, so try to send
+  // directly first
+  boost::system::error_code ec;
+  const auto send_now = [&] {
+    data.remove_prefix(socket_.write_some(boost::asio::buffer(data), ec));
+  };
+
+  send_now();
+  if (owned_io_service_) {
+    // nothing else runs on a private io_service, so wait on the socket itself
+    // instead of arming the deadline timer
+    const auto deadline =
+        PollClock::now() + std::chrono::milliseconds(timeout_ms);
+    while (!data.empty() && (!ec || ec == boost::asio::error::would_block) &&
+           WaitSocket(socket_, SocketWait::kWrite, deadline)) {
+      send_now();
+    }
+  }
 
-  boost::system::error_code ec = boost::asio::error::would_block;
+  if (data.empty()) {
+    return ErrorCode::kSuccess;
+  }
 
-  const auto write_handler = [&](auto&& e, auto&&) { ec = e; };
-  boost::asio::async_write(socket_, boost::asio::buffer(data), write_handler);
+  if (ec && ec != boost::asio::error::would_block) {
+    return ErrorCode::kSendFailed;
+  }
 
-  do {
-    io_service_.run_one();
-  } while (ec == boost::asio::error::would_block);
+  if (owned_io_service_) {
+    return ErrorCode::kSendTimedOut;
+  }
+
+  const bool completed = RunBlocking([&](auto done) {
+    StartDeadline(timeout_ms);
+    boost::asio::async_write(socket_, boost::asio::buffer(data),
+                             [&, done](auto&& e, auto&&) {
+                               done([&] {
+                                 boost::system::error_code ignored;
+                                 deadline_.cancel(ignored);
+                                 ec = e;
+                               });
+                             });
+  });
+
+  if (!completed) {
+    return ErrorCode::kNotConnected;
+  }
 
   if (ec) {
     if (did_timeout_) {
@@ -160,37 +309,237 @@ ErrorCode TcpDriver::Impl::Write(std::string_view data,
 }
 
 Result<std::string> TcpDriver::Impl::ReadLine(unsigned int timeout_ms) {
+  return WaitForLine(timeout_ms).map(
+      [this](std::size_t len) { return TakeLine(len); });
+}
+
+Result<std::string_view> TcpDriver::Impl::ReadLineInto(
+    std::span<char> buf, unsigned int timeout_ms) {
+  return WaitForLine(timeout_ms).and_then(
+      [this, buf](std::size_t len) { return TakeLine(len, buf); });
+}
+
+Result<std::size_t> TcpDriver::Impl::WaitForLine(unsigned int timeout_ms) {
   if (!socket_.is_open()) {
     return Err(ErrorCode::kNotConnected);
   }
 
-  StartDeadline(timeout_ms);
+  // an earlier read may have received more than one line
+  if (auto len = input_buffer_.FindLine()) {
+    return *len;
+  }
+
+  // the response is often already waiting, so try to receive it directly
+  boost::system::error_code ec;
+  auto available = ReceiveNow(ec);
+  if (owned_io_service_) {
+    // nothing else runs on a private io_service, so wait on the socket itself
+    // instead of arming the deadline timer
+    const auto deadline =
+        PollClock::now() + std::chrono::milliseconds(timeout_ms);
+    while (!available && (!ec || ec == boost::asio::error::would_block) &&
+           WaitSocket(socket_, SocketWait::kRead, deadline)) {
+      available = ReceiveNow(ec);
+    }
+  }
+
+  if (available) {
+    return *available;
+  }
+
+  if (ec && ec != boost::asio::error::would_block) {
+    return Err(ec == boost::asio::error::no_buffer_space
+                   ? ReadError(ec)
+                   : ErrorCode::kReadFailed);
+  }
 
-  boost::system::error_code ec = boost::asio::error::would_block;
+  if (owned_io_service_) {
+    return Err(ErrorCode::kReadTimedOut);
+  }
 
-  const auto read_handler = [&](auto&& e, auto&&) { ec = e; };
-  boost::asio::async_read_until(socket_, input_buffer_, '\n', read_handler);
+  std::size_t line_len{};
+  const bool completed = RunBlocking([&](auto done) {
+    StartDeadline(timeout_ms);
+    ReceiveLine([&, done](auto&& e, std::size_t len) {
+      done([&] {
+        boost::system::error_code ignored;
+        deadline_.cancel(ignored);
+        ec = e;
+        line_len = len;
+      });
+    });
+  });
 
-  do {
-    io_service_.run_one();
-  } while (ec == boost::asio::error::would_block);
+  if (!completed) {
+    return Err(ErrorCode::kNotConnected);
+  }
 
   if (ec) {
-    if (did_timeout_) {
-      return Err(ErrorCode::kReadTimedOut);
-    }
-    return Err(ErrorCode::kReadFailed);
+    return Err(ReadError(ec));
   }
 
   if (!socket_.is_open()) {
     return Err(ErrorCode::kReadTimedOut);
   }
 
-  std::string line;
-  std::istream is(&input_buffer_);
-  std::getline(is, line);
+  return line_len;
+}
 
-  return line;
+void TcpDriver::Impl::AsyncWrite(std::string_view data,
+                                 unsigned int timeout_ms,
+                                 WriteHandler handler) {
+  if (owned_io_service_) {
+    // nothing runs a private io_service between calls, so complete inline
+    handler(Write(data, timeout_ms));
+    return;
+  }
+
+  // the caller's data may not outlive this call
+  auto buf = std::make_shared<std::string>(data);
+
+  boost::asio::post(strand_, [this, self = shared_from_this(), buf, timeout_ms,
+                              handler = std::move(handler)]() mutable {
+    if (!socket_.is_open()) {
+      handler(ErrorCode::kNotConnected);
+      return;
+    }
+
+    StartDeadline(timeout_ms);
+
+    const auto write_handler = [this, self = std::move(self), buf,
+                                handler = std::move(handler)](
+                                   const boost::system::error_code& ec,
+                                   std::size_t) {
+      boost::system::error_code ignored;
+      deadline_.cancel(ignored);
+
+      if (ec) {
+        handler(did_timeout_ ? ErrorCode::kSendTimedOut
+                             : ErrorCode::kSendFailed);
+      } else if (!socket_.is_open()) {
+        handler(ErrorCode::kSendTimedOut);
+      } else {
+        handler(ErrorCode::kSuccess);
+      }
+    };
+    boost::asio::async_write(socket_, boost::asio::buffer(*buf),
+                             write_handler);
+  });
+}
+
+void TcpDriver::Impl::AsyncReadLine(unsigned int timeout_ms,
+                                    ReadHandler handler) {
+  if (owned_io_service_) {
+    handler(ReadLine(timeout_ms));
+    return;
+  }
+
+  boost::asio::post(strand_, [this, self = shared_from_this(), timeout_ms,
+                              handler = std::move(handler)]() mutable {
+    if (!socket_.is_open()) {
+      handler(Err(ErrorCode::kNotConnected));
+      return;
+    }
+
+    if (auto len = input_buffer_.FindLine()) {
+      handler(TakeLine(*len));
+      return;
+    }
+
+    StartDeadline(timeout_ms);
+
+    auto read_handler = [this, self = std::move(self),
+                               handler = std::move(handler)](
+                                  const boost::system::error_code& ec,
+                                  std::size_t len) {
+      boost::system::error_code ignored;
+      deadline_.cancel(ignored);
+
+      if (ec) {
+        handler(Err(ReadError(ec)));
+      } else if (!socket_.is_open()) {
+        handler(Err(ErrorCode::kReadTimedOut));
+      } else {
+        handler(TakeLine(len));
+      }
+    };
+    ReceiveLine(std::move(read_handler));
+  });
+}
+
+std::optional<std::size_t> TcpDriver::Impl::ReceiveNow(
+    boost::system::error_code& ec) {
+  const auto space = input_buffer_.Prepare();
+  if (space.empty()) {
+    ec = boost::asio::error::no_buffer_space;
+    return std::nullopt;
+  }
+
+  const auto len =
+      socket_.read_some(boost::asio::buffer(space.data(), space.size()), ec);
+  if (ec) {
+    return std::nullopt;
+  }
+
+  input_buffer_.Commit(len);
+  return input_buffer_.FindLine();
+}
+
+template <class Handler>
+void TcpDriver::Impl::ReceiveLine(Handler&& handler) {
+  const auto space = input_buffer_.Prepare();
+  if (space.empty()) {
+    handler(boost::asio::error::no_buffer_space, 0);
+    return;
+  }
+
+  socket_.async_read_some(
+      boost::asio::buffer(space.data(), space.size()),
+      [this, handler = std::forward<Handler>(handler)](
+          const boost::system::error_code& ec, std::size_t len) mutable {
+        if (ec) {
+          handler(ec, 0);
+          return;
+        }
+
+        input_buffer_.Commit(len);
+        if (auto line_len = input_buffer_.FindLine()) {
+          handler(ec, *line_len);
+          return;
+        }
+
+        ReceiveLine(std::move(handler));
+      });
+}
+
+ErrorCode TcpDriver::Impl::ReadError(const boost::system::error_code& ec) {
+  if (ec == boost::asio::error::no_buffer_space) {
+    input_buffer_.Clear();
+    return ErrorCode::kResponseTooLong;
+  }
+  return did_timeout_ ? ErrorCode::kReadTimedOut : ErrorCode::kReadFailed;
+}
+
+template <class Start>
+bool TcpDriver::Impl::RunBlocking(Start&& start) {
+  auto wait = std::make_shared<BlockingWait>(io_service_, context_);
+  if (wait->Stopped()) {
+    return false;
+  }
+  // start is only used while the caller is still waiting
+  boost::asio::post(strand_, [&start, wait] {
+    wait->Start([&] { start(BlockingWait::Done{wait}); });
+  });
+  if (!wait->Wait()) {
+    // nothing runs the stopped io_service, so it's safe to cancel from here,
+    // which keeps the operation from using the caller's buffers if it's
+    // restarted
+    boost::system::error_code ignored;
+    socket_.cancel(ignored);
+    deadline_.cancel(ignored);
+    return false;
+  }
+  return true;
 }
 
 void TcpDriver::Impl::StartDeadline(unsigned int timeout_ms) {
@@ -205,4 +554,26 @@ void TcpDriver::Impl::StartDeadline(unsigned int timeout_ms) {
   did_timeout_ = false;
 }
 
+std::string TcpDriver::Impl::TakeLine(std::size_t len) {
+  std::string line(input_buffer_.Data().substr(0, len - 1));
+  input_buffer_.Consume(len);
+  return line;
+}
+
+Result<std::string_view> TcpDriver::Impl::TakeLine(std::size_t len,
+                                                   std::span<char> buf) {
+  // drop the newline, but consume the whole line even if it doesn't fit so
+  // the next read starts at the next line
+  const auto line = input_buffer_.Data().substr(0, len - 1);
+  if (line.size() > buf.size()) {
+    input_buffer_.Consume(len);
+    return Err(ErrorCode::kBufferTooSmall);
+  }
+
+  std::ranges::copy(line, buf.begin());
+  input_buffer_.Consume(len);
+
+  return std::string_view(buf.data(), line.size());
+}
+
 }  // namespace bci::abs::drivers
@@ -0,0 +1,91 @@
+/*
+ * Copyright (c) 2024, Bloomy Controls, Inc. All rights reserved.
+ *
+ * Use of this source code is governed by a BSD-3-clause license that can be
+ * found in the LICENSE file or at https://opensource.org/license/BSD-3-Clause
+ */
+
+#ifndef ABS_SCPI_DRIVER_SRC_TRANSACTIONLOCK_H
+#define ABS_SCPI_DRIVER_SRC_TRANSACTIONLOCK_H
+
+#include <condition_variable>
+#include <mutex>
+
+namespace bci::abs::detail {
+
+// Gives one thread at a time the use of a driver shared by thread-safe
+// clients. Sends waiting for the driver go ahead of waiting queries, so a
+// send-only command is usually only delayed by the transaction in progress,
+// but at most kMaxSendsAhead of them in a row, so queries aren't starved by a
+// steady stream of sends.
+class TransactionLock {
+ public:
+  // Holds the lock for the guard's lifetime. Does nothing if the lock is null.
+  class Guard {
+   public:
+    Guard(TransactionLock* lock, bool send) : lock_{lock} {
+      if (lock_) {
+        lock_->Acquire(send);
+      }
+    }
+
+    Guard(const Guard&) = delete;
+    Guard& operator=(const Guard&) = delete;
+
+    ~Guard() {
+      if (lock_) {
+        lock_->Release();
+      }
+    }
+
+   private:
+    TransactionLock* lock_;
+  };
+
+  static constexpr unsigned int kMaxSendsAhead = 8;
+
+  void Acquire(bool send) {
+    std::unique_lock lock{mutex_};
+    if (send) {
+      ++waiting_sends_;
+      cv_.wait(lock, [this] {
+        return !busy_ &&
+               (waiting_queries_ == 0 || sends_ahead_ < kMaxSendsAhead);
+      });
+      --waiting_sends_;
+      if (waiting_queries_ > 0) {
+        ++sends_ahead_;
+      }
+    } else {
+      ++waiting_queries_;
+      cv_.wait(lock, [this] {
+        return !busy_ &&
+               (waiting_sends_ == 0 || sends_ahead_ >= kMaxSendsAhead);
+      });
+      --waiting_queries_;
+      sends_ahead_ = 0;
+    }
+    busy_ = true;
+  }
+
+  void Release() {
+    {
+      std::lock_guard lock{mutex_};
+      busy_ = false;
+    }
+    cv_.notify_all();
+  }
+
+ private:
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  bool busy_{false};
+  unsigned int waiting_sends_{0};
+  unsigned int waiting_queries_{0};
+  // sends which have gone ahead of a waiting query since the last query
+  unsigned int sends_ahead_{0};
+};
+
+}  // namespace bci::abs::detail
+
+#endif /* ABS_SCPI_DRIVER_SRC_TRANSACTIONLOCK_H */
@@ -5,6 +5,7 @@
  * found in the LICENSE file or at https://opensource.org/license/BSD-3-Clause
  */
 
+#include <bci/abs/IoContext.h>
 #include <bci/abs/UdpDriver.h>
 
 #include <array>
@@ -12,12 +13,23 @@
 #include <boost/asio.hpp>
 #include <boost/asio/deadline_timer.hpp>
 #include <boost/asio/ip/udp.hpp>
+#include <boost/asio/strand.hpp>
 #include <boost/asio/write.hpp>
+#include <chrono>
 #include <cstdint>
+#include <deque>
+#include <limits>
 #include <memory>
+#include <span>
 #include <string>
 #include <string_view>
+#include <utility>
 
+#include "InstrumentUtil.h"
+#include "IoContextImpl.h"
+#include "RttEstimator.h"
+#include "ScpiUtil.h"
+#include "SocketWait.h"
 #include "Util.h"
 
 using boost::asio::deadline_timer;
@@ -27,8 +39,9 @@ namespace bci::abs::drivers {
 
 using util::Err;
 
-struct UdpDriver::Impl {
-  Impl();
+struct UdpDriver::Impl : std::enable_shared_from_this<UdpDriver::Impl> {
+  // Use the shared context if given, otherwise create a private io_service.
+  explicit Impl(IoContext::Impl* shared_context);
 
   ~Impl();
 
@@ -42,20 +55,108 @@ struct UdpDriver::Impl {
 
   Result<std::string> ReadLine(unsigned int timeout_ms);
 
+  Result<std::string_view> ReadLineInto(std::span<char> buf,
+                                        unsigned int timeout_ms);
+
+  void AsyncWrite(std::string_view data, unsigned int timeout_ms,
+                  WriteHandler handler);
+
+  void AsyncReadLine(unsigned int timeout_ms, ReadHandler handler);
+
+  void SetTimeoutPolicy(const UdpTimeoutPolicy& policy) noexcept {
+    policy_ = policy;
+  }
+
+  UdpTimeoutPolicy GetTimeoutPolicy() const noexcept { return policy_; }
+
+  UdpTimeoutStats GetTimeoutStats() const noexcept;
+
+  // Retries made by the last blocking read.
+  const unsigned int* LastRetries() const noexcept { return &last_retries_; }
+
  private:
   static constexpr std::size_t kBufLen = 8192;
 
-  boost::asio::io_service io_service_;
+  // Most queries tracked while awaiting their responses.
+  static constexpr std::size_t kMaxPending = 64;
+
+  std::unique_ptr<boost::asio::io_service> owned_io_service_;
+  boost::asio::io_service& io_service_;
+  boost::asio::strand<boost::asio::io_service::executor_type> strand_;
   boost::asio::ip::udp::socket socket_;
   boost::asio::deadline_timer deadline_;
   boost::asio::ip::udp::endpoint endpoint_;
-  std::array<std::uint8_t, kBufLen> buf_;
+  std::array<char, kBufLen> buf_;
   std::atomic<bool> timeout_;
+  // null for a private io_service
+  IoContext::Impl* context_;
+
+  UdpTimeoutPolicy policy_;
+  RttEstimator rtt_;
+
+  // send times of the queries written but not yet answered, oldest first
+  std::deque<PollClock::time_point> pending_;
+
+  // copy of the only pending query, if it may be resent
+  std::string retry_command_;
+  bool can_retry_;
+
+  // time of the last send of a query
+  PollClock::time_point last_send_;
+
+  // responses to queries which timed out may still arrive during this window
+  LateResponseWindow late_;
+
+  unsigned int last_retries_;
 
-  void CheckDeadline();
+  // published for GetTimeoutStats(), which may be called from any thread
+  std::atomic<std::int64_t> srtt_ns_;
+  std::atomic<std::int64_t> rttvar_ns_;
+  std::atomic<unsigned int> rto_ms_;
+  std::atomic<std::uint64_t> timeouts_;
+  std::atomic<std::uint64_t> retries_;
+
+  // Send a datagram.
+  ErrorCode Send(std::string_view data, unsigned int timeout_ms);
+
+  // Receive the response to the oldest pending query into a buffer and return
+  // its length, retrying according to the policy.
+  Result<std::size_t> Receive(std::span<char> buf, unsigned int timeout_ms);
+
+  // Receive a datagram into a buffer and return its length.
+  Result<std::size_t> ReceiveOnce(std::span<char> buf, unsigned int timeout_ms);
+
+  // Whether a datagram just received must be a late response to an earlier
+  // query, having arrived sooner after the last send than any response has.
+  bool IsLateResponse() const noexcept;
+
+  // Timeout of one attempt at receiving a response, given that the read must
+  // end by deadline.
+  unsigned int AttemptTimeout(unsigned int attempt, bool can_retry,
+                              PollClock::time_point deadline) const noexcept;
+
+  // How long a response to a query which timed out may still take to arrive,
+  // given the read's timeout.
+  PollClock::duration LateWait(unsigned int timeout_ms) const noexcept;
+
+  // Discard any datagrams waiting on the socket.
+  void Drain() noexcept;
+
+  void PublishStats() noexcept;
+
+  void StartDeadline(unsigned int timeout_ms);
+
+  // Start an asynchronous operation on the strand with start(done), and block
+  // until its handler calls done(store), where store() stores the results.
+  // Returns false without waiting if the IoContext is stopped.
+  template <class Start>
+  bool RunBlocking(Start&& start);
 };
 
-UdpDriver::UdpDriver() : impl_(std::make_shared<Impl>()) {}
+UdpDriver::UdpDriver() : impl_(std::make_shared<Impl>(nullptr)) {}
+
+UdpDriver::UdpDriver(IoContext& io_context)
+    : impl_(std::make_shared<Impl>(io_context.impl_.get())) {}
 
 UdpDriver::~UdpDriver() { Close(); }
 
@@ -70,23 +171,71 @@ void UdpDriver::Close() noexcept { impl_->Close(); }
 
 ErrorCode UdpDriver::Write(std::string_view data,
                            unsigned int timeout_ms) const {
-  return impl_->Write(data, timeout_ms);
+  return instr::ReportWrite(Instrumentation(), data,
+                            [&] { return impl_->Write(data, timeout_ms); });
 }
 
 Result<std::string> UdpDriver::ReadLine(unsigned int timeout_ms) const {
-  return impl_->ReadLine(timeout_ms);
+  return instr::ReportRead(
+      Instrumentation(), [&] { return impl_->ReadLine(timeout_ms); },
+      impl_->LastRetries());
+}
+
+Result<std::string_view> UdpDriver::ReadLineInto(
+    std::span<char> buf, unsigned int timeout_ms) const {
+  return instr::ReportRead(
+      Instrumentation(), [&] { return impl_->ReadLineInto(buf, timeout_ms); },
+      impl_->LastRetries());
+}
+
+void UdpDriver::AsyncWrite(std::string_view data, unsigned int timeout_ms,
+                           WriteHandler handler) const {
+  impl_->AsyncWrite(data, timeout_ms, std::move(handler));
 }
 
-UdpDriver::Impl::Impl()
-    : io_service_(),
-      socket_(io_service_),
-      deadline_(io_service_),
+void UdpDriver::AsyncReadLine(unsigned int timeout_ms,
+                              ReadHandler handler) const {
+  impl_->AsyncReadLine(timeout_ms, std::move(handler));
+}
+
+void UdpDriver::SetTimeoutPolicy(const UdpTimeoutPolicy& policy) noexcept {
+  impl_->SetTimeoutPolicy(policy);
+}
+
+UdpTimeoutPolicy UdpDriver::GetTimeoutPolicy() const noexcept {
+  return impl_->GetTimeoutPolicy();
+}
+
+UdpTimeoutStats UdpDriver::GetTimeoutStats() const noexcept {
+  return impl_->GetTimeoutStats();
+}
+
+UdpDriver::Impl::Impl(IoContext::Impl* shared_context)
+    : owned_io_service_(shared_context
+                            ? nullptr
+                            : std::make_unique<boost::asio::io_service>()),
+      io_service_(shared_context ? shared_context->io_service
+                                 : *owned_io_service_),
+      strand_(boost::asio::make_strand(io_service_)),
+      socket_(strand_),
+      deadline_(strand_),
       endpoint_(),
       buf_{},
-      timeout_{} {
-  deadline_.expires_at(boost::posix_time::pos_infin);
-  CheckDeadline();
-}
+      timeout_{},
+      context_(shared_context),
+      policy_{},
+      rtt_{},
+      pending_{},
+      retry_command_{},
+      can_retry_{false},
+      last_send_{},
+      late_{},
+      last_retries_{},
+      srtt_ns_{},
+      rttvar_ns_{},
+      rto_ms_{},
+      timeouts_{},
+      retries_{} {}
 
 UdpDriver::Impl::~Impl() { Close(); }
 
@@ -112,6 +261,8 @@ ErrorCode UdpDriver::Impl::Open(std::string_view local_ip,
   }
 
   endpoint_ = boost::asio::ip::udp::endpoint(remote_address, 5025);
+  rtt_.Reset();
+  PublishStats();
 
   socket_.open(boost::asio::ip::udp::v4(), ec);
   if (ec) {
@@ -140,6 +291,14 @@ ErrorCode UdpDriver::Impl::Open(std::string_view local_ip,
     return ErrorCode::kFailedToBindSocket;
   }
 
+  // blocking calls try the socket directly before falling back to the
+  // io_service (asynchronous operations are unaffected)
+  socket_.non_blocking(true, ec);
+  if (ec) {
+    socket_.close();
+    return ErrorCode::kSocketError;
+  }
+
   return ErrorCode::kSuccess;
 }
 
@@ -148,25 +307,82 @@ void UdpDriver::Impl::Close() noexcept {
   if (socket_.is_open()) {
     socket_.close(ignored);
   }
+  pending_.clear();
+  can_retry_ = false;
+  late_.Reset();
 }
 
 ErrorCode UdpDriver::Impl::Write(std::string_view data,
                                  unsigned int timeout_ms) {
+  // a late response may be waiting, but only when no reply is expected can
+  // everything waiting be discarded
+  if (pending_.empty() && late_.Contains(PollClock::now())) {
+    Drain();
+  }
+
+  const auto res = Send(data, timeout_ms);
+  if (res == ErrorCode::kSuccess && scpi::IsQuery(data)) {
+    if (pending_.size() == kMaxPending) {
+      pending_.pop_front();
+    }
+    last_send_ = PollClock::now();
+    pending_.push_back(last_send_);
+
+    can_retry_ = pending_.size() == 1 && policy_.max_retries > 0 &&
+                 scpi::IsRepeatableQuery(data);
+    if (can_retry_) {
+      retry_command_.assign(data);
+    }
+  }
+  return res;
+}
+
+ErrorCode UdpDriver::Impl::Send(std::string_view data,
+                                unsigned int timeout_ms) {
   if (!socket_.is_open()) {
     return ErrorCode::kNotConnected;
   }
 
-  timeout_ = false;
-  deadline_.expires_from_now(boost::posix_time::milliseconds(timeout_ms));
+  boost::system::error_code ec;
+  const auto send_now = [&] {
+    socket_.send_to(boost::asio::buffer(data), endpoint_, 0, ec);
+  };
 
-  boost::system::error_code ec = boost::asio::error::would_block;
+  send_now();
+  if (owned_io_service_) {
+    // nothing else runs on a private io_service, so wait on the socket itself
+    // instead of arming the deadline timer
+    const auto deadline =
+        PollClock::now() + std::chrono::milliseconds(timeout_ms);
+    while (ec == boost::asio::error::would_block &&
+           WaitSocket(socket_, SocketWait::kWrite, deadline)) {
+      send_now();
+    }
+  }
 
-  const auto write_handler = [&](auto&& e, auto&&) { ec = e; };
-  socket_.async_send_to(boost::asio::buffer(data), endpoint_, write_handler);
+  if (ec != boost::asio::error::would_block) {
+    return ec ? ErrorCode::kSendFailed : ErrorCode::kSuccess;
+  }
 
-  do {
-    io_service_.run_one();
-  } while (ec == boost::asio::error::would_block);
+  if (owned_io_service_) {
+    return ErrorCode::kSendTimedOut;
+  }
+
+  const bool completed = RunBlocking([&](auto done) {
+    StartDeadline(timeout_ms);
+    socket_.async_send_to(boost::asio::buffer(data), endpoint_,
+                          [&, done](auto&& e, auto&&) {
+                            done([&] {
+                              boost::system::error_code ignored;
+                              deadline_.cancel(ignored);
+                              ec = e;
+                            });
+                          });
+  });
+
+  if (!completed) {
+    return ErrorCode::kNotConnected;
+  }
 
   if (timeout_) {
     return ErrorCode::kSendTimedOut;
@@ -180,26 +396,220 @@ ErrorCode UdpDriver::Impl::Write(std::string_view data,
 }
 
 Result<std::string> UdpDriver::Impl::ReadLine(unsigned int timeout_ms) {
+  auto len = Receive(buf_, timeout_ms);
+  if (!len) {
+    return Err(len.error());
+  }
+
+  std::string line(buf_.data(), *len);
+
+  return line;
+}
+
+Result<std::string_view> UdpDriver::Impl::ReadLineInto(
+    std::span<char> buf, unsigned int timeout_ms) {
+  auto len = Receive(buf, timeout_ms);
+  if (!len) {
+    return Err(len.error());
+  }
+
+  // a datagram which fills the buffer may have been truncated
+  if (*len >= buf.size()) {
+    return Err(ErrorCode::kBufferTooSmall);
+  }
+
+  return std::string_view(buf.data(), *len);
+}
+
+Result<std::size_t> UdpDriver::Impl::Receive(std::span<char> buf,
+                                             unsigned int timeout_ms) {
+  last_retries_ = 0;
+  const auto deadline =
+      PollClock::now() + std::chrono::milliseconds(timeout_ms);
+
+  for (unsigned int attempt = 0;; ++attempt) {
+    const bool can_retry = can_retry_ && attempt < policy_.max_retries;
+    const auto attempt_deadline =
+        PollClock::now() +
+        std::chrono::milliseconds(AttemptTimeout(attempt, can_retry, deadline));
+
+    Result<std::size_t> len;
+    do {
+      const auto wait = std::max<std::int64_t>(
+          std::chrono::ceil<std::chrono::milliseconds>(attempt_deadline -
+                                                       PollClock::now())
+              .count(),
+          0);
+      len = ReceiveOnce(buf, static_cast<unsigned int>(wait));
+    } while (len && IsLateResponse());
+
+    if (len) {
+      if (!pending_.empty()) {
+        // a resent query's response may be to either send (Karn's algorithm)
+        if (attempt == 0) {
+          rtt_.AddSample(PollClock::now() - pending_.front());
+        }
+        pending_.pop_front();
+        PublishStats();
+      }
+      can_retry_ = false;
+      return len;
+    }
+
+    if (len.error() != ErrorCode::kReadTimedOut) {
+      return len;
+    }
+
+    // the response may yet arrive, and must not be taken as the response to a
+    // later query
+    timeouts_.fetch_add(1, std::memory_order_relaxed);
+    late_.Extend(PollClock::now(), LateWait(timeout_ms));
+
+    if (!can_retry || PollClock::now() >= deadline) {
+      if (!pending_.empty()) {
+        rtt_.Backoff();
+        pending_.pop_front();
+        PublishStats();
+      }
+      can_retry_ = false;
+      return len;
+    }
+
+    const auto remaining =
+        std::chrono::ceil<std::chrono::milliseconds>(deadline -
+                                                     PollClock::now());
+    if (Send(retry_command_, static_cast<unsigned int>(remaining.count())) !=
+        ErrorCode::kSuccess) {
+      can_retry_ = false;
+      return len;
+    }
+    last_send_ = PollClock::now();
+    ++last_retries_;
+    retries_.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+bool UdpDriver::Impl::IsLateResponse() const noexcept {
+  const auto now = PollClock::now();
+  return late_.Contains(now) && rtt_.HasSample() &&
+         now - last_send_ < rtt_.MinRtt() / 2;
+}
+
+unsigned int UdpDriver::Impl::AttemptTimeout(
+    unsigned int attempt, bool can_retry,
+    PollClock::time_point deadline) const noexcept {
+  const auto remaining = std::max<std::int64_t>(
+      std::chrono::ceil<std::chrono::milliseconds>(deadline - PollClock::now())
+          .count(),
+      0);
+  const auto remaining_ms = static_cast<unsigned int>(remaining);
+
+  // the timeout only applies to responses to queries the driver sent
+  if (pending_.empty()) {
+    return remaining_ms;
+  }
+
+  if (policy_.adaptive && rtt_.HasSample()) {
+    return rtt_.TimeoutMs(attempt, policy_.min_timeout_ms, remaining_ms);
+  }
+
+  if (can_retry) {
+    // share what is left between the remaining attempts
+    return remaining_ms / (policy_.max_retries - attempt + 1);
+  }
+
+  return remaining_ms;
+}
+
+PollClock::duration UdpDriver::Impl::LateWait(
+    unsigned int timeout_ms) const noexcept {
+  const auto rto_ms =
+      rtt_.HasSample()
+          ? rtt_.TimeoutMs(0, policy_.min_timeout_ms,
+                           std::numeric_limits<unsigned int>::max())
+          : 0;
+  return std::chrono::milliseconds(std::max(timeout_ms, rto_ms));
+}
+
+void UdpDriver::Impl::Drain() noexcept {
+  boost::system::error_code ec;
+  while (socket_.is_open() && !ec) {
+    socket_.receive(boost::asio::buffer(buf_), 0, ec);
+  }
+}
+
+UdpTimeoutStats UdpDriver::Impl::GetTimeoutStats() const noexcept {
+  return {std::chrono::nanoseconds(srtt_ns_.load(std::memory_order_relaxed)),
+          std::chrono::nanoseconds(rttvar_ns_.load(std::memory_order_relaxed)),
+          rto_ms_.load(std::memory_order_relaxed),
+          timeouts_.load(std::memory_order_relaxed),
+          retries_.load(std::memory_order_relaxed)};
+}
+
+void UdpDriver::Impl::PublishStats() noexcept {
+  srtt_ns_.store(rtt_.SmoothedRtt().count(), std::memory_order_relaxed);
+  rttvar_ns_.store(rtt_.RttVariation().count(), std::memory_order_relaxed);
+  rto_ms_.store(
+      rtt_.HasSample()
+          ? rtt_.TimeoutMs(0, policy_.min_timeout_ms,
+                           std::numeric_limits<unsigned int>::max())
+          : 0,
+      std::memory_order_relaxed);
+}
+
+Result<std::size_t> UdpDriver::Impl::ReceiveOnce(std::span<char> buf,
+                                                 unsigned int timeout_ms) {
   if (!socket_.is_open()) {
     return Err(ErrorCode::kNotConnected);
   }
 
-  timeout_ = false;
-  deadline_.expires_from_now(boost::posix_time::milliseconds(timeout_ms));
+  // the response is often already waiting, so try to receive it directly
+  boost::system::error_code ec;
+  std::size_t read_len{};
+  const auto receive_now = [&] {
+    read_len = socket_.receive(boost::asio::buffer(buf.data(), buf.size()), 0,
+                               ec);
+  };
 
-  boost::system::error_code ec = boost::asio::error::would_block;
+  receive_now();
+  if (owned_io_service_) {
+    // nothing else runs on a private io_service, so wait on the socket itself
+    // instead of arming the deadline timer
+    const auto deadline =
+        PollClock::now() + std::chrono::milliseconds(timeout_ms);
+    while (ec == boost::asio::error::would_block &&
+           WaitSocket(socket_, SocketWait::kRead, deadline)) {
+      receive_now();
+    }
+  }
 
-  std::size_t read_len{};
+  if (ec != boost::asio::error::would_block) {
+    if (ec) {
+      return Err(ErrorCode::kReadFailed);
+    }
+    return read_len;
+  }
 
-  const auto read_handler = [&](auto&& e, std::size_t len) {
-    ec = e;
-    read_len = len;
-  };
-  socket_.async_receive(boost::asio::buffer(buf_), read_handler);
+  if (owned_io_service_) {
+    return Err(ErrorCode::kReadTimedOut);
+  }
 
-  do {
-    io_service_.run_one();
-  } while (ec == boost::asio::error::would_block);
+  const bool completed = RunBlocking([&](auto done) {
+    StartDeadline(timeout_ms);
+    socket_.async_receive(boost::asio::buffer(buf.data(), buf.size()),
+                          [&, done](auto&& e, std::size_t len) {
+                            done([&] {
+                              boost::system::error_code ignored;
+                              deadline_.cancel(ignored);
+                              ec = e;
+                              read_len = len;
+                            });
+                          });
+  });
+
+  if (!completed) {
+    return Err(ErrorCode::kNotConnected);
+  }
 
   if (timeout_) {
     return Err(ErrorCode::kReadTimedOut);
@@ -209,19 +619,116 @@ Result<std::string> UdpDriver::Impl::ReadLine(unsigned int timeout_ms) {
     return Err(ErrorCode::kReadFailed);
   }
 
-  std::string line((const char*)buf_.data(), read_len);
+  return read_len;
+}
 
-  return line;
+void UdpDriver::Impl::AsyncWrite(std::string_view data,
+                                 unsigned int timeout_ms,
+                                 WriteHandler handler) {
+  if (owned_io_service_) {
+    // nothing runs a private io_service between calls, so complete inline
+    handler(Write(data, timeout_ms));
+    return;
+  }
+
+  // the caller's data may not outlive this call
+  auto buf = std::make_shared<std::string>(data);
+
+  boost::asio::post(strand_, [this, self = shared_from_this(), buf, timeout_ms,
+                              handler = std::move(handler)]() mutable {
+    if (!socket_.is_open()) {
+      handler(ErrorCode::kNotConnected);
+      return;
+    }
+
+    StartDeadline(timeout_ms);
+
+    const auto write_handler = [this, self = std::move(self), buf,
+                                handler = std::move(handler)](
+                                   const boost::system::error_code& ec,
+                                   std::size_t) {
+      boost::system::error_code ignored;
+      deadline_.cancel(ignored);
+
+      if (timeout_) {
+        handler(ErrorCode::kSendTimedOut);
+      } else if (ec) {
+        handler(ErrorCode::kSendFailed);
+      } else {
+        handler(ErrorCode::kSuccess);
+      }
+    };
+    socket_.async_send_to(boost::asio::buffer(*buf), endpoint_, write_handler);
+  });
+}
+
+void UdpDriver::Impl::AsyncReadLine(unsigned int timeout_ms,
+                                    ReadHandler handler) {
+  if (owned_io_service_) {
+    handler(ReadLine(timeout_ms));
+    return;
+  }
+
+  boost::asio::post(strand_, [this, self = shared_from_this(), timeout_ms,
+                              handler = std::move(handler)]() mutable {
+    if (!socket_.is_open()) {
+      handler(Err(ErrorCode::kNotConnected));
+      return;
+    }
+
+    StartDeadline(timeout_ms);
+
+    const auto read_handler = [this, self = std::move(self),
+                               handler = std::move(handler)](
+                                  const boost::system::error_code& ec,
+                                  std::size_t len) {
+      boost::system::error_code ignored;
+      deadline_.cancel(ignored);
+
+      if (timeout_) {
+        handler(Err(ErrorCode::kReadTimedOut));
+      } else if (ec) {
+        handler(Err(ErrorCode::kReadFailed));
+      } else {
+        handler(std::string(buf_.data(), len));
+      }
+    };
+    socket_.async_receive(boost::asio::buffer(buf_), read_handler);
+  });
 }
 
-void UdpDriver::Impl::CheckDeadline() {
-  if (deadline_.expires_at() <= deadline_timer::traits_type::now()) {
-    timeout_ = true;
-    socket_.cancel();
-    deadline_.expires_at(boost::posix_time::pos_infin);
+template <class Start>
+bool UdpDriver::Impl::RunBlocking(Start&& start) {
+  auto wait = std::make_shared<BlockingWait>(io_service_, context_);
+  if (wait->Stopped()) {
+    return false;
+  }
+  // start is only used while the caller is still waiting
+  boost::asio::post(strand_, [&start, wait] {
+    wait->Start([&] { start(BlockingWait::Done{wait}); });
+  });
+  if (!wait->Wait()) {
+    // nothing runs the stopped io_service, so it's safe to cancel from here,
+    // which keeps the operation from using the caller's buffers if it's
+    // restarted
+    boost::system::error_code ignored;
+    socket_.cancel(ignored);
+    deadline_.cancel(ignored);
+    return false;
   }
+  return true;
+}
 
-  deadline_.async_wait([&](auto&&) { this->CheckDeadline(); });
+void UdpDriver::Impl::StartDeadline(unsigned int timeout_ms) {
+  timeout_ = false;
+  deadline_.expires_from_now(boost::posix_time::milliseconds(timeout_ms));
+  deadline_.async_wait([this](const boost::system::error_code& e) {
+    if (e != boost::asio::error::operation_aborted) {
+      timeout_ = true;
+      boost::system::error_code ignored;
+      socket_.cancel(ignored);
+    }
+  });
 }
 
 }  // namespace bci::abs::drivers
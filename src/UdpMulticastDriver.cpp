@@ -5,22 +5,39 @@
  * found in the LICENSE file or at https://opensource.org/license/BSD-3-Clause
  */
 
+#include <bci/abs/IoContext.h>
 #include <bci/abs/UdpMulticastDriver.h>
+#include <fmt/format.h>
 
+#include <algorithm>
 #include <array>
 #include <atomic>
 #include <boost/asio.hpp>
 #include <boost/asio/deadline_timer.hpp>
 #include <boost/asio/ip/udp.hpp>
+#include <boost/asio/strand.hpp>
 #include <boost/asio/write.hpp>
+#include <chrono>
+#include <cstddef>
 #include <cstdint>
 #include <memory>
+#include <span>
 #include <string>
 #include <string_view>
+#include <vector>
 
+#ifdef __linux__
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include <cerrno>
+#include <cstring>
+#endif
+
+#include "InstrumentUtil.h"
+#include "IoContextImpl.h"
 #include "Util.h"
 
-using boost::asio::deadline_timer;
 using boost::asio::ip::udp;
 
 namespace bci::abs::drivers {
@@ -30,7 +47,8 @@ static constexpr std::string_view kMulticastAddr = "239.188.26.181";
 using util::Err;
 
 struct UdpMcastDriver::Impl {
-  Impl();
+  // Use the shared context if given, otherwise create a private io_service.
+  explicit Impl(IoContext::Impl* shared_context);
 
   ~Impl();
 
@@ -44,20 +62,57 @@ struct UdpMcastDriver::Impl {
 
   Result<AddressedResponse> ReadLineFrom(unsigned int timeout_ms);
 
+  Result<std::span<const AddressedResponseView>> ReadBatchFrom(
+      unsigned int timeout_ms);
+
+  ErrorCode SetReceiveBufferSize(std::size_t bytes);
+
  private:
   static constexpr std::size_t kBufLen = 8192;
 
-  boost::asio::io_service io_service_;
+  // Longest dotted-quad IPv4 address, plus a terminator.
+  static constexpr std::size_t kIpLen = 16;
+
+  std::unique_ptr<boost::asio::io_service> owned_io_service_;
+  boost::asio::io_service& io_service_;
+  boost::asio::strand<boost::asio::io_service::executor_type> strand_;
   boost::asio::ip::udp::socket socket_;
   boost::asio::deadline_timer deadline_;
   boost::asio::ip::udp::endpoint endpoint_;
   std::array<std::uint8_t, kBufLen> buf_;
   std::atomic<bool> timeout_;
-
-  void CheckDeadline();
+  // null for a private io_service
+  IoContext::Impl* context_;
+  std::size_t rx_buf_size_;
+
+  // kMaxBatchSize buffers of kBufLen bytes for batched reads, allocated on
+  // first use, and the batch read into them
+  std::vector<char> slab_;
+  std::array<std::array<char, kIpLen>, kMaxBatchSize> batch_ips_;
+  std::array<AddressedResponseView, kMaxBatchSize> batch_;
+
+  void StartDeadline(unsigned int timeout_ms);
+
+  // Read the datagrams waiting on the socket into the slab without blocking,
+  // returning how many were read.
+  std::size_t ReceiveBatch(boost::system::error_code& ec);
+
+  // Fill in the index-th entry of the batch.
+  void SetBatchEntry(std::size_t index,
+                     const boost::asio::ip::address_v4::bytes_type& ip,
+                     std::size_t len);
+
+  // Start an asynchronous operation on the strand with start(done), and block
+  // until its handler calls done(store), where store() stores the results.
+  // Returns false without waiting if the IoContext is stopped.
+  template <class Start>
+  bool RunBlocking(Start&& start);
 };
 
-UdpMcastDriver::UdpMcastDriver() : impl_(std::make_shared<Impl>()) {}
+UdpMcastDriver::UdpMcastDriver() : impl_(std::make_shared<Impl>(nullptr)) {}
+
+UdpMcastDriver::UdpMcastDriver(IoContext& io_context)
+    : impl_(std::make_shared<Impl>(io_context.impl_.get())) {}
 
 UdpMcastDriver::~UdpMcastDriver() { Close(); }
 
@@ -69,11 +124,13 @@ void UdpMcastDriver::Close() noexcept { impl_->Close(); }
 
 ErrorCode UdpMcastDriver::Write(std::string_view data,
                                 unsigned int timeout_ms) const {
-  return impl_->Write(data, timeout_ms);
+  return instr::ReportWrite(Instrumentation(), data,
+                            [&] { return impl_->Write(data, timeout_ms); });
 }
 
 Result<std::string> UdpMcastDriver::ReadLine(unsigned int timeout_ms) const {
-  return impl_->ReadLine(timeout_ms);
+  return instr::ReportRead(Instrumentation(),
+                           [&] { return impl_->ReadLine(timeout_ms); });
 }
 
 Result<UdpMcastDriver::AddressedResponse> UdpMcastDriver::ReadLineFrom(
@@ -81,16 +138,32 @@ Result<UdpMcastDriver::AddressedResponse> UdpMcastDriver::ReadLineFrom(
   return impl_->ReadLineFrom(timeout_ms);
 }
 
-UdpMcastDriver::Impl::Impl()
-    : io_service_(),
-      socket_(io_service_),
-      deadline_(io_service_),
+Result<std::span<const UdpMcastDriver::AddressedResponseView>>
+UdpMcastDriver::ReadBatchFrom(unsigned int timeout_ms) const {
+  return impl_->ReadBatchFrom(timeout_ms);
+}
+
+ErrorCode UdpMcastDriver::SetReceiveBufferSize(std::size_t bytes) {
+  return impl_->SetReceiveBufferSize(bytes);
+}
+
+UdpMcastDriver::Impl::Impl(IoContext::Impl* shared_context)
+    : owned_io_service_(shared_context
+                            ? nullptr
+                            : std::make_unique<boost::asio::io_service>()),
+      io_service_(shared_context ? shared_context->io_service
+                                 : *owned_io_service_),
+      strand_(boost::asio::make_strand(io_service_)),
+      socket_(strand_),
+      deadline_(strand_),
       endpoint_(),
       buf_{},
-      timeout_{} {
-  deadline_.expires_at(boost::posix_time::pos_infin);
-  CheckDeadline();
-}
+      timeout_{},
+      context_(shared_context),
+      rx_buf_size_{kDefaultReceiveBufferSize},
+      slab_{},
+      batch_ips_{},
+      batch_{} {}
 
 UdpMcastDriver::Impl::~Impl() { Close(); }
 
@@ -117,8 +190,8 @@ ErrorCode UdpMcastDriver::Impl::Open(std::string_view interface_ip) {
     return ErrorCode::kSocketError;
   }
 
-  // TODO: is this a reasonable size?
-  boost::asio::socket_base::receive_buffer_size rx_buf_opt{1024 * 64};
+  boost::asio::socket_base::receive_buffer_size rx_buf_opt{
+      static_cast<int>(rx_buf_size_)};
   socket_.set_option(rx_buf_opt, ec);
   if (ec) {
     socket_.close();
@@ -139,11 +212,20 @@ ErrorCode UdpMcastDriver::Impl::Open(std::string_view interface_ip) {
     return ErrorCode::kFailedToJoinGroup;
   }
 
+  // batched reads receive whatever is waiting without blocking (asynchronous
+  // operations are unaffected)
+  socket_.non_blocking(true, ec);
+  if (ec) {
+    socket_.close();
+    return ErrorCode::kSocketError;
+  }
+
   return ErrorCode::kSuccess;
 }
 
 void UdpMcastDriver::Impl::Close() noexcept {
   boost::system::error_code ignored;
+  deadline_.cancel(ignored);
   if (socket_.is_open()) {
     socket_.close(ignored);
   }
@@ -155,17 +237,23 @@ ErrorCode UdpMcastDriver::Impl::Write(std::string_view data,
     return ErrorCode::kNotConnected;
   }
 
-  timeout_ = false;
-  deadline_.expires_from_now(boost::posix_time::milliseconds(timeout_ms));
-
-  boost::system::error_code ec = boost::asio::error::would_block;
-
-  const auto write_handler = [&](auto&& e, auto&&) { ec = e; };
-  socket_.async_send_to(boost::asio::buffer(data), endpoint_, write_handler);
-
-  do {
-    io_service_.run_one();
-  } while (ec == boost::asio::error::would_block);
+  boost::system::error_code ec;
+
+  const bool completed = RunBlocking([&](auto done) {
+    StartDeadline(timeout_ms);
+    socket_.async_send_to(boost::asio::buffer(data), endpoint_,
+                          [&, done](auto&& e, auto&&) {
+                            done([&] {
+                              boost::system::error_code ignored;
+                              deadline_.cancel(ignored);
+                              ec = e;
+                            });
+                          });
+  });
+
+  if (!completed) {
+    return ErrorCode::kNotConnected;
+  }
 
   if (timeout_) {
     return ErrorCode::kSendTimedOut;
@@ -183,22 +271,25 @@ Result<std::string> UdpMcastDriver::Impl::ReadLine(unsigned int timeout_ms) {
     return Err(ErrorCode::kNotConnected);
   }
 
-  timeout_ = false;
-  deadline_.expires_from_now(boost::posix_time::milliseconds(timeout_ms));
-
-  boost::system::error_code ec = boost::asio::error::would_block;
-
+  boost::system::error_code ec;
   std::size_t read_len{};
 
-  const auto read_handler = [&](auto&& e, std::size_t len) {
-    ec = e;
-    read_len = len;
-  };
-  socket_.async_receive(boost::asio::buffer(buf_), read_handler);
-
-  do {
-    io_service_.run_one();
-  } while (ec == boost::asio::error::would_block);
+  const bool completed = RunBlocking([&](auto done) {
+    StartDeadline(timeout_ms);
+    socket_.async_receive(boost::asio::buffer(buf_),
+                          [&, done](auto&& e, std::size_t len) {
+                            done([&] {
+                              boost::system::error_code ignored;
+                              deadline_.cancel(ignored);
+                              ec = e;
+                              read_len = len;
+                            });
+                          });
+  });
+
+  if (!completed) {
+    return Err(ErrorCode::kNotConnected);
+  }
 
   if (timeout_) {
     return Err(ErrorCode::kReadTimedOut);
@@ -219,23 +310,26 @@ Result<UdpMcastDriver::AddressedResponse> UdpMcastDriver::Impl::ReadLineFrom(
     return Err(ErrorCode::kNotConnected);
   }
 
-  timeout_ = false;
-  deadline_.expires_from_now(boost::posix_time::milliseconds(timeout_ms));
-
-  boost::system::error_code ec = boost::asio::error::would_block;
-
+  boost::system::error_code ec;
   std::size_t read_len{};
   udp::endpoint source;
 
-  const auto read_handler = [&](auto&& e, std::size_t len) {
-    ec = e;
-    read_len = len;
-  };
-  socket_.async_receive_from(boost::asio::buffer(buf_), source, read_handler);
-
-  do {
-    io_service_.run_one();
-  } while (ec == boost::asio::error::would_block);
+  const bool completed = RunBlocking([&](auto done) {
+    StartDeadline(timeout_ms);
+    socket_.async_receive_from(boost::asio::buffer(buf_), source,
+                               [&, done](auto&& e, std::size_t len) {
+                                 done([&] {
+                                   boost::system::error_code ignored;
+                                   deadline_.cancel(ignored);
+                                   ec = e;
+                                   read_len = len;
+                                 });
+                               });
+  });
+
+  if (!completed) {
+    return Err(ErrorCode::kNotConnected);
+  }
 
   if (timeout_) {
     return Err(ErrorCode::kReadTimedOut);
@@ -250,14 +344,170 @@ Result<UdpMcastDriver::AddressedResponse> UdpMcastDriver::Impl::ReadLineFrom(
   return AddressedResponse{source.address().to_string(), std::move(line)};
 }
 
-void UdpMcastDriver::Impl::CheckDeadline() {
-  if (deadline_.expires_at() <= deadline_timer::traits_type::now()) {
-    timeout_ = true;
-    socket_.cancel();
-    deadline_.expires_at(boost::posix_time::pos_infin);
+Result<std::span<const UdpMcastDriver::AddressedResponseView>>
+UdpMcastDriver::Impl::ReadBatchFrom(unsigned int timeout_ms) {
+  if (!socket_.is_open()) {
+    return Err(ErrorCode::kNotConnected);
+  }
+
+  if (slab_.empty()) {
+    slab_.resize(kMaxBatchSize * kBufLen);
+  }
+
+  const auto deadline = std::chrono::steady_clock::now() +
+                        std::chrono::milliseconds(timeout_ms);
+
+  boost::system::error_code ec;
+  std::size_t count{};
+
+  // a wakeup may find nothing to read, so wait again for what's left of the
+  // timeout
+  while (count == 0) {
+    const auto remaining = std::chrono::ceil<std::chrono::milliseconds>(
+        deadline - std::chrono::steady_clock::now());
+
+    const bool completed = RunBlocking([&](auto done) {
+      StartDeadline(static_cast<unsigned int>(
+          std::max<std::chrono::milliseconds::rep>(remaining.count(), 0)));
+      socket_.async_wait(udp::socket::wait_read, [&, done](auto&& e) {
+        done([&] {
+          boost::system::error_code ignored;
+          deadline_.cancel(ignored);
+          ec = e;
+          if (!ec) {
+            count = ReceiveBatch(ec);
+          }
+        });
+      });
+    });
+
+    if (!completed) {
+      return Err(ErrorCode::kNotConnected);
+    }
+
+    if (timeout_) {
+      return Err(ErrorCode::kReadTimedOut);
+    }
+
+    if (ec) {
+      return Err(ErrorCode::kReadFailed);
+    }
+  }
+
+  return std::span<const AddressedResponseView>{batch_.data(), count};
+}
+
+ErrorCode UdpMcastDriver::Impl::SetReceiveBufferSize(std::size_t bytes) {
+  rx_buf_size_ = bytes;
+  if (!socket_.is_open()) {
+    return ErrorCode::kSuccess;
+  }
+
+  boost::system::error_code ec;
+  boost::asio::socket_base::receive_buffer_size rx_buf_opt{
+      static_cast<int>(rx_buf_size_)};
+  socket_.set_option(rx_buf_opt, ec);
+  return ec ? ErrorCode::kSocketError : ErrorCode::kSuccess;
+}
+
+std::size_t UdpMcastDriver::Impl::ReceiveBatch(boost::system::error_code& ec) {
+#ifdef __linux__
+  std::array<mmsghdr, kMaxBatchSize> msgs{};
+  std::array<iovec, kMaxBatchSize> iovs{};
+  std::array<sockaddr_in, kMaxBatchSize> sources{};
+  for (std::size_t i = 0; i < kMaxBatchSize; ++i) {
+    iovs[i].iov_base = slab_.data() + i * kBufLen;
+    iovs[i].iov_len = kBufLen;
+    msgs[i].msg_hdr.msg_iov = &iovs[i];
+    msgs[i].msg_hdr.msg_iovlen = 1;
+    msgs[i].msg_hdr.msg_name = &sources[i];
+    msgs[i].msg_hdr.msg_namelen = sizeof(sources[i]);
+  }
+
+  const int n = ::recvmmsg(socket_.native_handle(), msgs.data(), kMaxBatchSize,
+                           MSG_DONTWAIT, nullptr);
+  if (n < 0) {
+    if (errno != EAGAIN && errno != EWOULDBLOCK) {
+      ec = boost::system::error_code(errno, boost::system::system_category());
+    }
+    return 0;
   }
 
-  deadline_.async_wait([&](auto&&) { this->CheckDeadline(); });
+  const auto count = static_cast<std::size_t>(n);
+  for (std::size_t i = 0; i < count; ++i) {
+    boost::asio::ip::address_v4::bytes_type ip;
+    std::memcpy(ip.data(), &sources[i].sin_addr, ip.size());
+    SetBatchEntry(i, ip, msgs[i].msg_len);
+  }
+  return count;
+#else
+  // one datagram per call until the socket would block
+  std::size_t count = 0;
+  while (count < kMaxBatchSize) {
+    udp::endpoint source;
+    boost::system::error_code recv_ec;
+    const auto len = socket_.receive_from(
+        boost::asio::buffer(slab_.data() + count * kBufLen, kBufLen), source, 0,
+        recv_ec);
+    if (recv_ec) {
+      // the datagrams already received are returned, and an error which
+      // persists is reported by the next read
+      if (count == 0 && recv_ec != boost::asio::error::would_block) {
+        ec = recv_ec;
+      }
+      break;
+    }
+    SetBatchEntry(count++, source.address().to_v4().to_bytes(), len);
+  }
+  return count;
+#endif
+}
+
+void UdpMcastDriver::Impl::SetBatchEntry(
+    std::size_t index, const boost::asio::ip::address_v4::bytes_type& ip,
+    std::size_t len) {
+  auto& ip_buf = batch_ips_[index];
+  const auto ip_len =
+      fmt::format_to_n(ip_buf.data(), ip_buf.size(), "{}.{}.{}.{}", ip[0],
+                       ip[1], ip[2], ip[3])
+          .size;
+  batch_[index] = AddressedResponseView{
+      std::string_view{ip_buf.data(), ip_len},
+      std::string_view{slab_.data() + index * kBufLen, len}};
+}
+
+template <class Start>
+bool UdpMcastDriver::Impl::RunBlocking(Start&& start) {
+  auto wait = std::make_shared<BlockingWait>(io_service_, context_);
+  if (wait->Stopped()) {
+    return false;
+  }
+  // start is only used while the caller is still waiting
+  boost::asio::post(strand_, [&start, wait] {
+    wait->Start([&] { start(BlockingWait::Done{wait}); });
+  });
+  if (!wait->Wait()) {
+    // nothing runs the stopped io_service, so it's safe to cancel from here,
+    // which keeps the operation from using the caller's buffers if it's
+    // restarted
+    boost::system::error_code ignored;
+    socket_.cancel(ignored);
+    deadline_.cancel(ignored);
+    return false;
+  }
+  return true;
+}
+
+void UdpMcastDriver::Impl::StartDeadline(unsigned int timeout_ms) {
+  timeout_ = false;
+  deadline_.expires_from_now(boost::posix_time::milliseconds(timeout_ms));
+  deadline_.async_wait([this](const boost::system::error_code& e) {
+    if (e != boost::asio::error::operation_aborted) {
+      timeout_ = true;
+      boost::system::error_code ignored;
+      socket_.cancel(ignored);
+    }
+  });
 }
 
 }  // namespace bci::abs::drivers